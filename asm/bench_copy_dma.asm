@@ -0,0 +1,40 @@
+; DMA benchmark: copy 1024 words from x4000 to x5000 with the
+; DMA engine, then halt. Compare the cycle count reported at
+; halt against bench_copy_sw.asm. Run without an OS (the DMA
+; registers are in I/O space, so we need supervisor mode):
+;   build/sim -b binaries/bench_copy_dma.bin -q
+.ORIG x3000
+    LD R0, SRC
+    STI R0, DMASRC
+    LD R0, DST
+    STI R0, DMADST
+    LD R0, LEN
+    STI R0, DMALEN
+    AND R0, R0, #0
+    ADD R0, R0, #1      ;; go (copy mode, no interrupt)
+    STI R0, DMACTL
+WAIT
+    LDI R0, DMACTL      ;; spin until the done bit (15) is set
+    BRzp WAIT
+    AND R0, R0, #0
+    STI R0, MCR         ;; halt
+DONE
+    BRnzp DONE
+
+SRC
+    .FILL x4000
+DST
+    .FILL x5000
+LEN
+    .FILL #1024
+DMASRC
+    .FILL xFE10
+DMADST
+    .FILL xFE12
+DMALEN
+    .FILL xFE14
+DMACTL
+    .FILL xFE16
+MCR
+    .FILL xFFFE
+.END
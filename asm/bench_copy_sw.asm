@@ -0,0 +1,28 @@
+; DMA benchmark baseline: copy 1024 words from x4000 to x5000
+; with an LDR/STR loop, then halt. See bench_copy_dma.asm.
+;   build/sim -b binaries/bench_copy_sw.bin -q
+.ORIG x3000
+    LD R1, SRC
+    LD R2, DST
+    LD R3, LEN
+LOOP
+    LDR R0, R1, #0
+    STR R0, R2, #0
+    ADD R1, R1, #1
+    ADD R2, R2, #1
+    ADD R3, R3, #-1
+    BRp LOOP
+    AND R0, R0, #0
+    STI R0, MCR         ;; halt
+DONE
+    BRnzp DONE
+
+SRC
+    .FILL x4000
+DST
+    .FILL x5000
+LEN
+    .FILL #1024
+MCR
+    .FILL xFFFE
+.END
@@ -0,0 +1,37 @@
+; DMA benchmark: clear 1024 words at x5000 with the DMA engine
+; in fill mode, then halt. Compare the cycle count reported at
+; halt against bench_fill_sw.asm.
+;   build/sim -b binaries/bench_fill_dma.bin -q
+.ORIG x3000
+    AND R0, R0, #0
+    STI R0, DMASRC      ;; fill value
+    LD R0, DST
+    STI R0, DMADST
+    LD R0, LEN
+    STI R0, DMALEN
+    AND R0, R0, #0
+    ADD R0, R0, #3      ;; go, fill mode (no interrupt)
+    STI R0, DMACTL
+WAIT
+    LDI R0, DMACTL      ;; spin until the done bit (15) is set
+    BRzp WAIT
+    AND R0, R0, #0
+    STI R0, MCR         ;; halt
+DONE
+    BRnzp DONE
+
+DST
+    .FILL x5000
+LEN
+    .FILL #1024
+DMASRC
+    .FILL xFE10
+DMADST
+    .FILL xFE12
+DMALEN
+    .FILL xFE14
+DMACTL
+    .FILL xFE16
+MCR
+    .FILL xFFFE
+.END
@@ -0,0 +1,23 @@
+; DMA benchmark baseline: clear 1024 words at x5000 with a STR
+; loop, then halt. See bench_fill_dma.asm.
+;   build/sim -b binaries/bench_fill_sw.bin -q
+.ORIG x3000
+    AND R0, R0, #0
+    LD R2, DST
+    LD R3, LEN
+LOOP
+    STR R0, R2, #0
+    ADD R2, R2, #1
+    ADD R3, R3, #-1
+    BRp LOOP
+    STI R0, MCR         ;; halt (R0 is still 0)
+DONE
+    BRnzp DONE
+
+DST
+    .FILL x5000
+LEN
+    .FILL #1024
+MCR
+    .FILL xFFFE
+.END
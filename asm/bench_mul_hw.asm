@@ -0,0 +1,28 @@
+; MUL/DIV/MOD benchmark: same sum as bench_mul_sw.asm, with
+; the multiply/divide unit (opcode 1101). Needs the in-tree
+; assembler (asm3503), which knows the new mnemonics.
+;   build/sim -b binaries/bench_mul_hw.bin -q
+.ORIG x3000
+    AND R4, R4, #0
+    LD R3, N
+LOOP
+    MUL R0, R3, R3
+    DIV R1, R0, #7
+    MOD R2, R0, #7
+    ADD R4, R4, R1
+    ADD R4, R4, R2
+    ADD R3, R3, #-1
+    BRp LOOP
+    ST R4, RESULT
+    AND R0, R0, #0
+    STI R0, MCR         ;; halt
+DONE
+    BRnzp DONE
+
+N
+    .FILL #100
+RESULT
+    .BLKW 1
+MCR
+    .FILL xFFFE
+.END
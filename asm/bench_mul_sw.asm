@@ -0,0 +1,73 @@
+; MUL/DIV/MOD benchmark baseline: for i = 100 down to 1, add
+; (i*i)/7 and (i*i)%7 into R4, then halt. Multiply and divide
+; are shift-and-add / shift-and-subtract subroutines.
+; See bench_mul_hw.asm.
+;   build/sim -b binaries/bench_mul_sw.bin -q
+.ORIG x3000
+    AND R4, R4, #0
+    LD R3, N
+LOOP
+    ADD R1, R3, #0
+    ADD R2, R3, #0
+    JSR MULT            ;; R0 = i*i
+    ADD R1, R0, #0
+    AND R2, R2, #0
+    ADD R2, R2, #7
+    JSR DIVMOD          ;; R0 = i*i / 7, R1 = i*i % 7
+    ADD R4, R4, R0
+    ADD R4, R4, R1
+    ADD R3, R3, #-1
+    BRp LOOP
+    ST R4, RESULT
+    AND R0, R0, #0
+    STI R0, MCR         ;; halt
+DONE
+    BRnzp DONE
+
+; R0 = R1 * R2 (low 16 bits). Clobbers R1, R5, R6
+MULT
+    AND R0, R0, #0
+    ADD R5, R0, #1      ;; mask
+MLOOP
+    AND R6, R2, R5
+    BRz MSKIP
+    ADD R0, R0, R1
+MSKIP
+    ADD R1, R1, R1
+    ADD R5, R5, R5
+    BRnp MLOOP          ;; until the mask shifts out
+    RET
+
+; R0 = R1 / R2, R1 = R1 % R2 (unsigned, small R2 > 0).
+; Clobbers R2, R5, R6
+DIVMOD
+    NOT R2, R2
+    ADD R2, R2, #1      ;; -divisor
+    ADD R0, R1, #0      ;; quotient bits shift in from the right
+    AND R1, R1, #0      ;; remainder
+    AND R5, R5, #0
+    ADD R5, R5, #8
+    ADD R5, R5, R5      ;; 16 bits
+DLOOP
+    ADD R1, R1, R1
+    ADD R0, R0, #0
+    BRzp DSHIFT
+    ADD R1, R1, #1      ;; top bit of the dividend
+DSHIFT
+    ADD R0, R0, R0
+    ADD R6, R1, R2
+    BRn DNEXT
+    ADD R1, R6, #0
+    ADD R0, R0, #1
+DNEXT
+    ADD R5, R5, #-1
+    BRp DLOOP
+    RET
+
+N
+    .FILL #100
+RESULT
+    .BLKW 1
+MCR
+    .FILL xFFFE
+.END
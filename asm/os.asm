@@ -409,7 +409,7 @@
     ;
 	.FILL INT_KBD_HANDLER 	; x80
 	.FILL INT_NULL_HANDLER	; x81
-	.FILL INT_NULL_HANDLER	; x82
+	.FILL INT_TX_HANDLER	; x82
 	.FILL INT_NULL_HANDLER	; x83
 	.FILL INT_NULL_HANDLER	; x84
 	.FILL INT_NULL_HANDLER	; x85
@@ -591,7 +591,6 @@ INIT_PSR .FILL x8002 ; Priv=1, Prio=0, N=0, Z=1, P=0
 ;; Register save area for handlers
 ;;
 PUTS_R2_SAVE.BLKW 1
-OUT_R1_SAVE .BLKW 1
 IN_R0_SAVE  .BLKW 1
 KBD_R0_SAVE .BLKW 1
 KBD_R1_SAVE .BLKW 1
@@ -621,15 +620,6 @@ PUTS_LOOP
 DONE_PUTS
     LD R2, PUTS_R2_SAVE
     RTI
-    
-TRAP_OUT_HANDLER
-    ST R1, OUT_R1_SAVE
-DISPLAYWAIT
-    LDI R1, DSR
-    BRzp DISPLAYWAIT
-    STI R0, DDR         ; char comes in in R0
-    LD R1, OUT_R1_SAVE
-    RTI
 
 
 
@@ -732,10 +722,7 @@ SR8_HI_MASK .FILL xFF00
 TRAP_HALT_HANDLER              ; we don't come back from a HALT, so no need to save regs
 	LEA R0, TRAP_HALT_MSG
 	PUTS
-    LD R3, DELAY
-DELAY_LOOP
-    ADD R3, R3, #-1
-    BRp DELAY_LOOP
+    JSR TX_FLUSH               ; make sure all of our output makes it out
 	LDI R0, MCR	   
 	LD R1, MASK_HI
 	AND R0, R0, R1             ; clear the "clock enable" bit (bit 15)
@@ -743,7 +730,6 @@ DELAY_LOOP
 STAY_HALTED
 	BRnzp STAY_HALTED          ; this instruction shouldn't actually execute...
 
-DELAY .FILL x0FFF
 TRAP_HALT_MSG        .STRINGZ "techOS requesting machine halt.\n"
 
 
@@ -758,6 +744,10 @@ TRAP_NULL_TRAP_MSG .STRINGZ "\ntechOS encountered an unhandled TRAP.\n"
 INT_KBD_HANDLER
     ST R0, KBD_R0_SAVE
     ST R1, KBD_R1_SAVE
+KBD_DRAIN
+    LDI R0, KBDR        ; the interrupt stays up until we've taken
+    LDI R1, KBSR        ; everything out of the keyboard FIFO
+    BRn KBD_DRAIN
     LEA R0, TRAP_FOO
     PUTS
     LD R0, KBD_R0_SAVE
@@ -804,5 +794,176 @@ INT_NULL_HANDLER
 
 INT_NULL_INT_MSG    .STRINGZ "\nUnhandled interrupt.\n"
 
+;;
+;; Serial output. The serial port has a small FIFO (DSR[15] means
+;; "not full"), and we keep a bigger ring buffer in front of it, so
+;; OUT only has to wait on the line when the ring fills up. The TX
+;; interrupt (x82, raised while the FIFO runs low) moves characters
+;; from the ring to the FIFO in bursts.
+;;
+;; OUT runs at priority 4, so neither the TX interrupt nor an ISR
+;; that prints (e.g., the keyboard's) can get in while it's using
+;; the ring. Anyone else who takes from the ring (TX_SEND_ONE) turns
+;; the TX interrupt off first.
+;;
+TRAP_OUT_HANDLER
+    ADD R6, R6, #-1
+    STR R1, R6, #0      ; not safe to use OUT_R1_SAVE yet
+    LD R1, OUT_PSR
+    ADD R6, R6, #-1
+    STR R1, R6, #0
+    LEA R1, OUT_ATOMIC
+    ADD R6, R6, #-1
+    STR R1, R6, #0
+    RTI                 ; "return" to OUT_ATOMIC at priority 4
+OUT_ATOMIC
+    LDR R1, R6, #0
+    ADD R6, R6, #1
+    ST R1, OUT_R1_SAVE
+    ST R2, OUT_R2_SAVE
+    ST R3, OUT_R3_SAVE
+    ST R7, OUT_R7_SAVE
+    LD R1, TX_HEAD
+    LD R2, TX_TAIL
+    NOT R3, R1
+    ADD R3, R3, #1
+    ADD R3, R2, R3      ; R3 <- tail - head
+    BRnp OUT_QUEUE      ; ring isn't empty, so get in line
+    LDI R3, TX_DSR
+    BRzp OUT_QUEUE      ; FIFO is full
+    STI R0, TX_DDR      ; char comes in in R0, straight into the FIFO
+    BRnzp OUT_DONE
+OUT_QUEUE
+    LD R1, TX_MASK
+    ADD R3, R2, #1
+    AND R3, R3, R1      ; R3 <- next tail
+    LD R1, TX_HEAD
+    NOT R1, R1
+    ADD R1, R1, #1
+    ADD R1, R3, R1
+    BRnp OUT_ROOM
+    JSR TX_SEND_ONE     ; ring is full, make room ourselves
+OUT_ROOM
+    LD R1, TX_RING_PTR
+    ADD R1, R1, R2
+    STR R0, R1, #0      ; ring[tail] <- char
+    ST R3, TX_TAIL      ; ...and only then publish it
+    LD R1, TX_INT_ENABLE
+    STI R1, TX_DSR      ; the TX interrupt takes it from here
+OUT_DONE
+    LD R7, OUT_R7_SAVE
+    LD R3, OUT_R3_SAVE
+    LD R2, OUT_R2_SAVE
+    LD R1, OUT_R1_SAVE
+    RTI                 ; back to the caller's priority, too
+
+
+INT_TX_HANDLER
+    ST R0, TXI_R0_SAVE
+    ST R1, TXI_R1_SAVE
+    ST R2, TXI_R2_SAVE
+TXI_LOOP
+    LD R0, TX_HEAD
+    LD R1, TX_TAIL
+    NOT R2, R1
+    ADD R2, R2, #1
+    ADD R2, R0, R2      ; R2 <- head - tail
+    BRz TXI_EMPTY
+    LDI R2, TX_DSR
+    BRzp TXI_DONE       ; FIFO is full again, wait for the next interrupt
+    LD R1, TX_RING_PTR
+    ADD R1, R1, R0
+    LDR R1, R1, #0
+    STI R1, TX_DDR      ; FIFO <- ring[head]
+    LD R1, TX_MASK
+    ADD R0, R0, #1
+    AND R0, R0, R1
+    ST R0, TX_HEAD
+    BRnzp TXI_LOOP
+TXI_EMPTY
+    AND R0, R0, #0
+    STI R0, TX_DSR      ; nothing left to send, turn the interrupt off
+TXI_DONE
+    LD R2, TXI_R2_SAVE
+    LD R1, TXI_R1_SAVE
+    LD R0, TXI_R0_SAVE
+    RTI
+
+
+; Moves one char from the ring to the FIFO, waiting on the line if
+; it has to. Leaves the TX interrupt off. Clobbers R1.
+TX_SEND_ONE
+    ST R0, TX1_R0_SAVE
+    AND R1, R1, #0
+    STI R1, TX_DSR      ; TX interrupt off, TX_HEAD is ours now
+    LD R0, TX_HEAD
+    LD R1, TX_TAIL
+    NOT R1, R1
+    ADD R1, R1, #1
+    ADD R1, R0, R1
+    BRz TX1_DONE        ; the handler emptied it before we got here
+TX1_WAIT
+    LDI R1, TX_DSR
+    BRzp TX1_WAIT
+    LD R1, TX_RING_PTR
+    ADD R1, R1, R0
+    LDR R1, R1, #0
+    STI R1, TX_DDR
+    LD R1, TX_MASK
+    ADD R0, R0, #1
+    AND R0, R0, R1
+    ST R0, TX_HEAD
+TX1_DONE
+    LD R0, TX1_R0_SAVE
+    RET
+
+
+; Sends everything still in the ring, and waits for it to go out
+; on the line. For HALT, which may be running in an ISR, so it can't
+; count on the TX interrupt. Clobbers R0, R1.
+TX_FLUSH
+    ST R7, TXF_R7_SAVE
+TXF_LOOP
+    LD R0, TX_HEAD
+    LD R1, TX_TAIL
+    NOT R1, R1
+    ADD R1, R1, #1
+    ADD R1, R0, R1
+    BRz TXF_DRAIN
+    JSR TX_SEND_ONE
+    BRnzp TXF_LOOP
+TXF_DRAIN
+    LDI R0, TX_DSR
+    LD R1, TX_IDLE
+    AND R0, R0, R1
+    BRz TXF_DRAIN       ; wait for the last char to leave the serial port
+    LD R7, TXF_R7_SAVE
+    RET
+
+
+TX_DSR        .FILL xFE04
+TX_DDR        .FILL xFE06
+TX_INT_ENABLE .FILL x4000
+TX_IDLE       .FILL x2000
+
+OUT_PSR       .FILL x0400 ; supervisor, priority 4
+
+TX_HEAD     .FILL x0000     ; next char to hand to the FIFO
+TX_TAIL     .FILL x0000     ; next free slot
+TX_MASK     .FILL x003F     ; ring holds TX_MASK chars
+TX_RING_PTR .FILL TX_RING
+
+OUT_R1_SAVE .BLKW 1
+OUT_R2_SAVE .BLKW 1
+OUT_R3_SAVE .BLKW 1
+OUT_R7_SAVE .BLKW 1
+TXI_R0_SAVE .BLKW 1
+TXI_R1_SAVE .BLKW 1
+TXI_R2_SAVE .BLKW 1
+TX1_R0_SAVE .BLKW 1
+TXF_R7_SAVE .BLKW 1
+
+TX_RING     .BLKW 64
+
 	.END
 
@@ -0,0 +1,51 @@
+; Shared counter: every core adds 1 to COUNT N times, holding
+; LOCK0 around each add. Core 0 waits for the others to check
+; in, then halts with COUNT = N * cores (NEGCORES has to
+; match the build).
+;   make CORES=2 sim && build/sim -b binaries/smp_count.bin -a x3000 -q
+.ORIG x3000
+    LD R1, N
+LOOP
+    LDI R0, LOCK0       ;; test-and-set: 0 means we got it
+    BRnp LOOP
+    LD R2, COUNT
+    ADD R2, R2, #1
+    ST R2, COUNT
+    STI R0, LOCK0       ;; any write releases it
+    ADD R1, R1, #-1
+    BRp LOOP
+CHECKIN
+    LDI R0, LOCK0
+    BRnp CHECKIN
+    LD R2, DONE
+    ADD R2, R2, #1
+    ST R2, DONE
+    STI R0, LOCK0
+    LDI R3, CPUID
+    BRnp STOP           ;; not core 0
+WAIT
+    LD R2, DONE
+    LD R3, NEGCORES
+    ADD R2, R2, R3
+    BRn WAIT
+STOP
+    AND R0, R0, #0
+    STI R0, MCR         ;; halt (this core)
+SPIN
+    BRnzp SPIN
+
+N
+    .FILL #100
+NEGCORES
+    .FILL #-2
+COUNT
+    .FILL #0
+DONE
+    .FILL #0
+LOCK0
+    .FILL xFE30
+CPUID
+    .FILL xFE20
+MCR
+    .FILL xFFFE
+.END
@@ -0,0 +1,156 @@
+/*
+ * asm3503: command line front end for the in-tree assembler
+ * (src/cpp/asm.cpp).
+ *
+ *   asm3503 [-o out.obj | -d dir] [-x .ext] [-q] file.asm...
+ *
+ * For every input, writes the object file (foo.obj next to foo.asm,
+ * or in the directory -d names, or wherever -o says when there's only
+ * one input; -x changes the .obj), its symbol table
+ * (.sym) and its line table (.lines) next to the object file. Any
+ * number of files can go through one process, which is much cheaper
+ * than starting an assembler per file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <string>
+
+#include "common.h"
+#include "asm.h"
+
+static void
+print_usage (const char * prog)
+{
+    SUGGESTION_PRINT("Usage: " UNBOLD("%s [options] <file.asm>..."), prog);
+    SUGGESTION_PRINT("Options:");
+    SUGGESTION_PRINT("  " UNBOLD("--output ") "or " UNBOLD("-o <path>") ": Write the object file to " UNBOLD("<path>") " (one input only). The .sym and .lines files go next to it");
+    SUGGESTION_PRINT("  " UNBOLD("--dir    ") "or " UNBOLD("-d <dir> ") ": Write the object files to " UNBOLD("<dir>") " instead of next to their sources");
+    SUGGESTION_PRINT("  " UNBOLD("--ext    ") "or " UNBOLD("-x <ext> ") ": Give the object files the extension " UNBOLD("<ext>") " (default .obj)");
+    SUGGESTION_PRINT("  " UNBOLD("--quiet  ") "or " UNBOLD("-q       ") ": Only print errors");
+}
+
+static struct option long_options[] = {
+    {"output", required_argument, 0, 'o'},
+    {"dir",    required_argument, 0, 'd'},
+    {"ext",    required_argument, 0, 'x'},
+    {"quiet",  no_argument, 0, 'q'},
+    {"help",   no_argument, 0, 'h'},
+    {0, 0, 0, 0}};
+
+
+// path with its extension (if any) swapped for ext
+static std::string
+with_ext (const std::string & path, const char * ext)
+{
+    size_t slash = path.find_last_of('/');
+    size_t dot   = path.find_last_of('.');
+
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path + ext;
+    }
+    return path.substr(0, dot) + ext;
+}
+
+
+static int
+assemble_one (const char * in, const std::string & out, bool quiet)
+{
+    asm_result_t * r = asm_assemble_file(in);
+
+    if (!r) {
+        ERROR_PRINT("%s: out of memory", in);
+        return -1;
+    }
+
+    if (r->error[0]) {
+        ERROR_PRINT("%s", r->error);
+        asm_free(r);
+        return -1;
+    }
+
+    std::string sym   = with_ext(out, ".sym");
+    std::string lines = with_ext(out, ".lines");
+
+    int ret = 0;
+    if (asm_write_obj(r, out.c_str())) {
+        ERROR_PRINT("Could not write '%s'", out.c_str());
+        ret = -1;
+    } else if (asm_write_sym(r, sym.c_str())) {
+        ERROR_PRINT("Could not write '%s'", sym.c_str());
+        ret = -1;
+    } else if (asm_write_lines(r, lines.c_str())) {
+        ERROR_PRINT("Could not write '%s'", lines.c_str());
+        ret = -1;
+    } else if (!quiet) {
+        printf("%s: %zu words at x%04X, %zu symbols\n", in, r->nwords, r->orig, r->nsyms);
+    }
+
+    asm_free(r);
+    return ret;
+}
+
+
+int
+main (int argc, char ** argv)
+{
+    const char * out = NULL;
+    const char * dir = NULL;
+    const char * ext = ".obj";
+    bool quiet = false;
+
+    while (1) {
+        int c = getopt_long(argc, argv, "o:d:x:qh", long_options, NULL);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+            case 'o':
+                out = optarg;
+                break;
+            case 'd':
+                dir = optarg;
+                break;
+            case 'x':
+                ext = optarg;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind == argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (out && argc - optind > 1) {
+        ERROR_PRINT("-o only works with one input");
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = optind; i < argc; i++) {
+        std::string obj = out ? std::string(out) : with_ext(argv[i], ext);
+        if (!out && dir) {
+            size_t slash = obj.find_last_of('/');
+            obj = std::string(dir) + "/" + (slash == std::string::npos ? obj : obj.substr(slash + 1));
+        }
+        if (assemble_one(argv[i], obj, quiet)) {
+            failed++;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,792 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "asm.h"
+
+/*
+ * Two passes over the source: the first splits it into statements and
+ * gives every statement (and label) its address, the second encodes.
+ * Tokens point into the source buffer, so nothing is copied except
+ * .STRINGZ text and the symbol names that end up in the result.
+ */
+
+namespace {
+
+enum kind {
+    K_ALU,      // ADD/AND DR, SR1, SR2|imm5
+    K_NOT,      // NOT DR, SR
+    K_PC9,      // LD/LDI/LEA/ST/STI R, label|offset9
+    K_BASE,     // LDR/STR R, BaseR, offset6
+    K_BR,       // BRnzp label|offset9
+    K_JSR,      // JSR label|offset11
+    K_REG,      // JMP/JSRR BaseR
+    K_TRAP,     // TRAP trapvect8
+    K_MD,       // MUL/DIV/MOD DR, SR1, SR2|imm3
+    K_FIXED,    // RET, RTI, the trap aliases
+    D_ORIG,
+    D_END,
+    D_FILL,
+    D_BLKW,
+    D_STRINGZ,
+};
+
+struct mnemonic {
+    const char * name;
+    kind k;
+    uint16_t bits;
+};
+
+const mnemonic mnemonics[] = {
+    {"ADD",   K_ALU,   0x1000},
+    {"AND",   K_ALU,   0x5000},
+    {"NOT",   K_NOT,   0x903F},
+    {"LD",    K_PC9,   0x2000},
+    {"LDI",   K_PC9,   0xA000},
+    {"LEA",   K_PC9,   0xE000},
+    {"ST",    K_PC9,   0x3000},
+    {"STI",   K_PC9,   0xB000},
+    {"LDR",   K_BASE,  0x6000},
+    {"STR",   K_BASE,  0x7000},
+    {"BR",    K_BR,    0x0E00},
+    {"BRN",   K_BR,    0x0800},
+    {"BRZ",   K_BR,    0x0400},
+    {"BRP",   K_BR,    0x0200},
+    {"BRNZ",  K_BR,    0x0C00},
+    {"BRNP",  K_BR,    0x0A00},
+    {"BRZP",  K_BR,    0x0600},
+    {"BRNZP", K_BR,    0x0E00},
+    {"JMP",   K_REG,   0xC000},
+    {"JSRR",  K_REG,   0x4000},
+    {"JSR",   K_JSR,   0x4800},
+    {"RET",   K_FIXED, 0xC1C0},
+    {"RTI",   K_FIXED, 0x8000},
+    {"TRAP",  K_TRAP,  0xF000},
+    {"GETC",  K_FIXED, 0xF020},
+    {"OUT",   K_FIXED, 0xF021},
+    {"PUTS",  K_FIXED, 0xF022},
+    {"IN",    K_FIXED, 0xF023},
+    {"PUTSP", K_FIXED, 0xF024},
+    {"HALT",  K_FIXED, 0xF025},
+    {"MUL",   K_MD,    0xD008},
+    {"DIV",   K_MD,    0xD010},
+    {"MOD",   K_MD,    0xD018},
+    {".ORIG",    D_ORIG,    0},
+    {".END",     D_END,     0},
+    {".FILL",    D_FILL,    0},
+    {".BLKW",    D_BLKW,    0},
+    {".STRINGZ", D_STRINGZ, 0},
+};
+
+#define MAX_MNEMONIC 8
+#define MAX_OPERANDS 3
+
+struct token {
+    const char * p;
+    size_t len;
+};
+
+struct statement {
+    uint32_t line;
+    uint16_t addr;
+    const mnemonic * m;
+    int n;
+    token t[MAX_OPERANDS];
+    std::string str;    // .STRINGZ only, escapes done
+};
+
+struct assembler {
+    const char * name;
+    char * error;
+    std::vector<statement> stmts;
+    std::unordered_map<std::string, uint16_t> syms;
+    std::vector<std::pair<std::string, uint16_t>> order;
+    bool have_orig;
+    uint16_t orig;
+    uint32_t size;
+};
+
+
+const mnemonic *
+find_mnemonic (const token & t)
+{
+    static const std::unordered_map<std::string, const mnemonic *> table = [] {
+        std::unordered_map<std::string, const mnemonic *> t;
+        for (const mnemonic & m : mnemonics) {
+            t[m.name] = &m;
+        }
+        return t;
+    }();
+
+    if (t.len > MAX_MNEMONIC) {
+        return NULL;
+    }
+
+    char up[MAX_MNEMONIC + 1];
+    for (size_t i = 0; i < t.len; i++) {
+        up[i] = toupper((unsigned char)t.p[i]);
+    }
+    up[t.len] = 0;
+
+    auto it = table.find(up);
+    return it == table.end() ? NULL : it->second;
+}
+
+
+bool __attribute__((format(printf, 3, 4)))
+fail (assembler & a, uint32_t line, const char * fmt, ...)
+{
+    int n = snprintf(a.error, sizeof(((asm_result_t*)0)->error), "%s:%u: ", a.name, line);
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(a.error + n, sizeof(((asm_result_t*)0)->error) - n, fmt, ap);
+    va_end(ap);
+
+    return false;
+}
+
+
+bool
+parse_num (const token & t, long * v)
+{
+    const char * p = t.p;
+    const char * e = t.p + t.len;
+    int base = 10;
+
+    if (p < e && *p == '#') {
+        p++;
+    } else if (p < e && (*p == 'x' || *p == 'X')) {
+        p++;
+        base = 16;
+    } else if (e - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        base = 16;
+    }
+
+    bool neg = p < e && *p == '-';
+    if (neg) {
+        p++;
+    }
+
+    if (p == e) {
+        return false;
+    }
+
+    long n = 0;
+    for (; p < e; p++) {
+        int d;
+        if (isdigit((unsigned char)*p)) {
+            d = *p - '0';
+        } else if (base == 16 && isxdigit((unsigned char)*p)) {
+            d = toupper((unsigned char)*p) - 'A' + 10;
+        } else {
+            return false;
+        }
+        n = n * base + d;
+        if (n > 0x1FFFF) {
+            return false; // nothing that big fits anywhere
+        }
+    }
+
+    *v = neg ? -n : n;
+    return true;
+}
+
+
+bool
+is_ident (const token & t)
+{
+    if (!t.len || !(isalpha((unsigned char)t.p[0]) || t.p[0] == '_')) {
+        return false;
+    }
+    for (size_t i = 1; i < t.len; i++) {
+        if (!(isalnum((unsigned char)t.p[i]) || t.p[i] == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int
+parse_reg (const token & t)
+{
+    if (t.len == 2 && (t.p[0] == 'R' || t.p[0] == 'r') && t.p[1] >= '0' && t.p[1] <= '7') {
+        return t.p[1] - '0';
+    }
+    return -1;
+}
+
+
+// one line of source into tokens (and, for .STRINGZ, its string).
+// Returns the number of tokens, or -1 on a syntax error.
+int
+split_line (assembler & a, const char * p, const char * e, uint32_t line,
+            token * toks, int max, std::string * str, bool * has_str)
+{
+    int n = 0;
+    *has_str = false;
+
+    while (p < e) {
+        char c = *p;
+
+        if (c == ';') {
+            break;
+        }
+
+        if (c == ' ' || c == '\t' || c == ',' || c == '\r') {
+            p++;
+            continue;
+        }
+
+        if (c == '"') {
+            if (*has_str) {
+                fail(a, line, "more than one string");
+                return -1;
+            }
+            *has_str = true;
+            for (p++; p < e && *p != '"'; p++) {
+                if (*p != '\\') {
+                    str->push_back(*p);
+                    continue;
+                }
+                if (++p == e) {
+                    break;
+                }
+                switch (*p) {
+                    case 'n':  str->push_back('\n'); break;
+                    case 't':  str->push_back('\t'); break;
+                    case 'r':  str->push_back('\r'); break;
+                    case 'e':  str->push_back('\033'); break;
+                    case '0':  str->push_back('\0'); break;
+                    case '\\': str->push_back('\\'); break;
+                    case '"':  str->push_back('"'); break;
+                    default:
+                        fail(a, line, "unknown escape '\\%c'", *p);
+                        return -1;
+                }
+            }
+            if (p == e) {
+                fail(a, line, "unterminated string");
+                return -1;
+            }
+            p++;
+            continue;
+        }
+
+        // like lc3as, a '.' starts a new token ("LABEL.BLKW 1")
+        const char * s = p++;
+        while (p < e && *p != ' ' && *p != '\t' && *p != ',' && *p != ';' && *p != '"' && *p != '\r' && *p != '.') {
+            p++;
+        }
+
+        if (n == max) {
+            fail(a, line, "too many operands");
+            return -1;
+        }
+        toks[n].p   = s;
+        toks[n].len = p - s;
+        n++;
+    }
+
+    return n;
+}
+
+
+unsigned
+words_of (const statement & s, long blkw)
+{
+    switch (s.m->k) {
+        case D_ORIG:
+        case D_END:     return 0;
+        case D_BLKW:    return (unsigned)blkw;
+        case D_STRINGZ: return s.str.size() + 1;
+        default:        return 1;
+    }
+}
+
+
+bool
+pass1 (assembler & a, const char * src, size_t len)
+{
+    const char * p   = src;
+    const char * end = src + len;
+    uint32_t line    = 0;
+    uint32_t pc      = 0;
+
+    while (p < end) {
+        const char * e = (const char *)memchr(p, '\n', end - p);
+        if (!e) {
+            e = end;
+        }
+        line++;
+
+        token toks[1 + 1 + MAX_OPERANDS];
+        statement s;
+        bool has_str;
+        int n = split_line(a, p, e, line, toks, 1 + 1 + MAX_OPERANDS, &s.str, &has_str);
+        p = e + 1;
+
+        if (n < 0) {
+            return false;
+        }
+        if (!n) {
+            if (has_str) {
+                return fail(a, line, "string without .STRINGZ");
+            }
+            continue;
+        }
+
+        token * t = toks;
+        const mnemonic * m = find_mnemonic(t[0]);
+
+        if (!m) {
+            token label = t[0];
+            if (label.len > 1 && label.p[label.len - 1] == ':') {
+                label.len--;
+            }
+            if (!is_ident(label) || parse_reg(label) >= 0) {
+                return fail(a, line, "'%.*s' is not an instruction or a label", (int)t[0].len, t[0].p);
+            }
+            if (!a.have_orig) {
+                return fail(a, line, "label before .ORIG");
+            }
+
+            std::string name(label.p, label.len);
+            if (!a.syms.emplace(name, (uint16_t)pc).second) {
+                return fail(a, line, "'%s' is defined more than once", name.c_str());
+            }
+            a.order.emplace_back(name, (uint16_t)pc);
+
+            t++;
+            n--;
+            if (!n) {
+                if (has_str) {
+                    return fail(a, line, "string without .STRINGZ");
+                }
+                continue;
+            }
+
+            m = find_mnemonic(t[0]);
+            if (!m) {
+                return fail(a, line, "unknown instruction '%.*s'", (int)t[0].len, t[0].p);
+            }
+        }
+
+        if (has_str != (m->k == D_STRINGZ)) {
+            return fail(a, line, has_str ? "unexpected string" : ".STRINGZ needs a string");
+        }
+
+        s.line = line;
+        s.m    = m;
+        s.n    = n - 1;
+        if (s.n > MAX_OPERANDS) {
+            return fail(a, line, "too many operands");
+        }
+        for (int i = 0; i < s.n; i++) {
+            s.t[i] = t[i + 1];
+        }
+
+        if (m->k == D_ORIG) {
+            long v;
+            if (a.have_orig) {
+                return fail(a, line, "only one .ORIG per file");
+            }
+            if (s.n != 1 || !parse_num(s.t[0], &v) || v < 0 || v > 0xFFFF) {
+                return fail(a, line, ".ORIG needs an address");
+            }
+            a.have_orig = true;
+            a.orig      = (uint16_t)v;
+            pc          = (uint32_t)v;
+            continue;
+        }
+
+        if (!a.have_orig) {
+            return fail(a, line, "code before .ORIG");
+        }
+
+        if (m->k == D_END) {
+            break;
+        }
+
+        long blkw = 0;
+        if (m->k == D_BLKW && (s.n != 1 || !parse_num(s.t[0], &blkw) || blkw < 1 || blkw > 0xFFFF)) {
+            return fail(a, line, ".BLKW needs a count");
+        }
+
+        s.addr = (uint16_t)pc;
+        pc += words_of(s, blkw);
+        if (pc > 0x10000) {
+            return fail(a, line, "runs past the end of memory");
+        }
+
+        a.stmts.push_back(std::move(s));
+    }
+
+    if (!a.have_orig) {
+        return fail(a, line, "no .ORIG");
+    }
+
+    a.size = pc - a.orig;
+    return true;
+}
+
+
+bool
+need (assembler & a, const statement & s, int n)
+{
+    if (s.n != n) {
+        return fail(a, s.line, "%s takes %d operand%s", s.m->name, n, n == 1 ? "" : "s");
+    }
+    return true;
+}
+
+
+bool
+reg (assembler & a, const statement & s, int i, int * r)
+{
+    *r = parse_reg(s.t[i]);
+    if (*r < 0) {
+        return fail(a, s.line, "'%.*s' is not a register", (int)s.t[i].len, s.t[i].p);
+    }
+    return true;
+}
+
+
+bool
+imm (assembler & a, const statement & s, int i, long lo, long hi, long * v)
+{
+    if (!parse_num(s.t[i], v)) {
+        return fail(a, s.line, "'%.*s' is not a number", (int)s.t[i].len, s.t[i].p);
+    }
+    if (*v < lo || *v > hi) {
+        return fail(a, s.line, "%ld doesn't fit (%ld to %ld)", *v, lo, hi);
+    }
+    return true;
+}
+
+
+// a label (PC-relative from the next word) or a literal offset
+bool
+offset (assembler & a, const statement & s, int i, int bits, uint16_t * field)
+{
+    long lo = -(1L << (bits - 1));
+    long hi = (1L << (bits - 1)) - 1;
+    long v;
+
+    if (!parse_num(s.t[i], &v)) {
+        auto it = a.syms.find(std::string(s.t[i].p, s.t[i].len));
+        if (it == a.syms.end()) {
+            return fail(a, s.line, "undefined label '%.*s'", (int)s.t[i].len, s.t[i].p);
+        }
+        v = (long)it->second - (s.addr + 1);
+        if (v < lo || v > hi) {
+            return fail(a, s.line, "'%.*s' is too far away", (int)s.t[i].len, s.t[i].p);
+        }
+    } else if (v < lo || v > hi) {
+        return fail(a, s.line, "offset %ld doesn't fit in %d bits", v, bits);
+    }
+
+    *field = (uint16_t)(v & ((1L << bits) - 1));
+    return true;
+}
+
+
+bool
+encode (assembler & a, const statement & s, uint16_t * out)
+{
+    int dr, sr1, sr2;
+    long v;
+    uint16_t f;
+
+    switch (s.m->k) {
+        case K_ALU:
+        case K_MD:
+            if (!need(a, s, 3) || !reg(a, s, 0, &dr) || !reg(a, s, 1, &sr1)) {
+                return false;
+            }
+            *out = s.m->bits | (dr << 9) | (sr1 << 6);
+            if ((sr2 = parse_reg(s.t[2])) >= 0) {
+                *out |= sr2;
+            } else if (s.m->k == K_ALU) {
+                if (!imm(a, s, 2, -16, 15, &v)) {
+                    return false;
+                }
+                *out |= 0x20 | (v & 0x1F);
+            } else {
+                if (!imm(a, s, 2, 0, 7, &v)) {
+                    return false;
+                }
+                *out |= 0x20 | v;
+            }
+            return true;
+
+        case K_NOT:
+            if (!need(a, s, 2) || !reg(a, s, 0, &dr) || !reg(a, s, 1, &sr1)) {
+                return false;
+            }
+            *out = s.m->bits | (dr << 9) | (sr1 << 6);
+            return true;
+
+        case K_PC9:
+            if (!need(a, s, 2) || !reg(a, s, 0, &dr) || !offset(a, s, 1, 9, &f)) {
+                return false;
+            }
+            *out = s.m->bits | (dr << 9) | f;
+            return true;
+
+        case K_BASE:
+            if (!need(a, s, 3) || !reg(a, s, 0, &dr) || !reg(a, s, 1, &sr1) ||
+                !imm(a, s, 2, -32, 31, &v)) {
+                return false;
+            }
+            *out = s.m->bits | (dr << 9) | (sr1 << 6) | (v & 0x3F);
+            return true;
+
+        case K_BR:
+            if (!need(a, s, 1) || !offset(a, s, 0, 9, &f)) {
+                return false;
+            }
+            *out = s.m->bits | f;
+            return true;
+
+        case K_JSR:
+            if (!need(a, s, 1) || !offset(a, s, 0, 11, &f)) {
+                return false;
+            }
+            *out = s.m->bits | f;
+            return true;
+
+        case K_REG:
+            if (!need(a, s, 1) || !reg(a, s, 0, &sr1)) {
+                return false;
+            }
+            *out = s.m->bits | (sr1 << 6);
+            return true;
+
+        case K_TRAP:
+            if (!need(a, s, 1) || !imm(a, s, 0, 0, 0xFF, &v)) {
+                return false;
+            }
+            *out = s.m->bits | v;
+            return true;
+
+        case K_FIXED:
+            if (!need(a, s, 0)) {
+                return false;
+            }
+            *out = s.m->bits;
+            return true;
+
+        case D_FILL:
+            if (!need(a, s, 1)) {
+                return false;
+            }
+            if (!parse_num(s.t[0], &v)) {
+                auto it = a.syms.find(std::string(s.t[0].p, s.t[0].len));
+                if (it == a.syms.end()) {
+                    return fail(a, s.line, "undefined label '%.*s'", (int)s.t[0].len, s.t[0].p);
+                }
+                v = it->second;
+            } else if (v < -0x8000 || v > 0xFFFF) {
+                return fail(a, s.line, "%ld doesn't fit in a word", v);
+            }
+            *out = (uint16_t)v;
+            return true;
+
+        case D_BLKW:
+            // already sized, and the image starts out zeroed
+            return true;
+
+        case D_STRINGZ:
+            for (size_t i = 0; i < s.str.size(); i++) {
+                out[i] = (uint8_t)s.str[i];
+            }
+            out[s.str.size()] = 0;
+            return true;
+
+        default:
+            return fail(a, s.line, "%s can't go here", s.m->name);
+    }
+}
+
+} // namespace
+
+
+asm_result_t *
+asm_assemble (const char * src, size_t len, const char * name)
+{
+    asm_result_t * r = (asm_result_t*)calloc(1, sizeof(asm_result_t));
+    if (!r) {
+        return NULL;
+    }
+
+    assembler a;
+    a.name      = name ? name : "<input>";
+    a.error     = r->error;
+    a.have_orig = false;
+    a.orig      = 0;
+    a.size      = 0;
+
+    if (!pass1(a, src, len)) {
+        return r;
+    }
+
+    r->orig   = a.orig;
+    r->nwords = a.size;
+    r->words  = (uint16_t*)calloc(a.size ? a.size : 1, sizeof(uint16_t));
+    r->lines  = (asm_line_t*)malloc((a.stmts.size() ? a.stmts.size() : 1) * sizeof(asm_line_t));
+    if (!r->words || !r->lines) {
+        asm_free(r);
+        return NULL;
+    }
+
+    for (const statement & s : a.stmts) {
+        if (!encode(a, s, &r->words[s.addr - a.orig])) {
+            free(r->words);
+            free(r->lines);
+            r->words  = NULL;
+            r->lines  = NULL;
+            r->nwords = 0;
+            return r;
+        }
+        r->lines[r->nlines].addr = s.addr;
+        r->lines[r->nlines].line = s.line;
+        r->nlines++;
+    }
+
+    // the names all go in one block after the table itself
+    size_t names = 0;
+    for (auto & sym : a.order) {
+        names += sym.first.size() + 1;
+    }
+
+    r->syms = (asm_symbol_t*)malloc(a.order.size() * sizeof(asm_symbol_t) + names + 1);
+    if (!r->syms) {
+        asm_free(r);
+        return NULL;
+    }
+
+    char * np = (char*)(r->syms + a.order.size());
+    for (auto & sym : a.order) {
+        memcpy(np, sym.first.c_str(), sym.first.size() + 1);
+        r->syms[r->nsyms].name = np;
+        r->syms[r->nsyms].addr = sym.second;
+        r->nsyms++;
+        np += sym.first.size() + 1;
+    }
+
+    return r;
+}
+
+
+asm_result_t *
+asm_assemble_file (const char * path)
+{
+    FILE * f = fopen(path, "rb");
+    if (!f) {
+        asm_result_t * r = (asm_result_t*)calloc(1, sizeof(asm_result_t));
+        if (r) {
+            snprintf(r->error, sizeof(r->error), "%s: can't open it", path);
+        }
+        return r;
+    }
+
+    std::vector<char> src;
+    char buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        src.insert(src.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    return asm_assemble(src.data(), src.size(), path);
+}
+
+
+void
+asm_free (asm_result_t * r)
+{
+    if (!r) {
+        return;
+    }
+    free(r->words);
+    free(r->syms);
+    free(r->lines);
+    free(r);
+}
+
+
+bool
+asm_lookup (const asm_result_t * r, const char * name, uint16_t * addr)
+{
+    for (size_t i = 0; i < r->nsyms; i++) {
+        if (!strcmp(r->syms[i].name, name)) {
+            *addr = r->syms[i].addr;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+int
+asm_write_obj (const asm_result_t * r, const char * path)
+{
+    FILE * f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+
+    std::vector<uint8_t> out(2 * (r->nwords + 1));
+    out[0] = r->orig >> 8;
+    out[1] = r->orig & 0xFF;
+    for (size_t i = 0; i < r->nwords; i++) {
+        out[2 * i + 2] = r->words[i] >> 8;
+        out[2 * i + 3] = r->words[i] & 0xFF;
+    }
+
+    size_t n = fwrite(out.data(), 1, out.size(), f);
+    return (fclose(f) || n != out.size()) ? -1 : 0;
+}
+
+
+int
+asm_write_sym (const asm_result_t * r, const char * path)
+{
+    FILE * f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+
+    fprintf(f, "// Symbol table\n");
+    fprintf(f, "// Scope level 0:\n");
+    fprintf(f, "//\tSymbol Name       Page Address\n");
+    fprintf(f, "//\t----------------  ------------\n");
+    for (size_t i = 0; i < r->nsyms; i++) {
+        fprintf(f, "//\t%-16s  %04X\n", r->syms[i].name, r->syms[i].addr);
+    }
+    fprintf(f, "\n");
+
+    return fclose(f) ? -1 : 0;
+}
+
+
+int
+asm_write_lines (const asm_result_t * r, const char * path)
+{
+    FILE * f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < r->nlines; i++) {
+        fprintf(f, "%04X %u\n", r->lines[i].addr, r->lines[i].line);
+    }
+
+    return fclose(f) ? -1 : 0;
+}
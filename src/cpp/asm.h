@@ -0,0 +1,66 @@
+#ifndef __ASM_H__
+#define __ASM_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * In-tree assembler for iit3503 programs.
+ *
+ * Takes the same source as lc3as (one .ORIG ... .END block, the LC-3
+ * mnemonics, trap aliases and pseudo-ops), plus MUL/DIV/MOD for
+ * opcode 1101. It runs in-process: the simulator can load .asm files
+ * directly (see create_ram()), and asm3503 (src/asm/) is the command
+ * line front end the Makefile uses.
+ *
+ * Besides the image, every assembly keeps its symbol table and a line
+ * table (which source line each word came from) for the debugger and
+ * profilers.
+ */
+
+typedef struct asm_symbol {
+    const char * name;
+    uint16_t addr;
+} asm_symbol_t;
+
+typedef struct asm_line {
+    uint16_t addr;  // first word the line produced
+    uint32_t line;  // 1-based
+} asm_line_t;
+
+typedef struct asm_result {
+    uint16_t orig;
+    uint16_t * words;
+    size_t nwords;
+
+    asm_symbol_t * syms;    // in order of definition
+    size_t nsyms;
+
+    asm_line_t * lines;     // in address order
+    size_t nlines;
+
+    // "file:line: what went wrong" if assembly failed (and then
+    // there's no image), empty otherwise
+    char error[256];
+} asm_result_t;
+
+// assembles len bytes of source. name is only used in error messages.
+// Returns NULL only if memory runs out; check error[0] for failure.
+asm_result_t * asm_assemble (const char * src, size_t len, const char * name);
+asm_result_t * asm_assemble_file (const char * path);
+void asm_free (asm_result_t * r);
+
+// looks up a symbol by name; returns false if there's no such symbol
+bool asm_lookup (const asm_result_t * r, const char * name, uint16_t * addr);
+
+/*
+ * Output files. An object file is what lc3as writes (big-endian words,
+ * the origin first), and the symbol table is in lc3as's .sym format.
+ * A line table has one "<hex addr> <line>" line per statement that
+ * produced words. All return 0 on success.
+ */
+int asm_write_obj (const asm_result_t * r, const char * path);
+int asm_write_sym (const asm_result_t * r, const char * path);
+int asm_write_lines (const asm_result_t * r, const char * path);
+
+#endif
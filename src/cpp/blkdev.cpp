@@ -0,0 +1,89 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "blkdev.h"
+#include "ram.h"
+
+blkdev_t *
+blkdev_open (const char * path)
+{
+    struct stat st;
+    int fd;
+
+    // like shared_map(), this keeps what's in the file, but it's
+    // never created or resized
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        ERROR_PRINT("Could not open disk image '%s': %s", path, strerror(errno));
+        return NULL;
+    }
+
+    if (fstat(fd, &st)) {
+        ERROR_PRINT("Could not stat disk image '%s': %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    if (st.st_size < BLK_SECTOR_BYTES) {
+        ERROR_PRINT("Disk image '%s' is smaller than one sector", path);
+        close(fd);
+        return NULL;
+    }
+
+    blkdev_t * b = (blkdev_t*)malloc(sizeof(blkdev_t));
+    if (!b) {
+        ERROR_PRINT("Could not allocate block device");
+        close(fd);
+        return NULL;
+    }
+
+    b->len     = st.st_size;
+    b->sectors = st.st_size / BLK_SECTOR_BYTES;
+    b->disk    = (uint16_t*)mmap(NULL, b->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    // the mapping holds its own reference
+    close(fd);
+
+    if (b->disk == MAP_FAILED) {
+        ERROR_PRINT("Could not map disk image '%s': %s", path, strerror(errno));
+        free(b);
+        return NULL;
+    }
+
+    DEBUG_PRINT("Mapped disk image '%s' (%zu sectors)", path, b->sectors);
+
+    return b;
+}
+
+
+void
+blkdev_close (blkdev_t * b)
+{
+    munmap(b->disk, b->len);
+    free(b);
+}
+
+
+bool
+blkdev_transfer (blkdev_t * b, ram_t * ram, bool write, uint16_t sec, uint16_t addr, uint16_t cnt)
+{
+    if ((size_t)sec + cnt > b->sectors) {
+        return false;
+    }
+
+    uint16_t * at = b->disk + (size_t)sec * BLK_SECTOR_WORDS;
+    size_t words  = (size_t)cnt * BLK_SECTOR_WORDS;
+
+    if (write) {
+        ram_read_block(ram, addr, at, words);
+    } else {
+        ram_write_block(ram, addr, at, words);
+    }
+
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef __BLKDEV_H__
+#define __BLKDEV_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Host side of the block device (see BlockDev.scala). The disk
+ * is a plain file of 256-word (512 byte) sectors, mmap'd shared,
+ * so whatever the guest writes ends up in the file, and the file
+ * can be looked at (or changed) by other tools while the machine
+ * runs. Words are in host byte order, so a transfer is a straight
+ * copy between the mapping and guest RAM.
+ */
+
+#define BLK_SECTOR_WORDS 256
+#define BLK_SECTOR_BYTES (BLK_SECTOR_WORDS * 2)
+
+struct ram;
+
+typedef struct blkdev {
+    uint16_t * disk;
+    size_t len;       // bytes mapped
+    size_t sectors;   // whole sectors in the file (a partial one at the end is ignored)
+} blkdev_t;
+
+blkdev_t * blkdev_open (const char * path);
+void blkdev_close (blkdev_t * b);
+
+// carries out one command: cnt sectors starting at sector sec, from
+// guest RAM at addr (write) or into it (read). Fails, and touches
+// nothing, if that runs off the end of the disk.
+bool blkdev_transfer (blkdev_t * b, struct ram * ram, bool write, uint16_t sec, uint16_t addr, uint16_t cnt);
+
+#endif
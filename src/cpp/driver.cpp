@@ -5,12 +5,40 @@
 #include <cstring>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/select.h>
+#include <time.h>
 #include "common.h"
 #include "iit3503.h"
+#include "ram.h"
+#include "blkdev.h"
+#include "metrics.h"
+#include "memprof.h"
+#include "irqlat.h"
 #include "shell.h"
+#include "turbo.h"
+#include "ucode.h"
 
 #define MAX_IMAGE_NAME_LEN 256
 
+// instructions between keyboard polls in turbo mode
+#define TURBO_SLICE (1 << 16)
+
+// cycles between keyboard polls otherwise
+#define KBD_POLL_CYCLES 1024
+
+// cycles between keyboard polls with the microcode model
+#define UCODE_SLICE (1 << 16)
+
+// default cycles per disk sector: about what moving 256 words one
+// per cycle would take
+#define DISK_LATENCY 256
+
+// flight recorder records printed when a run goes wrong, by default
+#define HISTORY_DUMP 16
+
+// instructions between state fingerprints, by default
+#define FP_EVERY 10000
+
 using namespace std;
 
 dut_t * dut;
@@ -23,8 +51,114 @@ print_version (void)
 }
 
 
-double sc_time_stamp() {
-    return dut->main_time;
+// guest serial output goes straight to our terminal
+static void
+console_sink (void * arg, uint8_t c)
+{
+    putc(c, stdout); // TODO: if this isn't flushed we'll miss prompts
+}
+
+
+// returns a pending host keystroke, or -1
+static int
+poll_kbd (void)
+{
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    struct timeval tv;
+
+    FD_SET(fileno(stdin), &rfds);
+    tv.tv_sec = 0;
+    tv.tv_usec = 0; 
+
+    if (select(fileno(stdin)+1, &rfds, NULL, NULL, &tv) > 0) {
+        return fgetc(stdin);
+    }
+
+    return -1;
+}
+
+
+// where to write the statistics when the simulator exits. The shell
+// can exit() from under main(), so this also runs as an atexit hook,
+// but only ever writes them once.
+static const char * stats_path;
+
+static void
+dump_stats (void)
+{
+    if (!stats_path) {
+        return;
+    }
+
+    iit3503_stats_t st;
+    iit3503_read_stats(dut, &st);
+    metrics_dump(&st, stats_path);
+    stats_path = NULL;
+}
+
+
+static const char * heatmap_path;
+
+static void
+dump_heatmap (void)
+{
+    if (!heatmap_path || !dut->memprof) {
+        return;
+    }
+
+    memprof_csv(dut->memprof, heatmap_path);
+    heatmap_path = NULL;
+}
+
+
+static bool irqlat_on_exit;
+
+static void
+print_irqlat (void)
+{
+    if (!irqlat_on_exit) {
+        return;
+    }
+
+    irqlat_print(dut->irqlat, -1);
+    irqlat_on_exit = false;
+}
+
+
+// host keyboard input goes to the guest over its serial line. At
+// 115200 baud a character takes thousands of cycles, so there's no
+// need to ask the host every cycle.
+static device_t kbd_dev;
+
+static uint64_t
+check_for_kbd (dut_t * dut, device_t * dev)
+{
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    struct timeval tv = {0, 0};
+
+    FD_SET(fileno(stdin), &rfds);
+
+    if (select(fileno(stdin)+1, &rfds, NULL, NULL, &tv) > 0) {
+        char buf[256];
+
+        // the lockstep model has no serial line, so keystrokes go
+        // straight into the FIFO, one per poll
+        if (dut->shadow) {
+            if (read(fileno(stdin), buf, 1) == 1) {
+                iit3503_raise_irq(dut, 0x80, 4, (uint8_t)buf[0]);
+            }
+            return dut->cycle_count + KBD_POLL_CYCLES;
+        }
+
+        ssize_t n = read(fileno(stdin), buf, sizeof(buf));
+        if (n > 0) {
+            iit3503_write_uart(dut, buf, n);
+        }
+    }
+
+    return dut->cycle_count + KBD_POLL_CYCLES;
 }
 
 
@@ -34,18 +168,63 @@ static void print_usage (char ** argv) {
     SUGGESTION_PRINT("  " UNBOLD("--interactive ") "or " UNBOLD("-i        ")  ": Start the debug shell immediately");
     SUGGESTION_PRINT("  " UNBOLD("--os-image    ") "or " UNBOLD("-o <path> ")  ": Use OS image at " UNBOLD("<path>") ". If no OS image is provided, the provided program will run in supervisor mode.");
     SUGGESTION_PRINT("  " UNBOLD("--binary      ") "or " UNBOLD("-b <path> ")  ": Use the user program image at " UNBOLD("<path>"));
+    SUGGESTION_PRINT("                  Images can also be assembly source (" UNBOLD(".asm") "), assembled when loaded");
     SUGGESTION_PRINT("  " UNBOLD("--trace       ") "or " UNBOLD("-t <path> ")  ": Output a waveform file at " UNBOLD("<path>"));
+    SUGGESTION_PRINT("  " UNBOLD("--trace-window ") "or " UNBOLD("-R <a:b>  ")  ": Only trace instructions " UNBOLD("<a>") " up to " UNBOLD("<b>") " (e.g. the interval " UNBOLD("tools/fpcmp.py") " points at)");
+    SUGGESTION_PRINT("  " UNBOLD("--fingerprint ") "or " UNBOLD("-F <path> ")  ": Write a hash of the registers and RAM to " UNBOLD("<path>") " every so many instructions (compare runs with " UNBOLD("tools/fpcmp.py") ")");
+    SUGGESTION_PRINT("  " UNBOLD("--fingerprint-every ") "or " UNBOLD("-N <n>")  ": ... every " UNBOLD("<n>") " instructions (default %d)", FP_EVERY);
     SUGGESTION_PRINT("  " UNBOLD("--haltquit    ") "or " UNBOLD("-q        ")  ": Quit the simulator when the iit3503 halts");
+    SUGGESTION_PRINT("  " UNBOLD("--shm         ") "or " UNBOLD("-m <name> ")  ": Back guest RAM with POSIX shared memory object " UNBOLD("<name>") " and publish machine status at " UNBOLD("<name>.status"));
+    SUGGESTION_PRINT("  " UNBOLD("--ram-file    ") "or " UNBOLD("-f <path> ")  ": Like " UNBOLD("--shm") ", but back guest RAM with an mmap'd file at " UNBOLD("<path>") " (what's in it is kept across runs; images are loaded over it)");
+    SUGGESTION_PRINT("  " UNBOLD("--turbo       ") "or " UNBOLD("-T        ")  ": Functional simulation only (no RTL, no debug shell). Runs until the machine halts");
+    SUGGESTION_PRINT("  " UNBOLD("--ucode       ") "or " UNBOLD("-U        ")  ": Run on the C++ microcode model instead of the RTL (single core, no debug shell)");
+    SUGGESTION_PRINT("  " UNBOLD("--lockstep    ") "or " UNBOLD("-k        ")  ": Check the RTL against the microcode model every cycle (exit code %d if they diverge)", IIT3503_EXIT_DIVERGED);
+    SUGGESTION_PRINT("  " UNBOLD("--ram-wait    ") "or " UNBOLD("-w <n[:m]>")  ": Give every RAM access " UNBOLD("<n>") " wait states (or a random number between " UNBOLD("<n>") " and " UNBOLD("<m>") ")");
+    SUGGESTION_PRINT("  " UNBOLD("--ap-entry    ") "or " UNBOLD("-a <hex>  ")  ": Where cores other than core 0 start (multi-core builds, see " UNBOLD("make CORES=n") ")");
+    SUGGESTION_PRINT("  " UNBOLD("--disk        ") "or " UNBOLD("-d <path> ")  ": Attach the disk image at " UNBOLD("<path>") " (512-byte sectors, written in place) to the block device");
+    SUGGESTION_PRINT("  " UNBOLD("--disk-latency ") "or " UNBOLD("-L <n>    ")  ": Every disk sector takes " UNBOLD("<n>") " cycles (default %d)", DISK_LATENCY);
+    SUGGESTION_PRINT("  " UNBOLD("--stats       ") "or " UNBOLD("-s <path> ")  ": Write runtime statistics to " UNBOLD("<path>") " on exit (Prometheus textfile if it ends in .prom, JSON otherwise)");
+    SUGGESTION_PRINT("  " UNBOLD("--heatmap     ") "or " UNBOLD("-P <path> ")  ": Count memory accesses by address and region from reset, and write them to the CSV at " UNBOLD("<path>") " on exit (see the shell's " UNBOLD("heatmap") ")");
+    SUGGESTION_PRINT("  " UNBOLD("--irq-latency ") "or " UNBOLD("-Q        ")  ": Print interrupt latency percentiles per vector on exit (see the shell's " UNBOLD("irqlat") ")");
+    SUGGESTION_PRINT("  " UNBOLD("--max-cycles  ") "or " UNBOLD("-C <n>    ")  ": Give up after " UNBOLD("<n>") " cycles (exit code %d)", IIT3503_EXIT_TIMEOUT);
+    SUGGESTION_PRINT("  " UNBOLD("--max-instrs  ") "or " UNBOLD("-I <n>    ")  ": Give up after " UNBOLD("<n>") " instructions (exit code %d)", IIT3503_EXIT_TIMEOUT);
+    SUGGESTION_PRINT("  " UNBOLD("--max-wall-seconds ") "or " UNBOLD("-W <secs>")  ": Give up after " UNBOLD("<secs>") " seconds of host time (exit code %d)", IIT3503_EXIT_TIMEOUT);
+    SUGGESTION_PRINT("  " UNBOLD("--stop-on-exception ") "or " UNBOLD("-x")  ": Stop at the first privilege, illegal opcode or ACV exception (exit code %d)", IIT3503_EXIT_EXCEPTION);
+    SUGGESTION_PRINT("  " UNBOLD("--dump-on-timeout ") "or " UNBOLD("-D")  ": Print registers and statistics when one of the above stops the run");
+    SUGGESTION_PRINT("  " UNBOLD("--history     ") "or " UNBOLD("-H <n>    ")  ": Disassemble the last " UNBOLD("<n>") " instructions on an exception, a failed halt, a watchdog stop or ctrl+c (default %d, 0 = never)", HISTORY_DUMP);
+    SUGGESTION_PRINT("Exit codes: %d = halted, %d = simulator error, %d = guest halted with MCR[7:0] != 0",
+            IIT3503_EXIT_HALT, IIT3503_EXIT_ERROR, IIT3503_EXIT_GUEST);
 }
 
 static struct option long_options[] = {
 	{"interactive", no_argument, 0, 'i'},
 	{"binary",      required_argument, 0, 'b'},
 	{"trace",       required_argument, 0, 't'},
+	{"trace-window", required_argument, 0, 'R'},
+	{"fingerprint", required_argument, 0, 'F'},
+	{"fingerprint-every", required_argument, 0, 'N'},
 	{"os-image",    required_argument, 0, 'o'},
 	{"help",        no_argument, 0, 'h'},
 	{"version",     no_argument, 0, 'V'},
 	{"haltquit",    no_argument, 0, 'q'},
+	{"shm",         required_argument, 0, 'm'},
+	{"ram-file",    required_argument, 0, 'f'},
+	{"turbo",       no_argument, 0, 'T'},
+	{"ucode",       no_argument, 0, 'U'},
+	{"lockstep",    no_argument, 0, 'k'},
+	{"ram-wait",    required_argument, 0, 'w'},
+	{"ap-entry",    required_argument, 0, 'a'},
+	{"disk",        required_argument, 0, 'd'},
+	{"disk-latency", required_argument, 0, 'L'},
+	{"stats",       required_argument, 0, 's'},
+	{"heatmap",     required_argument, 0, 'P'},
+	{"irq-latency", no_argument, 0, 'Q'},
+	{"max-cycles",  required_argument, 0, 'C'},
+	{"max-instrs",  required_argument, 0, 'I'},
+	{"max-wall-seconds", required_argument, 0, 'W'},
+	{"stop-on-exception", no_argument, 0, 'x'},
+	{"dump-on-timeout", no_argument, 0, 'D'},
+	{"history",     required_argument, 0, 'H'},
 	{0, 0, 0, 0}};
 
 
@@ -53,9 +232,32 @@ typedef struct machine_opts {
     bool interactive;
     bool trace_en;
     char * trace;
+    unsigned long long trace_from;
+    unsigned long long trace_to;
+    char * fingerprint;
+    unsigned long long fp_every;
     char * image;
     char * os_image;
     bool haltquit;
+    char * shm;
+    bool shm_is_file;
+    bool turbo;
+    bool ucode;
+    bool lockstep;
+    unsigned ram_wait_min;
+    unsigned ram_wait_max;
+    unsigned ap_entry;
+    char * disk;
+    unsigned disk_latency;
+    char * stats;
+    char * heatmap;
+    bool irq_latency;
+    unsigned long long max_cycles;
+    unsigned long long max_instrs;
+    double max_wall_secs;
+    bool stop_on_excp;
+    bool watchdog_dump;
+    unsigned history;
 } machine_opts_t;
 
 
@@ -73,7 +275,7 @@ parse_args (int argc,
 
     while (1) {
         int opt_idx = 0;
-        int c = getopt_long(argc, argv, "b:t:hiVqo:", long_options, &opt_idx);
+        int c = getopt_long(argc, argv, "b:t:hiVqo:m:f:TUkw:a:d:L:s:P:QC:I:W:xDH:R:F:N:", long_options, &opt_idx);
 
         if (c == -1) {
             break;
@@ -91,16 +293,119 @@ parse_args (int argc,
             case 'o':
                 opts->os_image = optarg;
                 break;
+            case 'm':
+                opts->shm         = optarg;
+                opts->shm_is_file = false;
+                break;
+            case 'f':
+                opts->shm         = optarg;
+                opts->shm_is_file = true;
+                break;
+            case 'T':
+                opts->turbo = true;
+                break;
+            case 'U':
+                opts->ucode = true;
+                break;
+            case 'k':
+                opts->lockstep = true;
+                break;
+            case 'w': {
+                int n = sscanf(optarg, "%u:%u", &opts->ram_wait_min, &opts->ram_wait_max);
+                if (n < 1 || opts->ram_wait_min > 255 || opts->ram_wait_max > 255) {
+                    ERROR_PRINT("Bad wait state count '%s'", optarg);
+                    retcode = -1;
+                    goto ret;
+                }
+                if (n == 1) {
+                    opts->ram_wait_max = opts->ram_wait_min;
+                }
+                break;
+            }
+            case 'a':
+                if (sscanf(optarg, "%x", &opts->ap_entry) != 1 || opts->ap_entry > 0xFFFF) {
+                    ERROR_PRINT("Bad entry point '%s'", optarg);
+                    retcode = -1;
+                    goto ret;
+                }
+                break;
+            case 'd':
+                opts->disk = optarg;
+                break;
+            case 's':
+                opts->stats = optarg;
+                break;
+            case 'P':
+                opts->heatmap = optarg;
+                break;
+            case 'Q':
+                opts->irq_latency = true;
+                break;
+            case 'C':
+            case 'I': {
+                unsigned long long * n = c == 'C' ? &opts->max_cycles : &opts->max_instrs;
+                if (sscanf(optarg, "%llu", n) != 1) {
+                    ERROR_PRINT("Bad limit '%s'", optarg);
+                    retcode = -1;
+                    goto ret;
+                }
+                break;
+            }
+            case 'W':
+                if (sscanf(optarg, "%lf", &opts->max_wall_secs) != 1 || opts->max_wall_secs < 0) {
+                    ERROR_PRINT("Bad time limit '%s'", optarg);
+                    retcode = -1;
+                    goto ret;
+                }
+                break;
+            case 'x':
+                opts->stop_on_excp = true;
+                break;
+            case 'D':
+                opts->watchdog_dump = true;
+                break;
+            case 'H':
+                if (sscanf(optarg, "%u", &opts->history) != 1 || opts->history > IIT3503_HISTORY_LEN) {
+                    ERROR_PRINT("Bad history length '%s' (at most %d)", optarg, IIT3503_HISTORY_LEN);
+                    retcode = -1;
+                    goto ret;
+                }
+                break;
+            case 'L':
+                if (sscanf(optarg, "%u", &opts->disk_latency) != 1) {
+                    ERROR_PRINT("Bad disk latency '%s'", optarg);
+                    retcode = -1;
+                    goto ret;
+                }
+                break;
             case 't':
                 opts->trace_en = true;
                 opts->trace    = optarg;
                 break;
+            case 'R':
+                if (sscanf(optarg, "%llu:%llu", &opts->trace_from, &opts->trace_to) != 2 ||
+                    opts->trace_to <= opts->trace_from) {
+                    ERROR_PRINT("Bad trace window '%s'", optarg);
+                    retcode = -1;
+                    goto ret;
+                }
+                break;
+            case 'F':
+                opts->fingerprint = optarg;
+                break;
+            case 'N':
+                if (sscanf(optarg, "%llu", &opts->fp_every) != 1 || !opts->fp_every) {
+                    ERROR_PRINT("Bad fingerprint interval '%s'", optarg);
+                    retcode = -1;
+                    goto ret;
+                }
+                break;
             case 'V':
                 print_version();
                 exit(0);
             case 'q':
                 opts->haltquit = true;
-                goto ret;
+                break;
             case 'h':
                 print_usage(argv);
                 exit(0);
@@ -127,33 +432,386 @@ print_banner ()
 }
 
 
+typedef struct turbo_disk {
+    blkdev_t * disk;
+    ram_t * ram;
+} turbo_disk_t;
+
+
+// turbo's block device: there's no time, so commands are done
+// the moment they're issued
+static bool
+turbo_blk (void * arg, bool write, uint16_t sec, uint16_t addr, uint16_t cnt)
+{
+    turbo_disk_t * d = (turbo_disk_t*)arg;
+    return blkdev_transfer(d->disk, d->ram, write, sec, addr, cnt);
+}
+
+
+/*
+ * Turbo mode: same RAM image and devices, but executed by the
+ * block translator in turbo.cpp instead of the Verilated model
+ */
+static int
+run_turbo (machine_opts_t * opts)
+{
+    uint16_t entry = 0x3000;
+
+    if (!opts->image && !opts->os_image) {
+        ERROR_PRINT("Turbo mode needs a program or OS image");
+        return IIT3503_EXIT_ERROR;
+    }
+
+    ram_t * ram = create_ram(IIT3503_RAMSIZE,
+                             opts->image,
+                             opts->os_image,
+                             &entry,
+                             opts->shm,
+                             opts->shm_is_file);
+    if (!ram) {
+        ERROR_PRINT("Could not create RAM");
+        return IIT3503_EXIT_ERROR;
+    }
+
+    turbo_t * t = turbo_create(ram, entry);
+    if (!t) {
+        destroy_ram(ram);
+        return IIT3503_EXIT_ERROR;
+    }
+
+    isa_state_t * s = turbo_state(t);
+    s->out = console_sink;
+
+    turbo_disk_t disk = { NULL, ram };
+    if (opts->disk) {
+        disk.disk = blkdev_open(opts->disk);
+        if (!disk.disk) {
+            turbo_destroy(t);
+            destroy_ram(ram);
+            return IIT3503_EXIT_ERROR;
+        }
+        s->blk     = turbo_blk;
+        s->blk_arg = &disk;
+    }
+
+    INFO_PRINT("Turbo mode: functional simulation only, starting at x%04x", entry);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    const turbo_stats_t * st = turbo_stats(t);
+    uint64_t deadline = opts->max_wall_secs > 0 ? host_ns() + (uint64_t)(opts->max_wall_secs * 1e9) : 0;
+    int code = IIT3503_EXIT_HALT;
+
+    // there are no cycles here, so only the instruction and time
+    // limits apply (checked once per slice)
+    while (turbo_run(t, TURBO_SLICE) != TURBO_HALTED) {
+        int c = poll_kbd();
+        if (c >= 0) {
+            isa_raise_irq(s, 0x80, 4, (uint16_t)c);
+        }
+
+        if ((opts->max_instrs && st->instrs >= opts->max_instrs) ||
+            (deadline && host_ns() >= deadline)) {
+            code = IIT3503_EXIT_TIMEOUT;
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    fflush(stdout);
+    if (code == IIT3503_EXIT_TIMEOUT) {
+        ERROR_PRINT("Stopped: out of time at PC x%04x", s->pc);
+    } else {
+        INFO_PRINT("Machine halted.");
+        if (IIT3503_GUEST_STATUS(s->mcr)) {
+            ERROR_PRINT("The guest reported failure (MCR[7:0] = x%02x)", IIT3503_GUEST_STATUS(s->mcr));
+            code = IIT3503_EXIT_GUEST;
+        }
+    }
+    INFO_PRINT("%lu instructions in %.3fs (%.1f MIPS)",
+            st->instrs,
+            secs,
+            secs > 0 ? st->instrs / secs / 1e6 : 0.0);
+    INFO_PRINT("%lu slow-path steps, %lu blocks translated, %lu invalidated",
+            st->slow,
+            st->translated,
+            st->invalidated);
+
+    if (disk.disk) {
+        blkdev_close(disk.disk);
+    }
+    turbo_destroy(t);
+    destroy_ram(ram);
+
+    return code;
+}
+
+
+/*
+ * The microcode model's disk. Like the RTL harness's (blk_tick() in
+ * iit3503.cpp), a command takes latency cycles per sector, and the
+ * data moves when it's done.
+ */
+typedef struct ucode_disk {
+    blkdev_t * disk;
+    ram_t * ram;
+    uint32_t latency;
+    bool busy;
+    uint64_t done_at;
+} ucode_disk_t;
+
+
+// this cycle's inputs for the model, or NULL if there's nothing new
+static const ucode_inputs_t *
+ucode_devices (ucode_t * u, ucode_disk_t * d, uint64_t now, int key, ucode_inputs_t * in)
+{
+    ucode_blk_req_t req;
+    bool pending = ucode_blk_pending(u, &req);
+
+    if (key < 0 && !pending) {
+        return NULL;
+    }
+
+    memset(in, 0, sizeof(*in));
+    in->intv     = 0x80;
+    in->int_prio = 4;
+
+    if (key >= 0) {
+        in->dev_ready = true;
+        in->dev_data  = (uint8_t)key;
+    }
+
+    if (pending && !d->busy) {
+        d->busy    = true;
+        d->done_at = now + (uint64_t)d->latency * req.cnt;
+    } else if (pending && now >= d->done_at) {
+        bool ok = d->disk && blkdev_transfer(d->disk, d->ram, req.write, req.sec, req.addr, req.cnt);
+
+        in->blk_done  = true;
+        in->blk_error = !ok;
+        in->ic_flush  = ok && !req.write;
+        d->busy       = false;
+    }
+
+    return in;
+}
+
+
+/*
+ * Microcode mode: same RAM image and devices, run cycle by cycle on
+ * the C++ model of the microcoded machine (ucode.cpp) instead of
+ * the Verilated one
+ */
+static int
+run_ucode (machine_opts_t * opts)
+{
+    uint16_t entry = 0x3000;
+
+    if (!opts->image && !opts->os_image) {
+        ERROR_PRINT("Microcode mode needs a program or OS image");
+        return IIT3503_EXIT_ERROR;
+    }
+
+    ram_t * ram = create_ram(IIT3503_RAMSIZE,
+                             opts->image,
+                             opts->os_image,
+                             &entry,
+                             opts->shm,
+                             opts->shm_is_file);
+    if (!ram) {
+        ERROR_PRINT("Could not create RAM");
+        return IIT3503_EXIT_ERROR;
+    }
+
+    ucode_t * u = ucode_create(ram->ram, entry);
+    if (!u) {
+        destroy_ram(ram);
+        return IIT3503_EXIT_ERROR;
+    }
+
+    ucode_set_wait_states(u, opts->ram_wait_min, opts->ram_wait_max);
+    ucode_set_uart_sink(u, console_sink, NULL);
+
+    ucode_disk_t disk = { NULL, ram, opts->disk_latency, false, 0 };
+    if (opts->disk) {
+        disk.disk = blkdev_open(opts->disk);
+        if (!disk.disk) {
+            ucode_destroy(u);
+            destroy_ram(ram);
+            return IIT3503_EXIT_ERROR;
+        }
+    }
+
+    INFO_PRINT("Microcode mode: C++ model of the RTL, starting at x%04x", entry);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    uint64_t deadline = opts->max_wall_secs > 0 ? host_ns() + (uint64_t)(opts->max_wall_secs * 1e9) : 0;
+    int code = IIT3503_EXIT_HALT;
+    bool halted = false;
+
+    iit3503_regs_t regs;
+    ucode_read_regs(u, &regs);
+
+    // keyboard, limits and time are looked at once per slice
+    while (!halted) {
+        int key = poll_kbd();
+        ucode_inputs_t in;
+
+        for (int i = 0; i < UCODE_SLICE && !halted; i++) {
+            halted = ucode_cycle(u, ucode_devices(u, &disk, regs.cycles + i, key, &in));
+            key = -1;
+        }
+
+        ucode_read_regs(u, &regs);
+
+        if (!halted &&
+            ((opts->max_cycles && regs.cycles >= opts->max_cycles) ||
+             (opts->max_instrs && regs.instrs >= opts->max_instrs) ||
+             (deadline && host_ns() >= deadline))) {
+            code = IIT3503_EXIT_TIMEOUT;
+            break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    fflush(stdout);
+    if (code == IIT3503_EXIT_TIMEOUT) {
+        ERROR_PRINT("Stopped: out of time at PC x%04x", regs.pc);
+    } else {
+        INFO_PRINT("Machine halted.");
+        if (IIT3503_GUEST_STATUS(regs.mcr)) {
+            ERROR_PRINT("The guest reported failure (MCR[7:0] = x%02x)", IIT3503_GUEST_STATUS(regs.mcr));
+            code = IIT3503_EXIT_GUEST;
+        }
+    }
+    INFO_PRINT("%lu cycles (%lu instructions) in %.3fs (%.1f kHz)",
+            regs.cycles,
+            regs.instrs,
+            secs,
+            secs > 0 ? regs.cycles / secs / 1e3 : 0.0);
+
+    if (disk.disk) {
+        blkdev_close(disk.disk);
+    }
+    ucode_destroy(u);
+    destroy_ram(ram);
+
+    return code;
+}
+
+
 int 
 main (int argc, char **argv)
 {
     machine_opts_t opts = {0};
+    opts.disk_latency = DISK_LATENCY;
+    opts.history      = HISTORY_DUMP;
+    opts.fp_every     = FP_EVERY;
 
     int ret = parse_args(argc, argv, &opts);
     if (ret) {
-        return ret;
+        return IIT3503_EXIT_ERROR;
     }
+    if (opts.turbo) {
+        print_version();
+        return run_turbo(&opts);
+    }
+    if (opts.ucode) {
+        print_version();
+        return run_ucode(&opts);
+    }
+
     Verilated::commandArgs(argc, argv);
 
     print_banner();
 
-    dut = iit3503_init(opts.trace_en, opts.haltquit, opts.trace, opts.image, opts.os_image);
+    iit3503_config_t cfg = {0};
+    cfg.image       = opts.image;
+    cfg.os_image    = opts.os_image;
+    cfg.trace       = opts.trace_en ? opts.trace : NULL;
+    cfg.shm         = opts.shm;
+    cfg.shm_is_file = opts.shm_is_file;
+    cfg.ram_wait_min = opts.ram_wait_min;
+    cfg.ram_wait_max = opts.ram_wait_max;
+    cfg.ap_entry     = opts.ap_entry;
+    cfg.disk         = opts.disk;
+    cfg.disk_latency = opts.disk_latency;
+    cfg.lockstep     = opts.lockstep;
+    cfg.fingerprint  = opts.fingerprint;
+    cfg.fingerprint_every = opts.fp_every;
+
+    if (cfg.trace) {
+        cout << "Enabling timing output." << endl;
+    }
+
+    dut = iit3503_init(&cfg);
 
     if (!dut) {
         ERROR_PRINT("Could not initialize 3503\n");
         exit(EXIT_FAILURE);
     }
 
+    dut->haltquit   = opts.haltquit;
+
+    if (opts.trace_to) {
+        dut->trace_from = opts.trace_from;
+        dut->trace_to   = opts.trace_to;
+    }
+
+    dut->max_cycles    = opts.max_cycles;
+    dut->max_instrs    = opts.max_instrs;
+    dut->max_wall_ns   = (uint64_t)(opts.max_wall_secs * 1e9);
+    dut->stop_on_excp  = opts.stop_on_excp;
+    dut->watchdog_dump = opts.watchdog_dump;
+    dut->history_dump  = opts.history;
+
+    if (opts.stats) {
+        stats_path = opts.stats;
+        atexit(dump_stats);
+    }
+
+    if (opts.heatmap) {
+        if (!(dut->memprof = memprof_create())) {
+            exit(EXIT_FAILURE);
+        }
+        heatmap_path = opts.heatmap;
+        atexit(dump_heatmap);
+    }
+
+    if (opts.irq_latency) {
+        irqlat_on_exit = true;
+        atexit(print_irqlat);
+    }
+
+    sched_device(&kbd_dev, "kbd", check_for_kbd);
+    sched_wake(&dut->sched, &kbd_dev, 0);
+    iit3503_set_uart_sink(dut, console_sink, NULL);
+
+    cout << "Reset." << endl;
     iit3503_reset(dut);
 
     cout << "Starting Simulation." << endl;
         
     run_shell(dut, opts.interactive);
 
+    // the shell ran out of input: say how the guest left things
+    iit3503_regs_t regs;
+    iit3503_read_regs(dut, &regs);
+    int code = IIT3503_GUEST_STATUS(regs.mcr) ? IIT3503_EXIT_GUEST : IIT3503_EXIT_HALT;
+
+    dump_stats();
+    dump_heatmap();
+    print_irqlat();
     iit3503_deinit(dut);
 
-    return 0;
+    return code;
 }
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "fingerprint.h"
+#include "ram.h"
+
+struct fingerprint {
+    FILE * out;
+    uint64_t every;
+    bool first;                   // nothing's been hashed yet
+    uint64_t pages[RAM_PAGES];    // every page's hash, as of its last write
+};
+
+/*
+ * The hash: eight 32-bit lanes, each folding in every eighth word
+ * pair with a multiply and a shift, then the lanes folded together.
+ * GCC turns the lane arithmetic into whatever vector instructions
+ * the build targets (AVX2 on x86-64-v3, SSE2 otherwise).
+ */
+typedef uint32_t fp_vec_t __attribute__((vector_size(32)));
+
+#define FP_CHUNK sizeof(fp_vec_t)
+
+static inline uint64_t
+mix64 (uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+
+// len has to be a multiple of FP_CHUNK
+static uint64_t
+hash_block (const void * p, size_t len, uint64_t seed)
+{
+    const fp_vec_t mul = { 0x9E3779B1u, 0x85EBCA77u, 0xC2B2AE3Du, 0x27D4EB2Fu,
+                           0x165667B1u, 0xD3A2646Cu, 0xFD7046C5u, 0xB55A4F09u };
+    fp_vec_t acc = mul ^ (uint32_t)seed ^ (uint32_t)(seed >> 32);
+
+    for (size_t i = 0; i < len; i += FP_CHUNK) {
+        fp_vec_t w;
+        memcpy(&w, (const char*)p + i, FP_CHUNK);
+        acc  = (acc ^ w) * mul;
+        acc ^= acc >> 15;
+    }
+
+    uint64_t h = seed ^ len;
+    for (unsigned l = 0; l < FP_CHUNK / sizeof(uint32_t); l++) {
+        h = mix64(h ^ acc[l]);
+    }
+
+    return h;
+}
+
+
+fingerprint_t *
+fingerprint_open (const char * path, uint64_t every)
+{
+    fingerprint_t * fp = (fingerprint_t*)calloc(1, sizeof(fingerprint_t));
+
+    if (!fp) {
+        ERROR_PRINT("Could not allocate fingerprint state");
+        return NULL;
+    }
+
+    fp->out = fopen(path, "wb");
+    if (!fp->out) {
+        ERROR_PRINT("Could not open fingerprint file '%s'", path);
+        free(fp);
+        return NULL;
+    }
+
+    fp->every = every ? every : 1;
+    fp->first = true;
+
+    fwrite(FP_MAGIC, 1, 8, fp->out);
+    fwrite(&fp->every, sizeof(fp->every), 1, fp->out);
+
+    return fp;
+}
+
+
+void
+fingerprint_close (fingerprint_t * fp)
+{
+    fclose(fp->out);
+    free(fp);
+}
+
+
+uint64_t
+fingerprint_take (fingerprint_t * fp, ram_t * ram, const iit3503_regs_t * regs)
+{
+    uint16_t words[RAM_PAGE_WORDS];
+
+    // the RTL writes the array model's RAM itself, so no page there
+    // can be trusted not to have changed
+    bool all = fp->first || ram->scope;
+
+    for (unsigned page = 0; page < RAM_PAGES; page++) {
+        uint64_t bit = 1ull << (page % 64);
+
+        if (!all && !(ram->dirty[page / 64] & bit)) {
+            continue;
+        }
+
+        ram->dirty[page / 64] &= ~bit;
+        ram_read_block(ram, (uint16_t)(page << RAM_PAGE_SHIFT), words, RAM_PAGE_WORDS);
+        fp->pages[page] = hash_block(words, sizeof(words), page);
+    }
+
+    fp->first = false;
+
+    // the pages' hashes, then the registers
+    uint16_t arch[FP_CHUNK / sizeof(uint16_t)] = { 0 };
+    memcpy(arch, regs->r, sizeof(regs->r));
+    arch[8] = regs->pc;
+    arch[9] = regs->psr;
+
+    fp_record_t rec;
+    rec.instrs = regs->instrs;
+    rec.cycles = regs->cycles;
+    rec.hash   = hash_block(arch, sizeof(arch), hash_block(fp->pages, sizeof(fp->pages), 0));
+
+    fwrite(&rec, sizeof(rec), 1, fp->out);
+
+    return (regs->instrs / fp->every + 1) * fp->every;
+}
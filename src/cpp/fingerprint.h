@@ -0,0 +1,49 @@
+#ifndef __FINGERPRINT_H__
+#define __FINGERPRINT_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "libiit3503.h"
+
+/*
+ * Architectural state fingerprints: every so many instructions, a
+ * 64-bit hash of the registers, PC, PSR and all of RAM, written to a
+ * file. Two runs that should behave the same (e.g. before and after
+ * an RTL or harness change) can then be compared a record at a time
+ * instead of by diffing traces, and the first interval they disagree
+ * in found by binary search (tools/fpcmp.py). A run traced over just
+ * that interval (driver --trace-window) shows what happened.
+ *
+ * RAM is hashed a page at a time, and each page's hash is kept, so
+ * only pages written since the last fingerprint (see ram_dirty())
+ * are hashed again.
+ *
+ * The file is FP_MAGIC, the interval (a uint64_t), then one
+ * fp_record_t per fingerprint, all little-endian.
+ */
+
+#define FP_MAGIC "I3503FP1"
+
+typedef struct fp_record {
+    uint64_t instrs;
+    uint64_t cycles;         // not hashed: only recorded
+    uint64_t hash;
+} fp_record_t;
+
+struct ram;
+
+typedef struct fingerprint fingerprint_t;
+
+// a fingerprint every `every` instructions, to the file at path
+fingerprint_t * fingerprint_open (const char * path, uint64_t every);
+void fingerprint_close (fingerprint_t * fp);
+
+/*
+ * Takes one, with regs as iit3503_read_regs() has them (at an
+ * instruction boundary). Returns the instruction count the next one
+ * is due at: the next multiple of every.
+ */
+uint64_t fingerprint_take (fingerprint_t * fp, struct ram * ram, const iit3503_regs_t * regs);
+
+#endif
@@ -1,14 +1,19 @@
+#include <stdio.h>
 #include <string.h>
-#include <iostream>
+#include <atomic>
 #include "common.h"
 #include "iit3503.h"
-#include "shell.h"
 #include "ram.h"
+#include "blkdev.h"
+#include "status.h"
+#include "ucode.h"
+#include "fingerprint.h"
+#include "memprof.h"
+#include "irqlat.h"
 
 #include <verilated.h>
 #include <verilated_vcd_c.h>
 #include "VTop.h"
-using namespace std;
 
 const char * mnemonics[16] = {
     "BR",
@@ -24,7 +29,7 @@ const char * mnemonics[16] = {
     "LDI",
     "STI",
     "RET",
-    "(undefined)",
+    "MUL/DIV/MOD",
     "LEA",
     "TRAP",
 };
@@ -41,71 +46,326 @@ const char * regnames[8] = {
 };
 
 
+thread_local dut_t * iit3503_cur;
+
+double
+sc_time_stamp ()
+{
+    return iit3503_cur ? iit3503_cur->main_time : 0;
+}
+
+
 static bool
 check_should_halt (dut_t * dut)
 {
     if (dut->top->io_halt) {
-        INFO_PRINT("Machine halted.");
-        if (dut->haltquit) {
-            printf("  Quitting. Goodbye.\n");
-            exit(0);
+        if (dut->status) {
+            status_update(dut->status, dut);
         }
         return true;
     }
     return false;
 }
 
+// is this instruction in the waveform's window?
+static inline bool
+tracing (dut_t * dut)
+{
+    return dut->trace_en && dut->instr_count >= dut->trace_from && dut->instr_count < dut->trace_to;
+}
+
+
+static inline void
+half_cycle (dut_t * dut, uint8_t clock)
+{
+    dut->top->clock = clock;
+    dut->top->eval();
+    if (tracing(dut)) {
+        dut->tfp->dump((double)dut->main_time);
+    }
+    dut->main_time++;
+}
+
+
+// the same, keeping track of where the host time goes
+static void
+half_cycle_timed (dut_t * dut, uint8_t clock)
+{
+    uint64_t t0 = host_ns();
+
+    dut->top->clock = clock;
+    dut->top->eval();
+
+    uint64_t t1 = host_ns();
+    dut->metrics.eval_ns += t1 - t0;
+
+    if (tracing(dut)) {
+        dut->tfp->dump((double)dut->main_time);
+        dut->metrics.trace_ns += host_ns() - t1;
+    }
+    dut->main_time++;
+}
+
+
+/*
+ * Lockstep: what the RTL was given this cycle, for the microcode
+ * model to be given the same. This has to be read after the
+ * harness devices have run, just before the clock edge.
+ */
+static inline void
+lockstep_inputs (dut_t * dut, ucode_inputs_t * in)
+{
+    VTop * top = dut->top;
+
+    in->dev_ready = top->io_devReady;
+    in->dev_data  = top->io_devData & 0xFF;
+    in->intv      = top->io_intv;
+    in->int_prio  = top->io_intPriority;
+    in->ic_flush  = top->io_icFlush;
+    in->blk_done  = top->io_blk_done;
+    in->blk_error = top->io_blk_error;
+}
+
+
+#define LOCKSTEP_CMP(field, fmt)                                          \
+    if (rtl.field != model.field) {                                       \
+        ERROR_PRINT("  " #field ": RTL " fmt ", model " fmt, rtl.field, model.field); \
+    }
+
+// Runs the model's half of the cycle the RTL just ran, and compares
+// the two. Only the first mismatch is reported; after that the two
+// have nothing useful left to say about each other.
 static void
-check_for_kbd (dut_t * dut)
+lockstep_check (dut_t * dut, const ucode_inputs_t * in)
+{
+    iit3503_regs_t rtl, model;
+
+    ucode_cycle(dut->shadow, in);
+
+    if (dut->diverged_at) {
+        return;
+    }
+
+    iit3503_read_regs(dut, &rtl);
+    ucode_read_regs(dut->shadow, &model);
+
+    if (rtl.upc == model.upc && rtl.pc == model.pc && rtl.ir == model.ir &&
+        rtl.psr == model.psr && !memcmp(rtl.r, model.r, sizeof(rtl.r)) &&
+        rtl.mar == model.mar && rtl.mdr == model.mdr && rtl.mcr == model.mcr) {
+        return;
+    }
+
+    dut->diverged_at = dut->cycle_count;
+
+    ERROR_PRINT("Lockstep: the RTL and the microcode model diverged at cycle %lu (instruction %lu)",
+            dut->cycle_count,
+            dut->instr_count);
+    LOCKSTEP_CMP(upc, "%u")
+    LOCKSTEP_CMP(pc,  "x%04x")
+    LOCKSTEP_CMP(ir,  "x%04x")
+    LOCKSTEP_CMP(psr, "x%04x")
+    for (int i = 0; i < 8; i++) {
+        LOCKSTEP_CMP(r[i], "x%04x")
+    }
+    LOCKSTEP_CMP(mar, "x%04x")
+    LOCKSTEP_CMP(mdr, "x%04x")
+    LOCKSTEP_CMP(mcr, "x%04x")
+}
+
+
+/*
+ * Flight recorder: a record of what the instruction in flight did,
+ * into the next slot of the ring. This runs at every instruction
+ * boundary, so it only copies what the debug ports show: the
+ * registers against the ones it started with, and for loads and
+ * stores, MAR and MDR (which still hold the last access when IFETCH
+ * comes around).
+ */
+static inline void
+history_retire (dut_t * dut, uint8_t flags)
 {
-    fd_set rfds;
-    FD_ZERO(&rfds);
-    struct timeval tv;
+    VTop * top = dut->top;
+    iit3503_retire_t * rec = &dut->history[dut->history_count++ & (IIT3503_HISTORY_LEN - 1)];
+    uint16_t regs[8] = {
+        top->io_debugR0, top->io_debugR1, top->io_debugR2, top->io_debugR3,
+        top->io_debugR4, top->io_debugR5, top->io_debugR6, top->io_debugR7,
+    };
 
-    FD_SET(fileno(stdin), &rfds);
-    tv.tv_sec = 0;
-    tv.tv_usec = 0; 
+    rec->cycle = dut->cycle_count;
+    rec->pc    = dut->history_pc;
+    rec->ir    = top->io_debugIR;
+    rec->psr   = top->io_debugPSR;
+    rec->flags = flags;
 
-    if (select(fileno(stdin)+1, &rfds, NULL, NULL, &tv) > 0) {
-        unsigned char c = fgetc(stdin);
-        iit3503_raise_irq(dut, 0x80, 4, (uint16_t)c);
+    for (uint8_t k = 0; k < 8; k++) {
+        if (regs[k] != dut->history_regs[k]) {
+            rec->flags  |= IIT3503_RETIRE_REG;
+            rec->reg     = k;
+            rec->reg_val = regs[k];
+            break;
+        }
+    }
+
+    if (!flags) {
+        switch (rec->ir >> 12) {
+            case 0x2: case 0x6: case 0xA: // LD, LDR, LDI
+                rec->flags |= IIT3503_RETIRE_LOAD;
+                break;
+            case 0x3: case 0x7: case 0xB: // ST, STR, STI
+                rec->flags |= IIT3503_RETIRE_STORE;
+                break;
+            default:
+                break;
+        }
+        rec->mem_addr = top->io_debugMAR;
+        rec->mem_data = top->io_debugMDR;
+    }
+
+    dut->history_taken = flags != 0;
+}
+
+
+// the next instruction's starting point, at IFETCH
+static inline void
+history_fetch (dut_t * dut)
+{
+    VTop * top = dut->top;
+
+    dut->history_pc      = top->io_debugPC;
+    dut->history_regs[0] = top->io_debugR0;
+    dut->history_regs[1] = top->io_debugR1;
+    dut->history_regs[2] = top->io_debugR2;
+    dut->history_regs[3] = top->io_debugR3;
+    dut->history_regs[4] = top->io_debugR4;
+    dut->history_regs[5] = top->io_debugR5;
+    dut->history_regs[6] = top->io_debugR6;
+    dut->history_regs[7] = top->io_debugR7;
+    dut->history_taken   = false;
+}
+
+
+// whether a load or store to a goes to a device register rather
+// than RAM (see AddrCtrl.scala)
+static bool
+is_devreg (uint16_t a)
+{
+    switch (a) {
+        case 0xFE00: case 0xFE02: case 0xFE04: case 0xFE06: case 0xFE08:
+        case 0xFE10: case 0xFE12: case 0xFE14: case 0xFE16:
+        case 0xFE18: case 0xFE1A: case 0xFE1C: case 0xFE1E:
+        case 0xFE20: case 0xFFFE:
+            return true;
     }
+    return (a >> 3) == (0xFE30 >> 3);
 }
 
+
+// the memory profile's part of a cycle. RAM accesses are counted as
+// they complete (extern_ram_commit()), against R6 as of this cycle;
+// device registers never get there, so they're counted here, once
+// the state that accessed one moves on.
+static inline void
+memprof_cycle (dut_t * dut, uint8_t upc)
+{
+    memprof_t * mp = dut->memprof;
+    uint8_t last  = dut->last_upc;
+
+    if (upc != last && ((IIT3503_MIO_UPCS >> last) & 1) && is_devreg(dut->top->io_debugMAR)) {
+        memprof_count(mp, dut->top->io_debugMAR, (IIT3503_MIO_WRITES >> last) & 1);
+    }
+
+    mp->sp = dut->top->io_debugR6;
+}
+
+
 bool
 iit3503_step_cycle (dut_t * dut, bool reset)
 {
-    if (!reset)
-        uart_rx((uint8_t)dut->top->io_uartTxd);
+    metrics_t * m = &dut->metrics;
+    bool timed    = !(dut->cycle_count & (METRICS_SAMPLE - 1));
+    uint64_t t0   = 0;
+    uint64_t model_ns = 0;
 
-    check_for_kbd(dut);
+    iit3503_cur = dut;
 
-    // reset device interrupt ready signal
-    if (dut->top->io_intAck) {
-        dut->top->io_devReady = 0;
-        dut->top->io_intAck = 0;
+    if (timed) {
+        t0       = host_ns();
+        model_ns = m->eval_ns + m->trace_ns;
     }
 
+    if (dut->cycle_count >= dut->sched.next) {
+        sched_run(dut, &dut->sched, dut->cycle_count);
+    }
 
-    dut->top->clock = 1;
-    dut->top->eval();
-    if (dut->trace_en) {
-        dut->tfp->dump((double)dut->main_time);
+    ucode_inputs_t in;
+    if (dut->shadow) {
+        lockstep_inputs(dut, &in);
     }
-    dut->main_time++;
 
-    dut->top->clock = 0;
-    dut->top->eval();
-    if (dut->trace_en) {
-        dut->tfp->dump((double)dut->main_time);
+    if (timed) {
+        half_cycle_timed(dut, 1);
+        half_cycle_timed(dut, 0);
+    } else {
+        half_cycle(dut, 1);
+        half_cycle(dut, 0);
     }
-    dut->main_time++;
     dut->cycle_count++;
 
-    if (!reset)
-        return check_should_halt(dut);
+    bool halted = false;
 
-    return false;
+    if (!reset) {
+        uint8_t upc = dut->top->io_debuguPC;
+
+        if (dut->memprof) {
+            memprof_cycle(dut, upc);
+        }
+
+        if (upc == IIT3503_FETCH_UPC && dut->last_upc != IIT3503_FETCH_UPC) {
+            dut->instr_count++;
+            if (!dut->history_taken) {
+                history_retire(dut, 0);
+            }
+            irqlat_boundary(dut->irqlat, dut->cycle_count, dut->top->io_debugIR,
+                            dut->history_regs[6], dut->top->io_debugR6);
+            history_fetch(dut);
+            if (dut->status) {
+                status_update(dut->status, dut);
+            }
+            if (dut->fp && dut->instr_count >= dut->fp_next) {
+                iit3503_regs_t regs;
+                iit3503_read_regs(dut, &regs);
+                dut->fp_next = fingerprint_take(dut->fp, dut->ram, &regs);
+            }
+        } else if (upc != dut->last_upc) {
+            if (upc == IIT3503_INTACK_UPC) {
+                m->irqs_taken++;
+                history_retire(dut, IIT3503_RETIRE_INT);
+                irqlat_ack(dut->irqlat, dut->cycle_count, dut->top->io_intAck);
+            } else if ((IIT3503_EXCP_UPCS >> upc) & 1) {
+                dut->excp_upc = upc;
+                dut->excps++;
+                history_retire(dut, IIT3503_RETIRE_EXCP);
+                irqlat_excp(dut->irqlat);
+            } else if (dut->last_upc == IIT3503_VECTOR_UPC) {
+                irqlat_vector(dut->irqlat, dut->top->io_debugMAR & 0xFF);
+            }
+        }
+        dut->last_upc = upc;
+
+        if (dut->shadow) {
+            lockstep_check(dut, &in);
+        }
+
+        halted = check_should_halt(dut);
+    }
+
+    if (timed) {
+        model_ns = m->eval_ns + m->trace_ns - model_ns;
+        m->harness_ns += host_ns() - t0 - model_ns;
+        m->sampled++;
+    }
+
+    return halted;
 }
 
 
@@ -115,7 +375,7 @@ iit3503_step_instr (dut_t * dut, bool reset)
     bool halt = false;
     do {
         halt = iit3503_step_cycle(dut, reset);
-    } while (dut->top->io_debuguPC != 18 && !halt);
+    } while (dut->top->io_debuguPC != IIT3503_FETCH_UPC && !halt);
 
     return halt;
 }
@@ -124,8 +384,6 @@ iit3503_step_instr (dut_t * dut, bool reset)
 void
 iit3503_reset (dut_t * dut)
 {
-    cout << "Reset." << endl;
-
     // reset
     dut->top->reset = 1;
     for (int i = 0; i < 5; i++) {
@@ -133,13 +391,111 @@ iit3503_reset (dut_t * dut)
     }
 
     dut->top->reset = 0;
+    dut->last_upc   = IIT3503_FETCH_UPC;
+    history_fetch(dut);
+    irqlat_forget(dut->irqlat);
+
+    // whatever the disk was doing, the device has forgotten it
+    dut->blk_busy   = false;
+    dut->excp_upc   = 0;
+
+    // the model starts over from the same RAM
+    if (dut->shadow) {
+        iit3503_read_mem(dut, 0, dut->shadow_mem, IIT3503_RAMSIZE);
+        ucode_reset(dut->shadow);
+        dut->diverged_at = 0;
+    }
+}
+
+
+// copies guest RAM the host changed over to the lockstep model's
+static void
+lockstep_mirror (dut_t * dut, uint16_t addr, size_t count)
+{
+    if (count > IIT3503_RAMSIZE) {
+        count = IIT3503_RAMSIZE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint16_t a = (uint16_t)(addr + i);
+        dut->shadow_mem[a] = ram_peek(dut->ram, a);
+    }
+}
+
+
+// devReady, icFlush and the disk's done/error are strobes: they're
+// raised between cycles, and have done their job once one clock edge
+// has seen them
+static uint64_t
+strobe_tick (dut_t * dut, device_t * dev)
+{
+    dut->top->io_devReady  = 0;
+    dut->top->io_icFlush   = 0;
+    dut->top->io_blk_done  = 0;
+    dut->top->io_blk_error = 0;
+    return SCHED_NEVER;
+}
+
+
+static void
+strobe (dut_t * dut)
+{
+    sched_wake(&dut->sched, &dut->strobe_dev, dut->cycle_count + 1);
+}
+
+
+// how often the disk looks for a new command
+#define BLK_POLL_CYCLES 64
+
+// The disk's end of the block device. It notices a command at its
+// next poll, and finishes it disk_latency cycles per sector later:
+// that's when the data moves (straight between the image and RAM)
+// and done gets pulsed.
+static uint64_t
+blk_tick (dut_t * dut, device_t * dev)
+{
+    VTop * top = dut->top;
+    uint64_t now = dut->cycle_count;
+
+    if (!dut->blk_busy) {
+        if (!top->io_blk_req) {
+            return now + BLK_POLL_CYCLES;
+        }
+        dut->blk_busy = true;
+        return now + 1 + (uint64_t)dut->disk_latency * top->io_blk_cnt;
+    }
+
+    bool write = top->io_blk_write;
+    bool ok = dut->disk && blkdev_transfer(dut->disk, dut->ram, write,
+                                           top->io_blk_sec,
+                                           top->io_blk_addr,
+                                           top->io_blk_cnt);
+
+    top->io_blk_done  = 1;
+    top->io_blk_error = !ok;
+
+    // a read may have landed on code the I-cache is holding
+    if (ok && !write) {
+        top->io_icFlush = 1;
+
+        // the model's block device only ever sees done, so the
+        // data has to be carried over to its RAM by hand
+        if (dut->shadow) {
+            lockstep_mirror(dut, top->io_blk_addr, (size_t)top->io_blk_cnt * BLK_SECTOR_WORDS);
+        }
+    }
+
+    strobe(dut);
+    dut->blk_busy = false;
+
+    return now + BLK_POLL_CYCLES;
 }
 
 
 dut_t *
-iit3503_init (bool trace_en, bool haltquit, char * trace, char * image, char * os_image)
+iit3503_init (const iit3503_config_t * cfg)
 {
-    uint16_t entry;
+    uint16_t entry = cfg->entry;
     dut_t * dut = (dut_t*)malloc(sizeof(dut_t));
     if (!dut) {
         ERROR_PRINT("Could not allocate DUT");
@@ -147,39 +503,182 @@ iit3503_init (bool trace_en, bool haltquit, char * trace, char * image, char * o
     }
     memset(dut, 0, sizeof(dut_t));
 
-    dut->trace    = trace;
-    dut->image    = image;
-    dut->os_image = os_image;
+    dut->trace    = cfg->trace;
+    dut->image    = cfg->image;
+    dut->os_image = cfg->os_image;
+#ifdef IIT3503_RAM_ARRAY
+    // guest RAM lives in the model, and the backdoor finds it by
+    // name, so every model needs a name of its own
+    static std::atomic<unsigned> models(0);
+    char name[32];
+    snprintf(name, sizeof(name), "iit3503_%u", models++);
+    dut->top      = new VTop(name);
+#else
     dut->top      = new VTop;
+#endif
 
-    dut->trace_en = trace_en;
-    dut->haltquit = haltquit;
+    dut->trace_en = cfg->trace != NULL;
+    dut->trace_to = UINT64_MAX;
 
     if (dut->trace_en) {
         dut->tfp = new VerilatedVcdC;
-        cout << "Enabling timing output." << endl;
         Verilated::traceEverOn(true);
         dut->top->trace(dut->tfp, 99); // trace 99 levels of module hierarchy
         dut->tfp->open(dut->trace);
     }
 
-    dut->ram = (ram_t*)create_ram(IIT3503_RAMSIZE, image, os_image, &entry);
+    dut->ram = (ram_t*)create_ram(IIT3503_RAMSIZE,
+                                  (char*)cfg->image,
+                                  (char*)cfg->os_image,
+                                  &entry,
+                                  cfg->shm,
+                                  cfg->shm_is_file);
     if (!dut->ram) {
         ERROR_PRINT("Could not create RAM");
-        return NULL;
+        goto out_err1;
+    }
+
+    ram_set_wait_states(dut->ram, cfg->ram_wait_min, cfg->ram_wait_max);
+
+#ifdef IIT3503_RAM_ARRAY
+    if (cfg->shm) {
+        ERROR_PRINT("Shared RAM needs the DPI memory model (make RAM_MODEL=dpi)");
+        goto out_err2;
+    }
+
+    char scope[64];
+    snprintf(scope, sizeof(scope), "%s.Top.mem", dut->top->name());
+    if (ram_attach(dut->ram, scope)) {
+        goto out_err2;
+    }
+#endif
+
+    if (cfg->shm) {
+        dut->status = status_create(cfg->shm, cfg->shm_is_file);
+        if (!dut->status) {
+            ERROR_PRINT("Could not create status page");
+            goto out_err2;
+        }
+    }
+
+    if (cfg->disk) {
+        dut->disk = blkdev_open(cfg->disk);
+        if (!dut->disk) {
+            goto out_err3;
+        }
+    }
+    dut->disk_latency = cfg->disk_latency;
+
+    if (cfg->lockstep) {
+        if (IIT3503_CORES > 1) {
+            ERROR_PRINT("Lockstep needs a single core build (make CORES=1)");
+            goto out_err4;
+        }
+
+        // nobody else may write RAM behind the model's back
+        if (cfg->shm) {
+            ERROR_PRINT("Lockstep doesn't work with shared RAM");
+            goto out_err4;
+        }
+
+        dut->shadow_mem = (uint16_t*)calloc(IIT3503_RAMSIZE, sizeof(uint16_t));
+        if (!dut->shadow_mem) {
+            ERROR_PRINT("Could not allocate lockstep RAM");
+            goto out_err4;
+        }
+
+        dut->shadow = ucode_create(dut->shadow_mem, entry);
+        if (!dut->shadow) {
+            goto out_err5;
+        }
+        ucode_set_wait_states(dut->shadow, cfg->ram_wait_min, cfg->ram_wait_max);
+    }
+
+    if (cfg->fingerprint) {
+        dut->fp = fingerprint_open(cfg->fingerprint, cfg->fingerprint_every);
+        if (!dut->fp) {
+            goto out_err6;
+        }
+        dut->fp_next = cfg->fingerprint_every ? cfg->fingerprint_every : 1;
+    }
+
+    dut->irqlat = irqlat_create();
+    if (!dut->irqlat) {
+        goto out_err7;
     }
 
     dut->resetvec = entry;
 
     dut->top->io_resetVec = entry;
+#if IIT3503_CORES > 1
+    dut->top->io_apVec    = cfg->ap_entry;
+#endif
+
+    dut->metrics.start_ns = host_ns();
+
+    sched_init(&dut->sched);
+    sched_device(&dut->strobe_dev, "strobes", strobe_tick);
+    uart_init(dut);
+
+    sched_device(&dut->blk_dev, "disk", blk_tick);
+    sched_wake(&dut->sched, &dut->blk_dev, 0);
 
     return dut;
+
+out_err7:
+    if (dut->fp) {
+        fingerprint_close(dut->fp);
+    }
+out_err6:
+    if (dut->shadow) {
+        ucode_destroy(dut->shadow);
+    }
+out_err5:
+    free(dut->shadow_mem);
+out_err4:
+    if (dut->disk) {
+        blkdev_close(dut->disk);
+    }
+out_err3:
+    if (dut->status) {
+        status_destroy(dut->status);
+    }
+out_err2:
+    destroy_ram(dut->ram);
+out_err1:
+    if (dut->trace_en) {
+        dut->tfp->close();
+        delete dut->tfp;
+    }
+    delete dut->top;
+    free(dut);
+    return NULL;
 }
 
 
 void
 iit3503_deinit (dut_t * dut)
 {
+    if (dut->status) {
+        status_destroy(dut->status);
+    }
+
+    if (dut->disk) {
+        blkdev_close(dut->disk);
+    }
+
+    if (dut->shadow) {
+        ucode_destroy(dut->shadow);
+        free(dut->shadow_mem);
+    }
+
+    if (dut->fp) {
+        fingerprint_close(dut->fp);
+    }
+
+    memprof_destroy(dut->memprof);
+    irqlat_destroy(dut->irqlat);
+
     destroy_ram(dut->ram);
     dut->top->final();
     delete dut->top;
@@ -193,17 +692,189 @@ iit3503_deinit (dut_t * dut)
 }
 
 /*
- * We only have a keyboard device:
- *  - int priority = 4
- *  - int vec = x80
+ * Hands one byte straight to the keyboard FIFO (bypassing the serial
+ * line), and sets the vector/priority the keyboard interrupts with.
+ * Normally that's x80 at priority 4.
  */
 void
 iit3503_raise_irq (dut_t * dut, uint8_t irqnum, uint8_t priority, uint16_t data)
 {
+    dut->metrics.irqs_raised++;
+    irqlat_raise(dut->irqlat, dut->cycle_count);
     dut->top->io_intPriority = priority;
     dut->top->io_intv        = irqnum;
     dut->top->io_devReady = 1;
     dut->top->io_devData  = data;
+    strobe(dut);
+}
+
+
+int
+iit3503_run_until (dut_t * dut, uint16_t pc, uint64_t max_cycles)
+{
+    uint64_t stop = dut->cycle_count + max_cycles;
+
+    while (dut->cycle_count < stop) {
+        if (iit3503_step_cycle(dut, false)) {
+            return IIT3503_STOP_HALT;
+        }
+
+        if (dut->top->io_debuguPC == IIT3503_FETCH_UPC && dut->top->io_debugPC == pc) {
+            return IIT3503_STOP_PC;
+        }
+    }
+
+    return IIT3503_STOP_LIMIT;
+}
+
+
+unsigned
+iit3503_num_cores (void)
+{
+    return IIT3503_CORES;
+}
+
+
+bool
+iit3503_select_core (dut_t * dut, unsigned core)
+{
+    if (core >= IIT3503_CORES) {
+        return false;
+    }
+
+    dut->top->io_debugCore = core;
+    dut->top->eval();
+
+    // don't count the switch itself as an instruction boundary, and
+    // record this core from here on
+    dut->last_upc = dut->top->io_debuguPC;
+    history_fetch(dut);
+    irqlat_forget(dut->irqlat);
+    return true;
+}
+
+
+void
+iit3503_read_regs (dut_t * dut, iit3503_regs_t * regs)
+{
+    VTop * top = dut->top;
+
+    regs->r[0]   = top->io_debugR0;
+    regs->r[1]   = top->io_debugR1;
+    regs->r[2]   = top->io_debugR2;
+    regs->r[3]   = top->io_debugR3;
+    regs->r[4]   = top->io_debugR4;
+    regs->r[5]   = top->io_debugR5;
+    regs->r[6]   = top->io_debugR6;
+    regs->r[7]   = top->io_debugR7;
+    regs->pc     = top->io_debugPC;
+    regs->ir     = top->io_debugIR;
+    regs->psr    = top->io_debugPSR;
+    regs->upc    = top->io_debuguPC;
+    regs->mar    = top->io_debugMAR;
+    regs->mdr    = top->io_debugMDR;
+    regs->mcr    = top->io_debugMCR;
+    regs->cycles = dut->cycle_count;
+    regs->instrs = dut->instr_count;
+    regs->icache_hits   = top->io_debugICHits;
+    regs->icache_misses = top->io_debugICMisses;
+}
+
+
+int
+watchdog_check (dut_t * dut, bool check_wall)
+{
+    if (dut->diverged_at) {
+        return IIT3503_EXIT_DIVERGED;
+    }
+
+    if (dut->stop_on_excp && dut->excp_upc) {
+        return IIT3503_EXIT_EXCEPTION;
+    }
+
+    if ((dut->max_cycles && dut->cycle_count >= dut->max_cycles) ||
+        (dut->max_instrs && dut->instr_count >= dut->max_instrs)) {
+        return IIT3503_EXIT_TIMEOUT;
+    }
+
+    if (check_wall && dut->max_wall_ns && host_ns() - dut->metrics.start_ns >= dut->max_wall_ns) {
+        return IIT3503_EXIT_TIMEOUT;
+    }
+
+    return 0;
+}
+
+
+uint64_t
+iit3503_diverged (dut_t * dut)
+{
+    return dut->diverged_at;
+}
+
+
+void
+iit3503_read_stats (dut_t * dut, iit3503_stats_t * st)
+{
+    const metrics_t * m = &dut->metrics;
+
+    // scale the sampled cycles' host time up to all of them
+    double scale = m->sampled ? (double)dut->cycle_count / m->sampled : 0.0;
+
+    st->cycles       = dut->cycle_count;
+    st->instrs       = dut->instr_count;
+    st->wall_secs    = (host_ns() - m->start_ns) / 1e9;
+    st->eval_secs    = m->eval_ns * scale / 1e9;
+    st->trace_secs   = m->trace_ns * scale / 1e9;
+    st->harness_secs = m->harness_ns * scale / 1e9;
+    st->irqs_raised  = m->irqs_raised;
+    st->irqs_taken   = m->irqs_taken;
+    st->uart_out     = m->uart_out;
+    st->uart_in      = m->uart_in;
+}
+
+
+size_t
+iit3503_history (dut_t * dut, iit3503_retire_t * buf, size_t n)
+{
+    uint64_t have = dut->history_count < IIT3503_HISTORY_LEN ? dut->history_count : IIT3503_HISTORY_LEN;
+
+    if (n > have) {
+        n = have;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = dut->history[(dut->history_count - n + i) & (IIT3503_HISTORY_LEN - 1)];
+    }
+
+    return n;
+}
+
+
+// the address space is 64K words, so these wrap
+// around at the top of memory just like the guest does
+void
+iit3503_read_mem (dut_t * dut, uint16_t addr, uint16_t * buf, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = ram_peek(dut->ram, (uint16_t)(addr + i));
+    }
+}
+
+
+void
+iit3503_write_mem (dut_t * dut, uint16_t addr, const uint16_t * buf, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        ram_poke(dut->ram, (uint16_t)(addr + i), buf[i]);
+    }
+
+    if (dut->shadow) {
+        ucode_write_mem(dut->shadow, addr, buf, count);
+    }
+
+    // the I-cache can't see these
+    dut->top->io_icFlush = 1;
+    strobe(dut);
 }
 
 
@@ -230,10 +901,9 @@ iit3503_instr_repr (dut_t * dut, uint16_t addr, char * buf, size_t buflen)
 
     switch (u_pc) {
         case 18:
-        case 33:
         case 28:
         case 30:
-            ir = dut->ram->ram[pc]; // IR hasn't been loaded yet, so we get it directly
+            ir = ram_peek(dut->ram, pc); // IR hasn't been loaded yet, so we get it directly
             break;
         default:
             ir = (uint16_t)dut->top->io_debugIR;
@@ -244,7 +914,7 @@ iit3503_instr_repr (dut_t * dut, uint16_t addr, char * buf, size_t buflen)
 
     switch (op) {
         case 0: 
-            snprintf(buf, buflen, "%s (%s%s%s) PCoffset9=%d", 
+            snprintf(buf, buflen, "%s (%s%s%s) PCoffset9=%d",
                     mnemonics[op],
                     ((ir >> 11) & 1) ? "n" : "",
                     ((ir >> 10) & 1) ? "z" : "",
@@ -334,9 +1004,27 @@ iit3503_instr_repr (dut_t * dut, uint16_t addr, char * buf, size_t buflen)
                     ((ir>>6) & 0x7) == 7 ? "RET" : mnemonics[op],
                     regnames[(ir >> 9) & 0x7]);
             break;
-        case 13:
-            snprintf(buf, buflen, "Reserved opcode (1101)");
-            break;
+        case 13: {
+            static const char * mds[] = { NULL, "MUL", "DIV", "MOD" };
+            uint8_t md = (ir >> 3) & 0x3;
+
+            if (!md) {
+                snprintf(buf, buflen, "Reserved opcode (1101)");
+            } else if (ir & 0x20) {
+                snprintf(buf, buflen, "%s DR=%s, SR1=%s, imm3=%d",
+                        mds[md],
+                        regnames[(ir >> 9) & 0x7],
+                        regnames[(ir >> 6) & 0x7],
+                        ir & 0x7);
+            } else {
+                snprintf(buf, buflen, "%s DR=%s, SR1=%s, SR2=%s",
+                        mds[md],
+                        regnames[(ir >> 9) & 0x7],
+                        regnames[(ir >> 6) & 0x7],
+                        regnames[ir & 0x7]);
+            }
+        }
+        break;
         case 14: 
             snprintf(buf, buflen, "%s DR=%s PCoffset9=%d",
                     mnemonics[op],
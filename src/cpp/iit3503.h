@@ -3,12 +3,75 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include "libiit3503.h"
+#include "scheduler.h"
+#include "metrics.h"
 
 #define IIT3503_RAMSIZE (1<<16)
 
+// set by the Makefile to match the generated Top (make CORES=n)
+#ifndef IIT3503_CORES
+#define IIT3503_CORES 1
+#endif
+
+// guest serial output kept around when no sink is installed
+#define IIT3503_UART_BUFLEN 4096
+
 struct ram;
+struct blkdev;
+struct ucode;
+struct fingerprint;
+struct memprof;
+struct irqlat;
 struct Vtop;
 struct VerilatedVcdC;
+struct machine_status;
+
+// uPC of the first IFETCH state. Arriving here means
+// the previous instruction has retired.
+#define IIT3503_FETCH_UPC 18
+
+// uPC of the first interrupt state (INT ACK)
+#define IIT3503_INTACK_UPC 49
+
+// uPCs an exception enters at: RTI from user mode (44), ACV (48, 56,
+// 57, 60, 61) and illegal opcode (62), one bit each
+#define IIT3503_EXCP_UPCS ((1ull << 44) | (1ull << 48) | (1ull << 56) | (1ull << 57) | \
+                           (1ull << 60) | (1ull << 61) | (1ull << 62))
+
+// uPCs that access memory or a device register (MIO.EN), and the
+// ones of those that write. Each waits for R, so an access is done
+// when the uPC moves on. 16 is the book's STx write, which
+// ControlStore.scala still leaves to be filled in.
+#define IIT3503_MIO_UPCS   ((1ull << 16) | (1ull << 24) | (1ull << 25) | (1ull << 28) | \
+                            (1ull << 29) | (1ull << 36) | (1ull << 40) | (1ull << 41) | \
+                            (1ull << 52) | (1ull << 53))
+#define IIT3503_MIO_WRITES ((1ull << 16) | (1ull << 41) | (1ull << 52))
+
+// uPC of the interrupt sequence's vector table read (MAR = x01vv)
+#define IIT3503_VECTOR_UPC 53
+
+// process exit codes for batch runs
+enum {
+    IIT3503_EXIT_HALT      = 0, // halted with MCR[7:0] = 0
+    IIT3503_EXIT_ERROR     = 1, // the simulator itself failed
+    IIT3503_EXIT_TIMEOUT   = 2, // ran out of cycles, instructions or time
+    IIT3503_EXIT_EXCEPTION = 3, // took an exception (with stop_on_excp)
+    IIT3503_EXIT_GUEST     = 4, // halted with MCR[7:0] != 0: the guest says it failed
+    IIT3503_EXIT_DIVERGED  = 5, // the RTL and the microcode model disagreed (lockstep)
+};
+
+// host-side model of the receiving end of the serial line
+typedef struct uart_rx_state {
+    int shift_reg;
+    int bits_reg;  // samples left: 8 data bits, then the stop bit (0 = idle)
+} uart_rx_state_t;
+
+// host-side serializer driving the guest's receive line
+typedef struct uart_tx_state {
+    int bits;    // bits left in the current frame (0 = idle)
+    int frame;   // shifted out LSB first
+} uart_tx_state_t;
 
 typedef struct dut {
     struct VTop * top;
@@ -17,29 +80,107 @@ typedef struct dut {
     bool trace_en;
     bool haltquit;
 
+    // only instructions [trace_from, trace_to) go in the waveform
+    uint64_t trace_from;
+    uint64_t trace_to;
+
     struct ram * ram;
     uint64_t cycle_count;
+    uint64_t instr_count;
+    uint8_t last_upc;
+
+    // live status page (only when RAM is shared)
+    struct machine_status * status;
 
     uint64_t main_time;
-    uint64_t timeout;
+
+    // watchdog for batch runs (0 = no limit, see watchdog_check())
+    uint64_t max_cycles;
+    uint64_t max_instrs;
+    uint64_t max_wall_ns;
+    bool stop_on_excp;
+    bool watchdog_dump; // print registers and stats when it fires
+    uint8_t excp_upc;   // where the latest exception went in (0 = none)
+    uint64_t excps;     // how many exceptions have been taken
+
+    // flight recorder (see history_retire()), and how many of its
+    // records the shell prints when a run goes wrong (0 = none)
+    iit3503_retire_t history[IIT3503_HISTORY_LEN];
+    uint64_t history_count;   // records ever written
+    uint16_t history_pc;      // where the instruction in flight came from
+    uint16_t history_regs[8]; // ... and the registers before it
+    bool history_taken;       // it already has a record (INT or EXCP)
+    unsigned history_dump;
 
     uint16_t resetvec;
 
     const char * image;
     const char * trace;
     const char * os_image;
+
+    uart_rx_state_t uart;
+    uart_tx_state_t uart_out;
+
+    iit3503_uart_sink_t uart_sink;
+    void * uart_sink_arg;
+    char uart_buf[IIT3503_UART_BUFLEN];
+    size_t uart_head;
+    size_t uart_tail;
+
+    // host input waiting to be sent to the guest
+    char uart_in_buf[IIT3503_UART_BUFLEN];
+    size_t uart_in_head;
+    size_t uart_in_tail;
+
+    // host-side devices, and when they next need to run
+    sched_t sched;
+    device_t uart_rx_dev;
+    device_t uart_tx_dev;
+    device_t strobe_dev;  // drops devReady/icFlush after their cycle
+
+    // block device (NULL disk: every command fails)
+    struct blkdev * disk;
+    uint32_t disk_latency;
+    bool blk_busy;        // a command is being carried out
+    device_t blk_dev;
+
+    metrics_t metrics;
+
+    // lockstep: the microcode model, run next to the RTL on its own
+    // copy of RAM (see lockstep_check())
+    struct ucode * shadow;
+    uint16_t * shadow_mem;
+    uint64_t diverged_at; // cycle of the first mismatch (0 = none)
+
+    // state fingerprints (see fingerprint.h), and the instruction
+    // count the next one is due at
+    struct fingerprint * fp;
+    uint64_t fp_next;
+
+    // memory access profile (see memprof.h), NULL when off
+    struct memprof * memprof;
+
+    // interrupt latency histograms (see irqlat.h)
+    struct irqlat * irqlat;
 } dut_t;
 
-dut_t * iit3503_init(bool trace_en, bool haltquit, char * trace, char * image, char * os_image);
+// the machine whose model is currently being evaluated. DPI
+// hooks (e.g. extern_ram_read()) have no other way of knowing which
+// instance they belong to.
+extern thread_local dut_t * iit3503_cur;
 
-bool iit3503_step_cycle(dut_t * dut, bool reset);
-bool iit3503_step_instr(dut_t * dut, bool reset);
-void iit3503_reset(dut_t * dut);
-void iit3503_deinit(dut_t * dut);
-void iit3503_raise_irq (dut_t * dut, uint8_t irq, uint8_t priority, uint16_t data);
 void iit3503_instr_repr (dut_t * dut, uint16_t addr, char * buf, size_t buflen);
 
-void uart_rx(uint8_t rxd);
+// which limit the run has hit (IIT3503_EXIT_TIMEOUT or _EXCEPTION),
+// or 0 if it should keep going. Time is only looked at when check_wall
+// is set, since that's not free.
+int watchdog_check (dut_t * dut, bool check_wall);
+
+// the status the guest left in MCR[7:0] when it stopped the clock
+#define IIT3503_GUEST_STATUS(mcr) ((mcr) & 0xFF)
+
+// sets up the serial line's devices (see uart.cpp)
+void uart_init(dut_t * dut);
 
 
 #endif
@@ -0,0 +1,327 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "irqlat.h"
+
+#define SUB (1u << IRQLAT_SUB_BITS)
+
+// widest bar in a histogram
+#define BAR_WIDTH 40
+
+static const char * const stage_names[IRQLAT_STAGES] = {
+    "raise->ack",
+    "ack->entry",
+    "entry->RTI",
+    "total",
+};
+
+static inline unsigned
+bucket (uint64_t v)
+{
+    if (v < SUB) {
+        return (unsigned)v;
+    }
+
+    unsigned e = 63 - __builtin_clzll(v);
+    return ((e - IRQLAT_SUB_BITS + 1) << IRQLAT_SUB_BITS) + ((v >> (e - IRQLAT_SUB_BITS)) & (SUB - 1));
+}
+
+
+// the largest value that lands in bucket b
+static uint64_t
+bucket_top (unsigned b)
+{
+    if (b < SUB) {
+        return b;
+    }
+
+    unsigned e = (b >> IRQLAT_SUB_BITS) + IRQLAT_SUB_BITS - 1;
+    uint64_t lo = (uint64_t)(SUB + (b & (SUB - 1))) << (e - IRQLAT_SUB_BITS);
+    return lo + (1ull << (e - IRQLAT_SUB_BITS)) - 1;
+}
+
+
+static void
+record (irqlat_t * il, uint8_t vec, irqlat_stage_t stage, uint64_t cycles)
+{
+    irqlat_hist_t * h = il->vecs[vec][stage];
+
+    if (!h) {
+        h = il->vecs[vec][stage] = (irqlat_hist_t*)calloc(1, sizeof(irqlat_hist_t));
+        if (!h) {
+            return;
+        }
+        h->min = UINT64_MAX;
+    }
+
+    h->count++;
+    h->sum += cycles;
+    if (cycles < h->min) {
+        h->min = cycles;
+    }
+    if (cycles > h->max) {
+        h->max = cycles;
+    }
+    h->buckets[bucket(cycles)]++;
+}
+
+
+irqlat_t *
+irqlat_create (void)
+{
+    irqlat_t * il = (irqlat_t*)calloc(1, sizeof(irqlat_t));
+
+    if (!il) {
+        ERROR_PRINT("Could not allocate the interrupt latency state");
+        return NULL;
+    }
+
+    il->raised = IRQLAT_NONE;
+    return il;
+}
+
+
+void
+irqlat_destroy (irqlat_t * il)
+{
+    if (!il) {
+        return;
+    }
+
+    for (unsigned v = 0; v < 256; v++) {
+        for (unsigned s = 0; s < IRQLAT_STAGES; s++) {
+            free(il->vecs[v][s]);
+        }
+    }
+    free(il);
+}
+
+
+void
+irqlat_forget (irqlat_t * il)
+{
+    il->raised   = IRQLAT_NONE;
+    il->entering = false;
+    il->excp     = false;
+    il->depth    = 0;
+}
+
+
+void
+irqlat_reset (irqlat_t * il)
+{
+    for (unsigned v = 0; v < 256; v++) {
+        for (unsigned s = 0; s < IRQLAT_STAGES; s++) {
+            free(il->vecs[v][s]);
+            il->vecs[v][s] = NULL;
+        }
+    }
+    il->lost = 0;
+}
+
+
+void
+irqlat_raise (irqlat_t * il, uint64_t cycle)
+{
+    // raises the machine hasn't got to yet are all served by the
+    // next interrupt, so they're timed from the first
+    if (il->raised == IRQLAT_NONE) {
+        il->raised = cycle;
+    }
+}
+
+
+void
+irqlat_ack (irqlat_t * il, uint64_t cycle, bool host)
+{
+    il->entering    = true;
+    il->next.vec    = 0;
+    il->next.ack    = cycle;
+    il->next.raised = IRQLAT_NONE;
+
+    if (host && il->raised != IRQLAT_NONE) {
+        il->next.raised = il->raised;
+        il->raised      = IRQLAT_NONE;
+    }
+}
+
+
+void
+irqlat_vector (irqlat_t * il, uint8_t vec)
+{
+    if (il->entering) {
+        il->next.vec = vec;
+    }
+}
+
+
+void
+irqlat_excp (irqlat_t * il)
+{
+    il->excp = true;
+}
+
+
+void
+irqlat_boundary (irqlat_t * il, uint64_t cycle, uint16_t ir, uint16_t sp, uint16_t sp_now)
+{
+    // the handler's first instruction. ir is whatever ran before the
+    // interrupt, not an instruction of its own.
+    if (il->entering) {
+        irqlat_frame_t * f = &il->next;
+
+        il->entering = false;
+        f->entry     = cycle;
+        f->sp        = sp_now;
+
+        if (f->raised != IRQLAT_NONE) {
+            record(il, f->vec, IRQLAT_RAISE, f->ack - f->raised);
+        }
+        record(il, f->vec, IRQLAT_ENTRY, f->entry - f->ack);
+
+        if (il->depth == IRQLAT_DEPTH) {
+            memmove(il->frames, il->frames + 1, sizeof(*f) * (IRQLAT_DEPTH - 1));
+            il->depth--;
+            il->lost++;
+        }
+        il->frames[il->depth++] = *f;
+        return;
+    }
+
+    // ... likewise an exception's
+    if (il->excp) {
+        il->excp = false;
+        return;
+    }
+
+    if ((ir >> 12) != 0x8 || !il->depth) {
+        return;
+    }
+
+    // an RTI. Handlers deeper than this one's have been left some
+    // other way (or this is a TRAP's, deeper still).
+    while (il->depth && il->frames[il->depth - 1].sp < sp) {
+        il->depth--;
+        il->lost++;
+    }
+
+    if (il->depth && il->frames[il->depth - 1].sp == sp) {
+        irqlat_frame_t * f = &il->frames[--il->depth];
+        record(il, f->vec, IRQLAT_HANDLER, cycle - f->entry);
+        record(il, f->vec, IRQLAT_TOTAL, cycle - (f->raised != IRQLAT_NONE ? f->raised : f->ack));
+    }
+}
+
+
+uint64_t
+irqlat_percentile (const irqlat_hist_t * h, double p)
+{
+    if (!h || !h->count) {
+        return 0;
+    }
+
+    uint64_t want = (uint64_t)(p * h->count + 0.5);
+    if (want < 1) {
+        want = 1;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < IRQLAT_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= want) {
+            uint64_t top = bucket_top(b);
+            return top < h->max ? top : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+
+// counts by power of two
+static void
+print_hist (const irqlat_hist_t * h)
+{
+    uint64_t rows[65] = { 0 };
+    uint64_t most = 0;
+    unsigned first = 65, last = 0;
+
+    for (unsigned b = 0; b < IRQLAT_BUCKETS; b++) {
+        if (!h->buckets[b]) {
+            continue;
+        }
+        uint64_t top = bucket_top(b);
+        unsigned row = top ? 64 - __builtin_clzll(top) : 0;
+        rows[row] += h->buckets[b];
+        first = row < first ? row : first;
+        last  = row > last ? row : last;
+    }
+    for (unsigned r = first; r <= last; r++) {
+        most = rows[r] > most ? rows[r] : most;
+    }
+
+    for (unsigned r = first; r <= last; r++) {
+        char bar[BAR_WIDTH + 1];
+        unsigned len = (unsigned)((rows[r] * BAR_WIDTH + most - 1) / most);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+
+        uint64_t lo = r ? 1ull << (r - 1) : 0;
+        uint64_t hi = r ? (1ull << r) - 1 : 0;
+        INFO_PRINT("      %8lu-%-8lu %10lu %s", lo, hi, rows[r], bar);
+    }
+}
+
+
+void
+irqlat_print (const irqlat_t * il, int vec)
+{
+    bool any = false;
+
+    for (unsigned v = 0; v < 256; v++) {
+        if (vec >= 0 && v != (unsigned)vec) {
+            continue;
+        }
+
+        bool seen = false;
+        for (unsigned s = 0; s < IRQLAT_STAGES; s++) {
+            seen |= il->vecs[v][s] != NULL;
+        }
+        if (!seen) {
+            continue;
+        }
+
+        if (!any) {
+            INFO_PRINT("  Interrupt latency, in cycles:");
+            INFO_PRINT("    %-8s %-11s %8s %8s %8s %8s %8s %8s %8s", "Vector", "Stage",
+                    "Count", "Min", "Mean", "p50", "p90", "p99", "Max");
+            any = true;
+        }
+
+        for (unsigned s = 0; s < IRQLAT_STAGES; s++) {
+            const irqlat_hist_t * h = il->vecs[v][s];
+            if (!h) {
+                continue;
+            }
+
+            INFO_PRINT("    x%02x      %-11s %8lu %8lu %8.1f %8lu %8lu %8lu %8lu", v, stage_names[s],
+                    h->count, h->min, (double)h->sum / h->count,
+                    irqlat_percentile(h, 0.50), irqlat_percentile(h, 0.90),
+                    irqlat_percentile(h, 0.99), h->max);
+
+            if (vec >= 0) {
+                print_hist(h);
+            }
+        }
+    }
+
+    if (!any) {
+        INFO_PRINT("  No interrupts %s yet", vec >= 0 ? "on that vector" : "taken");
+        return;
+    }
+
+    if (il->lost) {
+        INFO_PRINT("  %lu interrupt(s) never seen to return with an RTI", il->lost);
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef __IRQLAT_H__
+#define __IRQLAT_H__
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Interrupt latency, per interrupt vector. Each interrupt the
+ * machine takes is timed (in cycles) from
+ *
+ *   - the host raising it (iit3503_raise_irq(); the keyboard
+ *     interrupt only, since nothing else is raised by the host) to
+ *     the INT ACK microstate,
+ *   - INT ACK to the handler's first instruction (pushing PSR and
+ *     PC, and reading the vector table),
+ *   - that to the handler's RTI,
+ *
+ * and from the raise (or INT ACK, if the host didn't raise it) to
+ * the RTI overall. Each stage has a histogram, log-linear like HDR
+ * histograms: exact below 8 cycles, then 8 buckets per power of two,
+ * so percentiles read off it are within 12.5%.
+ *
+ * Handlers nest, and TRAPs and exceptions in them push frames and
+ * RTI too, so an RTI is matched to its interrupt by the stack
+ * pointer: the RTI that returns from an interrupt starts with R6
+ * where it was at the handler's first instruction.
+ */
+
+typedef enum irqlat_stage {
+    IRQLAT_RAISE,   // raise to INT ACK
+    IRQLAT_ENTRY,   // INT ACK to the handler
+    IRQLAT_HANDLER, // the handler to its RTI
+    IRQLAT_TOTAL,   // raise (or INT ACK) to RTI
+    IRQLAT_STAGES
+} irqlat_stage_t;
+
+#define IRQLAT_SUB_BITS 3
+#define IRQLAT_BUCKETS  ((64 - IRQLAT_SUB_BITS + 1) << IRQLAT_SUB_BITS)
+
+// interrupts taken inside each other's handlers, at most
+#define IRQLAT_DEPTH 16
+
+#define IRQLAT_NONE UINT64_MAX
+
+typedef struct irqlat_hist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[IRQLAT_BUCKETS];
+} irqlat_hist_t;
+
+typedef struct irqlat_frame {
+    uint8_t vec;
+    uint16_t sp;      // R6 at the handler's first instruction
+    uint64_t raised;  // IRQLAT_NONE if the host didn't
+    uint64_t ack;
+    uint64_t entry;
+} irqlat_frame_t;
+
+typedef struct irqlat {
+    uint64_t raised;  // the oldest raise not acknowledged yet
+
+    // the interrupt being entered (between INT ACK and its handler)
+    bool entering;
+    irqlat_frame_t next;
+
+    // an exception went in since the last instruction boundary
+    bool excp;
+
+    irqlat_frame_t frames[IRQLAT_DEPTH];
+    unsigned depth;
+    uint64_t lost;    // interrupts never seen to return
+
+    irqlat_hist_t * vecs[256][IRQLAT_STAGES]; // NULL until used
+} irqlat_t;
+
+irqlat_t * irqlat_create (void);
+void irqlat_destroy (irqlat_t * il);
+
+// forgets the interrupts in flight (the machine was reset), or
+// everything
+void irqlat_forget (irqlat_t * il);
+void irqlat_reset (irqlat_t * il);
+
+// what the harness sees, as it sees it
+void irqlat_raise (irqlat_t * il, uint64_t cycle);
+void irqlat_ack (irqlat_t * il, uint64_t cycle, bool host);
+void irqlat_vector (irqlat_t * il, uint8_t vec);
+void irqlat_excp (irqlat_t * il);
+
+// an instruction boundary, after the instruction ir retired. sp is
+// R6 from before it, and sp_now from after.
+void irqlat_boundary (irqlat_t * il, uint64_t cycle, uint16_t ir, uint16_t sp, uint16_t sp_now);
+
+/*
+ * p (0..1) of the way through h: the top of the bucket it's in,
+ * but never past the largest latency seen.
+ */
+uint64_t irqlat_percentile (const irqlat_hist_t * h, double p);
+
+// the percentiles of every vector seen, and with vec >= 0, that
+// one's histograms
+void irqlat_print (const irqlat_t * il, int vec);
+
+#endif
@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "isa.h"
+
+#define BITS(x, hi, lo) (((x) >> (lo)) & ((1u << ((hi) - (lo) + 1)) - 1))
+
+static inline uint16_t
+sext (uint16_t x, int bits)
+{
+    uint16_t m = 1u << (bits - 1);
+    x &= (1u << bits) - 1;
+    return (x ^ m) - m;
+}
+
+
+void
+isa_init (isa_state_t * s, uint16_t * mem, uint16_t pc)
+{
+    memset(s, 0, sizeof(*s));
+    s->mem       = mem;
+    s->pc        = pc;
+    s->psr       = 0x0002; // supervisor, priority 0, Z
+    s->saved_usp = 0xFDFF;
+    s->saved_ssp = 0x0000;
+    s->mcr       = 0x8000;
+    s->kbcr      = 0x0001;
+}
+
+
+void
+isa_raise_irq (isa_state_t * s, uint8_t vec, uint8_t prio, uint16_t data)
+{
+    s->irq_vec  = vec;
+    s->irq_prio = prio & 0x7;
+
+    if (s->rx_count < ISA_RX_DEPTH) {
+        s->rx_fifo[(s->rx_head + s->rx_count++) % ISA_RX_DEPTH] = data & 0xFF;
+    }
+}
+
+
+// reading KBDR takes the character out of the FIFO
+static uint16_t
+kbdr_read (isa_state_t * s)
+{
+    if (!s->rx_count) {
+        return 0;
+    }
+
+    uint16_t c = s->rx_fifo[s->rx_head];
+    s->rx_head = (s->rx_head + 1) % ISA_RX_DEPTH;
+    s->rx_count--;
+
+    return c;
+}
+
+
+static uint16_t
+lock_read (isa_state_t * s, uint16_t addr)
+{
+    uint8_t bit = 1 << (addr - ISA_LOCK0);
+    uint16_t old = (s->locks & bit) ? 1 : 0;
+
+    s->locks |= bit;
+    return old;
+}
+
+
+static uint16_t
+rd (isa_state_t * s, uint16_t addr)
+{
+    if (addr >= ISA_LOCK0 && addr < ISA_LOCK0 + ISA_LOCKS) {
+        return lock_read(s, addr);
+    }
+
+    switch (addr) {
+        case ISA_KBSR: return (s->rx_count ? 0x8000 : 0) | s->kbsr | s->rx_count;
+        case ISA_KBDR: return kbdr_read(s);
+        case ISA_KBCR: return s->kbcr;
+        case ISA_DSR:  return ISA_DSR_READY | ISA_DSR_IDLE | s->dsr;
+        case ISA_DDR:  return 0;
+        case ISA_DMASRC: return s->dma_src;
+        case ISA_DMADST: return s->dma_dst;
+        case ISA_DMALEN: return s->dma_len;
+        case ISA_DMACTL: return s->dma_ctl;
+        case ISA_BLKSEC: return s->blk_sec;
+        case ISA_BLKADR: return s->blk_adr;
+        case ISA_BLKCNT: return s->blk_cnt;
+        case ISA_BLKCTL: return s->blk_ctl;
+        case ISA_CPUID:  return 0;
+        case ISA_MCR:  return s->mcr;
+        default:       return s->mem[addr];
+    }
+}
+
+
+static void wr (isa_state_t * s, uint16_t addr, uint16_t val);
+
+
+static void
+dma_ctl_write (isa_state_t * s, uint16_t val)
+{
+    s->dma_ctl = (s->dma_ctl & ISA_DMA_FILL) | (val & ISA_DMA_IE);
+
+    if (!(val & ISA_DMA_GO)) {
+        return;
+    }
+
+    s->dma_ctl = (s->dma_ctl & ~ISA_DMA_FILL) | (val & ISA_DMA_FILL);
+
+    for (; s->dma_len; s->dma_len--) {
+        if (val & ISA_DMA_FILL) {
+            wr(s, s->dma_dst++, s->dma_src);
+        } else {
+            wr(s, s->dma_dst++, s->mem[s->dma_src++]);
+        }
+    }
+
+    s->dma_ctl |= ISA_DMA_DONE;
+}
+
+
+static void
+blk_ctl_write (isa_state_t * s, uint16_t val)
+{
+    s->blk_ctl = (s->blk_ctl & ISA_BLK_WRITE) | (val & ISA_BLK_IE);
+
+    if (!(val & ISA_BLK_GO)) {
+        return;
+    }
+
+    bool write = val & ISA_BLK_WRITE;
+    s->blk_ctl = (s->blk_ctl & ~ISA_BLK_WRITE) | (val & ISA_BLK_WRITE) | ISA_BLK_DONE;
+
+    if (!s->blk_cnt) {
+        return;
+    }
+
+    if (!s->blk || !s->blk(s->blk_arg, write, s->blk_sec, s->blk_adr, s->blk_cnt)) {
+        s->blk_ctl |= ISA_BLK_ERR;
+        return;
+    }
+
+    // the disk went straight into memory, so tell whoever's watching
+    if (!write && s->wr_hook) {
+        unsigned words = s->blk_cnt * ISA_BLK_SECTOR;
+        for (unsigned i = 0; i < words && i < 0x10000; i++) {
+            s->wr_hook(s->wr_arg, (uint16_t)(s->blk_adr + i));
+        }
+    }
+}
+
+
+static void
+wr (isa_state_t * s, uint16_t addr, uint16_t val)
+{
+    if (addr >= ISA_LOCK0 && addr < ISA_LOCK0 + ISA_LOCKS) {
+        s->locks &= ~(1 << (addr - ISA_LOCK0));
+        return;
+    }
+
+    switch (addr) {
+        case ISA_KBSR:
+            s->kbsr = val & 0x4000;
+            break;
+        case ISA_KBCR:
+            s->kbcr = val;
+            break;
+        case ISA_KBDR:
+            break;
+        case ISA_DSR:
+            s->dsr = val & ISA_DSR_IE;
+            break;
+        case ISA_DDR:
+            if (s->out) {
+                s->out(s->out_arg, val & 0xFF);
+            }
+            break;
+        case ISA_DMASRC: s->dma_src = val; break;
+        case ISA_DMADST: s->dma_dst = val; break;
+        case ISA_DMALEN: s->dma_len = val; break;
+        case ISA_DMACTL:
+            dma_ctl_write(s, val);
+            break;
+        case ISA_BLKSEC: s->blk_sec = val; break;
+        case ISA_BLKADR: s->blk_adr = val; break;
+        case ISA_BLKCNT: s->blk_cnt = val; break;
+        case ISA_BLKCTL:
+            blk_ctl_write(s, val);
+            break;
+        case ISA_MCR:
+            s->mcr = val;
+            break;
+        case ISA_CPUID:
+            break;
+        default:
+            s->mem[addr] = val;
+            if (s->wr_hook) {
+                s->wr_hook(s->wr_arg, addr);
+            }
+    }
+}
+
+
+static void
+setcc (isa_state_t * s, uint16_t v)
+{
+    uint16_t cc = (v & 0x8000) ? 4 : (v ? 1 : 2);
+    s->psr = (s->psr & ~0x7) | cc;
+}
+
+
+/*
+ * MUL/DIV/MOD are signed. DIV truncates toward zero and MOD takes
+ * the sign of the dividend (like C). Dividing by zero gives xFFFF
+ * for DIV and the dividend for MOD, and x8000 / -1 is x8000.
+ */
+static uint16_t
+muldiv (unsigned op, uint16_t a, uint16_t b)
+{
+    int32_t x = (int16_t)a;
+    int32_t y = (int16_t)b;
+
+    switch (op) {
+        case ISA_MD_MUL: return (uint16_t)(x * y);
+        case ISA_MD_DIV: return y ? (uint16_t)(x / y) : 0xFFFF;
+        default:         return y ? (uint16_t)(x % y) : a;
+    }
+}
+
+
+/*
+ * Common entry sequence for interrupts, exceptions and TRAPs:
+ * switch to the supervisor stack (if we were in user mode), push the
+ * old PSR and the return PC, and jump through the vector.
+ */
+static void
+enter (isa_state_t * s, uint16_t table, uint8_t vec, uint16_t ret_pc, int new_prio)
+{
+    uint16_t old_psr = s->psr;
+
+    if (old_psr & ISA_PSR_PRIV) {
+        s->saved_usp = s->r[6];
+        s->r[6]      = s->saved_ssp;
+    }
+
+    s->psr &= ~ISA_PSR_PRIV;
+    if (new_prio >= 0) {
+        s->psr = (s->psr & ~0x0700) | ((new_prio & 0x7) << 8);
+    }
+
+    // R6 just past MCR: the clock stops at whichever push lands on
+    // it, and the machine gets no further
+    wr(s, --s->r[6], old_psr);
+    if (!(s->mcr & 0x8000)) {
+        return;
+    }
+    wr(s, --s->r[6], ret_pc);
+    if (!(s->mcr & 0x8000)) {
+        return;
+    }
+
+    s->pc = rd(s, table | vec);
+}
+
+
+static isa_event_t
+exception (isa_state_t * s, uint8_t vec, uint16_t ret_pc)
+{
+    enter(s, 0x0100, vec, ret_pc, -1);
+    switch (vec) {
+        case ISA_VEC_PRIV: return ISA_EXCP_PRIV;
+        case ISA_VEC_ILL:  return ISA_EXCP_ILL;
+        default:           return ISA_EXCP_ACV;
+    }
+}
+
+
+isa_event_t
+isa_step (isa_state_t * s)
+{
+    if (!(s->mcr & 0x8000)) {
+        return ISA_HALTED;
+    }
+
+    switch (isa_irq_pending(s)) {
+        case ISA_IRQ_KBD:
+            // stays asserted until the handler drains the FIFO
+            enter(s, 0x0100, s->irq_vec, s->pc, s->irq_prio);
+            return ISA_INT;
+        case ISA_IRQ_DMA:
+            // stays asserted until the handler writes DMACTL
+            enter(s, 0x0100, ISA_DMA_VEC, s->pc, ISA_DMA_PRIO);
+            return ISA_INT;
+        case ISA_IRQ_TX:
+            // stays asserted until the handler clears DSR[14]
+            enter(s, 0x0100, ISA_TX_VEC, s->pc, ISA_TX_PRIO);
+            return ISA_INT;
+        case ISA_IRQ_BLK:
+            // stays asserted until the handler writes BLKCTL
+            enter(s, 0x0100, ISA_BLK_VEC, s->pc, ISA_BLK_PRIO);
+            return ISA_INT;
+        default:
+            break;
+    }
+
+    uint16_t ipc = s->pc;
+
+    if (isa_acv(s, ipc)) {
+        return exception(s, ISA_VEC_ACV, ipc);
+    }
+
+    uint16_t ir = rd(s, ipc);
+    s->pc++;
+
+    uint16_t dr   = BITS(ir, 11, 9);
+    uint16_t sr1  = BITS(ir, 8, 6);
+    uint16_t sr2  = BITS(ir, 2, 0);
+    uint16_t addr = 0;
+    uint16_t v;
+
+    switch (ir >> 12) {
+        case 0x0: // BR
+            if (BITS(ir, 11, 9) & (s->psr & 0x7)) {
+                s->pc += sext(ir, 9);
+            }
+            break;
+
+        case 0x1: // ADD
+        case 0x5: // AND
+            v = (ir & 0x20) ? sext(ir, 5) : s->r[sr2];
+            v = ((ir >> 12) == 0x1) ? s->r[sr1] + v : s->r[sr1] & v;
+            s->r[dr] = v;
+            setcc(s, v);
+            break;
+
+        case 0x9: // NOT
+            v = ~s->r[sr1];
+            s->r[dr] = v;
+            setcc(s, v);
+            break;
+
+        case 0x2: // LD
+        case 0xA: // LDI
+            addr = s->pc + sext(ir, 9);
+            if (isa_acv(s, addr)) {
+                return exception(s, ISA_VEC_ACV, ipc);
+            }
+            if ((ir >> 12) == 0xA) {
+                addr = rd(s, addr);
+                if (isa_acv(s, addr)) {
+                    return exception(s, ISA_VEC_ACV, ipc);
+                }
+            }
+            v = rd(s, addr);
+            s->r[dr] = v;
+            setcc(s, v);
+            break;
+
+        case 0x6: // LDR
+            addr = s->r[sr1] + sext(ir, 6);
+            if (isa_acv(s, addr)) {
+                return exception(s, ISA_VEC_ACV, ipc);
+            }
+            v = rd(s, addr);
+            s->r[dr] = v;
+            setcc(s, v);
+            break;
+
+        case 0xE: // LEA (no condition codes as of the 3rd edition)
+            s->r[dr] = s->pc + sext(ir, 9);
+            break;
+
+        case 0x3: // ST
+        case 0xB: // STI
+            addr = s->pc + sext(ir, 9);
+            if (isa_acv(s, addr)) {
+                return exception(s, ISA_VEC_ACV, ipc);
+            }
+            if ((ir >> 12) == 0xB) {
+                addr = rd(s, addr);
+                if (isa_acv(s, addr)) {
+                    return exception(s, ISA_VEC_ACV, ipc);
+                }
+            }
+            wr(s, addr, s->r[dr]);
+            break;
+
+        case 0x7: // STR
+            addr = s->r[sr1] + sext(ir, 6);
+            if (isa_acv(s, addr)) {
+                return exception(s, ISA_VEC_ACV, ipc);
+            }
+            wr(s, addr, s->r[dr]);
+            break;
+
+        case 0x4: // JSR/JSRR
+            v = (ir & 0x800) ? s->pc + sext(ir, 11) : s->r[sr1];
+            s->r[7] = s->pc;
+            s->pc   = v;
+            break;
+
+        case 0xC: // JMP/RET
+            s->pc = s->r[sr1];
+            break;
+
+        case 0x8: // RTI
+            if (s->psr & ISA_PSR_PRIV) {
+                return exception(s, ISA_VEC_PRIV, ipc);
+            }
+            s->pc  = rd(s, s->r[6]++);
+            s->psr = rd(s, s->r[6]++) & ISA_PSR_MASK;
+            if (s->psr & ISA_PSR_PRIV) {
+                s->saved_ssp = s->r[6];
+                s->r[6]      = s->saved_usp;
+            }
+            break;
+
+        case 0xF: // TRAP
+            enter(s, 0x0000, BITS(ir, 7, 0), s->pc, -1);
+            return ISA_TRAP;
+
+        case 0xD: // MUL/DIV/MOD, reserved if IR[4:3] = 00
+            if (!BITS(ir, 4, 3)) {
+                // ... unless IR[11] is set (state 63): supervisor
+                // mode, on the same stack
+                if (ir & 0x0800) {
+                    s->psr &= ~ISA_PSR_PRIV;
+                    break;
+                }
+                return exception(s, ISA_VEC_ILL, ipc);
+            }
+            v = (ir & 0x20) ? BITS(ir, 2, 0) : s->r[sr2];
+            v = muldiv(BITS(ir, 4, 3), s->r[sr1], v);
+            s->r[dr] = v;
+            setcc(s, v);
+            break;
+    }
+
+    return ISA_RETIRED;
+}
+
+
+void
+isa_disasm (uint16_t ir, char * buf, size_t len)
+{
+    static const char * brs[] = { "NOP", "BRp", "BRz", "BRzp", "BRn", "BRnp", "BRnz", "BR" };
+
+    uint16_t dr  = BITS(ir, 11, 9);
+    uint16_t sr1 = BITS(ir, 8, 6);
+
+    switch (ir >> 12) {
+        case 0x0:
+            if (BITS(ir, 11, 9) == 0) {
+                snprintf(buf, len, "NOP");
+            } else {
+                snprintf(buf, len, "%s #%d", brs[BITS(ir, 11, 9)], (int16_t)sext(ir, 9));
+            }
+            break;
+        case 0x1:
+        case 0x5:
+            if (ir & 0x20) {
+                snprintf(buf, len, "%s R%d, R%d, #%d", (ir >> 12) == 1 ? "ADD" : "AND",
+                         dr, sr1, (int16_t)sext(ir, 5));
+            } else {
+                snprintf(buf, len, "%s R%d, R%d, R%d", (ir >> 12) == 1 ? "ADD" : "AND",
+                         dr, sr1, BITS(ir, 2, 0));
+            }
+            break;
+        case 0x9:  snprintf(buf, len, "NOT R%d, R%d", dr, sr1); break;
+        case 0x2:  snprintf(buf, len, "LD R%d, #%d", dr, (int16_t)sext(ir, 9)); break;
+        case 0xA:  snprintf(buf, len, "LDI R%d, #%d", dr, (int16_t)sext(ir, 9)); break;
+        case 0x6:  snprintf(buf, len, "LDR R%d, R%d, #%d", dr, sr1, (int16_t)sext(ir, 6)); break;
+        case 0xE:  snprintf(buf, len, "LEA R%d, #%d", dr, (int16_t)sext(ir, 9)); break;
+        case 0x3:  snprintf(buf, len, "ST R%d, #%d", dr, (int16_t)sext(ir, 9)); break;
+        case 0xB:  snprintf(buf, len, "STI R%d, #%d", dr, (int16_t)sext(ir, 9)); break;
+        case 0x7:  snprintf(buf, len, "STR R%d, R%d, #%d", dr, sr1, (int16_t)sext(ir, 6)); break;
+        case 0x4:
+            if (ir & 0x800) {
+                snprintf(buf, len, "JSR #%d", (int16_t)sext(ir, 11));
+            } else {
+                snprintf(buf, len, "JSRR R%d", sr1);
+            }
+            break;
+        case 0xC:
+            if (sr1 == 7) {
+                snprintf(buf, len, "RET");
+            } else {
+                snprintf(buf, len, "JMP R%d", sr1);
+            }
+            break;
+        case 0x8:  snprintf(buf, len, "RTI"); break;
+        case 0xF:  snprintf(buf, len, "TRAP x%02X", BITS(ir, 7, 0)); break;
+        case 0xD: {
+            static const char * mds[] = { NULL, "MUL", "DIV", "MOD" };
+            if (!BITS(ir, 4, 3)) {
+                snprintf(buf, len, ".FILL x%04X", ir);
+            } else if (ir & 0x20) {
+                snprintf(buf, len, "%s R%d, R%d, #%d", mds[BITS(ir, 4, 3)], dr, sr1, BITS(ir, 2, 0));
+            } else {
+                snprintf(buf, len, "%s R%d, R%d, R%d", mds[BITS(ir, 4, 3)], dr, sr1, BITS(ir, 2, 0));
+            }
+            break;
+        }
+    }
+}
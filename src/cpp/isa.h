@@ -0,0 +1,214 @@
+#ifndef __ISA_H__
+#define __ISA_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Reference (architectural) model of the iit3503 ISA.
+ *
+ * This is written from the ISA spec (P&P 3rd ed., App. A and C),
+ * *not* from the microcode, so it can serve as an independent
+ * oracle for the RTL. One call to isa_step() corresponds to one
+ * trip through the FSM from IFETCH (state 18) back to IFETCH: it
+ * either executes one instruction, or enters an interrupt/exception
+ * service routine.
+ */
+
+#define ISA_KBSR 0xFE00
+#define ISA_KBDR 0xFE02
+#define ISA_DSR  0xFE04
+#define ISA_DDR  0xFE06
+#define ISA_KBCR 0xFE08
+#define ISA_DMASRC 0xFE10
+#define ISA_DMADST 0xFE12
+#define ISA_DMALEN 0xFE14
+#define ISA_DMACTL 0xFE16
+#define ISA_BLKSEC 0xFE18
+#define ISA_BLKADR 0xFE1A
+#define ISA_BLKCNT 0xFE1C
+#define ISA_BLKCTL 0xFE1E
+#define ISA_CPUID  0xFE20
+#define ISA_LOCK0  0xFE30 // LOCK0-7: read = test-and-set, write = release
+#define ISA_LOCKS  8
+#define ISA_MCR  0xFFFE
+
+#define ISA_DMA_DONE  0x8000
+#define ISA_DMA_IE    0x4000
+#define ISA_DMA_FILL  0x0002
+#define ISA_DMA_GO    0x0001
+
+// the DMA engine's (fixed) interrupt line
+#define ISA_DMA_VEC   0x81
+#define ISA_DMA_PRIO  3
+
+#define ISA_BLK_DONE  0x8000
+#define ISA_BLK_IE    0x4000
+#define ISA_BLK_ERR   0x2000
+#define ISA_BLK_WRITE 0x0002 // RAM to disk
+#define ISA_BLK_GO    0x0001
+
+#define ISA_BLK_SECTOR 256   // words
+
+// the block device's (fixed) interrupt line
+#define ISA_BLK_VEC   0x83
+#define ISA_BLK_PRIO  3
+
+#define ISA_RX_DEPTH  16     // keyboard FIFO
+
+#define ISA_DSR_READY 0x8000 // TX FIFO not full
+#define ISA_DSR_IE    0x4000
+#define ISA_DSR_IDLE  0x2000 // TX FIFO empty and the line is quiet
+
+// the serial port's TX-low interrupt line
+#define ISA_TX_VEC    0x82
+#define ISA_TX_PRIO   4
+
+#define ISA_PSR_PRIV     0x8000
+#define ISA_PSR_PRIO(p)  (((p) >> 8) & 0x7)
+#define ISA_PSR_MASK     0x8707 // bits the hardware actually keeps
+
+// opcode 1101, IR[4:3]: multiply/divide (00 is still reserved, but
+// see isa_step() for 00 with IR[11] set)
+#define ISA_MD_MUL 1
+#define ISA_MD_DIV 2
+#define ISA_MD_MOD 3
+
+// vectors in the interrupt/exception table (x0100-x01FF)
+#define ISA_VEC_PRIV 0x00
+#define ISA_VEC_ILL  0x01
+#define ISA_VEC_ACV  0x02
+
+typedef enum isa_event {
+    ISA_RETIRED = 0,  // executed an ordinary instruction
+    ISA_TRAP,         // executed a TRAP
+    ISA_INT,          // took an interrupt instead of fetching
+    ISA_EXCP_PRIV,    // RTI in user mode
+    ISA_EXCP_ILL,     // reserved opcode
+    ISA_EXCP_ACV,     // access violation (fetch or data)
+    ISA_HALTED,       // MCR clock enable is clear; nothing happened
+} isa_event_t;
+
+typedef struct isa_state {
+    uint16_t r[8];
+    uint16_t pc;
+    uint16_t psr;
+    uint16_t saved_ssp;
+    uint16_t saved_usp;
+
+    // devices
+    uint16_t kbsr;    // only bit 14 (interrupt enable) is kept
+    uint16_t kbcr;    // [15:8] timeout, [7:0] interrupt threshold
+    uint8_t rx_fifo[ISA_RX_DEPTH];
+    uint8_t rx_head;
+    uint8_t rx_count;
+    uint16_t dsr;     // only ISA_DSR_IE is kept; output is instant here
+    uint16_t mcr;     // bit 15 = clock enable
+    uint8_t irq_vec;
+    uint8_t irq_prio;
+
+    // DMA engine. Transfers complete instantly here.
+    uint16_t dma_src;
+    uint16_t dma_dst;
+    uint16_t dma_len;
+    uint16_t dma_ctl;
+
+    // block device. Commands complete instantly here, through blk
+    // (below); with no blk, there's no disk and they all fail.
+    uint16_t blk_sec;
+    uint16_t blk_adr;
+    uint16_t blk_cnt;
+    uint16_t blk_ctl;
+
+    // spinlocks, one bit each. This is a single core (core 0),
+    // so nobody else ever holds one.
+    uint8_t locks;
+
+    uint16_t * mem;   // 64K words
+
+    // called for every write to DDR
+    void (*out)(void * arg, uint8_t c);
+    void * out_arg;
+
+    // called for every write that lands in memory (not a device)
+    void (*wr_hook)(void * arg, uint16_t addr);
+    void * wr_arg;
+
+    // carries out a block device command (see blkdev_transfer());
+    // returns false if it failed
+    bool (*blk)(void * arg, bool write, uint16_t sec, uint16_t addr, uint16_t cnt);
+    void * blk_arg;
+} isa_state_t;
+
+// puts the model in the same state the RTL comes out of reset in
+void isa_init (isa_state_t * s, uint16_t * mem, uint16_t pc);
+
+// a keystroke: data's low byte goes into the keyboard FIFO (if there's
+// room), and the keyboard interrupts at vec/prio from now on
+void isa_raise_irq (isa_state_t * s, uint8_t vec, uint8_t prio, uint16_t data);
+
+isa_event_t isa_step (isa_state_t * s);
+
+// interrupt sources, in arbitration order
+enum {
+    ISA_IRQ_NONE = 0,
+    ISA_IRQ_KBD,
+    ISA_IRQ_DMA,
+    ISA_IRQ_TX,
+    ISA_IRQ_BLK,
+};
+
+/*
+ * Which source (if any) the machine would take an interrupt from at
+ * the next IFETCH. Same arbitration as the hardware: the highest
+ * priority wins, ties go to the source listed first above.
+ */
+static inline int
+isa_irq_pending (const isa_state_t * s)
+{
+    int src      = ISA_IRQ_NONE;
+    uint8_t prio = 0;
+
+    // there's no time here, so a timeout has always run out
+    uint8_t thresh = s->kbcr & 0xFF;
+    bool kbd_due   = s->rx_count >= (thresh ? thresh : 1) ||
+                     (s->rx_count && (s->kbcr >> 8));
+
+    if ((s->kbsr & 0x4000) && kbd_due) {
+        src  = ISA_IRQ_KBD;
+        prio = s->irq_prio;
+    }
+
+    if ((s->dma_ctl & (ISA_DMA_DONE | ISA_DMA_IE)) == (ISA_DMA_DONE | ISA_DMA_IE) &&
+        (src == ISA_IRQ_NONE || ISA_DMA_PRIO > prio)) {
+        src  = ISA_IRQ_DMA;
+        prio = ISA_DMA_PRIO;
+    }
+
+    // the TX FIFO is always empty here, so always "low"
+    if ((s->dsr & ISA_DSR_IE) && (src == ISA_IRQ_NONE || ISA_TX_PRIO > prio)) {
+        src  = ISA_IRQ_TX;
+        prio = ISA_TX_PRIO;
+    }
+
+    if ((s->blk_ctl & (ISA_BLK_DONE | ISA_BLK_IE)) == (ISA_BLK_DONE | ISA_BLK_IE) &&
+        (src == ISA_IRQ_NONE || ISA_BLK_PRIO > prio)) {
+        src  = ISA_IRQ_BLK;
+        prio = ISA_BLK_PRIO;
+    }
+
+    return (src != ISA_IRQ_NONE && prio > ISA_PSR_PRIO(s->psr)) ? src : ISA_IRQ_NONE;
+}
+
+
+// true if the access would raise an ACV in the current mode
+static inline bool
+isa_acv (const isa_state_t * s, uint16_t addr)
+{
+    return (s->psr & ISA_PSR_PRIV) && (addr >= 0xFE00 || addr < 0x3000);
+}
+
+// disassemble in (lc3as-compatible) assembly syntax
+void isa_disasm (uint16_t ir, char * buf, size_t len);
+
+#endif
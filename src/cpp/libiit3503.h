@@ -0,0 +1,187 @@
+#ifndef __LIBIIT3503_H__
+#define __LIBIIT3503_H__
+
+/*
+ * Embeddable iit3503 simulator: the public C API.
+ *
+ * This is everything you need to drive a (Verilated, cycle-accurate)
+ * iit3503 from C, C++, or anything with a C FFI (e.g. Python ctypes)
+ * without going through the debug shell. Link against libiit3503.so
+ * (built with `make lib`).
+ *
+ * Each machine is an independent handle, so a test harness can keep
+ * many of them alive in one process. The library never touches
+ * stdin/stdout. Serial output from the guest is handed to a sink
+ * callback if one is installed, and buffered internally otherwise
+ * (see iit3503_read_uart()). Input for the guest's keyboard goes in
+ * over its serial line (see iit3503_write_uart()).
+ *
+ * A machine built with more than one core (make CORES=n) shares one
+ * RAM between them. Core 0 boots at the image's entry point and owns
+ * the devices; the rest start at ap_entry. Registers, stepping by
+ * instruction and run_until all follow the core picked with
+ * iit3503_select_core() (core 0 by default).
+ *
+ * A disk image given in the config is mapped in place: whatever the
+ * guest writes to its block device lands in the file.
+ *
+ * With lockstep set, every cycle is also run on the C++ microcode
+ * model (src/cpp/ucode.h) and the two are compared. The first cycle
+ * they disagree on is reported, and iit3503_diverged() says so from
+ * then on. That needs a single core build, private RAM, and keyboard
+ * input through iit3503_raise_irq() (the model has no serial line).
+ *
+ * Every machine keeps a flight recorder: a record of each of the last
+ * IIT3503_HISTORY_LEN instructions the selected core retired (and
+ * each interrupt and exception it took), for finding out how it got
+ * somewhere after the fact. See iit3503_history().
+ *
+ * With a fingerprint file in the config, a hash of the architectural
+ * state (registers, PC, PSR and all of RAM) is written to it every
+ * fingerprint_every instructions. tools/fpcmp.py finds the first
+ * interval two such files disagree in.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IIT3503_API __attribute__((visibility("default")))
+
+#define IIT3503_API_VERSION 9
+
+typedef struct dut iit3503_t;
+
+typedef struct iit3503_config {
+    const char * image;     // user program image (.obj, or .asm source). May be NULL (empty RAM).
+    const char * os_image;  // OS image (.obj or .asm). If NULL, the program runs in supervisor mode.
+    const char * trace;     // if non-NULL, write a VCD waveform here
+    const char * shm;       // if non-NULL, back RAM with this shm name (or file, see below)
+    bool shm_is_file;       // interpret shm as a file path instead of a POSIX shm name
+    uint16_t entry;         // reset vector to use when there is neither image nor OS
+    uint8_t ram_wait_min;   // every RAM access takes ram_wait_min..ram_wait_max
+    uint8_t ram_wait_max;   // extra cycles (0, 0 = single-cycle memory)
+    uint16_t ap_entry;      // reset vector for cores 1 and up (multi-core builds only)
+    const char * disk;      // if non-NULL, disk image file for the block device (used in place)
+    uint32_t disk_latency;  // cycles each sector of a disk command takes
+    bool lockstep;          // check every cycle against the microcode model
+    const char * fingerprint;   // if non-NULL, write state fingerprints here (see src/cpp/fingerprint.h)
+    uint64_t fingerprint_every; // ... one every this many instructions
+} iit3503_config_t;
+
+typedef struct iit3503_regs {
+    uint16_t r[8];
+    uint16_t pc;
+    uint16_t ir;
+    uint16_t psr;
+    uint16_t upc;
+    uint16_t mar;
+    uint16_t mdr;
+    uint16_t mcr;
+    uint64_t cycles;
+    uint64_t instrs;
+    uint32_t icache_hits;   // IFETCHes served by the instruction cache
+    uint32_t icache_misses; // IFETCHes that went out to RAM
+} iit3503_regs_t;
+
+// runtime statistics (see iit3503_read_stats()). The host time split
+// is estimated from a sample of the cycles.
+typedef struct iit3503_stats {
+    uint64_t cycles;
+    uint64_t instrs;
+    double wall_secs;       // since iit3503_init()
+    double eval_secs;       // host time in the model's eval()
+    double trace_secs;      // ... writing the waveform
+    double harness_secs;    // ... in the rest of a cycle (devices, bookkeeping)
+    uint64_t irqs_raised;   // by the host (iit3503_raise_irq())
+    uint64_t irqs_taken;    // interrupts the selected core acknowledged
+    uint64_t uart_out;      // bytes the guest sent on its serial line
+    uint64_t uart_in;       // bytes sent to the guest
+} iit3503_stats_t;
+
+// how many records the flight recorder keeps
+#define IIT3503_HISTORY_LEN 256 // power of two
+
+// what a retire record has in it
+enum {
+    IIT3503_RETIRE_REG   = 0x01, // it changed register reg
+    IIT3503_RETIRE_LOAD  = 0x02, // it read mem_data from mem_addr
+    IIT3503_RETIRE_STORE = 0x04, // it wrote mem_data to mem_addr
+    IIT3503_RETIRE_INT   = 0x08, // not an instruction: an interrupt was taken at pc
+    IIT3503_RETIRE_EXCP  = 0x10, // the instruction at pc raised an exception
+};
+
+// one entry in the flight recorder
+typedef struct iit3503_retire {
+    uint64_t cycle;         // when it retired
+    uint16_t pc;            // where it was fetched from
+    uint16_t ir;
+    uint16_t psr;           // afterwards
+    uint8_t flags;          // IIT3503_RETIRE_*
+    uint8_t reg;
+    uint16_t reg_val;       // reg's new value
+    uint16_t mem_addr;
+    uint16_t mem_data;
+} iit3503_retire_t;
+
+// reasons for iit3503_run_until() to return
+enum {
+    IIT3503_STOP_PC    = 0, // reached the requested PC at an instruction boundary
+    IIT3503_STOP_HALT  = 1, // the machine halted (MCR clock enable cleared)
+    IIT3503_STOP_LIMIT = 2, // ran out of cycles
+};
+
+typedef void (*iit3503_uart_sink_t)(void * arg, uint8_t c);
+
+IIT3503_API iit3503_t * iit3503_init (const iit3503_config_t * cfg);
+IIT3503_API void iit3503_deinit (iit3503_t * dut);
+IIT3503_API void iit3503_reset (iit3503_t * dut);
+
+// single clock cycle; returns true if the machine is halted
+IIT3503_API bool iit3503_step_cycle (iit3503_t * dut, bool reset);
+
+// run to the next instruction boundary; returns true if the machine is halted
+IIT3503_API bool iit3503_step_instr (iit3503_t * dut, bool reset);
+
+IIT3503_API int iit3503_run_until (iit3503_t * dut, uint16_t pc, uint64_t max_cycles);
+
+// how many cores this build has
+IIT3503_API unsigned iit3503_num_cores (void);
+
+// which core read_regs(), step_instr() and run_until() look at;
+// returns false (and changes nothing) if there's no such core
+IIT3503_API bool iit3503_select_core (iit3503_t * dut, unsigned core);
+
+IIT3503_API void iit3503_read_regs (iit3503_t * dut, iit3503_regs_t * regs);
+
+// with lockstep: the cycle the RTL and the microcode model first
+// disagreed on, or 0 if they haven't (or there's no lockstep)
+IIT3503_API uint64_t iit3503_diverged (iit3503_t * dut);
+IIT3503_API void iit3503_read_stats (iit3503_t * dut, iit3503_stats_t * stats);
+
+// copies the last (up to) n records from the flight recorder into
+// buf, oldest first; returns how many there were
+IIT3503_API size_t iit3503_history (iit3503_t * dut, iit3503_retire_t * buf, size_t n);
+IIT3503_API void iit3503_read_mem (iit3503_t * dut, uint16_t addr, uint16_t * buf, size_t count);
+IIT3503_API void iit3503_write_mem (iit3503_t * dut, uint16_t addr, const uint16_t * buf, size_t count);
+
+// puts the low byte of data straight into the keyboard FIFO, and makes
+// the keyboard interrupt with the given vector and priority from now on
+IIT3503_API void iit3503_raise_irq (iit3503_t * dut, uint8_t irq, uint8_t priority, uint16_t data);
+
+IIT3503_API void iit3503_set_uart_sink (iit3503_t * dut, iit3503_uart_sink_t sink, void * arg);
+IIT3503_API size_t iit3503_read_uart (iit3503_t * dut, char * buf, size_t len);
+
+// queues bytes to be sent to the guest over its serial receive line (at
+// the line's baud rate). Returns how many fit in the queue.
+IIT3503_API size_t iit3503_write_uart (iit3503_t * dut, const char * buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
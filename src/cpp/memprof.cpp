@@ -0,0 +1,168 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include "memprof.h"
+
+// the heatmap's shades, from no accesses to the busiest bucket
+static const char shades[] = " .:-=+*#%@";
+#define NSHADES (sizeof(shades) - 1)
+
+// buckets on a heatmap row
+#define ROW_BUCKETS 16
+
+#define TOP_BUCKETS 8
+
+static const char * const region_names[MEMPROF_REGIONS] = {
+    "trap table",
+    "int table",
+    "OS",
+    "user",
+    "stack (R6)",
+    "device page",
+};
+
+static inline uint64_t
+total (const uint64_t rw[2])
+{
+    return rw[0] + rw[1];
+}
+
+
+memprof_t *
+memprof_create (void)
+{
+    memprof_t * mp = (memprof_t*)calloc(1, sizeof(memprof_t));
+
+    if (!mp) {
+        ERROR_PRINT("Could not allocate the memory profile");
+    }
+
+    return mp;
+}
+
+
+void
+memprof_destroy (memprof_t * mp)
+{
+    free(mp);
+}
+
+
+void
+memprof_reset (memprof_t * mp)
+{
+    uint16_t sp = mp->sp;
+    memset(mp, 0, sizeof(*mp));
+    mp->sp = sp;
+}
+
+
+// log scale: one access is the faintest shade, the busiest bucket
+// the darkest
+static char
+shade (uint64_t n, uint64_t max)
+{
+    if (!n) {
+        return shades[0];
+    }
+    if (max <= 1) {
+        return shades[NSHADES - 1];
+    }
+
+    unsigned i = 1 + (unsigned)((NSHADES - 2) * log((double)n) / log((double)max) + 0.5);
+    return shades[i < NSHADES ? i : NSHADES - 1];
+}
+
+
+void
+memprof_print (const memprof_t * mp)
+{
+    uint64_t reads = 0, writes = 0, max = 0;
+
+    for (unsigned r = 0; r < MEMPROF_REGIONS; r++) {
+        reads  += mp->regions[r][0];
+        writes += mp->regions[r][1];
+    }
+    for (unsigned b = 0; b < MEMPROF_BUCKETS; b++) {
+        if (total(mp->buckets[b]) > max) {
+            max = total(mp->buckets[b]);
+        }
+    }
+
+    if (!reads && !writes) {
+        INFO_PRINT("  No memory accesses counted yet");
+        return;
+    }
+
+    INFO_PRINT("  %lu reads, %lu writes", reads, writes);
+    INFO_PRINT("  %-12s %12s %12s %7s", "Region", "Reads", "Writes", "Share");
+    for (unsigned r = 0; r < MEMPROF_REGIONS; r++) {
+        uint64_t n = total(mp->regions[r]);
+        INFO_PRINT("  %-12s %12lu %12lu %6.1f%%", region_names[r],
+                mp->regions[r][0], mp->regions[r][1], 100.0 * n / (reads + writes));
+    }
+
+    INFO_PRINT("  Heatmap (a cell per x%x words, '%c' = 1 access, '%c' = %lu):",
+            1 << MEMPROF_BUCKET_SHIFT, shades[1], shades[NSHADES - 1], max);
+    for (unsigned row = 0; row < MEMPROF_BUCKETS; row += ROW_BUCKETS) {
+        char cells[ROW_BUCKETS + 1];
+        for (unsigned i = 0; i < ROW_BUCKETS; i++) {
+            cells[i] = shade(total(mp->buckets[row + i]), max);
+        }
+        cells[ROW_BUCKETS] = '\0';
+        INFO_PRINT("    x%04x |%s|", row << MEMPROF_BUCKET_SHIFT, cells);
+    }
+
+    // the busiest buckets, by a selection pass per place
+    bool shown[MEMPROF_BUCKETS] = { false };
+    INFO_PRINT("  Busiest:");
+    for (unsigned k = 0; k < TOP_BUCKETS; k++) {
+        unsigned best = MEMPROF_BUCKETS;
+        for (unsigned b = 0; b < MEMPROF_BUCKETS; b++) {
+            if (!shown[b] && total(mp->buckets[b]) &&
+                (best == MEMPROF_BUCKETS || total(mp->buckets[b]) > total(mp->buckets[best]))) {
+                best = b;
+            }
+        }
+        if (best == MEMPROF_BUCKETS) {
+            break;
+        }
+
+        shown[best] = true;
+        unsigned lo = best << MEMPROF_BUCKET_SHIFT;
+        INFO_PRINT("    x%04x-x%04x %12lu reads %12lu writes", lo, lo + (1 << MEMPROF_BUCKET_SHIFT) - 1,
+                mp->buckets[best][0], mp->buckets[best][1]);
+    }
+}
+
+
+int
+memprof_csv (const memprof_t * mp, const char * path)
+{
+    FILE * f = fopen(path, "w");
+    if (!f) {
+        ERROR_PRINT("Could not write the memory profile to '%s': %s", path, strerror(errno));
+        return -1;
+    }
+
+    // the stack moves with R6, so it has no address range
+    fprintf(f, "kind,name,start,end,reads,writes\n");
+    for (unsigned r = 0; r < MEMPROF_REGIONS; r++) {
+        fprintf(f, "region,%s,,,%lu,%lu\n", region_names[r], mp->regions[r][0], mp->regions[r][1]);
+    }
+    for (unsigned b = 0; b < MEMPROF_BUCKETS; b++) {
+        unsigned lo = b << MEMPROF_BUCKET_SHIFT;
+        fprintf(f, "bucket,,0x%04x,0x%04x,%lu,%lu\n", lo, lo + (1 << MEMPROF_BUCKET_SHIFT) - 1,
+                mp->buckets[b][0], mp->buckets[b][1]);
+    }
+
+    if (fclose(f)) {
+        ERROR_PRINT("Could not write the memory profile to '%s': %s", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
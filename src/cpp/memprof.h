@@ -0,0 +1,87 @@
+#ifndef __MEMPROF_H__
+#define __MEMPROF_H__
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Memory access profile: reads and writes counted per 256-word
+ * bucket of the address space, and per region of the techOS memory
+ * map, for a heatmap of where the traffic goes (the shell's heatmap
+ * command).
+ *
+ * What's counted is what reaches RAM (extern_ram_commit(), so after
+ * the I-cache: fetches that hit don't show up, line fills do, and so
+ * do DMA and the block device), plus the loads and stores the
+ * harness sees go to device registers, which never reach RAM. With
+ * the array RAM model there's no hook per access, so only the
+ * device registers are counted.
+ */
+
+#define MEMPROF_BUCKET_SHIFT 8
+#define MEMPROF_BUCKETS      (0x10000 >> MEMPROF_BUCKET_SHIFT)
+
+// the memory map
+#define MEMPROF_VECTORS_BASE 0x0100 // interrupt/exception table
+#define MEMPROF_OS_BASE      0x0200
+#define MEMPROF_USER_BASE    0x3000
+#define MEMPROF_DEVICE_BASE  0xFE00
+
+// accesses this close to R6 count as the stack's
+#define MEMPROF_STACK_BELOW  8
+#define MEMPROF_STACK_ABOVE  32
+
+typedef enum memprof_region {
+    MEMPROF_TRAPS,    // trap vector table
+    MEMPROF_VECTORS,
+    MEMPROF_OS,       // OS code and data
+    MEMPROF_USER,     // the user program, and its heap
+    MEMPROF_STACK,
+    MEMPROF_DEVICE,   // the device page
+    MEMPROF_REGIONS
+} memprof_region_t;
+
+typedef struct memprof {
+    uint16_t sp;      // R6, as of the cycle being counted
+
+    // [0] reads, [1] writes
+    uint64_t buckets[MEMPROF_BUCKETS][2];
+    uint64_t regions[MEMPROF_REGIONS][2];
+} memprof_t;
+
+static inline memprof_region_t
+memprof_region (uint16_t addr, uint16_t sp)
+{
+    if (addr >= MEMPROF_DEVICE_BASE) {
+        return MEMPROF_DEVICE;
+    }
+    if (addr < MEMPROF_OS_BASE) {
+        return addr < MEMPROF_VECTORS_BASE ? MEMPROF_TRAPS : MEMPROF_VECTORS;
+    }
+
+    // R6 only means a stack once something's set it up
+    if (sp >= MEMPROF_OS_BASE &&
+        (uint16_t)(addr - sp + MEMPROF_STACK_BELOW) < MEMPROF_STACK_BELOW + MEMPROF_STACK_ABOVE) {
+        return MEMPROF_STACK;
+    }
+
+    return addr < MEMPROF_USER_BASE ? MEMPROF_OS : MEMPROF_USER;
+}
+
+static inline void
+memprof_count (memprof_t * mp, uint16_t addr, bool write)
+{
+    mp->buckets[addr >> MEMPROF_BUCKET_SHIFT][write]++;
+    mp->regions[memprof_region(addr, mp->sp)][write]++;
+}
+
+memprof_t * memprof_create (void);
+void memprof_destroy (memprof_t * mp);
+void memprof_reset (memprof_t * mp);
+
+// the region table and the heatmap (the shell's heatmap command)
+void memprof_print (const memprof_t * mp);
+
+// a row per region, then one per bucket. Returns 0 on success.
+int memprof_csv (const memprof_t * mp, const char * path);
+
+#endif
@@ -0,0 +1,128 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "metrics.h"
+
+static double
+ratio (double a, double b)
+{
+    return b > 0 ? a / b : 0.0;
+}
+
+
+void
+metrics_print (const iit3503_stats_t * st)
+{
+    INFO_PRINT("  Cycles:       %lu", st->cycles);
+    INFO_PRINT("  Instructions: %lu (CPI %.2f)", st->instrs, ratio(st->cycles, st->instrs));
+    INFO_PRINT("  Wall time:    %.3fs", st->wall_secs);
+    INFO_PRINT("  Speed:        %.3f MHz simulated, %.0f instructions/s",
+            ratio(st->cycles, st->wall_secs) / 1e6,
+            ratio(st->instrs, st->wall_secs));
+    INFO_PRINT("  Interrupts:   %lu raised by the host, %lu taken", st->irqs_raised, st->irqs_taken);
+    INFO_PRINT("  Serial:       %lu bytes out, %lu bytes in", st->uart_out, st->uart_in);
+
+    double other = st->wall_secs - st->eval_secs - st->trace_secs - st->harness_secs;
+    if (other < 0) {
+        other = 0; // the split is an estimate
+    }
+
+    INFO_PRINT("  Host time (estimated):");
+    INFO_PRINT("    eval()   %8.3fs (%4.1f%%)", st->eval_secs,    100 * ratio(st->eval_secs, st->wall_secs));
+    INFO_PRINT("    tracing  %8.3fs (%4.1f%%)", st->trace_secs,   100 * ratio(st->trace_secs, st->wall_secs));
+    INFO_PRINT("    harness  %8.3fs (%4.1f%%)", st->harness_secs, 100 * ratio(st->harness_secs, st->wall_secs));
+    INFO_PRINT("    other    %8.3fs (%4.1f%%)", other,            100 * ratio(other, st->wall_secs));
+}
+
+
+void
+metrics_progress (const iit3503_stats_t * st)
+{
+    INFO_PRINT("  [%.0fs] %lu cycles, %lu instrs, %.3f MHz, %.0f IPS, CPI %.2f",
+            st->wall_secs,
+            st->cycles,
+            st->instrs,
+            ratio(st->cycles, st->wall_secs) / 1e6,
+            ratio(st->instrs, st->wall_secs),
+            ratio(st->cycles, st->instrs));
+}
+
+
+static void
+dump_prom (const iit3503_stats_t * st, FILE * f)
+{
+#define PROM(name, type, help, fmt, val)                          \
+    fprintf(f, "# HELP iit3503_" name " " help "\n"               \
+               "# TYPE iit3503_" name " " type "\n"               \
+               "iit3503_" name " " fmt "\n", val)
+
+    PROM("cycles_total",           "counter", "Simulated clock cycles.",             "%lu", st->cycles);
+    PROM("instructions_total",     "counter", "Retired instructions.",               "%lu", st->instrs);
+    PROM("wall_seconds",           "gauge",   "Host time since the machine was created.", "%.6f", st->wall_secs);
+    PROM("simulated_hertz",        "gauge",   "Simulated cycles per host second.",   "%.1f", ratio(st->cycles, st->wall_secs));
+    PROM("instructions_per_second", "gauge",  "Retired instructions per host second.", "%.1f", ratio(st->instrs, st->wall_secs));
+    PROM("cycles_per_instruction", "gauge",   "Cycles per retired instruction.",     "%.4f", ratio(st->cycles, st->instrs));
+    PROM("irqs_raised_total",      "counter", "Interrupts raised by the host.",      "%lu", st->irqs_raised);
+    PROM("irqs_taken_total",       "counter", "Interrupts the machine acknowledged.", "%lu", st->irqs_taken);
+    PROM("uart_out_bytes_total",   "counter", "Bytes the guest sent on its serial line.", "%lu", st->uart_out);
+    PROM("uart_in_bytes_total",    "counter", "Bytes sent to the guest on its serial line.", "%lu", st->uart_in);
+
+#undef PROM
+
+    fprintf(f, "# HELP iit3503_host_seconds Estimated host time by where it went.\n"
+               "# TYPE iit3503_host_seconds gauge\n");
+    fprintf(f, "iit3503_host_seconds{part=\"eval\"} %.6f\n",    st->eval_secs);
+    fprintf(f, "iit3503_host_seconds{part=\"trace\"} %.6f\n",   st->trace_secs);
+    fprintf(f, "iit3503_host_seconds{part=\"harness\"} %.6f\n", st->harness_secs);
+}
+
+
+static void
+dump_json (const iit3503_stats_t * st, FILE * f)
+{
+    fprintf(f, "{\n");
+    fprintf(f, "  \"cycles\": %lu,\n", st->cycles);
+    fprintf(f, "  \"instructions\": %lu,\n", st->instrs);
+    fprintf(f, "  \"wall_seconds\": %.6f,\n", st->wall_secs);
+    fprintf(f, "  \"simulated_mhz\": %.6f,\n", ratio(st->cycles, st->wall_secs) / 1e6);
+    fprintf(f, "  \"instructions_per_second\": %.1f,\n", ratio(st->instrs, st->wall_secs));
+    fprintf(f, "  \"cpi\": %.4f,\n", ratio(st->cycles, st->instrs));
+    fprintf(f, "  \"irqs_raised\": %lu,\n", st->irqs_raised);
+    fprintf(f, "  \"irqs_taken\": %lu,\n", st->irqs_taken);
+    fprintf(f, "  \"uart_out_bytes\": %lu,\n", st->uart_out);
+    fprintf(f, "  \"uart_in_bytes\": %lu,\n", st->uart_in);
+    fprintf(f, "  \"host_seconds\": {\"eval\": %.6f, \"trace\": %.6f, \"harness\": %.6f}\n",
+            st->eval_secs, st->trace_secs, st->harness_secs);
+    fprintf(f, "}\n");
+}
+
+
+int
+metrics_dump (const iit3503_stats_t * st, const char * path)
+{
+    // write it next to the real thing and rename, so a collector
+    // never sees half a file
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE * f = fopen(tmp, "w");
+    if (!f) {
+        ERROR_PRINT("Could not write stats to '%s': %s", tmp, strerror(errno));
+        return -1;
+    }
+
+    size_t len = strlen(path);
+    if (len > 5 && !strcmp(path + len - 5, ".prom")) {
+        dump_prom(st, f);
+    } else {
+        dump_json(st, f);
+    }
+
+    if (fclose(f) || rename(tmp, path)) {
+        ERROR_PRINT("Could not write stats to '%s': %s", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+#include <stdint.h>
+#include <time.h>
+#include "libiit3503.h"
+
+/*
+ * Runtime statistics: what the machine did (cycles, instructions,
+ * interrupts, serial traffic) and where the host's time went.
+ *
+ * Timing every cycle would cost more than some of what's being
+ * timed, so only one cycle in METRICS_SAMPLE has its host time
+ * split up (between the model's eval(), writing the waveform, and
+ * the harness), and the totals are scaled up from those.
+ */
+
+#define METRICS_SAMPLE 64 // power of two
+
+typedef struct metrics {
+    uint64_t start_ns;
+    uint64_t irqs_raised;
+    uint64_t irqs_taken;
+    uint64_t uart_out;
+    uint64_t uart_in;
+
+    // over the sampled cycles only
+    uint64_t sampled;
+    uint64_t eval_ns;
+    uint64_t trace_ns;
+    uint64_t harness_ns;
+} metrics_t;
+
+static inline uint64_t
+host_ns (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// the full report (the shell's stats command)
+void metrics_print (const iit3503_stats_t * st);
+
+// one line, for while the machine runs
+void metrics_progress (const iit3503_stats_t * st);
+
+// writes st to path: a Prometheus textfile if it ends in .prom,
+// JSON otherwise. Returns 0 on success.
+int metrics_dump (const iit3503_stats_t * st, const char * path);
+
+#endif
@@ -6,71 +6,130 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include "ram.h"
+#include "asm.h"
 #include "iit3503.h"
+#include "memprof.h"
+#include "shm.h"
+
+#ifdef IIT3503_RAM_ARRAY
+#include <svdpi.h>
+#include "VTop__Dpi.h"
+#endif
+
+// an .asm file is assembled here and now, rather than loaded. Like
+// load_image(), returns 0 on success.
+static int
+load_asm (ram_t * ram, const char * img, const char * desc, uint16_t * orig)
+{
+    asm_result_t * r = asm_assemble_file(img);
+
+    if (!r || r->error[0]) {
+        ERROR_PRINT("Could not assemble %s image: %s", desc, r ? r->error : "out of memory");
+        goto out_err1;
+    }
+
+    if (r->orig + r->nwords > ram->size) {
+        ERROR_PRINT("%s image '%s' doesn't fit in RAM", desc, img);
+        goto out_err1;
+    }
+
+    memcpy(&ram->ram[r->orig], r->words, r->nwords * sizeof(word_t));
+
+    DEBUG_PRINT("Assembled %s image at x%04x", desc, r->orig);
+
+    *orig = r->orig;
+    asm_free(r);
+    return 0;
+
+out_err1:
+    if (r) {
+        asm_free(r);
+    }
+    return -1;
+}
 
-extern dut_t * dut;
 
-static uint16_t
-load_image (ram_t * ram, const char *img, const char * desc) {
-    int ret;
+// loads an image (big-endian, .ORIG first), and puts its origin in
+// *orig. Only the words it covers are touched, so whatever else is in
+// RAM (e.g. a --ram-file from an earlier run) stays as it was.
+// Returns 0 on success.
+static int
+load_image (ram_t * ram, const char *img, const char * desc, uint16_t * orig) {
     struct stat st;
     size_t size = 0;
-    uint16_t orig;
-
-    stat(img, &st);
 
-    if (st.st_size-2 > (ram->size*sizeof(word_t))) {
-        size = ram->size*sizeof(word_t);
-    } else {
-        size = st.st_size-2;
+    size_t len = strlen(img);
+    if (len > 4 && !strcmp(img + len - 4, ".asm")) {
+        return load_asm(ram, img, desc, orig);
     }
 
     FILE *fp = fopen(img, "rb");
     if (fp == NULL) {
-        ERROR_PRINT("Could not open file '%s'", img);
-        exit(EXIT_FAILURE);
+        ERROR_PRINT("Could not open %s image '%s': %s", desc, img, strerror(errno));
+        return -1;
     }
 
     // lop off the .ORIG space (for the OS this should be x0000)
-    ret = fread(&orig, 1, 2, fp);
-    assert(ret == 2);
+    if (fstat(fileno(fp), &st) || fread(orig, 1, 2, fp) != 2) {
+        ERROR_PRINT("Could not read %s image '%s'", desc, img);
+        goto out_err1;
+    }
+    *orig = be16toh(*orig);
 
-    ret = fread(&ram->ram[htobe16(orig)], 1, size, fp);
-    assert(ret == size);
+    size = (size_t)st.st_size - 2;
+    if (size > (ram->size - *orig) * sizeof(word_t)) {
+        size = (ram->size - *orig) * sizeof(word_t);
+    }
 
-    DEBUG_PRINT("Loading %s image at x%04x", desc, htobe16(orig));
+    if (fread(&ram->ram[*orig], 1, size, fp) != size) {
+        ERROR_PRINT("Could not read %s image '%s'", desc, img);
+        goto out_err1;
+    }
+
+    for (size_t i = *orig; i < *orig + size / sizeof(word_t); i++) {
+        ram->ram[i] = be16toh(ram->ram[i]);
+    }
+
+    DEBUG_PRINT("Loading %s image at x%04x", desc, *orig);
 
     fclose(fp);
+    return 0;
 
-    return orig;
+out_err1:
+    fclose(fp);
+    return -1;
 }
 
 
-static inline uint16_t
+static inline int
 load_os_image (ram_t * ram, const char * img)
 {
-    return load_image(ram, img, "OS");
+    uint16_t orig;
+    return load_image(ram, img, "OS", &orig);
 }
 
 
-static inline uint16_t
-load_program_image (ram_t * ram, const char * img, bool super)
+static inline int
+load_program_image (ram_t * ram, const char * img, bool super, uint16_t * orig)
 {
-    uint16_t orig = load_image(ram, img, "program");
+    if (load_image(ram, img, "program", orig)) {
+        return -1;
+    }
 
     if (!super) {
         // set the user entry point
-        ram->ram[0x0200] = orig;
+        ram->ram[0x0200] = *orig;
     }
 
-    return orig;
+    return 0;
 }
 
 
 
 ram_t *
-create_ram (size_t size, char * img, char * os_img, uint16_t * entry) 
+create_ram (size_t size, char * img, char * os_img, uint16_t * entry, const char * backing, bool backing_is_file)
 {
     ram_t * ram = (ram_t*)malloc(sizeof(ram_t));
 
@@ -80,27 +139,41 @@ create_ram (size_t size, char * img, char * os_img, uint16_t * entry)
     }
     memset(ram, 0, sizeof(ram_t));
 
-    ram->size = size;
-    ram->ram = (word_t*)malloc(sizeof(word_t)*size);
+    ram->size    = size;
+    ram->backing = backing;
+
+    if (backing) {
+        ram->ram = (word_t*)shared_map(backing, sizeof(word_t)*size, backing_is_file);
+    } else {
+        ram->ram = (word_t*)calloc(size, sizeof(word_t));
+    }
+
     if (!ram->ram) {
         ERROR_PRINT("Could not allocate RAM");
         goto out_err1;
     }
 
     if (os_img) {
+        uint16_t orig;
         *entry = 0x2ca;
-        load_os_image(ram, os_img);
-        load_program_image(ram, img, false);
-    } else {
-        *entry = htobe16(load_program_image(ram, img, true));
-    }
-
-    for(int i = 0; i < size; i++) {
-        ram->ram[i] = htobe16(ram->ram[i]);
+        if (load_os_image(ram, os_img) ||
+            (img && load_program_image(ram, img, false, &orig))) {
+            goto out_err2;
+        }
+    } else if (img) {
+        if (load_program_image(ram, img, true, entry)) {
+            goto out_err2;
+        }
     }
 
     return ram;
 
+out_err2:
+    if (backing) {
+        shared_unmap(ram->ram, sizeof(word_t)*size);
+    } else {
+        free(ram->ram);
+    }
 out_err1:
     free(ram);
     return NULL;
@@ -109,40 +182,193 @@ out_err1:
 void
 destroy_ram (ram_t * ram)
 {
-    free(ram->ram);
+    if (ram->backing) {
+        shared_unmap(ram->ram, sizeof(word_t)*ram->size);
+    } else {
+        free(ram->ram);
+    }
+
     free(ram);
 }
 
-// hooks into verilog
-extern "C" void extern_ram (uint8_t en, 
-                            uint8_t wEn,
-                            word_t dataIn,
-                            paddr_t addr,
-                            word_t* dataOut,
-                            uint8_t* R) {
+void
+ram_set_wait_states (ram_t * ram, uint8_t min, uint8_t max)
+{
+    ram->wait_min = min;
+    ram->wait_max = max < min ? min : max;
 
-    if (en) {
-#if 0
-        DEBUG_PRINT("RAM access:\n"
-                "\taddr=%04hx\n" 
-                "\t*dataOut=%04hx\n"
-                "\tdataIn=%04hx\n"
-                "\tEn=%01hhx\n" 
-                "\twEn=%01hhx\n"
-                "\tR=%01hhx\n", 
-                addr,  
-                *dataOut, 
-                dataIn, 
-                en, 
-                wEn,
-                *R);
+#ifdef IIT3503_RAM_ARRAY
+    if (ram->scope) {
+        svSetScope((svScope)ram->scope);
+        ram_backdoor_wait((char)ram->wait_min, (char)ram->wait_max);
+    }
 #endif
-        *dataOut = dut->ram->ram[addr];
-        if (wEn) {
-            dut->ram->ram[addr] = dataIn;
+}
+
+
+int
+ram_attach (ram_t * ram, const char * scope_name)
+{
+#ifdef IIT3503_RAM_ARRAY
+    svScope scope = svGetScopeFromName(scope_name);
+
+    if (!scope) {
+        ERROR_PRINT("No RAM in the model at '%s'", scope_name);
+        return -1;
+    }
+
+    ram->scope = scope;
+    svSetScope(scope);
+
+    for (size_t i = 0; i < ram->size; i++) {
+        ram_backdoor_write((short)i, (short)ram->ram[i]);
+    }
+
+    ram_backdoor_wait((char)ram->wait_min, (char)ram->wait_max);
+#else
+    (void)ram;
+    (void)scope_name;
+#endif
+    return 0;
+}
+
+
+uint16_t
+ram_peek (ram_t * ram, uint16_t addr)
+{
+#ifdef IIT3503_RAM_ARRAY
+    if (ram->scope) {
+        svSetScope((svScope)ram->scope);
+        return (uint16_t)ram_backdoor_read((short)addr);
+    }
+#endif
+    return ram->ram[addr];
+}
+
+
+void
+ram_poke (ram_t * ram, uint16_t addr, uint16_t val)
+{
+    ram_dirty(ram, addr);
+#ifdef IIT3503_RAM_ARRAY
+    if (ram->scope) {
+        svSetScope((svScope)ram->scope);
+        ram_backdoor_write((short)addr, (short)val);
+        return;
+    }
+#endif
+    ram->ram[addr] = val;
+}
+
+
+void
+ram_read_block (ram_t * ram, uint16_t addr, uint16_t * buf, size_t count)
+{
+#ifdef IIT3503_RAM_ARRAY
+    if (ram->scope) {
+        for (size_t i = 0; i < count; i++) {
+            buf[i] = ram_peek(ram, (uint16_t)(addr + i));
         }
-        *R = 1;
+        return;
+    }
+#endif
+    while (count) {
+        size_t n = ram->size - addr < count ? ram->size - addr : count;
+        memcpy(buf, &ram->ram[addr], n * sizeof(uint16_t));
+        buf   += n;
+        count -= n;
+        addr   = 0;
+    }
+}
+
+
+void
+ram_write_block (ram_t * ram, uint16_t addr, const uint16_t * buf, size_t count)
+{
+    // a page at a time, and the last word for whatever page it's on
+    for (size_t i = 0; i < count && i < ram->size; i += RAM_PAGE_WORDS) {
+        ram_dirty(ram, (uint16_t)(addr + i));
+    }
+    if (count) {
+        ram_dirty(ram, (uint16_t)(addr + count - 1));
+    }
+
+#ifdef IIT3503_RAM_ARRAY
+    if (ram->scope) {
+        for (size_t i = 0; i < count; i++) {
+            ram_poke(ram, (uint16_t)(addr + i), buf[i]);
+        }
+        return;
+    }
+#endif
+    while (count) {
+        size_t n = ram->size - addr < count ? ram->size - addr : count;
+        memcpy(&ram->ram[addr], buf, n * sizeof(uint16_t));
+        buf   += n;
+        count -= n;
+        addr   = 0;
+    }
+}
+
+#ifndef IIT3503_RAM_ARRAY
+
+
+// wait states for the access currently on the port. This has to
+// give the same answer every time it's asked within one access
+// (the read hook can be evaluated more than once per cycle), so
+// it's a hash of the access number rather than a running RNG
+static unsigned
+wait_states (ram_t * ram, paddr_t addr)
+{
+    unsigned span = ram->wait_max - ram->wait_min + 1;
+
+    if (span == 1) {
+        return ram->wait_min;
+    }
+
+    uint32_t h = (ram->accesses ^ ((uint32_t)addr << 16)) * 2654435761u;
+    return ram->wait_min + (h >> 16) % span;
+}
+
+
+// hooks into verilog (see src/v/ram.v). Reads are combinational:
+// data for whatever address is on the port, with R once the access
+// has been held for its wait states.
+extern "C" void extern_ram_read (uint8_t en,
+                                 paddr_t addr,
+                                 uint8_t waited,
+                                 word_t* dataOut,
+                                 uint8_t* R) {
+
+    if (en) {
+        ram_t * ram = iit3503_cur->ram;
+
+        *dataOut = ram->ram[addr];
+        *R = waited >= wait_states(ram, addr);
     } else {
+        *dataOut = 0;
         *R = 0;
     }
 }
+
+
+// the clock edge that completes an access
+extern "C" void extern_ram_commit (uint8_t wEn,
+                                   word_t dataIn,
+                                   paddr_t addr) {
+
+    ram_t * ram = iit3503_cur->ram;
+
+    if (wEn) {
+        ram->ram[addr] = dataIn;
+        ram_dirty(ram, addr);
+    }
+
+    if (iit3503_cur->memprof) {
+        memprof_count(iit3503_cur->memprof, addr, wEn);
+    }
+
+    ram->accesses++;
+}
+
+#endif
@@ -4,14 +4,61 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+// dirty page tracking (see ram_dirty()): 256-word pages
+#define RAM_PAGE_SHIFT 8
+#define RAM_PAGE_WORDS (1 << RAM_PAGE_SHIFT)
+#define RAM_PAGES      (0x10000 >> RAM_PAGE_SHIFT)
+
 typedef struct ram {
     unsigned short * ram;
     size_t size;
+
+    // non-NULL if RAM is backed by a named shared memory
+    // object or an mmap'd file rather than private memory
+    const char * backing;
+
+    // every access takes wait_min..wait_max extra cycles (picked
+    // per access, so the RTL has to really wait for R)
+    uint8_t wait_min;
+    uint8_t wait_max;
+    uint32_t accesses; // completed so far; seeds the pick
+
+    // a bit per page written since whoever's looking cleared it
+    // (see fingerprint.cpp). Only writes that go through here count,
+    // so the array model, where the RTL writes RAM itself, and shared
+    // RAM that other processes write to, can't be tracked.
+    uint64_t dirty[RAM_PAGES / 64];
+
+    // array model only (see src/v/ram.v): the DPI scope of the
+    // ExternalRAM that really holds guest memory. Once attached,
+    // ram[] is only where create_ram() loaded the images.
+    void * scope;
 } ram_t;
 
 struct dut;
 
-ram_t * create_ram (size_t size, char * img, char * os_image, uint16_t * entry);
+static inline void
+ram_dirty (ram_t * ram, uint16_t addr)
+{
+    unsigned page = addr >> RAM_PAGE_SHIFT;
+    ram->dirty[page / 64] |= 1ull << (page % 64);
+}
+
+ram_t * create_ram (size_t size, char * img, char * os_image, uint16_t * entry, const char * backing, bool backing_is_file);
 void destroy_ram(ram_t * ram);
+void ram_set_wait_states (ram_t * ram, uint8_t min, uint8_t max);
+
+// hands RAM over to the ExternalRAM with this DPI scope name (array
+// model only; a no-op otherwise). Copies in whatever is loaded.
+int ram_attach (ram_t * ram, const char * scope_name);
+
+// backdoor access, wherever guest memory lives
+uint16_t ram_peek (ram_t * ram, uint16_t addr);
+void ram_poke (ram_t * ram, uint16_t addr, uint16_t val);
+
+// the same for count words at a time, wrapping at the top of memory
+// (with the DPI model, these are a memcpy or two)
+void ram_read_block (ram_t * ram, uint16_t addr, uint16_t * buf, size_t count);
+void ram_write_block (ram_t * ram, uint16_t addr, const uint16_t * buf, size_t count);
 
 #endif
@@ -0,0 +1,125 @@
+#include <stddef.h>
+#include "common.h"
+#include "scheduler.h"
+
+
+void
+sched_init (sched_t * s)
+{
+    s->n    = 0;
+    s->next = SCHED_NEVER;
+}
+
+
+void
+sched_device (device_t * dev, const char * name, uint64_t (*tick)(struct dut *, device_t *))
+{
+    dev->name = name;
+    dev->tick = tick;
+    dev->when = SCHED_NEVER;
+    dev->slot = -1;
+}
+
+
+static inline void
+put (sched_t * s, unsigned i, device_t * dev)
+{
+    s->heap[i] = dev;
+    dev->slot  = i;
+}
+
+
+static void
+sift_up (sched_t * s, unsigned i)
+{
+    device_t * dev = s->heap[i];
+
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (s->heap[parent]->when <= dev->when) {
+            break;
+        }
+        put(s, i, s->heap[parent]);
+        i = parent;
+    }
+
+    put(s, i, dev);
+}
+
+
+static void
+sift_down (sched_t * s, unsigned i)
+{
+    device_t * dev = s->heap[i];
+
+    while (1) {
+        unsigned child = 2 * i + 1;
+        if (child >= s->n) {
+            break;
+        }
+        if (child + 1 < s->n && s->heap[child + 1]->when < s->heap[child]->when) {
+            child++;
+        }
+        if (dev->when <= s->heap[child]->when) {
+            break;
+        }
+        put(s, i, s->heap[child]);
+        i = child;
+    }
+
+    put(s, i, dev);
+}
+
+
+static void
+remove_top (sched_t * s)
+{
+    s->heap[0]->slot = -1;
+
+    if (--s->n) {
+        put(s, 0, s->heap[s->n]);
+        sift_down(s, 0);
+    }
+}
+
+
+void
+sched_wake (sched_t * s, device_t * dev, uint64_t when)
+{
+    if (dev->slot < 0) {
+        if (when == SCHED_NEVER) {
+            return;
+        }
+        assert(s->n < SCHED_MAX_DEVICES);
+        dev->when = when;
+        put(s, s->n++, dev);
+        sift_up(s, dev->slot);
+    } else if (when < dev->when) {
+        dev->when = when;
+        sift_up(s, dev->slot);
+    } else {
+        dev->when = when;
+        sift_down(s, dev->slot);
+    }
+
+    s->next = s->heap[0]->when;
+}
+
+
+void
+sched_run (struct dut * dut, sched_t * s, uint64_t now)
+{
+    while (s->n && s->heap[0]->when <= now) {
+        device_t * dev = s->heap[0];
+
+        remove_top(s);
+
+        // dev might wake other devices (or itself) from in here
+        uint64_t when = dev->tick(dut, dev);
+        if (when != SCHED_NEVER) {
+            sched_wake(s, dev, when > now ? when : now + 1);
+        }
+    }
+
+    s->next = s->n ? s->heap[0]->when : SCHED_NEVER;
+}
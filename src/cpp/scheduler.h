@@ -0,0 +1,51 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+#include <stdint.h>
+
+/*
+ * Device scheduler for the harness. Host-side device models (the
+ * serial line, the host keyboard, ...) don't need to look at the
+ * machine every cycle, only at times they know in advance: the
+ * next bit on a serial line, the next keyboard poll, and so on.
+ *
+ * Each device says when it next wants to run, and the scheduler
+ * keeps them in a min-heap on that cycle. The cycle loop only has
+ * to compare the cycle count against the earliest deadline; when
+ * it's reached, sched_run() calls every device that's due.
+ */
+
+#define SCHED_NEVER       UINT64_MAX
+#define SCHED_MAX_DEVICES 16
+
+struct dut;
+
+typedef struct device {
+    const char * name;
+
+    // called at (or, after a stall, just past) its deadline, before
+    // that cycle's clock edge. Returns the cycle to run at next, or
+    // SCHED_NEVER to sleep until someone calls sched_wake().
+    uint64_t (*tick)(struct dut * dut, struct device * dev);
+
+    uint64_t when;
+    int slot;   // index in the heap, or -1 while asleep
+} device_t;
+
+typedef struct sched {
+    device_t * heap[SCHED_MAX_DEVICES];
+    unsigned n;
+    uint64_t next;  // earliest deadline (SCHED_NEVER if nobody's waiting)
+} sched_t;
+
+void sched_init (sched_t * s);
+
+// sets up a device (asleep)
+void sched_device (device_t * dev, const char * name, uint64_t (*tick)(struct dut *, device_t *));
+
+// (re)schedules dev to run at cycle when, whether it was asleep or not
+void sched_wake (sched_t * s, device_t * dev, uint64_t when);
+
+// runs every device whose deadline is at or before now
+void sched_run (struct dut * dut, sched_t * s, uint64_t now);
+
+#endif
@@ -5,11 +5,16 @@
 #include <stdnoreturn.h>
 
 #include <signal.h>
+#include <time.h>
 
 #include "common.h"
 #include "shell.h"
 #include "iit3503.h"
 #include "ram.h"
+#include "metrics.h"
+#include "memprof.h"
+#include "irqlat.h"
+#include "isa.h"
 
 #include "VTop.h"
 #include <readline/history.h>
@@ -240,6 +245,144 @@ remove_bp (uint16_t bp_addr)
 }
 
 
+// Prints the last n records from the flight recorder, disassembled
+static void
+print_history (dut_t * dut, size_t n)
+{
+	iit3503_retire_t recs[IIT3503_HISTORY_LEN];
+
+	n = iit3503_history(dut, recs, n < IIT3503_HISTORY_LEN ? n : IIT3503_HISTORY_LEN);
+	if (!n) {
+		INFO_PRINT("  Nothing has retired yet");
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		const iit3503_retire_t * r = &recs[i];
+		char dis[32];
+		char what[64];
+		int len = 0;
+
+		what[0] = 0;
+
+		if (r->flags & IIT3503_RETIRE_INT) {
+			snprintf(dis, sizeof(dis), "(interrupt)");
+		} else {
+			isa_disasm(r->ir, dis, sizeof(dis));
+		}
+
+		if (r->flags & IIT3503_RETIRE_REG) {
+			len += snprintf(what + len, sizeof(what) - len, "  R%u=x%04x", r->reg, r->reg_val);
+		}
+		if (r->flags & IIT3503_RETIRE_LOAD) {
+			len += snprintf(what + len, sizeof(what) - len, "  [x%04x] -> x%04x", r->mem_addr, r->mem_data);
+		}
+		if (r->flags & IIT3503_RETIRE_STORE) {
+			len += snprintf(what + len, sizeof(what) - len, "  x%04x -> [x%04x]", r->mem_data, r->mem_addr);
+		}
+		if (r->flags & IIT3503_RETIRE_EXCP) {
+			snprintf(what + len, sizeof(what) - len, "  (exception)");
+		}
+
+		INFO_PRINT("  %10lu  x%04x: %04x  %-24s PSR=x%04x%s", r->cycle, r->pc, r->ir, dis, r->psr, what);
+	}
+}
+
+
+// exceptions the shell has already told the user about
+static uint64_t excps_seen;
+
+// Called after every cycle: an exception dumps the flight recorder
+// once the machine has gone into it
+static inline void
+check_excp (dut_t * dut)
+{
+	if (dut->excps == excps_seen) {
+		return;
+	}
+
+	excps_seen = dut->excps;
+
+	if (dut->history_dump) {
+		ERROR_PRINT("Exception (uPC %u); the last %u instructions:", dut->excp_upc, dut->history_dump);
+		print_history(dut, dut->history_dump);
+	}
+}
+
+
+// Called when stepping stops because the machine halted
+// wall clock when the shell took over, for the speed report
+static struct timespec sim_start;
+
+static void
+report_halt (dut_t * dut)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double secs = (now.tv_sec - sim_start.tv_sec) + (now.tv_nsec - sim_start.tv_nsec) / 1e9;
+
+	INFO_PRINT("Machine halted after %lu cycles (%lu instructions).",
+			dut->cycle_count,
+			dut->instr_count);
+	INFO_PRINT("  %.3fs of simulation (%.1f kHz)",
+			secs,
+			secs > 0 ? dut->cycle_count / secs / 1e3 : 0.0);
+
+	uint8_t status = IIT3503_GUEST_STATUS(dut->top->io_debugMCR);
+	if (status) {
+		ERROR_PRINT("  The guest reported failure (MCR[7:0] = x%02x)", status);
+		if (dut->history_dump) {
+			ERROR_PRINT("  The last %u instructions:", dut->history_dump);
+			print_history(dut, dut->history_dump);
+		}
+	}
+
+	if (dut->haltquit) {
+		printf("  Quitting. Goodbye.\n");
+		exit(status ? IIT3503_EXIT_GUEST : IIT3503_EXIT_HALT);
+	}
+}
+
+
+// with -i, a watchdog stop just drops back to the prompt
+static bool shell_interactive;
+
+static int cmd_allregs (dut_t * dut, char * args);
+
+// Called when the watchdog stops a run (see watchdog_check())
+static void
+report_watchdog (dut_t * dut, int why)
+{
+	if (why == IIT3503_EXIT_EXCEPTION) {
+		ERROR_PRINT("Stopped: exception (uPC %u) at PC x%04x", dut->excp_upc, dut->top->io_debugPC);
+	} else if (why == IIT3503_EXIT_DIVERGED) {
+		ERROR_PRINT("Stopped: the RTL and the microcode model diverged at cycle %lu", dut->diverged_at);
+	} else {
+		ERROR_PRINT("Stopped: out of time after %lu cycles (%lu instructions)",
+				dut->cycle_count,
+				dut->instr_count);
+	}
+
+	// an exception has had its dump already (see check_excp())
+	if (why != IIT3503_EXIT_EXCEPTION && dut->history_dump) {
+		ERROR_PRINT("  The last %u instructions:", dut->history_dump);
+		print_history(dut, dut->history_dump);
+	}
+
+	if (dut->watchdog_dump) {
+		iit3503_stats_t st;
+		cmd_allregs(dut, NULL);
+		iit3503_read_stats(dut, &st);
+		metrics_print(&st);
+	}
+
+	if (!shell_interactive) {
+		exit(why);
+	}
+}
+
+
 // Prints a helpful message (for when the PC changes) that indicates the new PC
 // and the corresponding instruction
 static void
@@ -289,8 +432,10 @@ cmd_step_cycle (dut_t * dut, char * args)
 	for (; n && !((bp_hit = is_valid_bp(dut->top->io_debugPC)) && (dut->top->io_debuguPC == 18)) && !sigint_received; n--) {
 		last_pc = dut->top->io_debugPC;
         if (iit3503_step_cycle(dut, false)) {
+            report_halt(dut);
             break;
         }
+        check_excp(dut);
 	}
 
 	if (bp_hit) {
@@ -320,8 +465,10 @@ cmd_step_instr (dut_t * dut, char * args)
 
 	for (; n && !((bp_hit = is_valid_bp(dut->top->io_debugPC)) && (dut->top->io_debuguPC == 18)) && !sigint_received; n--) {
 		if (iit3503_step_instr(dut, false)) {
+            report_halt(dut);
             break;
         }
+        check_excp(dut);
 	}
 
 	if (bp_hit) {
@@ -365,6 +512,8 @@ cmd_ustate (dut_t * dut, char * args)
     INFO_PRINT("MAR -> x%04x  ;  MDR -> x%04x", dut->top->io_debugMAR, dut->top->io_debugMDR);
     INFO_PRINT("DSR -> x%04x  ;  DDR -> x%04x", dut->top->io_debugDSR, dut->top->io_debugDDR);
     INFO_PRINT("MCR -> x%04x", dut->top->io_debugMCR);
+    INFO_PRINT("I-cache    -> %u hits, %u misses",
+            dut->top->io_debugICHits, dut->top->io_debugICMisses);
 	return 0;
 }
 
@@ -383,7 +532,10 @@ cmd_peek (dut_t * dut, char * args)
 	size_t addr;
 	GET_HEX_ADDR(addr);
 
-	INFO_PRINT("  x%04x: x%04x", (uint16_t)addr, dut->ram->ram[addr]);
+	uint16_t word;
+	iit3503_read_mem(dut, (uint16_t)addr, &word, 1);
+
+	INFO_PRINT("  x%04x: x%04x", (uint16_t)addr, word);
 	return 0;
 }
 
@@ -401,7 +553,8 @@ cmd_poke (dut_t * dut, char * args)
 		ERROR_PRINT("  Byte value $%zx is out of range", val);
 	}
 
-    dut->ram->ram[addr] = val;
+    uint16_t word = val;
+    iit3503_write_mem(dut, addr, &word, 1);
 	return 0;
 }
 
@@ -505,7 +658,15 @@ cmd_dumpmem (dut_t * dut, char * args)
 		return -1;
 	}
 
-	debug_hexdump_grouped(addr, dut->ram->ram + addr, count * 2, 2);
+	uint16_t * words = (uint16_t*)malloc(count * sizeof(uint16_t));
+	if (!words) {
+		ERROR_PRINT("  Couldn't allocate %zu words", count);
+		return 0;
+	}
+
+	iit3503_read_mem(dut, (uint16_t)addr, words, count);
+	debug_hexdump_grouped(addr, words, count * 2, 2);
+	free(words);
 	return 0;
 }
 
@@ -534,6 +695,158 @@ cmd_irq (dut_t * dut, char * args)
 }
 
 
+static int
+cmd_core (dut_t * dut, char * args)
+{
+    size_t core;
+    unsigned cur = dut->top->io_debugCore;
+    char * token = next_dec(&args, &core);
+
+    if (token && *token) {
+        ERROR_PRINT("  '%s' is not a valid positive decimal integer", token);
+        return -1;
+    }
+
+    if (token) {
+        for (unsigned i = 0; i < iit3503_num_cores(); i++) {
+            iit3503_select_core(dut, i);
+            INFO_PRINT("  %c core %u: PC=x%04x uPC=%u%s",
+                    i == cur ? '*' : ' ',
+                    i,
+                    dut->top->io_debugPC,
+                    dut->top->io_debuguPC,
+                    dut->top->io_debugHalt ? " (halted)" : "");
+        }
+        iit3503_select_core(dut, cur);
+        return 0;
+    }
+
+    if (!iit3503_select_core(dut, (unsigned)core)) {
+        ERROR_PRINT("  There's no core %zu (this machine has %u)", core, iit3503_num_cores());
+        return 0;
+    }
+
+    INFO_PRINT("  Now looking at core %zu", core);
+    print_pc_update(dut);
+    return 0;
+}
+
+
+// seconds between progress lines during continue (0 = none)
+static unsigned progress_secs = 10;
+
+// how often (in cycles) continue looks at the clock
+#define PROGRESS_CHECK_MASK 0xFFFF
+
+static int
+cmd_stats (dut_t * dut, char * args)
+{
+    size_t secs;
+    char * token = next_dec(&args, &secs);
+
+    if (token && *token) {
+        ERROR_PRINT("  '%s' is not a valid positive decimal integer", token);
+        return -1;
+    }
+
+    if (!token) {
+        progress_secs = (unsigned)secs;
+        if (secs) {
+            INFO_PRINT("  Progress every %zus during continue", secs);
+        } else {
+            INFO_PRINT("  No progress lines during continue");
+        }
+        return 0;
+    }
+
+    iit3503_stats_t st;
+    iit3503_read_stats(dut, &st);
+    metrics_print(&st);
+    return 0;
+}
+
+
+static int
+cmd_history (dut_t * dut, char * args)
+{
+	size_t n = 16;
+	if (*args) {
+		if (try_next_dec(&args, &n)) {
+			return -1;
+		}
+	}
+
+	print_history(dut, n);
+	return 0;
+}
+
+
+static int
+cmd_heatmap (dut_t * dut, char * args)
+{
+	char * arg = next_token(&args);
+
+	if (!strcmp(arg, "on")) {
+		if (!dut->memprof && !(dut->memprof = memprof_create())) {
+			return -1;
+		}
+		if (dut->ram->scope) {
+			INFO_PRINT("  Counting device registers only (the array RAM model has no per-access hook)");
+		} else {
+			INFO_PRINT("  Counting memory accesses from here on");
+		}
+		return 0;
+	}
+
+	if (!dut->memprof) {
+		ERROR_PRINT("  Not counting memory accesses (try 'heatmap on')");
+		return -1;
+	}
+
+	if (!strcmp(arg, "off")) {
+		memprof_destroy(dut->memprof);
+		dut->memprof = NULL;
+	} else if (!strcmp(arg, "reset")) {
+		memprof_reset(dut->memprof);
+	} else if (*arg) {
+		if (memprof_csv(dut->memprof, arg)) {
+			return -1;
+		}
+		INFO_PRINT("  Wrote '%s'", arg);
+	} else {
+		memprof_print(dut->memprof);
+	}
+
+	return 0;
+}
+
+
+static int
+cmd_irqlat (dut_t * dut, char * args)
+{
+	char * arg = next_token(&args);
+
+	if (!strcmp(arg, "reset")) {
+		irqlat_reset(dut->irqlat);
+		return 0;
+	}
+
+	int vec = -1;
+	if (*arg) {
+		char * end;
+		unsigned long v = strtoul(arg, &end, 16);
+		if (*end || v > 0xFF) {
+			ERROR_PRINT("  '%s' is not an interrupt vector (x00-xFF)", arg);
+			return -1;
+		}
+		vec = (int)v;
+	}
+
+	irqlat_print(dut->irqlat, vec);
+	return 0;
+}
+
+
 static int
 cmd_print_instr (dut_t * dut, char * args)
 {
@@ -548,12 +861,30 @@ cmd_cont (dut_t * dut, char * args)
 {
 	bool hit_bp = false;
 	uint16_t last_pc = dut->top->io_debugPC;
+	uint64_t last_progress = host_ns();
 
 	while (!((hit_bp = is_valid_bp(dut->top->io_debugPC)) && (dut->top->io_debuguPC == 18)) && !sigint_received) {
 		last_pc = dut->top->io_debugPC;
 		if (iit3503_step_cycle(dut, false)) {
+            report_halt(dut);
+            break;
+        }
+        check_excp(dut);
+
+        bool check_clock = !(dut->cycle_count & PROGRESS_CHECK_MASK);
+        int why = watchdog_check(dut, check_clock);
+        if (why) {
+            report_watchdog(dut, why);
             break;
         }
+
+        if (progress_secs && check_clock &&
+            host_ns() - last_progress >= progress_secs * 1000000000ull) {
+            iit3503_stats_t st;
+            iit3503_read_stats(dut, &st);
+            metrics_progress(&st);
+            last_progress = host_ns();
+        }
 	}
 
 	if (hit_bp) {
@@ -561,6 +892,11 @@ cmd_cont (dut_t * dut, char * args)
 		remove_bp(dut->top->io_debugPC);
 	} 
 
+	if (sigint_received && dut->history_dump) {
+		INFO_PRINT("  Interrupted; the last %u instructions:", dut->history_dump);
+		print_history(dut, dut->history_dump);
+	}
+
 	print_pc_update(dut);
 
 	return 0;
@@ -607,7 +943,7 @@ static int __attribute__((noreturn))
 cmd_quit (dut_t * cpu, char * args)
 {
 	printf("  Quitting. Goodbye.\n");
-	exit(0);
+	exit(IIT3503_GUEST_STATUS(cpu->top->io_debugMCR) ? IIT3503_EXIT_GUEST : IIT3503_EXIT_HALT);
 }
 
 #define SPELLINGS(...) ((const char * []){__VA_ARGS__, NULL})
@@ -680,6 +1016,31 @@ static const command_descriptor_t commands[] = {
 		"Raises the specified IRQ",
 		cmd_irq},
 
+	{SPELLINGS("stats"),
+		"[dec secs] ",
+		"Prints runtime statistics (with secs: print progress that often during continue, 0 = never)",
+		cmd_stats},
+
+	{SPELLINGS("core"),
+		"[dec n] ",
+		"Shows core n in regs/ustate/stepi (no n: lists the cores)",
+		cmd_core},
+
+	{SPELLINGS("history", "hist"),
+		"[dec n] ",
+		"Disassembles the last n instructions retired (default 16, at most 256)",
+		cmd_history},
+
+	{SPELLINGS("heatmap", "hm"),
+		"[on | off | reset | <path>] ",
+		"Counts memory accesses by address and region: on/off, print the heatmap, or write it to a CSV at path",
+		cmd_heatmap},
+
+	{SPELLINGS("irqlat", "il"),
+		"[hex8 vector | reset] ",
+		"Prints interrupt latency percentiles per vector (with vector: its histograms too), or starts over",
+		cmd_irqlat},
+
 	{SPELLINGS("pr", "print"),
 		"",
 		"Prints the current instruction",
@@ -760,6 +1121,10 @@ void
 run_shell (dut_t * dut, bool interactive)
 {
 	char * line = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &sim_start);
+	shell_interactive = interactive;
+
 	if (sigaction(SIGINT, &sigint_action, NULL)) {
 		ERROR_PRINT("  Couldn't register a SIGINT handler");
 		return;
@@ -0,0 +1,57 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm.h"
+
+void *
+shared_map (const char * name, size_t len, bool is_file)
+{
+    int fd;
+    void * addr;
+
+    if (is_file) {
+        fd = open(name, O_RDWR | O_CREAT, 0644);
+    } else {
+        fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    }
+
+    if (fd < 0) {
+        ERROR_PRINT("Could not open shared region '%s': %s", name, strerror(errno));
+        return NULL;
+    }
+
+    // keep whatever a previous run left there (a --ram-file carries
+    // guest memory across runs); a new or short region is extended
+    // with zeroes
+    struct stat st;
+    if (fstat(fd, &st) || ((size_t)st.st_size < len && ftruncate(fd, len))) {
+        ERROR_PRINT("Could not size shared region '%s': %s", name, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    // the mapping holds its own reference
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        ERROR_PRINT("Could not map shared region '%s': %s", name, strerror(errno));
+        return NULL;
+    }
+
+    DEBUG_PRINT("Mapped %zu bytes of shared %s '%s'", len, is_file ? "file" : "memory", name);
+
+    return addr;
+}
+
+void
+shared_unmap (void * addr, size_t len)
+{
+    munmap(addr, len);
+}
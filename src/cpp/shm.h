@@ -0,0 +1,16 @@
+#ifndef __SHM_H__
+#define __SHM_H__
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Helpers for mapping simulator state somewhere other
+ * processes can see it. A region is either a named POSIX
+ * shared memory object (e.g. "/iit3503") or a regular file
+ * on disk. Either way the mapping is MAP_SHARED, so external
+ * tools can mmap the same name and observe it with zero copies.
+ */
+void * shared_map (const char * name, size_t len, bool is_file);
+void shared_unmap (void * addr, size_t len);
+
+#endif
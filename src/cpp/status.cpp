@@ -0,0 +1,67 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include "status.h"
+#include "shm.h"
+#include "iit3503.h"
+
+#include "VTop.h"
+
+#define STATUS_SUFFIX ".status"
+
+machine_status_t *
+status_create (const char * name, bool is_file)
+{
+    char path[256];
+    machine_status_t * st;
+
+    // the status page sits next to the RAM region: "<name>.status"
+    snprintf(path, sizeof(path), "%s" STATUS_SUFFIX, name);
+
+    st = (machine_status_t*)shared_map(path, IIT3503_STATUS_SIZE, is_file);
+    if (!st) {
+        ERROR_PRINT("Could not create machine status page");
+        return NULL;
+    }
+
+    // unlike RAM, nothing from an earlier run is worth keeping here
+    memset(st, 0, IIT3503_STATUS_SIZE);
+    st->magic   = IIT3503_STATUS_MAGIC;
+    st->version = IIT3503_STATUS_VERSION;
+
+    return st;
+}
+
+void
+status_update (machine_status_t * st, dut_t * dut)
+{
+    VTop * top = dut->top;
+
+    // odd sequence number => update in progress
+    __atomic_store_n(&st->seq, st->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    st->pc      = top->io_debugPC;
+    st->ir      = top->io_debugIR;
+    st->psr     = top->io_debugPSR;
+    st->upc     = top->io_debuguPC;
+    st->regs[0] = top->io_debugR0;
+    st->regs[1] = top->io_debugR1;
+    st->regs[2] = top->io_debugR2;
+    st->regs[3] = top->io_debugR3;
+    st->regs[4] = top->io_debugR4;
+    st->regs[5] = top->io_debugR5;
+    st->regs[6] = top->io_debugR6;
+    st->regs[7] = top->io_debugR7;
+    st->cycles  = dut->cycle_count;
+    st->instrs  = dut->instr_count;
+    st->halted  = top->io_halt;
+
+    __atomic_store_n(&st->seq, st->seq + 1, __ATOMIC_RELEASE);
+}
+
+void
+status_destroy (machine_status_t * st)
+{
+    shared_unmap(st, IIT3503_STATUS_SIZE);
+}
@@ -0,0 +1,43 @@
+#ifndef __STATUS_H__
+#define __STATUS_H__
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IIT3503_STATUS_MAGIC   0x33353033 // "3503"
+#define IIT3503_STATUS_VERSION 1
+#define IIT3503_STATUS_SIZE    4096
+
+/*
+ * Live machine-status page. This lives in shared memory next to
+ * guest RAM so monitors can watch a running simulation without
+ * stopping it. It is only updated at instruction (retire) boundaries.
+ *
+ * Readers should use the sequence counter like a seqlock: read
+ * seq, copy out the fields, then re-read seq. If the two values
+ * differ or are odd, an update was in progress and the copy should
+ * be retried.
+ */
+typedef struct machine_status {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;
+
+    uint16_t pc;
+    uint16_t ir;
+    uint16_t psr;
+    uint16_t upc;
+    uint16_t regs[8];
+
+    uint64_t cycles;
+    uint64_t instrs;
+
+    uint8_t  halted;
+} machine_status_t;
+
+struct dut;
+
+machine_status_t * status_create (const char * name, bool is_file);
+void status_update (machine_status_t * st, struct dut * dut);
+void status_destroy (machine_status_t * st);
+
+#endif
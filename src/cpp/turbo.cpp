@@ -0,0 +1,474 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "ram.h"
+#include "isa.h"
+#include "turbo.h"
+
+/*
+ * Blocks are at most this many guest words long, so a block that
+ * overlaps page P must start no earlier than P*PAGE_WORDS - MAX_BLOCK.
+ */
+#define MAX_BLOCK   64
+#define PAGE_SHIFT  8
+#define PAGE_WORDS  (1 << PAGE_SHIFT)
+#define NPAGES      (0x10000 >> PAGE_SHIFT)
+
+#define BITS(x, hi, lo) (((x) >> (lo)) & ((1u << ((hi) - (lo) + 1)) - 1))
+
+// order must match the label table in turbo_run()
+enum uop_kind {
+    U_ADDR, U_ADDI, U_ANDR, U_ANDI, U_NOT,
+    U_LD, U_LDI, U_LDR, U_LEA,
+    U_ST, U_STI, U_STR,
+    U_NOP, U_BR, U_JMP, U_JSR, U_JSRR,
+    U_SLOW, U_END,
+};
+
+typedef struct uop {
+    const void * handler;
+    uint16_t pc;    // guest address of this instruction
+    uint8_t a;      // DR/SR (or nzp for BR)
+    uint8_t b;      // SR1/BaseR
+    uint16_t c;     // SR2, immediate, absolute address or target
+} uop_t;
+
+typedef struct block {
+    uint16_t start;
+    uint16_t len;   // guest words covered
+    bool user;      // privilege mode it was translated for
+    struct block * next_dead;
+    uop_t ops[];
+} block_t;
+
+struct turbo {
+    isa_state_t s;
+    ram_t * ram;
+    block_t * map[0x10000];
+    bool code_page[NPAGES];
+    block_t * dead;          // invalidated, freed at the next block boundary
+    turbo_stats_t stats;
+};
+
+
+static inline uint16_t
+sext (uint16_t x, int bits)
+{
+    uint16_t m = 1u << (bits - 1);
+    x &= (1u << bits) - 1;
+    return (x ^ m) - m;
+}
+
+
+// would this access have to go through the slow path?
+static inline bool
+bad_addr (uint16_t addr, bool user)
+{
+    return addr >= 0xFE00 || (user && addr < 0x3000);
+}
+
+
+static void
+kill_block (turbo_t * t, block_t * b)
+{
+    t->map[b->start] = NULL;
+    b->next_dead     = t->dead;
+    t->dead          = b;
+    t->stats.invalidated++;
+}
+
+
+static void
+invalidate_page (turbo_t * t, unsigned page)
+{
+    if (!t->code_page[page]) {
+        return;
+    }
+
+    t->code_page[page] = false;
+
+    unsigned lo   = page << PAGE_SHIFT;
+    unsigned from = lo >= MAX_BLOCK ? lo - MAX_BLOCK : 0;
+
+    for (unsigned a = from; a < lo + PAGE_WORDS; a++) {
+        block_t * b = t->map[a];
+        if (b && b->start + b->len > lo) {
+            kill_block(t, b);
+        }
+    }
+}
+
+
+void
+turbo_invalidate (turbo_t * t, uint16_t addr, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    unsigned last = ((unsigned)addr + count - 1) >> PAGE_SHIFT;
+    for (unsigned p = addr >> PAGE_SHIFT; p <= last && p < NPAGES; p++) {
+        invalidate_page(t, p);
+    }
+}
+
+
+// isa_step() writes (stack pushes, slow-path stores) land here
+static void
+wr_hook (void * arg, uint16_t addr)
+{
+    turbo_t * t = (turbo_t*)arg;
+    if (t->code_page[addr >> PAGE_SHIFT]) {
+        invalidate_page(t, addr >> PAGE_SHIFT);
+    }
+}
+
+
+static block_t *
+translate (turbo_t * t, uint16_t pc, bool user, const void * const * labels)
+{
+    block_t * b = (block_t*)malloc(sizeof(block_t) + (MAX_BLOCK + 1) * sizeof(uop_t));
+    if (!b) {
+        ERROR_PRINT("Could not allocate translation block");
+        exit(EXIT_FAILURE);
+    }
+
+    b->start = pc;
+    b->user  = user;
+
+    uint16_t * mem = t->s.mem;
+    unsigned a     = pc;
+    int n          = 0;
+    bool done      = false;
+
+    while (!done && n < MAX_BLOCK) {
+        uop_t * u = &b->ops[n++];
+        u->pc = a;
+
+        // instruction fetch from I/O space, or an ACV: the model handles it
+        if (bad_addr(a, user)) {
+            u->handler = labels[U_SLOW];
+            a++;
+            break;
+        }
+
+        uint16_t ir   = mem[a++];
+        uint16_t next = a;
+        uint16_t addr;
+        enum uop_kind k;
+
+        u->a = BITS(ir, 11, 9);
+        u->b = BITS(ir, 8, 6);
+
+        switch (ir >> 12) {
+            case 0x0: // BR
+                if (u->a == 0) {
+                    k = U_NOP;
+                } else {
+                    k    = U_BR;
+                    u->c = next + sext(ir, 9);
+                    done = true;
+                }
+                break;
+            case 0x1:
+            case 0x5:
+                if (ir & 0x20) {
+                    k    = (ir >> 12) == 0x1 ? U_ADDI : U_ANDI;
+                    u->c = sext(ir, 5);
+                } else {
+                    k    = (ir >> 12) == 0x1 ? U_ADDR : U_ANDR;
+                    u->c = BITS(ir, 2, 0);
+                }
+                break;
+            case 0x9:
+                k = U_NOT;
+                break;
+            case 0x2: // LD
+            case 0xA: // LDI
+            case 0x3: // ST
+            case 0xB: // STI
+                addr = next + sext(ir, 9);
+                if (bad_addr(addr, user)) {
+                    k    = U_SLOW;
+                    done = true;
+                    break;
+                }
+                switch (ir >> 12) {
+                    case 0x2: k = U_LD;  break;
+                    case 0xA: k = U_LDI; break;
+                    case 0x3: k = U_ST;  break;
+                    default:  k = U_STI; break;
+                }
+                u->c = addr;
+                break;
+            case 0x6:
+                k    = U_LDR;
+                u->c = sext(ir, 6);
+                break;
+            case 0x7:
+                k    = U_STR;
+                u->c = sext(ir, 6);
+                break;
+            case 0xE:
+                k    = U_LEA;
+                u->c = next + sext(ir, 9);
+                break;
+            case 0x4:
+                if (ir & 0x800) {
+                    k    = U_JSR;
+                    u->c = next + sext(ir, 11);
+                } else {
+                    k = U_JSRR;
+                }
+                done = true;
+                break;
+            case 0xC:
+                k    = U_JMP;
+                done = true;
+                break;
+            default: // RTI, TRAP, reserved
+                k    = U_SLOW;
+                done = true;
+                break;
+        }
+
+        u->handler = labels[k];
+    }
+
+    // falling off the end of the block
+    b->ops[n].handler = labels[U_END];
+    b->ops[n].pc      = a;
+
+    b->len = a - pc;
+
+    for (unsigned p = pc >> PAGE_SHIFT; p <= ((a - 1) >> PAGE_SHIFT) && p < NPAGES; p++) {
+        t->code_page[p] = true;
+    }
+
+    t->stats.translated++;
+
+    return b;
+}
+
+
+int
+turbo_run (turbo_t * t, uint64_t max_instrs)
+{
+    static const void * const labels[] = {
+        &&op_addr, &&op_addi, &&op_andr, &&op_andi, &&op_not,
+        &&op_ld, &&op_ldi, &&op_ldr, &&op_lea,
+        &&op_st, &&op_sti, &&op_str,
+        &&op_nop, &&op_br, &&op_jmp, &&op_jsr, &&op_jsrr,
+        &&op_slow, &&op_end,
+    };
+
+    isa_state_t * s = &t->s;
+    uint16_t * mem  = s->mem;
+    uint16_t * r    = s->r;
+    uint64_t icount = 0;
+    const uop_t * u;
+    block_t * b;
+    bool user;
+    uint16_t v;
+    uint16_t addr;
+    int ret;
+
+#define SETCC(x) (s->psr = (s->psr & ~0x7) | (((x) & 0x8000) ? 4 : ((x) ? 1 : 2)))
+#define NEXT     do { icount++; u++; goto *u->handler; } while (0)
+#define EXIT(to) do { s->pc = (to); goto dispatch; } while (0)
+#define STORE(a, x) do {                                   \
+        mem[(a)] = (x);                                    \
+        if (t->code_page[(a) >> PAGE_SHIFT]) {             \
+            invalidate_page(t, (a) >> PAGE_SHIFT);         \
+            icount++;                                      \
+            EXIT(u->pc + 1);                               \
+        }                                                  \
+    } while (0)
+
+dispatch:
+    while (t->dead) {
+        block_t * d = t->dead;
+        t->dead = d->next_dead;
+        free(d);
+    }
+
+    if (!(s->mcr & 0x8000)) {
+        ret = TURBO_HALTED;
+        goto out;
+    }
+
+    if (icount >= max_instrs) {
+        ret = TURBO_LIMIT;
+        goto out;
+    }
+
+    // pending interrupt: let the model take it
+    if (isa_irq_pending(s)) {
+        isa_step(s);
+        t->stats.slow++;
+        goto dispatch;
+    }
+
+    user = s->psr & ISA_PSR_PRIV;
+    b    = t->map[s->pc];
+
+    if (!b || b->user != user) {
+        if (b) {
+            kill_block(t, b);
+        }
+        b = translate(t, s->pc, user, labels);
+        t->map[s->pc] = b;
+    }
+
+    u = b->ops;
+    goto *u->handler;
+
+op_addr: v = r[u->b] + r[u->c]; r[u->a] = v; SETCC(v); NEXT;
+op_addi: v = r[u->b] + u->c;    r[u->a] = v; SETCC(v); NEXT;
+op_andr: v = r[u->b] & r[u->c]; r[u->a] = v; SETCC(v); NEXT;
+op_andi: v = r[u->b] & u->c;    r[u->a] = v; SETCC(v); NEXT;
+op_not:  v = ~r[u->b];          r[u->a] = v; SETCC(v); NEXT;
+op_lea:  r[u->a] = u->c; NEXT;
+op_nop:  NEXT;
+
+op_ld:
+    v = mem[u->c];
+    r[u->a] = v;
+    SETCC(v);
+    NEXT;
+
+op_ldi:
+    addr = mem[u->c];
+    if (bad_addr(addr, user)) {
+        goto op_slow;
+    }
+    v = mem[addr];
+    r[u->a] = v;
+    SETCC(v);
+    NEXT;
+
+op_ldr:
+    addr = r[u->b] + u->c;
+    if (bad_addr(addr, user)) {
+        goto op_slow;
+    }
+    v = mem[addr];
+    r[u->a] = v;
+    SETCC(v);
+    NEXT;
+
+op_st:
+    STORE(u->c, r[u->a]);
+    NEXT;
+
+op_sti:
+    addr = mem[u->c];
+    if (bad_addr(addr, user)) {
+        goto op_slow;
+    }
+    STORE(addr, r[u->a]);
+    NEXT;
+
+op_str:
+    addr = r[u->b] + u->c;
+    if (bad_addr(addr, user)) {
+        goto op_slow;
+    }
+    STORE(addr, r[u->a]);
+    NEXT;
+
+op_br:
+    icount++;
+    if (u->a & s->psr) {
+        EXIT(u->c);
+    }
+    EXIT(u->pc + 1);
+
+op_jmp:
+    icount++;
+    EXIT(r[u->b]);
+
+op_jsr:
+    icount++;
+    r[7] = u->pc + 1;
+    EXIT(u->c);
+
+op_jsrr:
+    icount++;
+    v    = r[u->b];
+    r[7] = u->pc + 1;
+    EXIT(v);
+
+op_slow:
+    s->pc = u->pc;
+    isa_step(s);
+    icount++;
+    t->stats.slow++;
+    goto dispatch;
+
+op_end:
+    EXIT(u->pc);
+
+out:
+#undef SETCC
+#undef NEXT
+#undef EXIT
+#undef STORE
+    t->stats.instrs += icount;
+    return ret;
+}
+
+
+turbo_t *
+turbo_create (ram_t * ram, uint16_t entry)
+{
+    turbo_t * t = (turbo_t*)malloc(sizeof(turbo_t));
+    if (!t) {
+        ERROR_PRINT("Could not allocate turbo state");
+        return NULL;
+    }
+    memset(t, 0, sizeof(turbo_t));
+
+    t->ram = ram;
+
+    isa_init(&t->s, ram->ram, entry);
+    t->s.wr_hook = wr_hook;
+    t->s.wr_arg  = t;
+
+    return t;
+}
+
+
+void
+turbo_destroy (turbo_t * t)
+{
+    for (unsigned a = 0; a < 0x10000; a++) {
+        if (t->map[a]) {
+            free(t->map[a]);
+        }
+    }
+
+    while (t->dead) {
+        block_t * d = t->dead;
+        t->dead = d->next_dead;
+        free(d);
+    }
+
+    free(t);
+}
+
+
+isa_state_t *
+turbo_state (turbo_t * t)
+{
+    return &t->s;
+}
+
+
+const turbo_stats_t *
+turbo_stats (turbo_t * t)
+{
+    return &t->stats;
+}
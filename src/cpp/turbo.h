@@ -0,0 +1,52 @@
+#ifndef __TURBO_H__
+#define __TURBO_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "isa.h"
+
+/*
+ * Turbo (functional-only) mode.
+ *
+ * No RTL at all: guest code is translated a basic block at a time into
+ * pre-decoded micro-ops which are run by a direct-threaded dispatcher.
+ * Blocks are cached per guest PC and dropped when something writes to
+ * a page they were translated from. Anything interesting (TRAP, RTI,
+ * interrupts, device registers, would-be ACVs) falls back to the ISA
+ * reference model one instruction at a time, so the architectural
+ * behavior is exactly that of isa_step().
+ */
+
+struct ram;
+
+typedef struct turbo turbo_t;
+
+typedef struct turbo_stats {
+    uint64_t instrs;         // guest instructions retired
+    uint64_t slow;           // ... of which went through isa_step()
+    uint64_t translated;     // blocks translated
+    uint64_t invalidated;    // blocks dropped because their code was written
+} turbo_stats_t;
+
+enum {
+    TURBO_HALTED = 0,
+    TURBO_LIMIT  = 1,
+};
+
+turbo_t * turbo_create (struct ram * ram, uint16_t entry);
+void turbo_destroy (turbo_t * t);
+
+// run until the machine halts, or for (roughly) max_instrs instructions
+int turbo_run (turbo_t * t, uint64_t max_instrs);
+
+// the architectural state; e.g. for raising interrupts or installing
+// an output callback
+isa_state_t * turbo_state (turbo_t * t);
+
+// for anyone writing guest memory behind turbo's back
+void turbo_invalidate (turbo_t * t, uint16_t addr, size_t count);
+
+const turbo_stats_t * turbo_stats (turbo_t * t);
+
+#endif
@@ -5,6 +5,8 @@
 #include <cstdio>
 
 #include "common.h"
+#include "iit3503.h"
+#include "VTop.h"
 
 #define FREQ 50000000
 #define BAUD 115200
@@ -12,68 +14,143 @@
 
 // TODO: CLEANUP
 
-static int rx_bit_count = ((FREQ + BAUD/2) / BAUD-1);
-static int rx_start_cnt = ((3*FREQ/2+BAUD/2)/BAUD-1);
-static int rx_shift_reg = 0;
-static int rx_cnt_reg = 0;
-static int rx_bits_reg = 0;
-static int rx_val_reg = 0;
+static const int rx_bit_count = ((FREQ + BAUD/2) / BAUD-1);
+static const int rx_start_cnt = ((3*FREQ/2+BAUD/2)/BAUD-1);
+static const int tx_bit_cycles = ((FREQ + BAUD/2) / BAUD);
+static const int rx_poll_cycles = tx_bit_cycles / 16;
 
-#define MAX_LINE_LEN 80
+static void 
+uart_push (dut_t * dut, char c)
+{
+    dut->metrics.uart_out++;
 
-static char console_buf[MAX_LINE_LEN];
-static int console_ptr = 0;
+    if (dut->uart_sink) {
+        dut->uart_sink(dut->uart_sink_arg, (uint8_t)c);
+        return;
+    }
 
-static inline void
-uart_buf_flush () {
-    console_ptr = 0;
-    printf("%s", console_buf);
-    fflush(stdout);
-    memset(console_buf, 0, MAX_LINE_LEN);
+    // nobody is listening yet, so hold on to it (dropping
+    // the oldest output if the buffer fills up)
+    dut->uart_buf[dut->uart_head] = c;
+    dut->uart_head = (dut->uart_head + 1) % IIT3503_UART_BUFLEN;
+    if (dut->uart_head == dut->uart_tail) {
+        dut->uart_tail = (dut->uart_tail + 1) % IIT3503_UART_BUFLEN;
+    }
 }
 
 
-static void 
-uart_push (char c)
+// The guest's serial output. While the line is idle it's sampled
+// at 16x the baud rate, like a real UART would. Once a start bit
+// shows up, each bit is looked at once, in its middle, and then the
+// receiver sits out the stop bit before it goes back to watching.
+static uint64_t
+uart_rx_tick (dut_t * dut, device_t * dev)
 {
-#if 0
-    if (c == '\n' || c == '\0') {
-        uart_buf_flush();
-        return;
-    } else {
-        console_buf[console_ptr++] = c;
-        if (console_ptr == MAX_LINE_LEN) {
-            uart_buf_flush();
+    uart_rx_state_t * u = &dut->uart;
+    uint8_t rxd = dut->top->io_uartTxd;
+    uint64_t now = dut->cycle_count;
+
+    if (!u->bits_reg) {
+        if (rxd) {
+            return now + rx_poll_cycles;
         }
+
+        // it fell somewhere since the last look, so aim for the
+        // middle of bit 0 from halfway between the two
+        u->bits_reg = 9;
+        return now + rx_start_cnt + 1 - rx_poll_cycles / 2;
+    }
+
+    if (u->bits_reg == 1) {
+        u->bits_reg = 0; // middle of the stop bit
+        return now + rx_poll_cycles;
     }
-#endif
-    putc(c, stdout); // TODO: if this isn't flushed we'll miss prompts
-    //fflush(stdout);
+
+    u->shift_reg = (u->shift_reg >> 1) | (rxd << 7);
+
+    if (--u->bits_reg == 1) {
+        uart_push(dut, u->shift_reg);
+        u->shift_reg = 0;
+    }
+
+    return now + rx_bit_count + 1;
 }
 
 
-void 
-uart_rx (uint8_t rxd) 
+// Drives the guest's receive line: one event per bit while there's
+// a frame going out, and asleep otherwise (iit3503_write_uart()
+// wakes it up).
+static uint64_t
+uart_tx_tick (dut_t * dut, device_t * dev)
 {
-    if (rx_cnt_reg) {
-        rx_cnt_reg--;
-    } else if (rx_bits_reg) {
-        rx_cnt_reg = rx_bit_count;
-        rx_shift_reg = (rx_shift_reg >> 1) | (rxd << 7);
-
-        if (rx_bits_reg == 1) {
-            rx_val_reg = 1;
-        }
+    uart_tx_state_t * u = &dut->uart_out;
 
-        rx_bits_reg--;
-    } else if (!rxd) {
-        rx_cnt_reg = rx_start_cnt;
-        rx_bits_reg = 8;
+    if (u->bits) {
+        u->frame >>= 1;
+        u->bits--;
     }
 
-    if (rx_val_reg) {
-        uart_push(rx_shift_reg);
-        rx_val_reg = 0;
-        rx_shift_reg = 0;
+    if (!u->bits && dut->uart_in_tail != dut->uart_in_head) {
+        // start bit, data, one stop bit
+        u->frame = (1 << 9) | ((uint8_t)dut->uart_in_buf[dut->uart_in_tail] << 1);
+        u->bits  = 10;
+        dut->metrics.uart_in++;
+        dut->uart_in_tail = (dut->uart_in_tail + 1) % IIT3503_UART_BUFLEN;
     }
+
+    dut->top->io_uartRxd = u->bits ? (u->frame & 1) : 1;
+
+    return u->bits ? dut->cycle_count + tx_bit_cycles : SCHED_NEVER;
+}
+
+
+void
+uart_init (dut_t * dut)
+{
+    sched_device(&dut->uart_rx_dev, "uart-rx", uart_rx_tick);
+    sched_device(&dut->uart_tx_dev, "uart-tx", uart_tx_tick);
+
+    dut->top->io_uartRxd = 1; // idle line
+    sched_wake(&dut->sched, &dut->uart_rx_dev, 0);
+}
+
+
+size_t
+iit3503_write_uart (dut_t * dut, const char * buf, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len && (dut->uart_in_head + 1) % IIT3503_UART_BUFLEN != dut->uart_in_tail) {
+        dut->uart_in_buf[dut->uart_in_head] = buf[n++];
+        dut->uart_in_head = (dut->uart_in_head + 1) % IIT3503_UART_BUFLEN;
+    }
+
+    // if the line's idle, the first frame goes out next cycle
+    if (n && dut->uart_tx_dev.slot < 0) {
+        sched_wake(&dut->sched, &dut->uart_tx_dev, dut->cycle_count);
+    }
+
+    return n;
+}
+
+
+void
+iit3503_set_uart_sink (dut_t * dut, iit3503_uart_sink_t sink, void * arg)
+{
+    dut->uart_sink     = sink;
+    dut->uart_sink_arg = arg;
+}
+
+
+size_t
+iit3503_read_uart (dut_t * dut, char * buf, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len && dut->uart_tail != dut->uart_head) {
+        buf[n++] = dut->uart_buf[dut->uart_tail];
+        dut->uart_tail = (dut->uart_tail + 1) % IIT3503_UART_BUFLEN;
+    }
+
+    return n;
 }
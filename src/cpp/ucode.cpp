@@ -0,0 +1,1026 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "ucode.h"
+#include "ucode_rom.h" // generated from ControlStore.scala (see tools/ucodegen.py)
+
+/*
+ * Each register below is named after the Chisel register it stands
+ * for. ucode_cycle() first works out everything the RTL computes
+ * combinationally in a cycle (from the registers as they are), then
+ * does what the clock edge does.
+ */
+
+#define BITS(x, hi, lo) (((x) >> (lo)) & ((1u << ((hi) - (lo) + 1)) - 1))
+
+// from UARTConsts, ICacheConsts, DMAConsts and BlockConsts
+#define TX_DEPTH     16
+#define TX_LOW_WATER 4
+#define TX_INT_VEC   0x82
+#define TX_INT_PRIO  4
+#define RX_DEPTH     16
+#define IC_SETS      32
+#define IC_WAYS      2
+#define IC_IDX_BITS  5
+#define DMA_INT_VEC  0x81
+#define DMA_INT_PRIO 3
+#define BLK_INT_VEC  0x83
+#define BLK_INT_PRIO 3
+
+// the serial port's bit time, as Tx and FifoRx work it out (50 MHz, 115200 baud)
+#define UART_FREQ     50000000
+#define UART_BAUD     115200
+#define UART_BIT_CYCLES ((UART_FREQ + UART_BAUD / 2) / UART_BAUD)
+
+// what AddrCtrl decided MAR points at when it was loaded
+enum mar_dev {
+    AT_MEM = 0,
+    AT_KBSR, AT_KBDR, AT_KBCR, AT_DSR, AT_DDR,
+    AT_DMASRC, AT_DMADST, AT_DMALEN, AT_DMACTL,
+    AT_BLKSEC, AT_BLKADR, AT_BLKCNT, AT_BLKCTL,
+    AT_CPUID, AT_LOCK, AT_MCR,
+};
+
+enum dma_state { DMA_IDLE = 0, DMA_READ, DMA_WRITE };
+
+struct ucode {
+    uint16_t * mem;
+    uint16_t resetvec;
+
+    // Control
+    uint8_t upc;
+    uint8_t last_upc;
+    uint64_t cycles;
+    uint64_t instrs;
+
+    // DataPath
+    uint16_t r[8];
+    uint16_t pc;
+    uint16_t ir;
+    bool priv;
+    uint8_t prio;
+    uint8_t cc;         // N, Z, P
+    uint16_t saved_ssp;
+    uint16_t saved_usp;
+    bool ben;
+    bool acv;
+
+    // IntCtrl
+    uint8_t table;
+    uint8_t vec;
+
+    // MulDiv
+    struct {
+        uint16_t result;
+        bool ready;
+        uint8_t count;
+        uint32_t rem;   // 17 bits
+        uint16_t quo;
+        uint16_t dvsr;
+        bool is_div;
+        bool neg_q;
+        bool neg_r;
+        bool mul_busy;
+        uint16_t mcand;
+        uint16_t mplier;
+    } md;
+
+    // MemCtrl and AddrCtrl
+    uint16_t mar;
+    uint16_t mdr;
+    uint8_t mar_dev;
+    uint8_t lock_idx;
+    uint16_t dsr;
+    uint16_t ddr;
+    bool tx_ie;
+    bool tx_valid;      // RegNext(ldDDR)
+    uint16_t kbsr;      // ready, int_en, level
+    uint16_t kbcr;
+    uint16_t mcr;
+
+    // DMA
+    struct {
+        uint8_t state;
+        uint16_t src;
+        uint16_t dst;
+        uint16_t len;
+        uint16_t buf;
+        bool done;
+        bool ie;
+        bool fill;
+    } dma;
+
+    // BlockDev
+    struct {
+        uint16_t sec;
+        uint16_t addr;
+        uint16_t cnt;
+        bool busy;
+        bool done;
+        bool err;
+        bool ie;
+        bool write;
+    } blk;
+
+    // Spinlocks (nobody else to fight over them)
+    uint8_t locks;
+
+    // FifoTx: the queue, and Tx behind it
+    uint8_t txq[TX_DEPTH];
+    uint8_t txq_head;
+    uint8_t txq_count;
+    uint32_t tx_cnt;
+    uint8_t tx_bits;
+
+    // FifoRx
+    uint8_t rxq[RX_DEPTH];
+    uint8_t rxq_head;
+    uint8_t rxq_count;
+    uint16_t rx_tick;   // the bit time counter
+    uint8_t quiet;
+
+    // ICache
+    uint16_t ic_tag[IC_WAYS][IC_SETS];
+    uint16_t ic_data[IC_WAYS][IC_SETS];
+    bool ic_valid[IC_WAYS][IC_SETS];
+    uint8_t ic_lru[IC_SETS];
+    uint32_t ic_hits;
+    uint32_t ic_misses;
+
+    // ExternalRAM
+    uint8_t held;
+    uint16_t held_addr;
+    bool held_wen;
+    uint8_t wait_min;
+    uint8_t wait_max;
+#ifdef IIT3503_RAM_ARRAY
+    uint8_t need;
+    uint16_t lfsr;
+#else
+    uint32_t accesses;
+#endif
+
+    // harness inputs that hold their value between cycles
+    uint8_t intv;
+    uint8_t int_prio;
+
+    iit3503_uart_sink_t sink;
+    void * sink_arg;
+};
+
+
+static inline uint16_t
+sext (uint16_t x, int bits)
+{
+    uint16_t m = 1u << (bits - 1);
+    x &= (1u << bits) - 1;
+    return (x ^ m) - m;
+}
+
+
+static inline uint16_t
+md_abs (uint16_t x)
+{
+    return (x & 0x8000) ? (uint16_t)(0 - x) : x;
+}
+
+
+static inline uint16_t
+psr_of (const ucode_t * u)
+{
+    return (u->priv << 15) | (u->prio << 8) | u->cc;
+}
+
+
+static uint8_t
+decode_mar (uint16_t a)
+{
+    switch (a) {
+        case 0xFE00: return AT_KBSR;
+        case 0xFE02: return AT_KBDR;
+        case 0xFE08: return AT_KBCR;
+        case 0xFE04: return AT_DSR;
+        case 0xFE06: return AT_DDR;
+        case 0xFE10: return AT_DMASRC;
+        case 0xFE12: return AT_DMADST;
+        case 0xFE14: return AT_DMALEN;
+        case 0xFE16: return AT_DMACTL;
+        case 0xFE18: return AT_BLKSEC;
+        case 0xFE1A: return AT_BLKADR;
+        case 0xFE1C: return AT_BLKCNT;
+        case 0xFE1E: return AT_BLKCTL;
+        case 0xFE20: return AT_CPUID;
+        case 0xFFFE: return AT_MCR;
+    }
+    return (a >> 3) == (0xFE30 >> 3) ? AT_LOCK : AT_MEM;
+}
+
+
+#ifndef IIT3503_RAM_ARRAY
+// same pick as wait_states() in ram.cpp
+static inline unsigned
+wait_states (const ucode_t * u, uint16_t addr)
+{
+    unsigned span = u->wait_max - u->wait_min + 1;
+
+    if (span == 1) {
+        return u->wait_min;
+    }
+
+    uint32_t h = (u->accesses ^ ((uint32_t)addr << 16)) * 2654435761u;
+    return u->wait_min + (h >> 16) % span;
+}
+#endif
+
+
+void
+ucode_reset (ucode_t * u)
+{
+    u->upc      = UCODE_RESET_UPC;
+    u->last_upc = UCODE_RESET_UPC;
+
+    memset(u->r, 0, sizeof(u->r));
+    u->pc        = u->resetvec;
+    u->ir        = 0;
+    u->priv      = false;
+    u->prio      = 0;
+    u->cc        = 2; // Z
+    u->saved_ssp = 0;
+    u->saved_usp = 0xFDFF;
+    u->ben       = false;
+    u->acv       = false;
+    u->table     = 0;
+    u->vec       = 0;
+
+    memset(&u->md, 0, sizeof(u->md));
+    u->md.ready = true;
+
+    u->mar      = 0;
+    u->mdr      = 0;
+    u->mar_dev  = AT_MEM;
+    u->lock_idx = 0;
+    u->dsr      = 0;
+    u->ddr      = 0;
+    u->tx_ie    = false;
+    u->kbsr     = 0;
+    u->kbcr     = 1;
+    u->mcr      = 0x8000;
+
+    memset(&u->dma, 0, sizeof(u->dma));
+    memset(&u->blk, 0, sizeof(u->blk));
+    u->locks = 0;
+
+    u->txq_head  = 0;
+    u->txq_count = 0;
+    u->tx_cnt    = 0;
+    u->tx_bits   = 0;
+
+    u->rxq_head  = 0;
+    u->rxq_count = 0;
+    u->rx_tick   = 0;
+    u->quiet     = 0;
+
+    memset(u->ic_valid, 0, sizeof(u->ic_valid));
+    memset(u->ic_lru, 0, sizeof(u->ic_lru));
+    u->ic_hits   = 0;
+    u->ic_misses = 0;
+
+    // ExternalRAM has no reset, but the reset cycles leave
+    // nothing on its port (MAR is 0, and it's a read)
+    u->held      = 0;
+    u->held_addr = 0;
+    u->held_wen  = false;
+}
+
+
+ucode_t *
+ucode_create (uint16_t * mem, uint16_t entry)
+{
+#ifdef UCODE_UNFINISHED
+    // there's no microcode to run until ControlStore.scala is done
+    ERROR_PRINT("The microcode model needs a finished control store (ControlStore.scala rows %s are FILL ME IN)",
+                UCODE_UNFINISHED);
+    (void)mem;
+    (void)entry;
+    return NULL;
+#endif
+
+    ucode_t * u = (ucode_t*)calloc(1, sizeof(ucode_t));
+    if (!u) {
+        ERROR_PRINT("Could not allocate microcode model");
+        return NULL;
+    }
+
+    u->mem      = mem;
+    u->resetvec = entry;
+    u->intv     = 0x80;
+    u->int_prio = 4;
+#ifdef IIT3503_RAM_ARRAY
+    u->lfsr     = 0xACE1;
+#endif
+
+    ucode_reset(u);
+    return u;
+}
+
+
+void
+ucode_destroy (ucode_t * u)
+{
+    free(u);
+}
+
+
+void
+ucode_set_wait_states (ucode_t * u, uint8_t min, uint8_t max)
+{
+    u->wait_min = min;
+    u->wait_max = max < min ? min : max;
+}
+
+
+void
+ucode_set_uart_sink (ucode_t * u, iit3503_uart_sink_t sink, void * arg)
+{
+    u->sink     = sink;
+    u->sink_arg = arg;
+}
+
+
+void
+ucode_raise_irq (ucode_t * u, uint8_t vec, uint8_t prio, uint8_t data)
+{
+    u->intv     = vec;
+    u->int_prio = prio;
+
+    if (u->rxq_count < RX_DEPTH) {
+        u->rxq[(u->rxq_head + u->rxq_count) % RX_DEPTH] = data;
+        u->rxq_count++;
+        u->quiet = 0;
+    }
+}
+
+
+bool
+ucode_cycle (ucode_t * u, const ucode_inputs_t * in)
+{
+    static const ucode_row_t idle = {};
+    ucode_inputs_t none = {};
+
+    if (in) {
+        u->intv     = in->intv;
+        u->int_prio = in->int_prio;
+    } else {
+        in = &none;
+    }
+
+    bool halt = !(u->mcr & 0x8000);
+
+    // a halted machine drives no control lines, but the
+    // microsequencer still looks at the row
+    const ucode_row_t * f = &ucode_rom[u->upc];
+    const ucode_row_t * s = halt ? &idle : f;
+
+    /* ---- DataPath ---- */
+
+    uint16_t ir = u->ir;
+
+    uint8_t sr1_sel = s->SR1MUX == 1 ? BITS(ir, 8, 6) : s->SR1MUX == 2 ? 6 : BITS(ir, 11, 9);
+    uint16_t sr1 = u->r[sr1_sel];
+    uint16_t sr2 = u->r[BITS(ir, 2, 0)];
+
+    uint16_t addr1 = s->ADDR1MUX ? sr1 : u->pc;
+    uint16_t addr2;
+    switch (s->ADDR2MUX) {
+        case 0:  addr2 = 0; break;
+        case 1:  addr2 = sext(ir, 6); break;
+        case 2:  addr2 = sext(ir, 9); break;
+        default: addr2 = sext(ir, 11); break;
+    }
+    uint16_t addr_calc = addr1 + addr2;
+
+    uint16_t bus = 0;
+
+    if (s->GatePC) {
+        bus |= u->pc;
+    }
+    if (s->GateMDR) {
+        bus |= u->mdr;
+    }
+    if (s->GateALU || s->GateMD) {
+        if (s->GateMD) {
+            bus |= u->md.result;
+        } else {
+            uint16_t b = (ir & 0x20) ? sext(ir, 5) : sr2;
+            switch (s->ALUK) {
+                case 0:  bus |= (uint16_t)(sr1 + b); break;
+                case 1:  bus |= sr1 & b; break;
+                case 2:  bus |= (uint16_t)~sr1; break;
+                default: bus |= sr1; break;
+            }
+        }
+    }
+    if (s->GateMARMUX) {
+        bus |= s->MARMUX ? addr_calc : BITS(ir, 7, 0);
+    }
+    if (s->GateVector) {
+        bus |= (u->table << 8) | u->vec;
+    }
+    if (s->GatePCm1) {
+        bus |= (uint16_t)(u->pc - 1);
+    }
+    if (s->GatePSR) {
+        bus |= psr_of(u);
+    }
+    if (s->GateSP) {
+        switch (s->SPMUX) {
+            case 0:  bus |= (uint16_t)(sr1 + 1); break;
+            case 1:  bus |= (uint16_t)(sr1 - 1); break;
+            case 2:  bus |= u->saved_ssp; break;
+            default: bus |= u->saved_usp; break;
+        }
+    }
+
+    // IFETCH decodes the instruction on its way into IR
+    uint16_t ir_now = s->LDIR ? bus : ir;
+
+    bool acv_now = u->priv && (BITS(bus, 15, 9) == 0x7F || BITS(bus, 15, 12) < 3);
+
+    /* ---- MemCtrl / AddrCtrl ---- */
+
+    bool memen = false, ld_kbsr = false, ld_kbcr = false, ld_dsr = false;
+    bool ld_ddr = false, ld_mcr = false, ld_lock = false;
+    bool kbdr_read = false, lock_read = false;
+    bool ld_dma[4] = {false, false, false, false};
+    bool ld_blk[4] = {false, false, false, false};
+    uint8_t sel = AT_MEM; // the INMUX (don't care in the RTL when nothing's read)
+
+    if (s->MIOEN) {
+        bool rw = s->RW;
+        uint8_t d = u->mar_dev;
+
+        switch (d) {
+            case AT_KBSR:
+                if (rw) ld_kbsr = true; else sel = d;
+                break;
+            case AT_KBDR:
+                if (!rw) { sel = d; kbdr_read = true; }
+                break;
+            case AT_KBCR:
+                if (rw) ld_kbcr = true; else sel = d;
+                break;
+            case AT_DSR:
+                if (rw) ld_dsr = true; else sel = d;
+                break;
+            case AT_DDR:
+                if (rw) ld_ddr = true;
+                break;
+            case AT_DMASRC: case AT_DMADST: case AT_DMALEN: case AT_DMACTL:
+                if (rw) ld_dma[d - AT_DMASRC] = true; else sel = d;
+                break;
+            case AT_BLKSEC: case AT_BLKADR: case AT_BLKCNT: case AT_BLKCTL:
+                if (rw) ld_blk[d - AT_BLKSEC] = true; else sel = d;
+                break;
+            case AT_CPUID:
+                if (!rw) sel = d;
+                break;
+            case AT_LOCK:
+                if (rw) ld_lock = true; else { sel = d; lock_read = true; }
+                break;
+            case AT_MCR:
+                if (rw) ld_mcr = true; else sel = d;
+                break;
+            default:
+                memen = true;
+                break;
+        }
+    }
+
+    // the DMA engine gets the port whenever the CPU isn't using it
+    bool cpu_off  = !s->MIOEN || halt;
+    bool dma_req  = u->dma.state != DMA_IDLE;
+    bool dma_owns = dma_req && cpu_off;
+
+    bool en          = dma_owns || memen;
+    bool wen         = dma_owns ? u->dma.state == DMA_WRITE : s->RW;
+    uint16_t data_in = dma_owns ? u->dma.buf : u->mdr;
+    uint16_t addr    = dma_owns ? (u->dma.state == DMA_WRITE ? u->dma.dst : u->dma.src) : u->mar;
+
+    /* ---- ICache ---- */
+
+    unsigned idx = addr & (IC_SETS - 1);
+    uint16_t tag = addr >> IC_IDX_BITS;
+
+    bool fetch  = u->upc == UCODE_FETCH_READ_UPC && !halt;
+    bool lookup = en && fetch && !wen;
+    bool in0    = u->ic_valid[0][idx] && u->ic_tag[0][idx] == tag;
+    bool in1    = u->ic_valid[1][idx] && u->ic_tag[1][idx] == tag;
+    bool hit    = lookup && (in0 || in1);
+    bool mem_en = en && !hit;
+
+    /* ---- ExternalRAM ---- */
+
+    uint8_t waited = (addr == u->held_addr && wen == u->held_wen) ? u->held : 0;
+    uint16_t mem_data = mem_en ? u->mem[addr] : 0;
+#ifdef IIT3503_RAM_ARRAY
+    unsigned span   = (unsigned)u->wait_max - u->wait_min + 1;
+    uint8_t needs   = waited == 0 ? (uint8_t)(u->wait_min + u->lfsr % span) : u->need;
+    bool mem_r      = mem_en && waited >= needs;
+#else
+    bool mem_r      = mem_en && waited >= wait_states(u, addr);
+#endif
+
+    bool ic_r        = hit || mem_r;
+    uint16_t ic_data = hit ? u->ic_data[in1 ? 1 : 0][idx] : mem_data;
+    bool fill        = lookup && !(in0 || in1) && mem_r;
+
+    // device registers answer right away
+    bool r = memen ? ic_r : true;
+
+    uint16_t inmux;
+    switch (sel) {
+        case AT_DSR:    inmux = u->dsr; break;
+        case AT_KBSR:   inmux = u->kbsr; break;
+        case AT_KBDR:   inmux = u->rxq_count ? u->rxq[u->rxq_head] : 0; break;
+        case AT_MCR:    inmux = u->mcr; break;
+        case AT_DMASRC: inmux = u->dma.src; break;
+        case AT_DMADST: inmux = u->dma.dst; break;
+        case AT_DMALEN: inmux = u->dma.len; break;
+        case AT_DMACTL: inmux = (u->dma.done << 15) | (u->dma.ie << 14) | (u->dma.fill << 1) | (u->dma.state != DMA_IDLE); break;
+        case AT_KBCR:   inmux = u->kbcr; break;
+        case AT_CPUID:  inmux = 0; break;
+        case AT_LOCK:   inmux = (u->locks >> u->lock_idx) & 1; break;
+        case AT_BLKSEC: inmux = u->blk.sec; break;
+        case AT_BLKADR: inmux = u->blk.addr; break;
+        case AT_BLKCNT: inmux = u->blk.cnt; break;
+        case AT_BLKCTL: inmux = (u->blk.done << 15) | (u->blk.ie << 14) | (u->blk.err << 13) | (u->blk.write << 1) | u->blk.busy; break;
+        default:        inmux = ic_data; break;
+    }
+
+    /* ---- interrupts (IRQArbiter) ---- */
+
+    unsigned thresh = (u->kbcr & 0xFF) ? (u->kbcr & 0xFF) : 1;
+    unsigned tmo    = u->kbcr >> 8;
+    bool rx_due     = u->rxq_count >= thresh || (tmo && u->rxq_count && u->quiet >= tmo);
+
+    bool req[4]     = {
+        (bool)((u->kbsr >> 14) & 1) && rx_due,
+        u->dma.done && u->dma.ie,
+        u->tx_ie && u->txq_count <= TX_LOW_WATER,
+        u->blk.done && u->blk.ie,
+    };
+    uint8_t vecs[4]  = { u->intv, DMA_INT_VEC, TX_INT_VEC, BLK_INT_VEC };
+    uint8_t prios[4] = { u->int_prio, DMA_INT_PRIO, TX_INT_PRIO, BLK_INT_PRIO };
+
+    int win = 0;
+    for (int i = 1; i < 4; i++) {
+        if (req[i] && (!req[win] || prios[i] > prios[win])) {
+            win = i;
+        }
+    }
+    // INT: a request that beats the PSR's priority, as of
+    // this cycle. DataPath.scala registers this (aGbReg) and never
+    // clears it, so the RTL takes an interrupt a cycle late, and then
+    // again at any priority.
+    uint8_t irq_prio = req[win] ? prios[win] : 0;
+    bool irq         = req[win] && irq_prio > u->prio;
+
+    /* ---- MicroSequencer ---- */
+
+    uint8_t next;
+
+    if (f->IRD) {
+        next = ir_now >> 12;
+    } else {
+        uint8_t c  = f->COND;
+        bool book  = !(c & 8);
+        bool fetch_test = book && c == 7;
+
+        if (fetch_test && irq) {
+            next = UCODE_INT_UPC;
+        } else {
+            bool and1 = (book && c == 6 && u->acv) || (fetch_test && acv_now);
+            bool and2 = book && c == 5 && irq;
+            bool and3 = (book && c == 4 && u->priv) ||
+                        (c == 9 && BITS(ir_now, 4, 3) != 0);
+            bool and4 = book && c == 2 && u->ben;
+            bool and5 = book && c == 1 && r;
+            bool and6 = (book && c == 3 && (ir_now & 0x0800)) ||
+                        (c == 8 && u->md.ready);
+
+            next = ((and1 << 5) | (and2 << 4) | (and3 << 3) | (and4 << 2) | (and5 << 1) | and6) | f->J;
+        }
+    }
+
+    /* ---- clock edge ---- */
+
+    uint16_t mdr = u->mdr; // what device register writes see
+
+    if (s->LDREG) {
+        uint8_t dr = s->DRMUX == 1 ? 7 : s->DRMUX == 2 ? 6 : BITS(ir, 11, 9);
+        u->r[dr] = bus;
+    }
+
+    if (s->LDPC) {
+        switch (s->PCMUX) {
+            case 1:  u->pc = addr_calc; break;
+            case 2:  u->pc = bus; break;
+            default: u->pc++; break;
+        }
+    }
+
+    if (s->LDPriv) {
+        u->priv = s->PSRMUX ? s->SetPriv : bus >> 15;
+    }
+    if (s->LDPriority) {
+        u->prio = s->PSRMUX ? irq_prio : BITS(bus, 10, 8);
+    }
+
+    if (s->LDBEN) {
+        u->ben = ((ir_now >> 9) & u->cc & 7) != 0;
+    }
+
+    if (s->LDCC) {
+        if (s->PSRMUX) {
+            u->cc = (bus & 0x8000) ? 4 : bus ? 1 : 2;
+        } else {
+            u->cc = bus & 7;
+        }
+    }
+
+    if (s->LDSavedSSP) {
+        u->saved_ssp = sr1;
+    }
+    if (s->LDSavedUSP) {
+        u->saved_usp = sr1;
+    }
+
+    if (s->LDACV) {
+        u->acv = acv_now;
+    }
+
+    if (s->LDIR) {
+        u->ir = bus;
+    }
+
+    if (s->LDVector) {
+        if (s->TableMUX) {
+            u->vec   = bus & 0xFF;
+            u->table = 0;
+        } else {
+            static const uint8_t fixed[4] = { 0, 0x00, 0x01, 0x02 };
+            u->vec   = s->VectorMUX ? fixed[s->VectorMUX] : vecs[win];
+            u->table = 1;
+        }
+    }
+
+    // MulDiv
+    if (s->LDMD) {
+        uint8_t op  = BITS(ir, 4, 3);
+        uint16_t a  = sr1;
+        uint16_t b  = (ir & 0x20) ? BITS(ir, 2, 0) : sr2;
+
+        if (op == 1) {
+            u->md.result   = 0;
+            u->md.mcand    = a;
+            u->md.mplier   = b;
+            u->md.mul_busy = b != 0;
+            u->md.ready    = b == 0;
+            u->md.count    = 0;
+        } else if (b == 0) {
+            u->md.result   = op == 2 ? 0xFFFF : a;
+            u->md.ready    = true;
+            u->md.mul_busy = false;
+            u->md.count    = 0;
+        } else {
+            u->md.is_div   = op == 2;
+            u->md.neg_q    = ((a ^ b) >> 15) & 1;
+            u->md.neg_r    = a >> 15;
+            u->md.quo      = md_abs(a);
+            u->md.dvsr     = md_abs(b);
+            u->md.rem      = 0;
+            u->md.count    = 16;
+            u->md.ready    = false;
+            u->md.mul_busy = false;
+        }
+    } else if (u->md.mul_busy) {
+        uint16_t p0   = (u->md.mplier & 1) ? u->md.mcand : 0;
+        uint16_t p1   = (u->md.mplier & 2) ? (uint16_t)(u->md.mcand << 1) : 0;
+        uint16_t rest = u->md.mplier >> 2;
+
+        u->md.result = u->md.result + p0 + p1;
+        u->md.mcand  = u->md.mcand << 2;
+        u->md.mplier = rest;
+
+        if (!rest) {
+            u->md.mul_busy = false;
+            u->md.ready    = true;
+        }
+    } else if (u->md.count) {
+        uint32_t trial = ((u->md.rem & 0xFFFF) << 1) | (u->md.quo >> 15);
+        bool fits      = trial >= u->md.dvsr;
+        uint32_t nrem  = (fits ? trial - u->md.dvsr : trial) & 0x1FFFF;
+        uint16_t nquo  = (u->md.quo << 1) | fits;
+
+        u->md.rem = nrem;
+        u->md.quo = nquo;
+
+        if (u->md.count-- == 1) {
+            uint16_t q = u->md.neg_q ? (uint16_t)(0 - nquo) : nquo;
+            uint16_t m = u->md.neg_r ? (uint16_t)(0 - nrem) : (uint16_t)nrem;
+            u->md.result = u->md.is_div ? q : m;
+            u->md.ready  = true;
+        }
+    }
+
+    // MemCtrl
+    if (s->LDMAR) {
+        u->mar      = bus;
+        u->mar_dev  = decode_mar(bus);
+        u->lock_idx = bus & 7;
+    }
+
+    if (s->LDMDR) {
+        u->mdr = s->MIOEN ? inmux : bus;
+    }
+
+    if (lock_read && s->LDMDR) {
+        u->locks |= 1 << u->lock_idx;
+    }
+    if (ld_lock) {
+        u->locks &= ~(1 << u->lock_idx);
+    }
+
+    bool kb_ie = ld_kbsr ? (mdr >> 14) & 1 : (u->kbsr >> 14) & 1;
+    u->kbsr = ((u->rxq_count != 0) << 15) | (kb_ie << 14) | u->rxq_count;
+
+    if (ld_kbcr) {
+        u->kbcr = mdr;
+    }
+
+    bool tx_ready = u->txq_count < TX_DEPTH;
+    bool tx_idle  = u->txq_count == 0 && u->tx_bits == 0;
+    u->dsr = (tx_ready << 15) | (u->tx_ie << 14) | (tx_idle << 13);
+
+    if (ld_dsr) {
+        u->tx_ie = (mdr >> 14) & 1;
+    }
+
+    if (ld_mcr) {
+        u->mcr = mdr;
+    }
+
+    // FifoTx. The FIFO takes DDR the cycle after it's written;
+    // Tx takes the head whenever it's between frames on a bit
+    // boundary.
+    bool enq = u->tx_valid && u->txq_count < TX_DEPTH;
+    uint8_t enq_byte = u->ddr & 0xFF;
+
+    if (u->tx_cnt == 0) {
+        u->tx_cnt = UART_BIT_CYCLES - 1;
+        if (u->tx_bits) {
+            u->tx_bits--;
+        } else if (u->txq_count) {
+            uint8_t c = u->txq[u->txq_head];
+            u->txq_head = (u->txq_head + 1) % TX_DEPTH;
+            u->txq_count--;
+            u->tx_bits = 11; // start, 8 data, 2 stop
+            if (u->sink) {
+                u->sink(u->sink_arg, c);
+            }
+        }
+    } else {
+        u->tx_cnt--;
+    }
+
+    if (enq) {
+        u->txq[(u->txq_head + u->txq_count) % TX_DEPTH] = enq_byte;
+        u->txq_count++;
+    }
+
+    u->tx_valid = ld_ddr;
+    if (ld_ddr) {
+        u->ddr = mdr;
+    }
+
+    // FifoRx: injected bytes only (the serial line stays idle)
+    bool rx_was_empty = u->rxq_count == 0;
+    bool rx_enq       = in->dev_ready && u->rxq_count < RX_DEPTH;
+    bool tick         = u->rx_tick == UART_BIT_CYCLES - 1;
+
+    if (kbdr_read && s->LDMDR && u->rxq_count) {
+        u->rxq_head = (u->rxq_head + 1) % RX_DEPTH;
+        u->rxq_count--;
+    }
+    if (rx_enq) {
+        u->rxq[(u->rxq_head + u->rxq_count) % RX_DEPTH] = in->dev_data;
+        u->rxq_count++;
+    }
+
+    if (rx_enq || rx_was_empty) {
+        u->quiet = 0;
+    } else if (tick && u->quiet != 255) {
+        u->quiet++;
+    }
+    u->rx_tick = tick ? 0 : u->rx_tick + 1;
+
+    // DMA
+    bool dma_busy = u->dma.state != DMA_IDLE;
+
+    if (!dma_busy) {
+        if (ld_dma[0]) u->dma.src = mdr;
+        if (ld_dma[1]) u->dma.dst = mdr;
+        if (ld_dma[2]) u->dma.len = mdr;
+    }
+
+    if (ld_dma[3]) {
+        u->dma.ie   = (mdr >> 14) & 1;
+        u->dma.done = false;
+        if (!dma_busy && (mdr & 1)) {
+            u->dma.fill = (mdr >> 1) & 1;
+            u->dma.buf  = u->dma.src;
+            if (u->dma.len == 0) {
+                u->dma.done = true;
+            } else {
+                u->dma.state = u->dma.fill ? DMA_WRITE : DMA_READ;
+            }
+        }
+    }
+
+    if (dma_busy && cpu_off && ic_r) {
+        if (u->dma.state == DMA_READ) {
+            u->dma.buf   = ic_data;
+            u->dma.state = DMA_WRITE;
+        } else {
+            bool last = u->dma.len == 1;
+            u->dma.dst++;
+            u->dma.len--;
+            if (!u->dma.fill) {
+                u->dma.src++;
+            }
+            if (last) {
+                u->dma.state = DMA_IDLE;
+                u->dma.done  = true;
+            } else {
+                u->dma.state = u->dma.fill ? DMA_WRITE : DMA_READ;
+            }
+        }
+    }
+
+    // BlockDev
+    bool blk_busy = u->blk.busy;
+
+    if (!blk_busy) {
+        if (ld_blk[0]) u->blk.sec  = mdr;
+        if (ld_blk[1]) u->blk.addr = mdr;
+        if (ld_blk[2]) u->blk.cnt  = mdr;
+    }
+
+    if (ld_blk[3]) {
+        u->blk.ie   = (mdr >> 14) & 1;
+        u->blk.done = false;
+        u->blk.err  = false;
+        if (!blk_busy && (mdr & 1)) {
+            u->blk.write = (mdr >> 1) & 1;
+            if (u->blk.cnt == 0) {
+                u->blk.done = true;
+            } else {
+                u->blk.busy = true;
+            }
+        }
+    }
+
+    if (blk_busy && in->blk_done) {
+        u->blk.busy = false;
+        u->blk.done = true;
+        u->blk.err  = in->blk_error;
+    }
+
+    // ICache
+    if (hit) {
+        u->ic_hits++;
+        u->ic_lru[idx] = in1 ? 0 : 1;
+    }
+
+    if (fill) {
+        int w = u->ic_lru[idx];
+        u->ic_tag[w][idx]   = tag;
+        u->ic_data[w][idx]  = mem_data;
+        u->ic_valid[w][idx] = true;
+        u->ic_lru[idx]      = !w;
+        u->ic_misses++;
+    }
+
+    // writes that land in RAM knock out whatever the I-cache has there
+    if (mem_en && wen && mem_r) {
+        for (int w = 0; w < IC_WAYS; w++) {
+            if (u->ic_tag[w][idx] == tag) {
+                u->ic_valid[w][idx] = false;
+            }
+        }
+    }
+
+    if (in->ic_flush) {
+        memset(u->ic_valid, 0, sizeof(u->ic_valid));
+    }
+
+    // ExternalRAM
+    u->held_addr = addr;
+    u->held_wen  = wen;
+#ifdef IIT3503_RAM_ARRAY
+    u->need      = needs;
+#endif
+    if (mem_en && mem_r) {
+        if (wen) {
+            u->mem[addr] = data_in;
+        }
+#ifdef IIT3503_RAM_ARRAY
+        u->lfsr = (u->lfsr << 1) | (((u->lfsr >> 15) ^ (u->lfsr >> 13) ^ (u->lfsr >> 12) ^ (u->lfsr >> 10)) & 1);
+#else
+        u->accesses++;
+#endif
+        u->held = 0;
+    } else if (mem_en) {
+        u->held = waited + 1;
+    } else {
+        u->held = 0;
+    }
+
+    // Control
+    if (!halt) {
+        u->upc = next;
+    }
+
+    u->cycles++;
+
+    if (u->upc == UCODE_RESET_UPC && u->last_upc != UCODE_RESET_UPC) {
+        u->instrs++;
+    }
+    u->last_upc = u->upc;
+
+    return !(u->mcr & 0x8000);
+}
+
+
+bool
+ucode_run (ucode_t * u, uint64_t max_cycles)
+{
+    for (uint64_t i = 0; i < max_cycles; i++) {
+        if (ucode_cycle(u, NULL)) {
+            return true;
+        }
+    }
+    return !(u->mcr & 0x8000);
+}
+
+
+void
+ucode_read_regs (ucode_t * u, iit3503_regs_t * regs)
+{
+    memcpy(regs->r, u->r, sizeof(regs->r));
+    regs->pc     = u->pc;
+    regs->ir     = u->ir;
+    regs->psr    = psr_of(u);
+    regs->upc    = u->upc;
+    regs->mar    = u->mar;
+    regs->mdr    = u->mdr;
+    regs->mcr    = u->mcr;
+    regs->cycles = u->cycles;
+    regs->instrs = u->instrs;
+    regs->icache_hits   = u->ic_hits;
+    regs->icache_misses = u->ic_misses;
+}
+
+
+void
+ucode_read_devregs (ucode_t * u, uint16_t * ddr, uint16_t * dsr)
+{
+    *ddr = u->ddr;
+    *dsr = u->dsr;
+}
+
+
+bool
+ucode_blk_pending (ucode_t * u, ucode_blk_req_t * req)
+{
+    if (!u->blk.busy) {
+        return false;
+    }
+
+    req->write = u->blk.write;
+    req->sec   = u->blk.sec;
+    req->addr  = u->blk.addr;
+    req->cnt   = u->blk.cnt;
+    return true;
+}
+
+
+void
+ucode_write_mem (ucode_t * u, uint16_t addr, const uint16_t * buf, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        u->mem[(uint16_t)(addr + i)] = buf[i];
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef __UCODE_H__
+#define __UCODE_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "libiit3503.h"
+
+/*
+ * C++ model of one iit3503 core (and the devices core 0 owns), at
+ * the level of the microcode.
+ *
+ * Every cycle it does what the RTL is meant to: look up the control
+ * store row for uPC, drive the bus and the datapath's muxes from it,
+ * load whatever registers the row says, and pick the next uPC the way
+ * MicroSequencer.scala does. The control store itself isn't written
+ * down here: tools/ucodegen.py generates it (ucode_rom.h) from
+ * ControlStore.scala at build time, so this runs the microcode the
+ * RTL does. The datapath, memory controller, I-cache, interrupt
+ * controller, multiply/divide unit, DMA engine, block device
+ * registers, serial FIFOs and RAM wait states are modeled register
+ * for register, after the Chisel.
+ *
+ * While any control store row is still FILL ME IN there's no machine
+ * to model: ucode_create() says which rows and returns NULL.
+ *
+ * Where the RTL is known to differ:
+ *
+ *   - INT is a request beating the PSR's priority in that same cycle.
+ *     DataPath.scala registers it (aGbReg) and never clears it.
+ *
+ * make check-ucode runs it against the ISA reference model
+ * (src/cpp/isa.cpp) on the fuzzer's random programs, which checks
+ * what it retires but not when. Only running it in lockstep with a
+ * Verilated Top (sim --lockstep) checks its timing, and that needs
+ * the RTL finished too.
+ *
+ * What it leaves out: other cores (this is a CORES=1 machine), and
+ * the serial receive line. Keyboard input goes straight into the RX
+ * FIFO, like iit3503_raise_irq() does.
+ */
+
+typedef struct ucode ucode_t;
+
+// what the harness drives into Top in a cycle (see iit3503.cpp)
+typedef struct ucode_inputs {
+    bool dev_ready;     // push dev_data into the keyboard FIFO
+    uint8_t dev_data;
+    uint8_t intv;       // keyboard interrupt vector
+    uint8_t int_prio;   // ... and priority
+    bool ic_flush;
+    bool blk_done;      // the disk finished the block device's command
+    bool blk_error;     // ... and it failed
+} ucode_inputs_t;
+
+// the block device's command, while it has one (see BlockDev.scala)
+typedef struct ucode_blk_req {
+    bool write;
+    uint16_t sec;
+    uint16_t addr;
+    uint16_t cnt;
+} ucode_blk_req_t;
+
+// mem is 64K words, and is where the model's RAM lives (it's written
+// to). The core comes out of reset at entry.
+ucode_t * ucode_create (uint16_t * mem, uint16_t entry);
+void ucode_destroy (ucode_t * u);
+void ucode_reset (ucode_t * u);
+
+void ucode_set_wait_states (ucode_t * u, uint8_t min, uint8_t max);
+
+// called with every byte the guest sends out on its serial line
+void ucode_set_uart_sink (ucode_t * u, iit3503_uart_sink_t sink, void * arg);
+
+/*
+ * A keystroke between cycles: data goes into the keyboard FIFO (if
+ * there's room), and the keyboard interrupts at vec/prio from now on.
+ * The same keystroke as an input (dev_ready) only lands at the end
+ * of the cycle it's given to.
+ */
+void ucode_raise_irq (ucode_t * u, uint8_t vec, uint8_t prio, uint8_t data);
+
+/*
+ * One clock cycle, with the given inputs (NULL: the idle ones, with
+ * whatever interrupt vector and priority were last given). Returns
+ * true if the machine is halted afterwards.
+ */
+bool ucode_cycle (ucode_t * u, const ucode_inputs_t * in);
+
+// runs until the machine halts (returns true) or max_cycles go by
+bool ucode_run (ucode_t * u, uint64_t max_cycles);
+
+// the same registers the RTL shows on its debug ports
+void ucode_read_regs (ucode_t * u, iit3503_regs_t * regs);
+
+// DDR and DSR, as the debug ports have them
+void ucode_read_devregs (ucode_t * u, uint16_t * ddr, uint16_t * dsr);
+
+// the command the block device is waiting on, if any
+bool ucode_blk_pending (ucode_t * u, ucode_blk_req_t * req);
+
+// for anyone writing guest memory behind the model's back. Like the
+// RTL's, the I-cache can't see this: give the next cycle ic_flush.
+void ucode_write_mem (ucode_t * u, uint16_t addr, const uint16_t * buf, size_t count);
+
+#endif
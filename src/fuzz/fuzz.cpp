@@ -0,0 +1,982 @@
+/*
+ * Differential fuzzer for the iit3503.
+ *
+ * Generates random (but well-formed) instruction streams, runs each one
+ * on the Verilated machine (via libiit3503) and on the ISA reference
+ * model in src/cpp/isa.cpp, and compares the architectural state
+ * (R0-R7, PC, PSR) every time the FSM comes back around to IFETCH. At
+ * the end of a case the whole of memory is compared too.
+ *
+ * Every case is a complete memory image:
+ *
+ *   x0000-x00FF  trap vector table (all entries -> TRAP handler)
+ *   x0100-x01FF  int/exception table
+ *   x02CA        boot code: loads random register values, enables
+ *                keyboard interrupts and RTIs to x3000 (in user mode
+ *                most of the time)
+ *   x0400-...    service routines. Exception handlers skip over the
+ *                faulting instruction (ACV restarts the program)
+ *   x3000-...    random code, followed by a pool of random data
+ *
+ * Boot code lives at x02CA so that a reproducer can be assembled and
+ * loaded into the simulator as if it were the OS (sim -o repro.asm).
+ *
+ * Workers (one per host core by default) pull seeds from a shared
+ * counter. A worker that hits a divergence shrinks the case itself
+ * (NOPing out words and dropping interrupts while it still diverges)
+ * and writes an .asm reproducer.
+ *
+ * Built with FUZZ_UCODE (make check-ucode), the machine under test is
+ * the microcode model (src/cpp/ucode.cpp) instead of the library, so
+ * the model can be checked against the reference without Verilator.
+ * The keyboard's timeout (KBCR[15:8]) takes real time there and none
+ * in the reference, so a case that sets one (say, by pushing a frame
+ * onto KBCR) can diverge; make check-ucode sticks to a seed that
+ * doesn't.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libiit3503.h"
+#include "isa.h"
+#ifdef FUZZ_UCODE
+#include "ucode.h"
+#endif
+
+#define VERSION_STRING "0.0.1"
+
+#define BOOT_ADDR   0x02CA
+#define TRAP_HND    0x0400
+#define SKIP_HND    0x0410
+#define ACV_HND     0x0420
+#define INT_HND     0x0430
+#define USER_BASE   0x3000
+#define KBD_VEC     0x80
+
+#define RTI_WORD    0x8000
+#define NOP_WORD    0x0000
+
+// how many retires we remember for the divergence report
+#define HIST_LEN    16
+
+typedef struct irq_event {
+    uint32_t at;      // raise after this many retires
+    uint8_t vec;
+    uint8_t prio;
+    uint16_t data;
+} irq_event_t;
+
+typedef struct fuzz_case {
+    uint64_t seed;
+    bool user;                  // run the random code in user mode
+    uint16_t init_regs[8];
+    std::vector<uint16_t> code; // code + data, loaded at USER_BASE
+    size_t ncode;               // how much of it is code
+    std::vector<irq_event_t> irqs;
+    uint8_t ram_wait;           // RAM accesses take 0..ram_wait extra cycles
+} fuzz_case_t;
+
+typedef struct divergence {
+    uint32_t retire;
+    std::string what;
+    iit3503_regs_t rtl;
+    isa_state_t ref;
+    uint16_t hist_pc[HIST_LEN];
+    uint16_t hist_ir[HIST_LEN];
+    isa_event_t hist_ev[HIST_LEN];
+    uint32_t nhist;
+} divergence_t;
+
+static struct {
+    unsigned jobs;
+    uint64_t seed;
+    uint64_t cases;      // 0 = forever
+    unsigned length;     // instructions per case
+    unsigned max_fail;
+    const char * outdir;
+    bool quiet;
+} opts = {
+    .jobs     = 0,
+    .seed     = 0,
+    .cases    = 10000,
+    .length   = 64,
+    .max_fail = 1,
+    .outdir   = ".",
+    .quiet    = false,
+};
+
+static std::atomic<uint64_t> next_case;
+static std::atomic<uint64_t> done_cases;
+static std::atomic<uint64_t> total_retires;
+static std::atomic<unsigned> failures;
+static std::mutex report_lock;
+
+
+/* !========== tiny encoder ==========! */
+
+static inline uint16_t
+off (int v, int bits)
+{
+    return (uint16_t)v & ((1u << bits) - 1);
+}
+
+static inline uint16_t op_ld (int dr, int o)   { return 0x2000 | dr << 9 | off(o, 9); }
+static inline uint16_t op_ldi (int dr, int o)  { return 0xA000 | dr << 9 | off(o, 9); }
+static inline uint16_t op_sti (int sr, int o)  { return 0xB000 | sr << 9 | off(o, 9); }
+static inline uint16_t op_ldr (int dr, int b, int o) { return 0x6000 | dr << 9 | b << 6 | off(o, 6); }
+static inline uint16_t op_str (int sr, int b, int o) { return 0x7000 | sr << 9 | b << 6 | off(o, 6); }
+static inline uint16_t op_addi (int dr, int sr, int i) { return 0x1020 | dr << 9 | sr << 6 | off(i, 5); }
+static inline uint16_t op_andi (int dr, int sr, int i) { return 0x5020 | dr << 9 | sr << 6 | off(i, 5); }
+
+
+/* !========== generation ==========! */
+
+typedef std::mt19937_64 rng_t;
+
+static inline unsigned
+pick (rng_t & rng, unsigned n)
+{
+    return std::uniform_int_distribution<unsigned>(0, n - 1)(rng);
+}
+
+static inline int
+pick_range (rng_t & rng, int lo, int hi)
+{
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+}
+
+
+/*
+ * PC-relative offset for the instruction at index i that (usually) lands
+ * somewhere inside the case's own code/data.
+ */
+static int
+local_off (rng_t & rng, size_t i, size_t total, int bits)
+{
+    int lo = -(1 << (bits - 1));
+    int hi = (1 << (bits - 1)) - 1;
+
+    if (pick(rng, 8) == 0) {
+        return pick_range(rng, lo, hi);
+    }
+
+    int o = pick_range(rng, -(int)i - 1, (int)total - (int)i - 2);
+    return o < lo ? lo : (o > hi ? hi : o);
+}
+
+
+static uint16_t
+gen_instr (rng_t & rng, size_t i, size_t total)
+{
+    int dr  = pick(rng, 8);
+    int sr1 = pick(rng, 8);
+    int sr2 = pick(rng, 8);
+
+    // roughly the dynamic mix of the asm/ programs, plus the odd stuff
+    switch (pick(rng, 24)) {
+        case 0: case 1: case 2:
+            return pick(rng, 2) ? (op_addi(dr, sr1, pick_range(rng, -16, 15)))
+                                : (0x1000 | dr << 9 | sr1 << 6 | sr2);
+        case 3: case 4:
+            return pick(rng, 2) ? (op_andi(dr, sr1, pick_range(rng, -16, 15)))
+                                : (0x5000 | dr << 9 | sr1 << 6 | sr2);
+        case 5:
+            return 0x903F | dr << 9 | sr1 << 6;
+        case 6: case 7: case 8:
+            return (pick(rng, 8) << 9) | off(pick(rng, 4) ? pick_range(rng, -8, 8)
+                                                          : local_off(rng, i, total, 9), 9);
+        case 9: case 10:
+            return op_ld(dr, local_off(rng, i, total, 9));
+        case 11:
+            return op_ldi(dr, local_off(rng, i, total, 9));
+        case 12: case 13:
+            return op_ldr(dr, sr1, pick_range(rng, -32, 31));
+        case 14:
+            return 0xE000 | dr << 9 | off(local_off(rng, i, total, 9), 9);
+        case 15: case 16:
+            return 0x3000 | dr << 9 | off(local_off(rng, i, total, 9), 9);
+        case 17:
+            return op_sti(dr, local_off(rng, i, total, 9));
+        case 18:
+            return op_str(dr, sr1, pick_range(rng, -32, 31));
+        case 19:
+            return pick(rng, 2) ? (0x4800 | off(local_off(rng, i, total, 11), 11))
+                                : (0x4000 | sr1 << 6);
+        case 20:
+            return 0xC000 | (pick(rng, 2) ? 7 : sr1) << 6;
+        case 21:
+            return pick(rng, 2) ? RTI_WORD : (0x8000 | pick(rng, 0x1000));
+        case 22:
+            return 0xF000 | pick(rng, 256);
+        default:
+            return pick(rng, 2) ? (0xD000 | pick(rng, 0x1000)) : (uint16_t)pick(rng, 0x10000);
+    }
+}
+
+
+static void
+gen_case (fuzz_case_t * fc, uint64_t seed, unsigned length)
+{
+    rng_t rng(seed);
+    size_t ndata = 16 + pick(rng, 32);
+    size_t total = length + ndata;
+
+    fc->seed  = seed;
+    fc->user  = pick(rng, 8) != 0;
+    fc->ncode = length;
+    fc->code.resize(total);
+    fc->irqs.clear();
+
+    for (int r = 0; r < 8; r++) {
+        fc->init_regs[r] = pick(rng, 2) ? USER_BASE + pick(rng, total) : pick(rng, 0x10000);
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        fc->code[i] = gen_instr(rng, i, total);
+    }
+
+    // data pool: mostly pointers back into the case (for LDI/STI), some junk
+    for (size_t i = length; i < total; i++) {
+        switch (pick(rng, 4)) {
+            case 0:  fc->code[i] = pick(rng, 0x10000); break;
+            case 1:  fc->code[i] = 0xFE00 | (pick(rng, 4) << 1); break;
+            default: fc->code[i] = USER_BASE + pick(rng, total); break;
+        }
+    }
+
+    // at most one per boundary: the harness only has one devReady
+    // strobe per cycle, so a second keystroke would be lost
+    unsigned nirq = pick(rng, 4);
+    for (unsigned n = 0; n < nirq; n++) {
+        irq_event_t e;
+        e.at   = pick(rng, length * 4);
+        e.vec  = pick(rng, 16) ? KBD_VEC : pick(rng, 256);
+        e.prio = pick(rng, 8);
+        e.data = pick(rng, 0x10000);
+
+        bool taken = false;
+        for (const irq_event_t & o : fc->irqs) {
+            taken |= o.at == e.at;
+        }
+        if (!taken) {
+            fc->irqs.push_back(e);
+        }
+    }
+
+    // the RTL has to get the same answers whatever the memory latency
+    fc->ram_wait = pick(rng, 4);
+}
+
+
+/*
+ * Lay the case out in a full 64K image (see the top of this file)
+ */
+static void
+build_image (const fuzz_case_t * fc, std::vector<uint16_t> & mem)
+{
+    mem.assign(0x10000, 0);
+
+    for (int v = 0; v < 0x100; v++) {
+        mem[0x0000 + v] = TRAP_HND;
+        mem[0x0100 + v] = SKIP_HND;
+    }
+    mem[0x0100 | ISA_VEC_ACV] = ACV_HND;
+    mem[0x0100 | KBD_VEC]     = INT_HND;
+
+    // TRAP: count it in R5 and go back
+    uint16_t trap[] = { op_addi(5, 5, 1), RTI_WORD };
+
+    // PRIV/ILL (and stray vectors): step over the offending instruction
+    uint16_t skip[] = { op_ldr(0, 6, 0), op_addi(0, 0, 1), op_str(0, 6, 0), RTI_WORD };
+
+    // ACV: restart the program (stepping over a bad fetch could take 12K exceptions)
+    uint16_t acv[] = { op_ld(0, 2), op_str(0, 6, 0), RTI_WORD, USER_BASE };
+
+    // keyboard: count it in R4, read KBDR into R3
+    uint16_t kbd[] = { op_addi(4, 4, 1), op_ldi(3, 1), RTI_WORD, ISA_KBDR };
+
+    memcpy(&mem[TRAP_HND], trap, sizeof(trap));
+    memcpy(&mem[SKIP_HND], skip, sizeof(skip));
+    memcpy(&mem[ACV_HND],  acv,  sizeof(acv));
+    memcpy(&mem[INT_HND],  kbd,  sizeof(kbd));
+
+    /*
+     * boot code. Data words follow the code; D(d) is the PC offset from
+     * instruction i to data word d. R6 is left alone: it ends up as the
+     * user stack pointer (SavedUSP) or the supervisor stack.
+     */
+    enum { NCODE = 17 };
+    enum { D_REGS = 0, D_SSP = 8, D_PSR, D_PC, D_IE, D_KBSR };
+    uint16_t * b = &mem[BOOT_ADDR];
+    int i = 0;
+#define D(d) (NCODE + (d) - (i + 1))
+    b[i] = op_ld(6, D(D_SSP));   i++;
+    b[i] = op_ld(0, D(D_PSR));   i++;
+    b[i] = op_addi(6, 6, -1);    i++;
+    b[i] = op_str(0, 6, 0);      i++;
+    b[i] = op_ld(0, D(D_PC));    i++;
+    b[i] = op_addi(6, 6, -1);    i++;
+    b[i] = op_str(0, 6, 0);      i++;
+    b[i] = op_ld(0, D(D_IE));    i++;
+    b[i] = op_sti(0, D(D_KBSR)); i++;
+    for (int r = 0; r < 8; r++) {
+        if (r != 6) {
+            b[i] = op_ld(r, D(D_REGS + r)); i++;
+        }
+    }
+    b[i] = RTI_WORD;             i++;
+#undef D
+
+    for (int r = 0; r < 8; r++) {
+        b[NCODE + D_REGS + r] = fc->init_regs[r];
+    }
+    b[NCODE + D_SSP]  = USER_BASE;
+    b[NCODE + D_PSR]  = fc->user ? 0x8002 : 0x0002;
+    b[NCODE + D_PC]   = USER_BASE;
+    b[NCODE + D_IE]   = 0x4000;
+    b[NCODE + D_KBSR] = ISA_KBSR;
+
+    for (size_t k = 0; k < fc->code.size(); k++) {
+        mem[USER_BASE + k] = fc->code[k];
+    }
+}
+
+
+/* !========== the machine under test ==========! */
+
+#ifdef FUZZ_UCODE
+
+typedef struct machine {
+    ucode_t * u;
+    std::vector<uint16_t> mem;
+    ucode_inputs_t in;
+
+    // a keystroke for the end of the next step
+    bool key;
+    uint8_t key_vec;
+    uint8_t key_prio;
+    uint8_t key_data;
+} machine_t;
+
+
+static machine_t *
+machine_create (const std::vector<uint16_t> & img, uint16_t entry, uint8_t ram_wait)
+{
+    machine_t * m = new machine_t;
+
+    m->mem = img;
+    m->u   = ucode_create(m->mem.data(), entry);
+    if (!m->u) {
+        delete m;
+        return NULL;
+    }
+    ucode_set_wait_states(m->u, 0, ram_wait);
+
+    memset(&m->in, 0, sizeof(m->in));
+    m->in.intv     = KBD_VEC;
+    m->in.int_prio = 4;
+    m->key         = false;
+    return m;
+}
+
+
+static void
+machine_destroy (machine_t * m)
+{
+    ucode_destroy(m->u);
+    delete m;
+}
+
+
+/*
+ * The keystroke lands at the end of the step, where the reference
+ * gets it. The library's comes in at the start, so it's in the FIFO
+ * for the step's own loads from KBDR.
+ */
+static void
+machine_raise_irq (machine_t * m, uint8_t vec, uint8_t prio, uint16_t data)
+{
+    m->key      = true;
+    m->key_vec  = vec;
+    m->key_prio = prio;
+    m->key_data = data & 0xFF;
+}
+
+
+// runs to the next IFETCH, or until the machine halts
+static bool
+machine_step_instr (machine_t * m)
+{
+    iit3503_regs_t regs;
+    ucode_blk_req_t req;
+    bool halt;
+
+    ucode_read_regs(m->u, &regs);
+    uint64_t instrs = regs.instrs;
+
+    do {
+        // there's no disk: a block device command fails right away
+        // (the reference fails them without one too)
+        bool pending = ucode_blk_pending(m->u, &req);
+        m->in.blk_done  = pending;
+        m->in.blk_error = pending;
+
+        halt = ucode_cycle(m->u, &m->in);
+
+        ucode_read_regs(m->u, &regs);
+    } while (regs.instrs == instrs && !halt);
+
+    if (m->key) {
+        ucode_raise_irq(m->u, m->key_vec, m->key_prio, m->key_data);
+        m->in.intv     = m->key_vec;
+        m->in.int_prio = m->key_prio;
+        m->key         = false;
+    }
+
+    return halt;
+}
+
+
+static void
+machine_read_regs (machine_t * m, iit3503_regs_t * regs)
+{
+    ucode_read_regs(m->u, regs);
+}
+
+
+static void
+machine_read_mem (machine_t * m, std::vector<uint16_t> & mem)
+{
+    mem = m->mem;
+}
+
+#else
+
+typedef iit3503_t machine_t;
+
+
+static machine_t *
+machine_create (const std::vector<uint16_t> & img, uint16_t entry, uint8_t ram_wait)
+{
+    iit3503_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.entry        = entry;
+    cfg.ram_wait_max = ram_wait;
+
+    iit3503_t * m = iit3503_init(&cfg);
+    if (!m) {
+        return NULL;
+    }
+    iit3503_write_mem(m, 0, img.data(), img.size());
+    iit3503_reset(m);
+    return m;
+}
+
+
+static void
+machine_destroy (machine_t * m)
+{
+    machine_destroy(m);
+}
+
+
+static void
+machine_raise_irq (machine_t * m, uint8_t vec, uint8_t prio, uint16_t data)
+{
+    iit3503_raise_irq(m, vec, prio, data);
+}
+
+
+static bool
+machine_step_instr (machine_t * m)
+{
+    return iit3503_step_instr(m, false);
+}
+
+
+static void
+machine_read_regs (machine_t * m, iit3503_regs_t * regs)
+{
+    iit3503_read_regs(m, regs);
+}
+
+
+static void
+machine_read_mem (machine_t * m, std::vector<uint16_t> & mem)
+{
+    mem.resize(0x10000);
+    iit3503_read_mem(m, 0, mem.data(), mem.size());
+}
+
+#endif
+
+
+/* !========== execution ==========! */
+
+static inline unsigned
+budget (const fuzz_case_t * fc)
+{
+    return fc->ncode * 4 + 64;
+}
+
+
+static bool
+compare (const iit3503_regs_t * a, const isa_state_t * b, std::string & what)
+{
+    char buf[128];
+
+    for (int r = 0; r < 8; r++) {
+        if (a->r[r] != b->r[r]) {
+            snprintf(buf, sizeof(buf), "R%d: rtl=x%04X ref=x%04X", r, a->r[r], b->r[r]);
+            what = buf;
+            return false;
+        }
+    }
+
+    if (a->pc != b->pc) {
+        snprintf(buf, sizeof(buf), "PC: rtl=x%04X ref=x%04X", a->pc, b->pc);
+        what = buf;
+        return false;
+    }
+
+    if ((a->psr & ISA_PSR_MASK) != (b->psr & ISA_PSR_MASK)) {
+        snprintf(buf, sizeof(buf), "PSR: rtl=x%04X ref=x%04X", a->psr & ISA_PSR_MASK, b->psr);
+        what = buf;
+        return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Run one case in lockstep. Returns true (and fills in *div, if given)
+ * on a divergence.
+ */
+static bool
+run_case (const fuzz_case_t * fc, divergence_t * div)
+{
+    std::vector<uint16_t> img;
+    build_image(fc, img);
+
+    machine_t * m = machine_create(img, BOOT_ADDR, fc->ram_wait);
+    if (!m) {
+        fprintf(stderr, "fuzz: could not create machine\n");
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<uint16_t> refmem(img);
+    isa_state_t ref;
+    isa_init(&ref, refmem.data(), BOOT_ADDR);
+
+    uint16_t hist_pc[HIST_LEN];
+    uint16_t hist_ir[HIST_LEN];
+    isa_event_t hist_ev[HIST_LEN];
+
+    std::string what;
+    bool diverged = false;
+    iit3503_regs_t regs;
+    unsigned n;
+    unsigned limit = budget(fc);
+
+    for (n = 0; n < limit; n++) {
+        for (const irq_event_t & e : fc->irqs) {
+            if (e.at == n) {
+                machine_raise_irq(m, e.vec, e.prio, e.data);
+            }
+        }
+
+        hist_pc[n % HIST_LEN] = ref.pc;
+        hist_ir[n % HIST_LEN] = refmem[ref.pc];
+
+        bool rtl_halt = machine_step_instr(m);
+        isa_event_t ev = isa_step(&ref);
+        hist_ev[n % HIST_LEN] = ev;
+
+        // interrupts are sampled in IFETCH from registered state, so one
+        // raised at a boundary is only seen by the RTL at the next one
+        for (const irq_event_t & e : fc->irqs) {
+            if (e.at == n) {
+                isa_raise_irq(&ref, e.vec, e.prio, e.data);
+            }
+        }
+
+        machine_read_regs(m, &regs);
+
+        // a write that clears MCR[15] stops the RTL's clock there and
+        // then (even halfway through pushing a frame), while the
+        // reference only stops at its next step
+        bool ref_halt = ev == ISA_HALTED || !(ref.mcr & 0x8000);
+
+        if (rtl_halt != ref_halt) {
+            what = rtl_halt ? "RTL halted, reference did not" : "reference halted, RTL did not";
+            diverged = true;
+            break;
+        }
+
+        if (rtl_halt) {
+            break;
+        }
+
+        if (!compare(&regs, &ref, what)) {
+            diverged = true;
+            break;
+        }
+    }
+
+    if (!diverged) {
+        std::vector<uint16_t> rtlmem;
+        machine_read_mem(m, rtlmem);
+        for (size_t a = 0; a < rtlmem.size(); a++) {
+            if (rtlmem[a] != refmem[a]) {
+                char buf[128];
+                snprintf(buf, sizeof(buf), "mem[x%04zX]: rtl=x%04X ref=x%04X", a, rtlmem[a], refmem[a]);
+                what = buf;
+                diverged = true;
+                break;
+            }
+        }
+    }
+
+    total_retires += n;
+
+    if (diverged && div) {
+        div->retire = n;
+        div->what   = what;
+        div->rtl    = regs;
+        div->ref    = ref;
+        div->ref.mem = NULL;
+        div->nhist  = n + 1 < HIST_LEN ? n + 1 : HIST_LEN;
+        for (uint32_t k = 0; k < div->nhist; k++) {
+            uint32_t idx = (n + 1 - div->nhist + k) % HIST_LEN;
+            div->hist_pc[k] = hist_pc[idx];
+            div->hist_ir[k] = hist_ir[idx];
+            div->hist_ev[k] = hist_ev[idx];
+        }
+    }
+
+    machine_destroy(m);
+
+    return diverged;
+}
+
+
+/* !========== minimization ==========! */
+
+static void
+minimize (fuzz_case_t * fc)
+{
+    bool progress = true;
+
+    while (progress) {
+        progress = false;
+
+        for (size_t i = fc->irqs.size(); i-- > 0; ) {
+            fuzz_case_t t = *fc;
+            t.irqs.erase(t.irqs.begin() + i);
+            if (run_case(&t, NULL)) {
+                *fc = t;
+                progress = true;
+            }
+        }
+
+        for (size_t i = fc->code.size(); i-- > 0; ) {
+            if (fc->code[i] == NOP_WORD) {
+                continue;
+            }
+            uint16_t old = fc->code[i];
+            fc->code[i] = NOP_WORD;
+            if (run_case(fc, NULL)) {
+                progress = true;
+            } else {
+                fc->code[i] = old;
+            }
+        }
+
+        for (int r = 0; r < 8; r++) {
+            if (r == 6 || fc->init_regs[r] == 0) {
+                continue;
+            }
+            uint16_t old = fc->init_regs[r];
+            fc->init_regs[r] = 0;
+            if (run_case(fc, NULL)) {
+                progress = true;
+            } else {
+                fc->init_regs[r] = old;
+            }
+        }
+    }
+
+    // drop trailing NOPs past the last interesting word
+    while (fc->code.size() > 1 && fc->code.back() == NOP_WORD) {
+        fuzz_case_t t = *fc;
+        t.code.pop_back();
+        if (t.ncode > t.code.size()) {
+            t.ncode = t.code.size();
+        }
+        if (!run_case(&t, NULL)) {
+            break;
+        }
+        *fc = t;
+    }
+}
+
+
+/* !========== reporting ==========! */
+
+static const char *
+event_name (isa_event_t ev)
+{
+    switch (ev) {
+        case ISA_RETIRED:   return "";
+        case ISA_TRAP:      return " [trap]";
+        case ISA_INT:       return " [interrupt]";
+        case ISA_EXCP_PRIV: return " [privilege exception]";
+        case ISA_EXCP_ILL:  return " [illegal opcode]";
+        case ISA_EXCP_ACV:  return " [ACV]";
+        case ISA_HALTED:    return " [halted]";
+    }
+    return "";
+}
+
+
+static void
+emit_fill (FILE * f, uint16_t addr, uint16_t w)
+{
+    char dis[64];
+
+    // the vector tables aren't code
+    if (addr < BOOT_ADDR) {
+        fprintf(f, "\t.FILL x%04X\t; x%04X\n", w, addr);
+        return;
+    }
+
+    isa_disasm(w, dis, sizeof(dis));
+    fprintf(f, "\t.FILL x%04X\t; x%04X: %s\n", w, addr, dis);
+}
+
+
+static void
+write_repro (const fuzz_case_t * fc, const divergence_t * div)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/fuzz-%016llx.asm", opts.outdir, (unsigned long long)fc->seed);
+
+    FILE * f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "fuzz: could not write '%s'\n", path);
+        return;
+    }
+
+    std::vector<uint16_t> img;
+    build_image(fc, img);
+
+    fprintf(f, "; iit3503 differential fuzzer reproducer (fuzz v%s)\n", VERSION_STRING);
+    fprintf(f, "; seed: %llu (%s mode, %u RAM wait states max)\n",
+            (unsigned long long)fc->seed, fc->user ? "user" : "supervisor", fc->ram_wait);
+    fprintf(f, ";\n; divergence after %u retires: %s\n", div->retire, div->what.c_str());
+    fprintf(f, ";   rtl: PC=x%04X PSR=x%04X R0-R7=", div->rtl.pc, div->rtl.psr);
+    for (int r = 0; r < 8; r++) {
+        fprintf(f, "x%04X%s", div->rtl.r[r], r < 7 ? " " : "\n");
+    }
+    fprintf(f, ";   ref: PC=x%04X PSR=x%04X R0-R7=", div->ref.pc, div->ref.psr);
+    for (int r = 0; r < 8; r++) {
+        fprintf(f, "x%04X%s", div->ref.r[r], r < 7 ? " " : "\n");
+    }
+    fprintf(f, ";\n; last retires (reference model):\n");
+    for (uint32_t k = 0; k < div->nhist; k++) {
+        char dis[64];
+        isa_disasm(div->hist_ir[k], dis, sizeof(dis));
+        fprintf(f, ";   x%04X  %-24s%s\n", div->hist_pc[k], dis, event_name(div->hist_ev[k]));
+    }
+    fprintf(f, ";\n; to reproduce, load this as the OS:\n");
+    fprintf(f, ";   build/sim -w 0:%u -o fuzz-%016llx.asm\n",
+            fc->ram_wait, (unsigned long long)fc->seed);
+    if (!fc->irqs.empty()) {
+        fprintf(f, "; and raise these interrupts (counting retires with stepi):\n");
+        for (const irq_event_t & e : fc->irqs) {
+            fprintf(f, ";   after %u: irq %02x %d %04x\n", e.at + 1, e.vec, e.prio, e.data);
+        }
+    }
+    fprintf(f, "\n\t.ORIG x0000\n");
+
+    // everything up to the end of the case, zero runs folded into .BLKW
+    size_t end = USER_BASE + fc->code.size();
+    for (size_t a = 0; a < end; ) {
+        if (img[a] == 0) {
+            size_t z = a;
+            while (z < end && img[z] == 0) {
+                z++;
+            }
+            if (z - a > 1) {
+                fprintf(f, "\t.BLKW #%zu\t; x%04zX\n", z - a, a);
+                a = z;
+                continue;
+            }
+        }
+        emit_fill(f, a, img[a]);
+        a++;
+    }
+
+    fprintf(f, "\t.END\n");
+    fclose(f);
+
+    printf("fuzz: divergence (seed %llu): %s\n      reproducer written to %s\n",
+           (unsigned long long)fc->seed, div->what.c_str(), path);
+}
+
+
+/* !========== driver ==========! */
+
+static void
+worker (void)
+{
+    fuzz_case_t fc;
+    divergence_t div;
+
+    while (failures < opts.max_fail) {
+        uint64_t n = next_case++;
+        if (opts.cases && n >= opts.cases) {
+            break;
+        }
+
+        gen_case(&fc, opts.seed + n, opts.length);
+
+        if (run_case(&fc, &div)) {
+            if (++failures > opts.max_fail) {
+                break;
+            }
+            minimize(&fc);
+            run_case(&fc, &div);
+
+            std::lock_guard<std::mutex> g(report_lock);
+            write_repro(&fc, &div);
+        }
+
+        uint64_t d = ++done_cases;
+        if (!opts.quiet && d % 1000 == 0) {
+            std::lock_guard<std::mutex> g(report_lock);
+            printf("fuzz: %llu cases, %llu retires\n",
+                   (unsigned long long)d, (unsigned long long)total_retires.load());
+            fflush(stdout);
+        }
+    }
+}
+
+
+static void
+usage (char * prog)
+{
+    fprintf(stderr, "Usage: %s [options]\n", prog);
+    fprintf(stderr, "Differentially fuzzes the iit3503 RTL against the ISA reference model.\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -j, --jobs <n>     worker threads (default: all cores)\n");
+    fprintf(stderr, "  -n, --cases <n>    number of cases to run, 0 for no limit (default: 10000)\n");
+    fprintf(stderr, "  -s, --seed <n>     first seed (default: random)\n");
+    fprintf(stderr, "  -l, --length <n>   instructions per case (default: 64)\n");
+    fprintf(stderr, "  -f, --failures <n> stop after n divergences (default: 1)\n");
+    fprintf(stderr, "  -o, --out <dir>    where to write reproducers (default: .)\n");
+    fprintf(stderr, "  -q, --quiet        no progress output\n");
+    fprintf(stderr, "  -h, --help         this message\n");
+    fprintf(stderr, "  -V, --version      print the version number and exit\n");
+}
+
+
+static struct option long_options[] = {
+    {"jobs",     required_argument, 0, 'j'},
+    {"cases",    required_argument, 0, 'n'},
+    {"seed",     required_argument, 0, 's'},
+    {"length",   required_argument, 0, 'l'},
+    {"failures", required_argument, 0, 'f'},
+    {"out",      required_argument, 0, 'o'},
+    {"quiet",    no_argument,       0, 'q'},
+    {"help",     no_argument,       0, 'h'},
+    {"version",  no_argument,       0, 'V'},
+    {0, 0, 0, 0}
+};
+
+
+int
+main (int argc, char ** argv)
+{
+    int c;
+    int optidx = 0;
+
+    opts.seed = std::random_device{}();
+
+    while ((c = getopt_long(argc, argv, "j:n:s:l:f:o:qhV", long_options, &optidx)) != -1) {
+        switch (c) {
+            case 'j':
+                opts.jobs = atoi(optarg);
+                break;
+            case 'n':
+                opts.cases = strtoull(optarg, NULL, 0);
+                break;
+            case 's':
+                opts.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'l':
+                opts.length = atoi(optarg);
+                break;
+            case 'f':
+                opts.max_fail = atoi(optarg);
+                break;
+            case 'o':
+                opts.outdir = optarg;
+                break;
+            case 'q':
+                opts.quiet = true;
+                break;
+            case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+            case 'V':
+                printf("iit3503 fuzzer version %s\n", VERSION_STRING);
+                exit(EXIT_SUCCESS);
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (opts.length < 1 || opts.length > 0x1000) {
+        fprintf(stderr, "fuzz: length must be between 1 and 4096\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.jobs == 0) {
+        opts.jobs = std::thread::hardware_concurrency();
+        if (opts.jobs == 0) {
+            opts.jobs = 1;
+        }
+    }
+
+    printf("fuzz: seed %llu, %u workers, %u instructions per case\n",
+           (unsigned long long)opts.seed, opts.jobs, opts.length);
+
+    std::vector<std::thread> workers;
+    for (unsigned j = 0; j < opts.jobs; j++) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread & t : workers) {
+        t.join();
+    }
+
+    printf("fuzz: %llu cases, %llu retires, %u divergence(s)\n",
+           (unsigned long long)done_cases.load(),
+           (unsigned long long)total_retires.load(),
+           failures.load() < opts.max_fail ? failures.load() : opts.max_fail);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 package iit3503
 import chisel3._
+import chisel3.util._
 
 /* 
  * Address control logic for the memory
@@ -7,11 +8,14 @@ import chisel3._
  *
  * This logic is in charge of determining which
  * memory accesses are actually to memory-mapped
- * I/O addresses. There are three possible devices
+ * I/O addresses. There are four possible devices
  * that can be accessed other than memory:
- *  - Keyboard (KBSR/KBDR)
+ *  - Keyboard (KBSR/KBDR/KBCR)
  *  - Output Device (DSR/DDR)
+ *  - DMA engine (DMASRC/DMADST/DMALEN/DMACTL)
+ *  - Block device (BLKSEC/BLKADR/BLKCNT/BLKCTL)
  *  - Machine Control Reg (MCR)
+ *  - Core ID (CPUID) and spinlocks (LOCK0-7, xFE30-xFE37)
  */
 
 trait InMuxConsts {
@@ -20,6 +24,17 @@ trait InMuxConsts {
   val kbsrSel = 2
   val kbdrSel = 3
   val mcrSel  = 4
+  val dmaSrcSel = 5
+  val dmaDstSel = 6
+  val dmaLenSel = 7
+  val dmaCtlSel = 8
+  val kbcrSel   = 9
+  val cpuidSel  = 10
+  val lockSel   = 11
+  val blkSecSel = 12
+  val blkAdrSel = 13
+  val blkCntSel = 14
+  val blkCtlSel = 15
 }
 
 // See Fig C.3, P&P pp. 712. This logic
@@ -27,16 +42,28 @@ trait InMuxConsts {
 // bottom of that figure
 class AddrCtrl extends Module with InMuxConsts {
   val io = IO(new Bundle {
-    val MAR   = Input(UInt(16.W))
+    val bus   = Input(UInt(16.W)) // what MAR gets loaded with
+    val LDMAR = Input(Bool())
     val MIOEN = Input(Bool())
     val RW    = Input(Bool())
 
     val MEMEN     = Output(Bool())
-    val INMUX_SEL = Output(UInt(2.W))
+    val INMUX_SEL = Output(UInt(4.W))
     val LDKBSR    = Output(Bool())
+    val LDKBCR    = Output(Bool())
     val LDDSR     = Output(Bool())
     val LDDDR     = Output(Bool())
     val LDMCR     = Output(Bool())
+    val LDDMASRC  = Output(Bool())
+    val LDDMADST  = Output(Bool())
+    val LDDMALEN  = Output(Bool())
+    val LDDMACTL  = Output(Bool())
+    val LDBLKSEC  = Output(Bool())
+    val LDBLKADR  = Output(Bool())
+    val LDBLKCNT  = Output(Bool())
+    val LDBLKCTL  = Output(Bool())
+    val LDLOCK    = Output(Bool())
+    val lockIdx   = Output(UInt(3.W))
 
     // reads to the KBSR should clear
     // the KBSR ready bit, which the memory
@@ -44,20 +71,64 @@ class AddrCtrl extends Module with InMuxConsts {
     // it that a read occured to KBSR so
     // it can clear that bit for us.
     val kbsrRead = Output(Bool())
+
+    // likewise, reading KBDR takes a character
+    // out of the keyboard FIFO
+    val kbdrRead = Output(Bool())
+
+    // and reading a LOCKn is a test-and-set
+    val lockRead = Output(Bool())
   })
 
   io.INMUX_SEL := DontCare
   io.MEMEN     := false.B
   io.LDKBSR    := false.B
+  io.LDKBCR    := false.B
   io.LDDSR     := false.B
   io.LDDDR     := false.B
   io.LDMCR     := false.B
+  io.LDDMASRC  := false.B
+  io.LDDMADST  := false.B
+  io.LDDMALEN  := false.B
+  io.LDDMACTL  := false.B
+  io.LDBLKSEC  := false.B
+  io.LDBLKADR  := false.B
+  io.LDBLKCNT  := false.B
+  io.LDBLKCTL  := false.B
+  io.LDLOCK    := false.B
 
   io.kbsrRead := false.B
+  io.kbdrRead := false.B
+  io.lockRead := false.B
+
+  // The address compares are done as MAR loads and kept
+  // in flops next to it, so they aren't on the path from
+  // MAR to MDR (or to R and the microsequencer) in the
+  // access itself.
+  def marIs(addr: String) = RegEnable(io.bus === addr.U, false.B, io.LDMAR)
+
+  val atKBSR   = marIs("hFE00")
+  val atKBDR   = marIs("hFE02")
+  val atKBCR   = marIs("hFE08")
+  val atDSR    = marIs("hFE04")
+  val atDDR    = marIs("hFE06")
+  val atDMASRC = marIs("hFE10")
+  val atDMADST = marIs("hFE12")
+  val atDMALEN = marIs("hFE14")
+  val atDMACTL = marIs("hFE16")
+  val atMCR    = marIs("hFFFE")
+  val atBLKSEC = marIs("hFE18")
+  val atBLKADR = marIs("hFE1A")
+  val atBLKCNT = marIs("hFE1C")
+  val atBLKCTL = marIs("hFE1E")
+  val atCPUID  = marIs("hFE20")
+  val atLOCK   = RegEnable(io.bus(15, 3) === (0xFE30 >> 3).U, false.B, io.LDMAR)
+
+  io.lockIdx := RegEnable(io.bus(2, 0), 0.U, io.LDMAR)
 
   when (io.MIOEN) {
     // KBSR
-    when (io.MAR === "hFE00".U) {
+    when (atKBSR) {
       when (io.RW) { // write
         io.LDKBSR := true.B
         } .otherwise {
@@ -65,24 +136,95 @@ class AddrCtrl extends Module with InMuxConsts {
           io.kbsrRead := true.B
         }
     // KBDR
-    } .elsewhen (io.MAR === "hFE02".U) {
+    } .elsewhen (atKBDR) {
       when (io.RW === false.B) { // reads only on KBDR
         io.INMUX_SEL := kbdrSel.U
+        io.kbdrRead  := true.B
+      }
+    // KBCR
+    } .elsewhen (atKBCR) {
+      when (io.RW) {
+        io.LDKBCR := true.B
+      } .otherwise {
+        io.INMUX_SEL := kbcrSel.U
       }
     // DSR
-    } .elsewhen (io.MAR === "hFE04".U) {
+    } .elsewhen (atDSR) {
       when (io.RW) { // write
         io.LDDSR := true.B
       } .otherwise {
         io.INMUX_SEL := dsrSel.U
       }
     // DDR
-    } .elsewhen (io.MAR === "hFE06".U) {
+    } .elsewhen (atDDR) {
       when (io.RW) { // write, no reads on DDR
         io.LDDDR := true.B
       } 
+    // DMA registers
+    } .elsewhen (atDMASRC) {
+      when (io.RW) {
+        io.LDDMASRC := true.B
+      } .otherwise {
+        io.INMUX_SEL := dmaSrcSel.U
+      }
+    } .elsewhen (atDMADST) {
+      when (io.RW) {
+        io.LDDMADST := true.B
+      } .otherwise {
+        io.INMUX_SEL := dmaDstSel.U
+      }
+    } .elsewhen (atDMALEN) {
+      when (io.RW) {
+        io.LDDMALEN := true.B
+      } .otherwise {
+        io.INMUX_SEL := dmaLenSel.U
+      }
+    } .elsewhen (atDMACTL) {
+      when (io.RW) {
+        io.LDDMACTL := true.B
+      } .otherwise {
+        io.INMUX_SEL := dmaCtlSel.U
+      }
+    // block device registers
+    } .elsewhen (atBLKSEC) {
+      when (io.RW) {
+        io.LDBLKSEC := true.B
+      } .otherwise {
+        io.INMUX_SEL := blkSecSel.U
+      }
+    } .elsewhen (atBLKADR) {
+      when (io.RW) {
+        io.LDBLKADR := true.B
+      } .otherwise {
+        io.INMUX_SEL := blkAdrSel.U
+      }
+    } .elsewhen (atBLKCNT) {
+      when (io.RW) {
+        io.LDBLKCNT := true.B
+      } .otherwise {
+        io.INMUX_SEL := blkCntSel.U
+      }
+    } .elsewhen (atBLKCTL) {
+      when (io.RW) {
+        io.LDBLKCTL := true.B
+      } .otherwise {
+        io.INMUX_SEL := blkCtlSel.U
+      }
+    // CPUID (read only)
+    } .elsewhen (atCPUID) {
+      when (io.RW === false.B) {
+        io.INMUX_SEL := cpuidSel.U
+      }
+    // LOCK0-7
+    } .elsewhen (atLOCK) {
+      when (io.RW) {
+        io.LDLOCK := true.B
+      } .otherwise {
+        io.INMUX_SEL := lockSel.U
+        io.lockRead  := true.B
+      }
     // MCR
-    } .elsewhen (io.MAR === "hFFFE".U) {
+    } .elsewhen (atMCR) {
       when (io.RW) { // write
         io.LDMCR := true.B
       } .otherwise {
@@ -0,0 +1,117 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+
+/*
+ * Block storage device for the 3503
+ *
+ * Moves whole sectors (256 words) between a disk and RAM. The
+ * disk itself isn't hardware we have: it's a file on the host,
+ * and the harness does the transfer (see src/cpp/blkdev.cpp).
+ * This module is the guest-facing half: four (supervisor-only)
+ * device registers, and the handshake with the host.
+ *
+ *  - xFE18 BLKSEC : first sector
+ *  - xFE1A BLKADR : RAM address of the buffer
+ *  - xFE1C BLKCNT : number of sectors
+ *  - xFE1E BLKCTL : [15] done, [14] interrupt enable, [13] error,
+ *                   [1] direction (0 = disk to RAM, 1 = RAM to
+ *                   disk), [0] go/busy
+ *
+ * It works like DMACTL: writing BLKCTL with bit 0 set starts a
+ * command, and any write to BLKCTL clears done and error (which
+ * is how an interrupt handler acknowledges the interrupt). The
+ * other registers can't be changed while a command is running,
+ * and the buffer mustn't be touched until it's done.
+ *
+ * While busy, req is up (with write, and the registers, saying
+ * what to do) until the host pulses done. It pulses error with
+ * it if the command couldn't be carried out (e.g. it ran past
+ * the end of the disk, or there's no disk).
+ */
+// what the harness sees of the block device (through Top)
+class BlockHostPort extends Bundle {
+  val req   = Output(Bool())
+  val write = Output(Bool()) // RAM to disk
+  val sec   = Output(UInt(16.W))
+  val addr  = Output(UInt(16.W))
+  val cnt   = Output(UInt(16.W))
+  val done  = Input(Bool())  // strobe: the command is finished
+  val error = Input(Bool())  // with done: ... and it failed
+}
+
+trait BlockConsts {
+  val blkIntVec  = 0x83
+  val blkIntPrio = 3
+}
+
+class BlockDev extends Module {
+  val io = IO(new Bundle {
+    // register writes from the memory controller
+    val wrData = Input(UInt(16.W))
+    val ldSec  = Input(Bool())
+    val ldAddr = Input(Bool())
+    val ldCnt  = Input(Bool())
+    val ldCtl  = Input(Bool())
+
+    // register reads
+    val sec  = Output(UInt(16.W))
+    val addr = Output(UInt(16.W))
+    val cnt  = Output(UInt(16.W))
+    val ctl  = Output(UInt(16.W))
+
+    // to and from the host
+    val req   = Output(Bool())
+    val write = Output(Bool())
+    val done  = Input(Bool())
+    val error = Input(Bool())
+
+    // completion interrupt
+    val irq = Output(Bool())
+  })
+
+  val sec   = RegInit(0.U(16.W))
+  val addr  = RegInit(0.U(16.W))
+  val cnt   = RegInit(0.U(16.W))
+  val busy  = RegInit(false.B)
+  val done  = RegInit(false.B)
+  val err   = RegInit(false.B)
+  val ie    = RegInit(false.B)
+  val write = RegInit(false.B)
+
+  io.sec  := sec
+  io.addr := addr
+  io.cnt  := cnt
+  io.ctl  := Cat(done, ie, err, 0.U(11.W), write, busy)
+  io.irq  := done & ie
+
+  io.req   := busy
+  io.write := write
+
+  when (!busy) {
+    when (io.ldSec)  { sec  := io.wrData }
+    when (io.ldAddr) { addr := io.wrData }
+    when (io.ldCnt)  { cnt  := io.wrData }
+  }
+
+  when (io.ldCtl) {
+    ie   := io.wrData(14)
+    done := false.B
+    err  := false.B
+    when (!busy && io.wrData(0)) {
+      write := io.wrData(1)
+      when (cnt === 0.U) {
+        done := true.B
+      } .otherwise {
+        busy := true.B
+      }
+    }
+  }
+
+  when (busy && io.done) {
+    busy := false.B
+    done := true.B
+    err  := io.error
+  }
+}
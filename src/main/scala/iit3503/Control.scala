@@ -45,16 +45,17 @@ class Control extends Module {
     val R     = Input(Bool())
     val BEN   = Input(Bool())
     val ACV   = Input(Bool())
+    val ACVNow = Input(Bool()) // ACV of what's on the bus right now
+    val mdReady = Input(Bool()) // multiply/divide unit done
 
     val halt = Input(Bool())
 
     val ctrlLines = Output(new CtrlSigs)
     val intAck    = Output(Bool())
+    val ifetch    = Output(Bool()) // the memory read in flight is an IFETCH
     val debuguPC  = Output(UInt(6.W))
   })
 
-  val ir = io.IR
-
   // our uPC is the "microcode program counter"
   // It directly corresponds to what state we are
   // in the machine's FSM.
@@ -84,6 +85,11 @@ class Control extends Module {
   // on the datapath. The *next* states of this FSM
   // are determined by the microsequencer and external
   // signals coming as input to the control.
+  //
+  // The ROM is read at uPC, which is a register: the lookup
+  // starts on the clock edge, ahead of everything the next
+  // state depends on (R, INT, BEN, the fetch address's ACV
+  // all settle late), rather than behind the microsequencer.
   val ctrlStore = Module(new ControlStore)
 
   // our current state is comprised of all
@@ -101,6 +107,11 @@ class Control extends Module {
   val ctrlFeed = uIR.feed
   val ctrlSigs = uIR.sigs
 
+  // IFETCH loads IR and decodes in the same state (30), so
+  // the microsequencer has to see the instruction while it's
+  // still on its way into IR
+  val ir = Mux(ctrlSigs.LDIR, io.bus, io.IR)
+
   // tell the ctrl store to give us a micro instruction
   // at current uPC
   ctrlStore.io.addr := uPC
@@ -119,6 +130,9 @@ class Control extends Module {
   // this is INT ACK behavior (interrupt acknowledge)
   io.intAck := uPC === 49.U
 
+  // state 28 is the IFETCH read (for the instruction cache)
+  io.ifetch := uPC === 28.U && !io.halt
+
   // connect the feedback lines back to the 
   // input side of the microsequencer 
   uSeq.io.cFeed := ctrlFeed
@@ -130,6 +144,9 @@ class Control extends Module {
   uSeq.io.BEN     := io.BEN      // was a branch taken?
   uSeq.io.PSR15   := io.PSR15    // are we in supervisor mode or user mode?
   uSeq.io.ACV     := io.ACV      // did an access violation occur?
+  uSeq.io.ACVNow  := io.ACVNow   // would the address on the bus cause one? (IFETCH)
+  uSeq.io.MDReady := io.mdReady  // has the multiply/divide unit finished?
+  uSeq.io.MDOp    := ir(4,3) =/= 0.U // MUL/DIV/MOD, or the reserved encoding?
 
   // DEBUGGING OUTPUTS
   io.debuguPC := uPC 
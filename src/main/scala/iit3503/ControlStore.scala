@@ -63,6 +63,8 @@ class CtrlSigs extends Bundle {
   val MIOEN      = Bool()
   val RW         = Bool()
   val SetPriv    = Bool()
+  val LDMD       = Bool() // start the multiply/divide unit
+  val GateMD     = Bool()
 }
 
 /*
@@ -76,10 +78,14 @@ class CtrlSigs extends Bundle {
  *   - COND4 : priv mode
  *   - COND5 : interrupt test
  *   - COND6 : ACV test
+ *   - COND7 : IFETCH test (interrupt, then ACV of the bus)
+ *   - COND8 : multiply/divide unit ready
+ *   - COND9 : multiply/divide op (IR[4:3] != 00). Sets J's bit 3,
+ *             not bit 0, so state 13 can leave IR[11] to state 50.
  */
 class CtrlFeedback extends Bundle {
   val IRD  = Bool()
-  val COND = UInt(3.W)
+  val COND = UInt(4.W)
   val J    = UInt(6.W)
 }
 
@@ -116,9 +122,12 @@ class ControlStore extends Module {
   
 
   // Note that the "IRD" line of the microsequencer is *only* used
-  // in the DECODE stage of instruction processing (state 32). This state
+  // in the DECODE stage of instruction processing. This state
   // is special because the next state entirely depends on the opcode of the
-  // fetched instruction. Thus, IRD is only set on row 32.
+  // fetched instruction. In the book that's state 32. Our IFETCH is
+  // shorter than the book's (18, 28, 30 instead of 18, 33, 28, 30, 32),
+  // so we decode in state 30, as the instruction goes into IR, and
+  // IRD is set on row 30. Rows 32 and 33 went to MUL/DIV/MOD.
   
 
   // 00 = BR - check for branch enable
@@ -243,13 +252,12 @@ class ControlStore extends Module {
   c12.sigs.ADDR2MUX := 0.U // 0
   cStore(12)        := c12
 
-  // 13 = Undefined Opcode
+  // 13 = MUL/DIV/MOD (step 1) - check for the reserved encoding
   val c13           = 0.U.asTypeOf(new MicroInstr)
-  c13.feed.J       := 62.U
-  c13.feed.COND    := "b011".U
-  c13.sigs.LDPriv  := true.B
-  c13.sigs.PSRMUX  := true.B
-  c13.sigs.SetPriv := false.B
+  c13.feed.J       := 50.U // reserved encoding
+  c13.feed.COND    := "b1001".U // 58 if IR[4:3] names an op
+  c13.sigs.LDMDR   := true.B
+  c13.sigs.GatePSR := true.B // MDR <- PSR, in case it's the exception
   cStore(13)       := c13
 
   // 14 = LEA (no mem access)
@@ -284,10 +292,11 @@ class ControlStore extends Module {
   c17.feed.J    := 24.U // back to ifetch
   cStore(17)    := c17
 
-  // 18 = IFETCH (step 1) - begin instruction fetch
+  // 18 = IFETCH (step 1) - begin instruction fetch, IRQ and ACV checks
+  // (the book's state 33 is folded in here)
   val c18          = 0.U.asTypeOf(new MicroInstr)
-  c18.feed.J      := 33.U
-  c18.feed.COND   := "b101".U // check for IRQ
+  c18.feed.J      := 28.U // 60 on ACV, 49 on IRQ
+  c18.feed.COND   := "b111".U // check for IRQ, then ACV
   c18.sigs.LDMAR  := true.B
   c18.sigs.GatePC := true.B
   c18.sigs.LDPC   := true.B
@@ -390,8 +399,11 @@ class ControlStore extends Module {
   c29.sigs.RW    := false.B // indirect write via read
   cStore(29)     := c29
 
-  // 30 = IFETCH (step 4) - load instruction into IR
+  // 30 = IFETCH (step 4) - load instruction into IR and DECODE
+  // (the book's state 32 is folded in here)
   val c30           = 0.U.asTypeOf(new MicroInstr)
+  c30.feed.IRD     := true.B // decode what's going into IR
+  c30.sigs.LDBEN   := true.B // set up CCs
   // FILL ME IN!
   cStore(30)       := c30
 
@@ -403,17 +415,22 @@ class ControlStore extends Module {
   c31.sigs.GateMDR := true.B
   cStore(31)       := c31
 
-  // 32 = DECODE 
+  // 32 = MUL/DIV/MOD (step 3) - wait for the unit
+  // (the book's DECODE, which IFETCH now does in state 30)
   val c32         = 0.U.asTypeOf(new MicroInstr)
-  c32.feed.IRD   := true.B // only enabled in decode!
-  c32.sigs.LDBEN := true.B // set up CCs
+  c32.feed.J     := 32.U
+  c32.feed.COND  := "b1000".U // 33 once it's ready
   cStore(32)     := c32
 
-  // 33 = IFETCH (step 2) - ifetch access violation check
-  val c33        = 0.U.asTypeOf(new MicroInstr)
-  c33.feed.J    := 28.U
-  c33.feed.COND := "b110".U // check ACV
-  cStore(33)    := c33
+  // 33 = MUL/DIV/MOD (step 4) - write the result, set CC
+  // (the book's IFETCH step 2, which state 18 now does)
+  val c33           = 0.U.asTypeOf(new MicroInstr)
+  c33.feed.J       := 18.U // back to ifetch
+  c33.sigs.GateMD  := true.B
+  c33.sigs.LDREG   := true.B // DR is IR[11..9]
+  c33.sigs.LDCC    := true.B
+  c33.sigs.PSRMUX  := true.B // CC from logic
+  cStore(33)       := c33
 
   // 34 = RTI (step 7) - pop stack, check for stack switch 
   val c34          = 0.U.asTypeOf(new MicroInstr)
@@ -582,7 +599,11 @@ class ControlStore extends Module {
   c49.sigs.SetPriv    := false.B // control provides new priv (Priv <- 0)
   cStore(49)          := c49
 
-  // 50 = Unused
+  // 50 = Reserved encoding of 1101 - check IR[11]
+  val c50        = 0.U.asTypeOf(new MicroInstr)
+  c50.feed.J    := 62.U // illegal opcode exception
+  c50.feed.COND := "b011".U // 63 if IR[11]
+  cStore(50)    := c50
   
   // 51 = RTI (step 8a) - Nothing
   val c51     = 0.U.asTypeOf(new MicroInstr)
@@ -627,7 +648,12 @@ class ControlStore extends Module {
   // 57 = ACV occurred
   cStore(57) := c48
 
-  // 58 = Unused
+  // 58 = MUL/DIV/MOD (step 2) - start the unit on SR1 and SR2/imm3
+  val c58           = 0.U.asTypeOf(new MicroInstr)
+  c58.feed.J       := 32.U
+  c58.sigs.LDMD    := true.B
+  c58.sigs.SR1MUX  := 1.U // IR[8..6]
+  cStore(58)       := c58
 
   // 59 = RTI (step 8b) - restore saved user SP
   val c59              = 0.U.asTypeOf(new MicroInstr)
@@ -646,7 +672,7 @@ class ControlStore extends Module {
   // 61 = ACV occurred
   cStore(61) := c48
 
-  // 62 = ??? 
+  // 62 = Illegal opcode exception
   val c62             = 0.U.asTypeOf(new MicroInstr)
   c62.feed.J         := 37.U
   c62.feed.COND      := "b100".U // check PSR[15]
@@ -0,0 +1,199 @@
+package iit3503
+import chisel3._
+import chisel3.util._
+
+/*
+ * What a core shows the outside world for debugging. Top puts
+ * one core's worth of these on its debug ports at a time.
+ */
+class CoreDebug extends Bundle {
+  val PC       = UInt(16.W)
+  val IR       = UInt(16.W)
+  val PSR      = UInt(16.W)
+  val R        = Vec(8, UInt(16.W))
+  val uPC      = UInt(6.W)
+  val MAR      = UInt(16.W)
+  val MDR      = UInt(16.W)
+  val DDR      = UInt(16.W)
+  val DSR      = UInt(16.W)
+  val MCR      = UInt(16.W)
+  val bus      = UInt(16.W)
+  val ICHits   = UInt(32.W)
+  val ICMisses = UInt(32.W)
+}
+
+/*
+ * One 3503 core: control, datapath, memory controller (with its
+ * own device registers and DMA engine), interrupt controller and
+ * I-cache. Memory, the serial port/keyboard and the spinlocks
+ * live in Top, which can have several of these.
+ */
+class Core extends Module with DMAConsts with UARTConsts with ICacheConsts with BlockConsts {
+
+  val io = IO(new Bundle {
+    val resetVec = Input(UInt(16.W))
+    val coreId   = Input(UInt(8.W))
+
+    // keyboard interrupt vector and priority (from the harness)
+    val intv        = Input(UInt(8.W))
+    val intPriority = Input(UInt(3.W))
+
+    // keyboard (RX FIFO) and serial out (TX FIFO)
+    val rx          = Flipped(DecoupledIO(UInt(8.W)))
+    val rxLevel     = Input(UInt(8.W))
+    val rxDue       = Input(Bool())
+    val rxThreshold = Output(UInt(8.W))
+    val rxTimeout   = Output(UInt(8.W))
+    val tx          = DecoupledIO(UInt(8.W))
+    val txLow       = Input(Bool())
+    val txIdle      = Input(Bool())
+
+    // the block device's host side
+    val blk = new BlockHostPort
+
+    // shared memory (through the arbiter), and the writes
+    // everyone makes to it
+    val mem       = new MemPort
+    val snoop     = Input(Bool())
+    val snoopAddr = Input(UInt(16.W))
+    val icFlush   = Input(Bool())
+
+    val lock = new LockPort
+
+    val halt   = Output(Bool())
+    val intAck = Output(Bool()) // the *keyboard* interrupt was taken
+
+    val debug = Output(new CoreDebug)
+  })
+
+  val ctrlUnit = Module(new Control)    // top-level control unit
+  val memCtrl  = Module(new MemCtrl)    // memory controller
+  val icache   = Module(new ICache(icSets, icWays)) // between memCtrl and memory
+  val intCtrl  = Module(new IntCtrl)    // interrupt controller
+  val dataPath = Module(new DataPath)   // datapath
+  val irqArb   = Module(new IRQArbiter(4)) // 0: keyboard, 1: DMA, 2: serial out, 3: block device
+
+  val ctrl = ctrlUnit.io.ctrlLines
+
+  // wire control unit to datapath
+  dataPath.io.ctrlSigs := ctrl
+  ctrlUnit.io.IR       := dataPath.io.ir
+  ctrlUnit.io.bus      := dataPath.io.bus
+  ctrlUnit.io.PSR15    := dataPath.io.psr15
+  ctrlUnit.io.N        := dataPath.io.n
+  ctrlUnit.io.Z        := dataPath.io.z
+  ctrlUnit.io.P        := dataPath.io.p
+  ctrlUnit.io.BEN      := dataPath.io.bEn
+  ctrlUnit.io.ACV      := dataPath.io.ACV
+  ctrlUnit.io.ACVNow   := dataPath.io.acvNow
+  ctrlUnit.io.mdReady  := dataPath.io.mdReady
+  ctrlUnit.io.INT      := dataPath.io.irq
+
+  // wire memory controller to datapath
+  dataPath.io.mdrVal       := memCtrl.io.mdrOut
+  memCtrl.io.bus           := dataPath.io.bus
+  memCtrl.io.coreId        := io.coreId
+
+  // wire up memory to memory controller, through the I-cache
+  memCtrl.io.memR    := icache.io.R
+  memCtrl.io.memData := icache.io.dataOut
+  icache.io.en       := memCtrl.io.en
+  icache.io.wEn      := memCtrl.io.wEn
+  icache.io.dataIn   := memCtrl.io.dataIn
+  icache.io.addr     := memCtrl.io.addr
+  icache.io.fetch    := ctrlUnit.io.ifetch
+  icache.io.flush    := io.icFlush
+  icache.io.snoop     := io.snoop
+  icache.io.snoopAddr := io.snoopAddr
+
+  icache.io.memR       := io.mem.R
+  icache.io.memDataOut := io.mem.dataOut
+  io.mem.en            := icache.io.memEn
+  io.mem.wEn           := icache.io.memWEn
+  io.mem.dataIn        := icache.io.memDataIn
+  io.mem.addr          := icache.io.memAddr
+
+  io.lock <> memCtrl.io.lock
+
+  // wire memory controller up to control unit
+  ctrlUnit.io.R    := memCtrl.io.R
+  ctrlUnit.io.halt := ~memCtrl.io.mcrOut(15)
+  memCtrl.io.LDMDR := ctrl.LDMDR
+  memCtrl.io.MIOEN := ctrl.MIOEN
+  memCtrl.io.LDMAR := ctrl.LDMAR
+  memCtrl.io.RDWR  := ctrl.RW
+
+  // bit 15 of MCR is "clock enable" bit
+  io.halt := ~memCtrl.io.mcrOut(15)
+
+  // wire up control unit to interrupt controller
+  intCtrl.io.VectorMux := ctrl.VectorMUX
+  intCtrl.io.TableMux  := ctrl.TableMUX
+  intCtrl.io.LDVector  := ctrl.LDVector
+
+  // wire up datapath to interrupt controller
+  intCtrl.io.bus             := dataPath.io.bus
+  dataPath.io.intHandlerAddr := intCtrl.io.out
+
+  // serial out and keyboard
+  io.tx <> memCtrl.io.tx
+  memCtrl.io.txLow  := io.txLow
+  memCtrl.io.txIdle := io.txIdle
+
+  io.rxThreshold := memCtrl.io.rxThreshold
+  io.rxTimeout   := memCtrl.io.rxTimeout
+  memCtrl.io.rx      <> io.rx
+  memCtrl.io.rxLevel := io.rxLevel
+  memCtrl.io.rxDue   := io.rxDue
+
+  io.blk <> memCtrl.io.blk
+
+  // interrupt sources: the keyboard (vector and priority come
+  // from the harness), the DMA engine, the serial port and the
+  // block device
+  irqArb.io.in(0).req  := memCtrl.io.devIntEnable
+  irqArb.io.in(0).vec  := io.intv
+  irqArb.io.in(0).prio := io.intPriority
+  irqArb.io.in(1).req  := memCtrl.io.dmaIntReq
+  irqArb.io.in(1).vec  := dmaIntVec.U
+  irqArb.io.in(1).prio := dmaIntPrio.U
+  irqArb.io.in(2).req  := memCtrl.io.txIntReq
+  irqArb.io.in(2).vec  := txIntVec.U
+  irqArb.io.in(2).prio := txIntPrio.U
+  irqArb.io.in(3).req  := memCtrl.io.blkIntReq
+  irqArb.io.in(3).vec  := blkIntVec.U
+  irqArb.io.in(3).prio := blkIntPrio.U
+
+  dataPath.io.devIntEnable := irqArb.io.out.req
+  dataPath.io.intPriority  := irqArb.io.out.prio
+  intCtrl.io.INTV          := irqArb.io.out.vec
+
+  // tell the outside world when it was the keyboard's
+  // interrupt that was taken
+  irqArb.io.ack := ctrlUnit.io.intAck
+  io.intAck     := irqArb.io.acks(0)
+
+  dataPath.io.resetVec := io.resetVec
+
+  /* DEBUG PORTS */
+  io.debug.PC   := dataPath.io.debugPC
+  io.debug.IR   := dataPath.io.debugIR
+  io.debug.PSR  := dataPath.io.debugPSR
+  io.debug.R(0) := dataPath.io.debugR0
+  io.debug.R(1) := dataPath.io.debugR1
+  io.debug.R(2) := dataPath.io.debugR2
+  io.debug.R(3) := dataPath.io.debugR3
+  io.debug.R(4) := dataPath.io.debugR4
+  io.debug.R(5) := dataPath.io.debugR5
+  io.debug.R(6) := dataPath.io.debugR6
+  io.debug.R(7) := dataPath.io.debugR7
+  io.debug.uPC  := ctrlUnit.io.debuguPC
+  io.debug.MDR  := memCtrl.io.debugMDR
+  io.debug.MAR  := memCtrl.io.debugMAR
+  io.debug.bus  := dataPath.io.bus
+  io.debug.DSR  := memCtrl.io.debugDSR
+  io.debug.DDR  := memCtrl.io.debugDDR
+  io.debug.MCR  := memCtrl.io.debugMCR
+  io.debug.ICHits   := icache.io.debugHits
+  io.debug.ICMisses := icache.io.debugMisses
+}
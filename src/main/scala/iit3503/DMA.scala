@@ -0,0 +1,133 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+
+/*
+ * DMA engine for the 3503
+ *
+ * Copies or fills blocks of memory without the CPU having to
+ * run a LDR/STR loop. It lives inside the memory controller and
+ * is programmed through four (supervisor-only) device registers:
+ *
+ *  - xFE10 DMASRC : source address (copy), or the fill value (fill)
+ *  - xFE12 DMADST : destination address
+ *  - xFE14 DMALEN : number of words left to transfer
+ *  - xFE16 DMACTL : [15] done, [14] interrupt enable,
+ *                   [1] mode (0 = copy, 1 = fill), [0] go/busy
+ *
+ * Writing DMACTL with bit 0 set starts a transfer. Any write to
+ * DMACTL clears the done bit, which is how an interrupt handler
+ * acknowledges the DMA interrupt. Copies go in ascending address
+ * order (like memcpy, not memmove). SRC/DST/LEN can't be changed
+ * while a transfer is in progress.
+ *
+ * The engine only gets the memory port in cycles where the CPU
+ * isn't using the memory controller (grant). It uses ExternalRAM
+ * the same way the CPU does: it holds an access on the port until
+ * R comes back. With no wait states a copy takes 2 granted cycles
+ * per word (read, write) and a fill takes 1. If the CPU takes the
+ * port back in the middle of an access, that access starts over
+ * (see ExternalRAM).
+ */
+trait DMAConsts {
+  val dmaIntVec  = 0x81
+  val dmaIntPrio = 3
+}
+
+class DMA extends Module {
+  val io = IO(new Bundle {
+    // register writes from the memory controller
+    val wrData = Input(UInt(16.W))
+    val ldSrc  = Input(Bool())
+    val ldDst  = Input(Bool())
+    val ldLen  = Input(Bool())
+    val ldCtl  = Input(Bool())
+
+    // register reads
+    val src = Output(UInt(16.W))
+    val dst = Output(UInt(16.W))
+    val len = Output(UInt(16.W))
+    val ctl = Output(UInt(16.W))
+
+    // memory port (only used when req && grant)
+    val grant   = Input(Bool())
+    val req     = Output(Bool())
+    val wEn     = Output(Bool())
+    val addr    = Output(UInt(16.W))
+    val dataIn  = Output(UInt(16.W))
+    val memData = Input(UInt(16.W))
+    val memR    = Input(Bool())
+
+    // completion interrupt
+    val irq = Output(Bool())
+  })
+
+  val idle :: read :: write :: Nil = Enum(3)
+  val state = RegInit(idle)
+
+  val src  = RegInit(0.U(16.W))
+  val dst  = RegInit(0.U(16.W))
+  val len  = RegInit(0.U(16.W))
+  val buf  = RegInit(0.U(16.W))
+  val done = RegInit(false.B)
+  val ie   = RegInit(false.B)
+  val fill = RegInit(false.B)
+
+  val busy = state =/= idle
+
+  io.src := src
+  io.dst := dst
+  io.len := len
+  io.ctl := Cat(done, ie, 0.U(12.W), fill, busy)
+  io.irq := done & ie
+
+  when (!busy) {
+    when (io.ldSrc) { src := io.wrData }
+    when (io.ldDst) { dst := io.wrData }
+    when (io.ldLen) { len := io.wrData }
+  }
+
+  when (io.ldCtl) {
+    ie   := io.wrData(14)
+    done := false.B
+    when (!busy && io.wrData(0)) {
+      fill := io.wrData(1)
+      buf  := src // fill pattern
+      when (len === 0.U) {
+        done := true.B
+      } .otherwise {
+        state := Mux(io.wrData(1), write, read)
+      }
+    }
+  }
+
+  io.req    := state === read || state === write
+  io.wEn    := state === write
+  io.addr   := Mux(state === write, dst, src)
+  io.dataIn := buf
+
+  switch (state) {
+    is (read) {
+      when (io.grant && io.memR) {
+        buf   := io.memData
+        state := write
+      }
+    }
+    is (write) {
+      when (io.grant && io.memR) {
+        dst := dst + 1.U
+        len := len - 1.U
+        when (!fill) {
+          src := src + 1.U
+        }
+        when (len === 1.U) {
+          state := idle
+          done  := true.B
+        } .otherwise {
+          state := Mux(fill, write, read)
+        }
+      }
+    }
+  }
+}
@@ -37,6 +37,8 @@ class DataPath extends Module {
     val p     = Output(Bool())
     val bEn   = Output(Bool())
     val ACV   = Output(Bool())
+    val acvNow = Output(Bool()) // what LDACV would load this cycle
+    val mdReady = Output(Bool()) // multiply/divide unit done
     val irq   = Output(Bool())
 
     /* DEBUG OUTPUTS */
@@ -72,6 +74,7 @@ class DataPath extends Module {
   val SavedUSP = RegInit("hfdff".U(16.W))
 
   val ALU  = Module(new ALU)
+  val MD   = Module(new MulDiv)
   val regs = Module(new RegFile)
 
   // for interrupt priority
@@ -85,6 +88,7 @@ class DataPath extends Module {
   io.p     := P
   io.bEn   := BEN
   io.ACV   := ACV
+  io.mdReady := MD.io.ready
 
   /*========== BUS SETUP ==============*/
   val bus    = Module(new Bus)
@@ -95,6 +99,7 @@ class DataPath extends Module {
   // who gets the bus is determined by
   // the GateX control lines
   bus.io.inputSel := Cat(Seq(
+    ctrl.GateMD,
     ctrl.GatePC,
     ctrl.GateMDR,
     ctrl.GateALU,
@@ -111,6 +116,7 @@ class DataPath extends Module {
 
   // we have to actually wire up the components
   // to the vector of bus inputs
+  bus.io.inputs(8) := MD.io.out
   bus.io.inputs(7) := PC
   bus.io.inputs(6) := io.mdrVal
   bus.io.inputs(5) := ALU.io.out
@@ -220,11 +226,14 @@ class DataPath extends Module {
      SavedUSP := regs.io.sr1Out
    }
 
-   // set branch enable if IR CC mask matches CC processor state
+   // set branch enable if IR CC mask matches CC processor state.
+   // IFETCH decodes in the same state that loads IR, so take the
+   // mask from the bus when that's where IR is coming from
+   val benIR = Mux(ctrl.LDIR, busOut, IR)
    when (ctrl.LDBEN) {
-     BEN := (IR(11) & N) |
-            (IR(10) & Z) |
-            (IR(9)  & P) 
+     BEN := (benIR(11) & N) |
+            (benIR(10) & Z) |
+            (benIR(9)  & P) 
    }
 
    // see Fig. C.6 (pp 709) and Fig 9.2 (pp. 316)
@@ -232,12 +241,17 @@ class DataPath extends Module {
    // - xFE00 -> xFFFF (I/O space)
    // - x0000 -> x2FFF (supervisor area/system stack)
    // KCH: note Fig C.6 has a bug for ACV in 3rd edition
+   val busOr  = busOut(15,9).andR() |  
+                busOut(15,12).asUInt() < 3.U
+   val acvNow = busOr & PSR.priv
    when (ctrl.LDACV) {
-     val busOr = busOut(15,9).andR() |  
-                 busOut(15,12).asUInt() < 3.U
-     ACV := busOr & PSR.priv
+     ACV := acvNow
    }
 
+   // IFETCH checks this directly instead of waiting a
+   // cycle for the ACV register
+   io.acvNow := acvNow
+
    when (io.intPriority > PSR.priority) {
      aGbReg := true.B
    }
@@ -252,6 +266,13 @@ class DataPath extends Module {
   ALU.io.in_b  := SR2MUX
   ALU.io.opSel := ctrl.ALUK
 
+  // MUL/DIV/MOD take SR2 or a zero-extended imm3 (not
+  // SR2MUX, which sign-extends imm5)
+  MD.io.start := ctrl.LDMD
+  MD.io.op    := IR(4, 3)
+  MD.io.in_a  := regs.io.sr1Out
+  MD.io.in_b  := Mux(IR(5), IR(2, 0), regs.io.sr2Out)
+
   // wire up the register file
   regs.io.wEn    := ctrl.LDREG
   regs.io.drSel  := DRMUX
@@ -0,0 +1,128 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+
+trait ICacheConsts {
+  val icSets = 32 // lines per way (one word each)
+  val icWays = 2  // 1 = direct mapped, 2 = 2-way with LRU
+}
+
+/*
+ * Instruction cache. This sits between the memory controller
+ * and ExternalRAM, on the same handshake (see src/v/ram.v).
+ *
+ * Only IFETCH reads (state 28, flagged by fetch) are looked up
+ * and filled; everything else goes straight through. A fetch
+ * that hits answers with R in the cycle it's asked, without
+ * touching memory, so wait states only cost anything on a miss.
+ *
+ * Lines are one word. Any write that reaches memory invalidates
+ * the line holding that address: snoop is every write that lands
+ * in RAM, from this core (CPU or DMA) or any other. flush drops
+ * everything (the harness pulses it when it changes RAM behind
+ * the machine's back).
+ */
+class ICache(sets: Int, ways: Int) extends Module {
+  require(isPow2(sets) && sets >= 2)
+  require(ways == 1 || ways == 2)
+
+  val io = IO(new Bundle {
+    // from the memory controller
+    val en     = Input(Bool())
+    val wEn    = Input(Bool())
+    val dataIn = Input(UInt(16.W))
+    val addr   = Input(UInt(16.W))
+    val fetch  = Input(Bool()) // this read is an IFETCH
+    val flush  = Input(Bool())
+
+    // a write landed in RAM (from anyone)
+    val snoop     = Input(Bool())
+    val snoopAddr = Input(UInt(16.W))
+
+    // back to the memory controller
+    val dataOut = Output(UInt(16.W))
+    val R       = Output(Bool())
+
+    // out to memory
+    val memEn      = Output(Bool())
+    val memWEn     = Output(Bool())
+    val memDataIn  = Output(UInt(16.W))
+    val memAddr    = Output(UInt(16.W))
+    val memDataOut = Input(UInt(16.W))
+    val memR       = Input(Bool())
+
+    // DEBUG OUTPUTS
+    val debugHits   = Output(UInt(32.W))
+    val debugMisses = Output(UInt(32.W))
+  })
+
+  val idxBits = log2Ceil(sets)
+  val idx     = io.addr(idxBits - 1, 0)
+  val tag     = io.addr(15, idxBits)
+
+  val tags  = Seq.fill(ways)(Mem(sets, UInt((16 - idxBits).W)))
+  val data  = Seq.fill(ways)(Mem(sets, UInt(16.W)))
+  val valid = Seq.fill(ways)(RegInit(VecInit(Seq.fill(sets)(false.B))))
+
+  // which way to fill next, per set (least recently used)
+  val lru = RegInit(VecInit(Seq.fill(sets)(0.U(1.W))))
+
+  val inWay  = (0 until ways).map(w => valid(w)(idx) && tags(w)(idx) === tag)
+  val wayHit = inWay.reduce(_ || _)
+  val hitWay = if (ways == 1) 0.U else Mux(inWay(1), 1.U, 0.U)
+
+  val lookup = io.en && io.fetch && !io.wEn
+  val hit    = lookup && wayHit
+  val fill   = lookup && !wayHit && io.memR
+
+  val hits   = RegInit(0.U(32.W))
+  val misses = RegInit(0.U(32.W))
+
+  // hits never go out to memory
+  io.memEn     := io.en && !hit
+  io.memWEn    := io.wEn
+  io.memDataIn := io.dataIn
+  io.memAddr   := io.addr
+
+  io.R       := hit || io.memR
+  io.dataOut := Mux(hit, Mux1H(inWay, data.map(_(idx))), io.memDataOut)
+
+  when (hit) {
+    hits := hits + 1.U
+    lru(idx) := ~hitWay
+  }
+
+  when (fill) {
+    val victim = if (ways == 1) 0.U else lru(idx)
+    for (w <- 0 until ways) {
+      when (victim === w.U) {
+        tags(w)(idx)  := tag
+        data(w)(idx)  := io.memDataOut
+        valid(w)(idx) := true.B
+      }
+    }
+    lru(idx) := ~victim
+    misses   := misses + 1.U
+  }
+
+  val sIdx = io.snoopAddr(idxBits - 1, 0)
+  val sTag = io.snoopAddr(15, idxBits)
+
+  when (io.snoop) {
+    for (w <- 0 until ways) {
+      when (tags(w)(sIdx) === sTag) {
+        valid(w)(sIdx) := false.B
+      }
+    }
+  }
+
+  when (io.flush) {
+    for (w <- 0 until ways) {
+      valid(w).foreach(_ := false.B)
+    }
+  }
+
+  io.debugHits   := hits
+  io.debugMisses := misses
+}
@@ -47,3 +47,50 @@ class IntCtrl extends Module {
 
   io.out := Cat(tableReg, vecReg)
 }
+
+/*
+ * One device's interrupt request: whether it wants service,
+ * which vector (in the x01 table) and at what priority.
+ */
+class IRQLine extends Bundle {
+  val req  = Bool()
+  val vec  = UInt(8.W)
+  val prio = UInt(3.W)
+}
+
+/*
+ * Picks which device gets to interrupt the CPU (the "which
+ * device has the highest priority" box in Fig. 9.2). Of the
+ * lines requesting service, the highest priority wins; ties
+ * go to the lowest-numbered line. With no requests, the output
+ * priority is 0 so nothing can beat the running program.
+ *
+ * The control unit's acknowledge is routed back to whichever
+ * line won.
+ */
+class IRQArbiter(n: Int) extends Module {
+  val io = IO(new Bundle {
+    val in     = Input(Vec(n, new IRQLine))
+    val out    = Output(new IRQLine)
+    val chosen = Output(UInt(log2Ceil(n max 2).W))
+
+    val ack  = Input(Bool())
+    val acks = Output(Vec(n, Bool()))
+  })
+
+  val lines = io.in.zipWithIndex.map { case (l, i) => (l, i.U(log2Ceil(n max 2).W)) }
+
+  val (winner, idx) = lines.reduce { (a, b) =>
+    val takeB = b._1.req && (!a._1.req || b._1.prio > a._1.prio)
+    (Mux(takeB, b._1, a._1), Mux(takeB, b._2, a._2))
+  }
+
+  io.out.req  := winner.req
+  io.out.vec  := winner.vec
+  io.out.prio := Mux(winner.req, winner.prio, 0.U)
+  io.chosen   := idx
+
+  for (i <- 0 until n) {
+    io.acks(i) := io.ack && idx === i.U
+  }
+}
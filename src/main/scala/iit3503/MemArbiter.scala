@@ -0,0 +1,123 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+
+/*
+ * One side of the RAM handshake (see src/v/ram.v), from the
+ * point of view of whoever is making the access.
+ */
+class MemPort extends Bundle {
+  val en     = Output(Bool())
+  val wEn    = Output(Bool())
+  val dataIn = Output(UInt(16.W))
+  val addr   = Output(UInt(16.W))
+
+  val dataOut = Input(UInt(16.W))
+  val R       = Input(Bool())
+}
+
+/*
+ * Shares one memory port between n cores, round robin.
+ *
+ * An access is granted to one core and stays granted until
+ * memory says R for it, since the handshake needs the port held
+ * that long. Then the next core after it (that wants the port)
+ * goes. Everyone else just sees R low, and waits the same way
+ * they'd wait on a slow memory.
+ *
+ * Writes that land are broadcast on snoop so every core's
+ * I-cache can drop its copy.
+ */
+class MemArbiter(n: Int) extends Module {
+  val io = IO(new Bundle {
+    val in  = Flipped(Vec(n, new MemPort))
+    val out = new MemPort
+
+    val snoop     = Output(Bool())
+    val snoopAddr = Output(UInt(16.W))
+  })
+
+  val w = log2Ceil(n max 2)
+
+  val last  = RegInit((n - 1).U(w.W)) // core 0 goes first
+  val owner = RegInit(0.U(w.W))
+  val busy  = RegInit(false.B)        // owner is mid-access
+
+  val reqs = VecInit(io.in.map(_.en))
+
+  // first core after the last one served that wants the port
+  val order = (1 to n).map(i => ((last +& i.U) % n.U)(w - 1, 0))
+  val next  = PriorityMux(order.map(k => reqs(k) -> k))
+
+  val grant = Mux(busy && reqs(owner), owner, next)
+  val valid = reqs(grant)
+
+  io.out.en     := valid
+  io.out.wEn    := io.in(grant).wEn
+  io.out.dataIn := io.in(grant).dataIn
+  io.out.addr   := io.in(grant).addr
+
+  for (i <- 0 until n) {
+    io.in(i).R       := valid && grant === i.U && io.out.R
+    io.in(i).dataOut := io.out.dataOut
+  }
+
+  when (valid && io.out.R) {
+    busy := false.B
+    last := grant
+  } .elsewhen (valid) {
+    busy  := true.B
+    owner := grant
+  } .otherwise {
+    busy := false.B
+  }
+
+  io.snoop     := valid && io.out.wEn && io.out.R
+  io.snoopAddr := io.out.addr
+}
+
+
+/*
+ * A core's connection to the hardware spinlocks (LOCK0-7).
+ * req is a test-and-set (a read of LOCKn), rel is a release
+ * (any write to LOCKn).
+ */
+class LockPort extends Bundle {
+  val req = Output(Bool())
+  val rel = Output(Bool())
+  val idx = Output(UInt(3.W))
+  val old = Input(Bool()) // what the test-and-set read: 0 = got it
+}
+
+/*
+ * Test-and-set locks shared by all the cores. If two cores
+ * test-and-set the same lock in the same cycle, the lower
+ * numbered core gets it. A test-and-set sees the lock as it was
+ * before any release in the same cycle.
+ */
+class Spinlocks(n: Int, nLocks: Int = 8) extends Module {
+  val io = IO(new Bundle {
+    val ports = Flipped(Vec(n, new LockPort))
+  })
+
+  val held = RegInit(VecInit(Seq.fill(nLocks)(false.B)))
+
+  for (i <- 0 until n) {
+    val p      = io.ports(i)
+    val beaten = (0 until i).map(j => io.ports(j).req && io.ports(j).idx === p.idx)
+    p.old := held(p.idx) || beaten.foldLeft(false.B)(_ || _)
+  }
+
+  // releases go last, so they win over a same-cycle take
+  for (p <- io.ports) {
+    when (p.req) {
+      held(p.idx) := true.B
+    }
+  }
+  for (p <- io.ports) {
+    when (p.rel) {
+      held(p.idx) := false.B
+    }
+  }
+}
@@ -7,14 +7,18 @@ import chisel3.util._
 class DeviceRegister extends Bundle {
   val ready  = Bool()
   val int_en = Bool()
-  val unused = UInt(14.W)
+  val unused = UInt(6.W)
+  val level  = UInt(8.W) // characters waiting (keyboard only)
 }
 
 /*
  * Memory controller for the 3503
  * Interfaces with:
  * - the datapath
- * - I/O devices (just 2 for now)
+ * - I/O devices (keyboard, serial out)
+ * - the DMA engine (see DMA.scala)
+ * - the block device (see BlockDev.scala)
+ * - the spinlocks shared with the other cores (see MemArbiter.scala)
  * - main memory
  *
  * The memory controller implements the logic on the bottom of Figure C.3
@@ -37,9 +41,18 @@ class MemCtrl extends Module {
     // from datapath
     val bus   = Input(UInt(16.W))
 
-    // for keyboard
-    val devReady     = Input(Bool())
-    val devData      = Input(UInt(16.W))
+    // which core this is (read back through CPUID)
+    val coreId = Input(UInt(8.W))
+
+    // test-and-set locks (LOCK0-7)
+    val lock = new LockPort
+
+    // for keyboard (the RX FIFO, see FifoRx)
+    val rx          = Flipped(DecoupledIO(UInt(8.W)))
+    val rxLevel     = Input(UInt(8.W))
+    val rxDue       = Input(Bool())  // threshold or timeout reached
+    val rxThreshold = Output(UInt(8.W))
+    val rxTimeout   = Output(UInt(8.W))
 
     // to datapath 
     val mdrOut       = Output(UInt(16.W))
@@ -47,6 +60,17 @@ class MemCtrl extends Module {
     // tells datapath an int has fired
     val devIntEnable = Output(Bool())
 
+    // DMA transfer complete (goes to the interrupt arbiter)
+    val dmaIntReq = Output(Bool())
+
+    // block device: the host's side of the handshake, and its
+    // completion interrupt (goes to the interrupt arbiter)
+    val blk       = new BlockHostPort
+    val blkIntReq = Output(Bool())
+
+    // serial output is running low (goes to the interrupt arbiter)
+    val txIntReq = Output(Bool())
+
     // goes to top-level and control unit
     val mcrOut = Output(UInt(16.W))
 
@@ -60,7 +84,9 @@ class MemCtrl extends Module {
     val addr   = Output(UInt(16.W))
 
     // out to serial port
-    val tx = DecoupledIO(UInt(8.W))
+    val tx     = DecoupledIO(UInt(8.W))
+    val txLow  = Input(Bool()) // few characters left in the TX FIFO
+    val txIdle = Input(Bool()) // TX FIFO empty, line idle
 
     // DEBUG OUTPUTS
     val debugMDR = Output(UInt(16.W))
@@ -74,34 +100,58 @@ class MemCtrl extends Module {
   val MAR = RegInit(0.U(16.W))
 
   val addrCtrl = Module(new AddrCtrl)
+  val dma      = Module(new DMA)
+  val blkDev   = Module(new BlockDev)
 
   // device registers
-  val DSR = RegInit(0.U(16.W)) // device status reg
-  val DDR = RegInit(0.U(16.W)) // device data reg
+  val DSR  = RegInit(0.U(16.W)) // device status reg
+  val DDR  = RegInit(0.U(16.W)) // device data reg
+  val txIE = RegInit(false.B)   // DSR[14]: TX interrupt enable
 
   // keyboard regsiters
   val KBSR = RegInit(0.U.asTypeOf(new DeviceRegister))
-  val KBDR = RegInit(0.U(16.W))                   // keyboard data reg
+  val KBDR = Mux(io.rx.valid, io.rx.bits, 0.U(16.W)) // head of the RX FIFO
+  val KBCR = RegInit(1.U(16.W)) // keyboard control: [15:8] timeout, [7:0] threshold
 
   val MCR = RegInit(Cat(1.U(1.W), 0.U(15.W))) // machine control reg (bit 15 is clock enable bit)
 
   // short hands for control signals
   // from address control logic
   val ldKBSR   = addrCtrl.io.LDKBSR
+  val ldKBCR   = addrCtrl.io.LDKBCR
   val ldDSR    = addrCtrl.io.LDDSR
   val ldDDR    = addrCtrl.io.LDDDR
   val ldMCR    = addrCtrl.io.LDMCR
   val inMuxSel = addrCtrl.io.INMUX_SEL
 
   // tell datapath whether or not the device is set
-  // to enable interrupts
-  io.devIntEnable := KBSR.int_en & KBSR.ready
-
-  // connect DSR, DDR to serial output
-  DSR := Cat(io.tx.ready, 0.U(15.W))
+  // to enable interrupts. The keyboard interrupts once enough
+  // characters have piled up (or have been sitting there for
+  // long enough), not necessarily on every one.
+  io.devIntEnable := KBSR.int_en & io.rxDue
+
+  // reading KBDR consumes the character
+  io.rx.ready := addrCtrl.io.kbdrRead && io.LDMDR
+
+  // likewise, reading LOCKn takes the lock (if it's free)
+  io.lock.req := addrCtrl.io.lockRead && io.LDMDR
+  io.lock.rel := addrCtrl.io.LDLOCK
+  io.lock.idx := addrCtrl.io.lockIdx
+
+  io.rxThreshold := KBCR(7, 0)
+  io.rxTimeout   := KBCR(15, 8)
+
+  // connect DSR, DDR to serial output. DSR is:
+  // [15] ready (TX FIFO not full), [14] interrupt enable,
+  // [13] idle (everything written to DDR is out on the line)
+  DSR := Cat(io.tx.ready, txIE, io.txIdle, 0.U(13.W))
   io.tx.valid := RegNext(ldDDR)
   io.tx.bits  := DDR(7, 0)
 
+  // interrupt while the FIFO is running low, so the OS
+  // can top it up (or turn the interrupt off)
+  io.txIntReq := txIE && io.txLow
+
   // expose MDR to datapath
   io.mdrOut := MDR
 
@@ -109,38 +159,80 @@ class MemCtrl extends Module {
   io.mcrOut := MCR
 
   // wire up address controller
-  addrCtrl.io.MAR   := MAR
+  addrCtrl.io.bus   := io.bus
+  addrCtrl.io.LDMAR := io.LDMAR
   addrCtrl.io.MIOEN := io.MIOEN
   addrCtrl.io.RW    := io.RDWR
 
+  // wire up the DMA engine's registers
+  dma.io.wrData := MDR
+  dma.io.ldSrc  := addrCtrl.io.LDDMASRC
+  dma.io.ldDst  := addrCtrl.io.LDDMADST
+  dma.io.ldLen  := addrCtrl.io.LDDMALEN
+  dma.io.ldCtl  := addrCtrl.io.LDDMACTL
+  io.dmaIntReq  := dma.io.irq
+
+  // and the block device's
+  blkDev.io.wrData := MDR
+  blkDev.io.ldSec  := addrCtrl.io.LDBLKSEC
+  blkDev.io.ldAddr := addrCtrl.io.LDBLKADR
+  blkDev.io.ldCnt  := addrCtrl.io.LDBLKCNT
+  blkDev.io.ldCtl  := addrCtrl.io.LDBLKCTL
+  blkDev.io.done   := io.blk.done
+  blkDev.io.error  := io.blk.error
+  io.blk.req       := blkDev.io.req
+  io.blk.write     := blkDev.io.write
+  io.blk.sec       := blkDev.io.sec
+  io.blk.addr      := blkDev.io.addr
+  io.blk.cnt       := blkDev.io.cnt
+  io.blkIntReq     := blkDev.io.irq
+
+  // The DMA engine may use the memory port whenever the CPU
+  // isn't talking to the memory controller (or is halted)
+  val cpuOffPort = !io.MIOEN || !MCR(15)
+  val dmaOwns    = dma.io.req && cpuOffPort
+  dma.io.grant   := cpuOffPort
+  dma.io.memData := io.memData
+  dma.io.memR    := io.memR
+
   // wire up the memory
-  io.en     := addrCtrl.io.MEMEN
-  io.wEn    := io.RDWR
-  io.dataIn := MDR
-  io.addr   := MAR
-
-  io.R := MuxLookup(inMuxSel, io.memData, Seq( 
-    //0.U -> io.memR,
-    0.U -> true.B,
-    1.U -> true.B,
-    2.U -> true.B,
-    3.U -> true.B,
-    4.U -> true.B
-  ))
+  io.en     := Mux(dmaOwns, true.B, addrCtrl.io.MEMEN)
+  io.wEn    := Mux(dmaOwns, dma.io.wEn, io.RDWR)
+  io.dataIn := Mux(dmaOwns, dma.io.dataIn, MDR)
+  io.addr   := Mux(dmaOwns, dma.io.addr, MAR)
+
+  // memory says when it's done (see ExternalRAM). Device
+  // registers always answer in the cycle they're accessed.
+  io.R := Mux(addrCtrl.io.MEMEN, io.memR, true.B)
 
 
   // MMIO select: controls whether the MDR is loaded from:
   // - DSR (device status)
   // - KBSR (keyboard status)
   // - KBDR (keyboard data)
+  // - KBCR (keyboard control)
   // - MCR (machine control)
+  // - DMA registers
+  // - CPUID, LOCKn
+  // - block device registers
   // - Memory
   val INMUX  = MuxLookup(inMuxSel, io.memData, Seq(
     0.U -> io.memData,
     1.U -> DSR,
     2.U -> KBSR.asUInt(),
     3.U -> KBDR,
-    4.U -> MCR
+    4.U -> MCR,
+    5.U -> dma.io.src,
+    6.U -> dma.io.dst,
+    7.U -> dma.io.len,
+    8.U -> dma.io.ctl,
+    9.U -> KBCR,
+    10.U -> io.coreId,
+    11.U -> io.lock.old,
+    12.U -> blkDev.io.sec,
+    13.U -> blkDev.io.addr,
+    14.U -> blkDev.io.cnt,
+    15.U -> blkDev.io.ctl
   ))
 
   // Controls whether the MDR is loaded from the bus
@@ -155,10 +247,16 @@ class MemCtrl extends Module {
     KBSR := MDR.asTypeOf(new DeviceRegister)
   } 
 
-  KBSR.ready := io.devReady
+  KBSR.ready  := io.rx.valid
+  KBSR.unused := 0.U
+  KBSR.level  := io.rxLevel
+
+  when (ldKBCR) {
+    KBCR := MDR
+  }
 
   when (ldDSR) {
-    DSR := MDR
+    txIE := MDR(14) // the rest of DSR is status
   }
 
   when (ldDDR) {
@@ -169,8 +267,6 @@ class MemCtrl extends Module {
     MCR := MDR
   }
 
-  KBDR := io.devData
-
   // wire up debug signals
   io.debugMDR := MDR
   io.debugMAR := MAR
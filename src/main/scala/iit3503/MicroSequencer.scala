@@ -24,6 +24,9 @@ class MicroSequencer extends Module {
     val BEN      = Input(Bool())
     val PSR15    = Input(Bool())
     val ACV      = Input(Bool())
+    val ACVNow   = Input(Bool()) // ACV of the address on the bus this cycle
+    val MDReady  = Input(Bool()) // the multiply/divide unit is done
+    val MDOp     = Input(Bool()) // IR[4:3] names a multiply/divide op
 
     val ctrlAddr = Output(UInt(6.W)) // address of next state in control store
   })
@@ -38,42 +41,66 @@ class MicroSequencer extends Module {
                      Cat(0.U(2.W), io.IR15_11(4, 1)),  // if true 00 ++ IR[15:12]
                      condSide) // else logic below
 
+  // COND8 and up are the multiply/divide tests; the
+  // book's conditions all have COND(3) clear
+  val book = ~io.cFeed.COND(3)
+
+  // IFETCH test (COND7): checks for an interrupt and for an
+  // access violation on the fetch address in the same state
+  // that puts that address in MAR. ACV can't come from the
+  // ACV register here since it is only being loaded this cycle.
+  val fetch = book &
+              io.cFeed.COND(2) &
+              io.cFeed.COND(1) &
+              io.cFeed.COND(0)
+
   // Faults/Exceptions
-  val and1 = io.cFeed.COND(2) & 
-             io.cFeed.COND(1) &
-            ~io.cFeed.COND(0) & 
-             io.ACV
+  val and1 = (book &
+              io.cFeed.COND(2) & 
+              io.cFeed.COND(1) &
+             ~io.cFeed.COND(0) & 
+              io.ACV) |
+             (fetch & io.ACVNow)
 
   // Interrupt Present
-  val and2 = io.cFeed.COND(2) &
+  val and2 = book &
+             io.cFeed.COND(2) &
             ~io.cFeed.COND(1) &
              io.cFeed.COND(0) &
              io.INT
 
   // User Privilege Mode
-  val and3 = io.cFeed.COND(2) &
-            ~io.cFeed.COND(1) &
-            ~io.cFeed.COND(0) &
-             io.PSR15
+  val and3 = (book &
+              io.cFeed.COND(2) &
+             ~io.cFeed.COND(1) &
+             ~io.cFeed.COND(0) &
+              io.PSR15) |
+             (io.cFeed.COND === 9.U & io.MDOp) // not reserved
 
   // Branch 
   // TODO: job security
   val and4 = false.B
 
   // Ready
-  val and5 = ~io.cFeed.COND(2) &
+  val and5 = book &
+             ~io.cFeed.COND(2) &
              ~io.cFeed.COND(1) &
               io.cFeed.COND(0) &
               io.R
 
   // Addr mode
-  val and6 = ~io.cFeed.COND(2) &
+  val and6 = (book &
+             ~io.cFeed.COND(2) &
               io.cFeed.COND(1) &
               io.cFeed.COND(0) &
-              io.IR15_11(0)
+              io.IR15_11(0)) |
+             (io.cFeed.COND === 8.U & io.MDReady)   // MUL/DIV done
 
 
   val x = Cat(and1, and2, and3, and4, and5, and6)
 
-  condSide := x | io.cFeed.J
+  // an interrupt takes priority over a fetch ACV and goes
+  // straight to the INT entry (state 49), which J can't be
+  // ORed into along with the ACV state
+  condSide := Mux(fetch & io.INT, 49.U, x | io.cFeed.J)
 }
@@ -0,0 +1,121 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+
+
+/**
+  * Multiply/divide unit for opcode 1101 (MUL/DIV/MOD).
+  * This sits next to the ALU, but unlike the ALU it's
+  * multi-cycle: the control unit pulses start, waits
+  * for ready, and then gates out the result.
+  *
+  * All three ops are signed:
+  *   - MUL : low 16 bits of the product (1-8 cycles)
+  *   - DIV : quotient, truncated toward zero (16 cycles)
+  *   - MOD : remainder, with the sign of the dividend (16 cycles)
+  *
+  * Dividing by zero gives xFFFF (DIV) or the dividend (MOD)
+  * right away, and x8000 / -1 is x8000.
+  *
+  * MUL does two bits of in_b per cycle (a full 16x16 array
+  * doesn't fit in an HX1K, let alone at 50 MHz), and stops
+  * as soon as the bits left are all zero.
+  */
+trait MulDivConsts {
+  val mdMul = 1
+  val mdDiv = 2
+  val mdMod = 3
+}
+
+class MulDiv extends Module with MulDivConsts {
+  val io = IO(new Bundle {
+    val start = Input(Bool())
+    val op    = Input(UInt(2.W)) // IR[4:3]
+    val in_a  = Input(UInt(16.W))
+    val in_b  = Input(UInt(16.W))
+
+    val ready = Output(Bool()) // out is valid (until the next start)
+    val out   = Output(UInt(16.W))
+  })
+
+  val result = RegInit(0.U(16.W))
+  val ready  = RegInit(true.B)
+
+  // restoring division on the magnitudes, one quotient bit
+  // per cycle. The signs get patched up at the end.
+  val count = RegInit(0.U(5.W))
+  val rem   = RegInit(0.U(17.W))
+  val quo   = RegInit(0.U(16.W))
+  val dvsr  = RegInit(0.U(16.W))
+  val isDiv = RegInit(false.B)
+  val negQ  = RegInit(false.B)
+  val negR  = RegInit(false.B)
+
+  // shift-and-add multiply, low 16 bits only (which are
+  // the same signed or not)
+  val mulBusy = RegInit(false.B)
+  val mcand   = RegInit(0.U(16.W))
+  val mplier  = RegInit(0.U(16.W))
+
+  def abs(x: UInt) = Mux(x(15), (0.U - x)(15, 0), x)
+
+  when (io.start) {
+    when (io.op === mdMul.U) {
+      result  := 0.U
+      mcand   := io.in_a
+      mplier  := io.in_b
+      mulBusy := io.in_b =/= 0.U
+      ready   := io.in_b === 0.U
+      count   := 0.U
+    } .elsewhen (io.in_b === 0.U) {
+      result  := Mux(io.op === mdDiv.U, "hFFFF".U, io.in_a)
+      ready   := true.B
+      mulBusy := false.B
+      count   := 0.U
+    } .otherwise {
+      isDiv   := io.op === mdDiv.U
+      negQ    := io.in_a(15) ^ io.in_b(15)
+      negR    := io.in_a(15)
+      quo     := abs(io.in_a)
+      dvsr    := abs(io.in_b)
+      rem     := 0.U
+      count   := 16.U
+      ready   := false.B
+      mulBusy := false.B
+    }
+  } .elsewhen (mulBusy) {
+    val p0   = Mux(mplier(0), mcand, 0.U)
+    val p1   = Mux(mplier(1), mcand << 1, 0.U)
+    val sum  = (result + p0 + p1)(15, 0)
+    val rest = mplier >> 2
+
+    result := sum
+    mcand  := (mcand << 2)(15, 0)
+    mplier := rest
+
+    when (rest === 0.U) {
+      mulBusy := false.B
+      ready   := true.B
+    }
+  } .elsewhen (count =/= 0.U) {
+    val trial = Cat(rem(15, 0), quo(15))
+    val fits  = trial >= dvsr
+    val nRem  = Mux(fits, trial - dvsr, trial)
+    val nQuo  = Cat(quo(14, 0), fits)
+
+    rem   := nRem
+    quo   := nQuo
+    count := count - 1.U
+
+    when (count === 1.U) {
+      val q = Mux(negQ, 0.U - nQuo, nQuo)
+      val r = Mux(negR, 0.U - nRem(15, 0), nRem(15, 0))
+      result := Mux(isDiv, q, r)(15, 0)
+      ready  := true.B
+    }
+  }
+
+  io.ready := ready
+  io.out   := result
+}
@@ -1,5 +1,6 @@
 package iit3503
 import chisel3._
+import chisel3.util._
 
 /* 
  * This means that the RAM is actually
@@ -8,6 +9,8 @@ import chisel3._
  * other provider. We use this so our simulator
  * can set up RAM for us. 
  *
+ * The memory controller holds an access on the port until R
+ * comes back; read data is combinational. See src/v/ram.v.
  */
 class ExternalRAM extends BlackBox {
   val io = IO(new Bundle {
@@ -23,7 +26,16 @@ class ExternalRAM extends BlackBox {
 }
 
 
-class RAM(size: Int) extends Module {
+/*
+ * Chisel model of ExternalRAM's handshake (see src/v/ram.v),
+ * for tests. The port is held until R; reads are combinational
+ * and a write lands on the edge where R is asserted. Each access
+ * takes between minWait and maxWait extra cycles, picked when
+ * the access starts from an LFSR that steps once per access (the
+ * same seed and taps as ram.v's array model, so both pick the
+ * same wait states for the same accesses).
+ */
+class RAM(size: Int, minWait: Int = 0, maxWait: Int = 0) extends Module {
   val io = IO(new Bundle {
     val en     = Input(Bool())
     val wEn    = Input(Bool())
@@ -34,19 +46,35 @@ class RAM(size: Int) extends Module {
     val R       = Output(Bool())
   })
 
-  val mem = SyncReadMem(size, UInt(16.W))
+  require(minWait >= 0 && maxWait >= minWait && maxWait < 256)
+
+  val mem = Mem(size, UInt(16.W))
+
+  val held     = RegInit(0.U(8.W))
+  val heldAddr = RegNext(io.addr)
+  val heldWEn  = RegNext(io.wEn)
+  val waited   = Mux(io.addr === heldAddr && io.wEn === heldWEn, held, 0.U)
 
-  io.dataOut := DontCare
+  // wait states for this access: fixed when it starts
+  val lfsr  = RegInit("hACE1".U(16.W))
+  val span  = maxWait - minWait + 1
+  val pick  = if (span == 1) 0.U else lfsr % span.U
+  val need  = RegInit(minWait.U(8.W))
+  val needs = Mux(waited === 0.U, minWait.U + pick, need)
+  need := needs
 
-  when (io.en) {
-    val rdwrPort = mem(io.addr)
-    when (io.wEn) { // write
+  io.R       := io.en && waited >= needs
+  io.dataOut := Mux(io.en, mem(io.addr), 0.U)
+
+  when (io.en && io.R) {
+    when (io.wEn) {
       mem(io.addr) := io.dataIn
-    } .otherwise {
-      io.dataOut := rdwrPort
     }
+    lfsr := Cat(lfsr(14, 0), lfsr(15) ^ lfsr(13) ^ lfsr(12) ^ lfsr(10))
+    held := 0.U
+  } .elsewhen (io.en) {
+    held := waited + 1.U
+  } .otherwise {
+    held := 0.U
   }
-
-  io.R := true.B // single cycle access assumed
 }
-
@@ -14,25 +14,42 @@ import chisel3.stage.{ChiselStage, ChiselGeneratorAnnotation}
  * This is pretty common for top-level modules in bigger projects.
  * Notice you don't see any combinational or sequential logic here.
  *
+ * The machine can have more than one core (see Core.scala). They
+ * share memory through a MemArbiter, and the spinlocks (LOCK0-7).
+ * Core 0 boots the machine and owns the keyboard, display and disk. The
+ * debug ports show whichever core debugCore picks.
+ *
+ * chiseltest can't simulate ExternalRAM (it's Verilog), so a
+ * test can ask for a Chisel RAM of testRAM words instead, with
+ * testWait wait states on every access (see RAM.scala).
+ *
  */
 
-class Top extends Module {
+class Top(nCores: Int = 1, testRAM: Int = 0, testWait: Int = 0) extends Module with UARTConsts {
+  require(nCores >= 1 && nCores <= 8)
 
   val io = IO(new Bundle{
 
     val resetVec = Input(UInt(16.W))
+    // where cores 1 and up start (core 0 starts at resetVec)
+    val apVec    = if (nCores > 1) Some(Input(UInt(16.W))) else None
 
     val intv        = Input(UInt(8.W))
     val intPriority = Input(UInt(3.W))
 
-    val devReady = Input(Bool()) // keyboard has input
+    val devReady = Input(Bool()) // strobe: push devData[7:0] into the keyboard FIFO
     val devData  = Input(UInt(16.W)) // keyboard data
+    val icFlush  = Input(Bool()) // strobe: RAM changed behind the machine's back
+
+    val blk = new BlockHostPort // the harness carries out block device commands
 
+    val uartRxd = Input(Bool())  // keyboard input, as a serial line
     val uartTxd = Output(Bool())
-    val halt    = Output(Bool())
-    val intAck  = Output(Bool())
+    val halt    = Output(Bool()) // core 0 is halted
+    val intAck  = Output(Bool()) // the *keyboard* interrupt was taken
 
     /* DEBUG OUTPUTS */
+    val debugCore = Input(UInt(8.W)) // which core the ports below show
     val debugPC  = Output(UInt(16.W))
     val debugIR  = Output(UInt(16.W))
     val debugPSR = Output(UInt(16.W))
@@ -51,102 +68,136 @@ class Top extends Module {
     val debugDSR = Output(UInt(16.W))
     val debugMCR = Output(UInt(16.W))
     val debugBus = Output(UInt(16.W))
+    val debugICHits   = Output(UInt(32.W))
+    val debugICMisses = Output(UInt(32.W))
+    val debugHalt     = Output(Bool())
   })
 
-  val ctrlUnit = Module(new Control)    // top-level control unit
-  val memCtrl  = Module(new MemCtrl)    // memory controller
-  val mem      = Module(new ExternalRAM)
-  val intCtrl  = Module(new IntCtrl)    // interrupt controller
-  val dataPath = Module(new DataPath)   // datapath
-
-  val serialOut = Module(new BufferedTx(50000000, 115200))
-
-  val ctrl = ctrlUnit.io.ctrlLines
-
-  // wire control unit to datapath
-  dataPath.io.ctrlSigs := ctrl
-  ctrlUnit.io.IR       := dataPath.io.ir
-  ctrlUnit.io.bus      := dataPath.io.bus
-  ctrlUnit.io.PSR15    := dataPath.io.psr15
-  ctrlUnit.io.N        := dataPath.io.n
-  ctrlUnit.io.Z        := dataPath.io.z
-  ctrlUnit.io.P        := dataPath.io.p
-  ctrlUnit.io.BEN      := dataPath.io.bEn
-  ctrlUnit.io.ACV      := dataPath.io.ACV
-  ctrlUnit.io.INT      := dataPath.io.irq
-
-  // wire memory controller to datapath
-  dataPath.io.mdrVal       := memCtrl.io.mdrOut
-  dataPath.io.devIntEnable := memCtrl.io.devIntEnable
-  memCtrl.io.bus           := dataPath.io.bus
-
-  // wire up memory to memory controller
-  memCtrl.io.memR    := mem.io.R
-  memCtrl.io.memData := mem.io.dataOut
-  mem.io.en          := memCtrl.io.en
-  mem.io.wEn         := memCtrl.io.wEn
-  mem.io.dataIn      := memCtrl.io.dataIn
-  mem.io.addr        := memCtrl.io.addr
-
-  // since this memory is a black box (external)
-  // module, it needs to have our clock connected to it
-  mem.io.clk := clock
-  
-  // wire memory controller up to control unit
-  ctrlUnit.io.R    := memCtrl.io.R
-  ctrlUnit.io.halt := ~memCtrl.io.mcrOut(15)
-  memCtrl.io.LDMDR := ctrl.LDMDR
-  memCtrl.io.MIOEN := ctrl.MIOEN
-  memCtrl.io.LDMAR := ctrl.LDMAR
-  memCtrl.io.RDWR  := ctrl.RW
-
-  // bit 15 of MCR is "clock enable" bit
-  io.halt := ~memCtrl.io.mcrOut(15)
-
-  // wire up control unit to interrupt controller
-  intCtrl.io.VectorMux := ctrl.VectorMUX
-  intCtrl.io.TableMux  := ctrl.TableMUX
-  intCtrl.io.LDVector  := ctrl.LDVector
-
-  // wire up datapath to interrupt controller
-  intCtrl.io.bus             := dataPath.io.bus
-  dataPath.io.intHandlerAddr := intCtrl.io.out
+  val cores = Seq.tabulate(nCores) { i =>
+    Module(new Core).suggestName(s"core$i")
+  }
+  val arb    = Module(new MemArbiter(nCores)) // everyone shares mem
+  val locks  = Module(new Spinlocks(nCores))
+
+  val serialOut = Module(new FifoTx(50000000, 115200, txFifoDepth, txLowWater))
+  val serialIn  = Module(new FifoRx(50000000, 115200, rxFifoDepth))
+
+  if (testRAM > 0) {
+    val mem = Module(new RAM(testRAM, testWait, testWait)).suggestName("mem")
+    mem.io.en     := arb.io.out.en
+    mem.io.wEn    := arb.io.out.wEn
+    mem.io.dataIn := arb.io.out.dataIn
+    mem.io.addr   := arb.io.out.addr
+    arb.io.out.dataOut := mem.io.dataOut
+    arb.io.out.R       := mem.io.R
+  } else {
+    // since this memory is a black box (external)
+    // module, it needs to have our clock connected to it.
+    // The simulator finds it by name (Top.mem).
+    val mem = Module(new ExternalRAM).suggestName("mem")
+    mem.io.clk    := clock
+    mem.io.en     := arb.io.out.en
+    mem.io.wEn    := arb.io.out.wEn
+    mem.io.dataIn := arb.io.out.dataIn
+    mem.io.addr   := arb.io.out.addr
+    arb.io.out.dataOut := mem.io.dataOut
+    arb.io.out.R       := mem.io.R
+  }
+
+  for ((core, i) <- cores.zipWithIndex) {
+    core.io.coreId := i.U
+
+    // core 0 boots the machine. This is either the techOS entry
+    // point (x02CA) or the .ORIG of a user program. The others
+    // start wherever the harness says, and tell themselves apart
+    // by reading CPUID.
+    core.io.resetVec := (if (i == 0) io.resetVec else io.apVec.get)
+
+    arb.io.in(i) <> core.io.mem
+    core.io.snoop     := arb.io.snoop
+    core.io.snoopAddr := arb.io.snoopAddr
+    core.io.icFlush   := io.icFlush
+
+    locks.io.ports(i) <> core.io.lock
+
+    core.io.intv        := io.intv
+    core.io.intPriority := io.intPriority
+
+    // the devices belong to core 0. Everyone else sees a keyboard
+    // that never has anything, and a display that eats everything.
+    if (i != 0) {
+      core.io.rx.valid  := false.B
+      core.io.rx.bits   := 0.U
+      core.io.rxLevel   := 0.U
+      core.io.rxDue     := false.B
+      core.io.tx.ready  := true.B
+      core.io.txLow     := false.B
+      core.io.txIdle    := true.B
+      core.io.blk.done  := false.B
+      core.io.blk.error := false.B
+    }
+  }
+
+  val boot = cores(0).io
+
+  io.halt   := boot.halt
+  io.intAck := boot.intAck
+
+  io.blk <> boot.blk
 
   io.uartTxd := serialOut.io.txd
-  serialOut.io.channel <> memCtrl.io.tx
+  serialOut.io.channel <> boot.tx
+  boot.txLow  := serialOut.io.low
+  boot.txIdle := serialOut.io.idle
 
   // wire up the keyboard device
-  dataPath.io.intPriority := io.intPriority
-  intCtrl.io.INTV         := io.intv
-  memCtrl.io.devReady     := io.devReady
-  memCtrl.io.devData      := io.devData
-  io.intAck               := ctrlUnit.io.intAck
-
-  // This is either the techOS entry point (x02CA) or
-  // the .ORIG of a user program
-  dataPath.io.resetVec := io.resetVec
+  serialIn.io.rxd          := io.uartRxd
+  serialIn.io.inject.valid := io.devReady
+  serialIn.io.inject.bits  := io.devData(7, 0)
+  serialIn.io.threshold    := boot.rxThreshold
+  serialIn.io.timeout      := boot.rxTimeout
+  boot.rx                  <> serialIn.io.channel
+  boot.rxLevel             := serialIn.io.level
+  boot.rxDue               := serialIn.io.due
 
   /* DEBUG PORTS */
-  io.debugPC  := dataPath.io.debugPC
-  io.debugIR  := dataPath.io.debugIR
-  io.debugPSR := dataPath.io.debugPSR
-  io.debugR0  := dataPath.io.debugR0
-  io.debugR1  := dataPath.io.debugR1
-  io.debugR2  := dataPath.io.debugR2
-  io.debugR3  := dataPath.io.debugR3
-  io.debugR4  := dataPath.io.debugR4
-  io.debugR5  := dataPath.io.debugR5
-  io.debugR6  := dataPath.io.debugR6
-  io.debugR7  := dataPath.io.debugR7
-  io.debuguPC := ctrlUnit.io.debuguPC
-  io.debugMDR := memCtrl.io.debugMDR
-  io.debugMAR := memCtrl.io.debugMAR
-  io.debugBus := dataPath.io.bus
-  io.debugDSR := memCtrl.io.debugDSR
-  io.debugDDR := memCtrl.io.debugDDR
-  io.debugMCR := memCtrl.io.debugMCR
+  val dbgSel = Mux(io.debugCore < nCores.U, io.debugCore, 0.U)
+  val dbg    = if (nCores == 1) cores(0).io.debug
+               else VecInit(cores.map(_.io.debug))(dbgSel)
+  val dbgHalt = if (nCores == 1) boot.halt
+                else VecInit(cores.map(_.io.halt))(dbgSel)
+
+  io.debugPC  := dbg.PC
+  io.debugIR  := dbg.IR
+  io.debugPSR := dbg.PSR
+  io.debugR0  := dbg.R(0)
+  io.debugR1  := dbg.R(1)
+  io.debugR2  := dbg.R(2)
+  io.debugR3  := dbg.R(3)
+  io.debugR4  := dbg.R(4)
+  io.debugR5  := dbg.R(5)
+  io.debugR6  := dbg.R(6)
+  io.debugR7  := dbg.R(7)
+  io.debuguPC := dbg.uPC
+  io.debugMDR := dbg.MDR
+  io.debugMAR := dbg.MAR
+  io.debugBus := dbg.bus
+  io.debugDSR := dbg.DSR
+  io.debugDDR := dbg.DDR
+  io.debugMCR := dbg.MCR
+  io.debugICHits   := dbg.ICHits
+  io.debugICMisses := dbg.ICMisses
+  io.debugHalt     := dbgHalt
 }
 
+/*
+ * Usage: SimMain [--cores n] <ChiselStage args>
+ */
 object SimMain extends App {
-  (new ChiselStage).execute(args, Seq(ChiselGeneratorAnnotation(() => new Top)))
+  val (nCores, rest) = args.toList match {
+    case "--cores" :: n :: tail => (n.toInt, tail)
+    case other                  => (1, other)
+  }
+  (new ChiselStage).execute(rest.toArray,
+    Seq(ChiselGeneratorAnnotation(() => new Top(nCores))))
 }
@@ -23,6 +23,7 @@ class Tx(frequency: Int, baudRate: Int) extends Module {
   val io = IO(new Bundle {
     val txd     = Output(UInt(1.W))
     val channel = Flipped(new UartIO())
+    val idle    = Output(Bool()) // not in the middle of a frame
   })
 
   val BIT_CNT = ((frequency + baudRate / 2) / baudRate - 1).asUInt()
@@ -33,6 +34,7 @@ class Tx(frequency: Int, baudRate: Int) extends Module {
 
   io.channel.ready := (cntReg === 0.U) && (bitsReg === 0.U)
   io.txd := shiftReg(0)
+  io.idle := bitsReg === 0.U
 
   when(cntReg === 0.U) {
 
@@ -148,6 +150,102 @@ class BufferedTx(frequency: Int, baudRate: Int) extends Module {
   io.txd <> tx.io.txd
 }
 
+// the 3503's serial port (see FifoTx), and its TX interrupt line
+trait UARTConsts {
+  val txFifoDepth = 16
+  val txLowWater  = 4
+  val txIntVec    = 0x82
+  val txIntPrio   = 4
+  val rxFifoDepth = 16
+}
+
+/*
+ * The 3503's serial port: a transmitter with a FIFO in front of it,
+ * so the OS can hand over a burst of characters at once instead of
+ * waiting on the line for each one.
+ *
+ *  - channel.ready: the FIFO isn't full (this is DSR[15])
+ *  - low:  at most lowWater characters are still waiting to go out.
+ *          This is what raises the TX interrupt.
+ *  - idle: the FIFO is empty and the last frame is completely out
+ */
+class FifoTx(frequency: Int, baudRate: Int, depth: Int, lowWater: Int) extends Module {
+  require(depth >= 1 && lowWater >= 0 && lowWater < depth)
+
+  val io = IO(new Bundle {
+    val txd     = Output(UInt(1.W))
+    val channel = Flipped(new UartIO())
+    val low     = Output(Bool())
+    val idle    = Output(Bool())
+  })
+
+  val tx   = Module(new Tx(frequency, baudRate))
+  val fifo = Module(new Queue(UInt(8.W), depth))
+
+  fifo.io.enq <> io.channel
+  tx.io.channel <> fifo.io.deq
+  io.txd  := tx.io.txd
+  io.low  := fifo.io.count <= lowWater.U
+  io.idle := fifo.io.count === 0.U && tx.io.idle
+}
+
+/*
+ * The 3503's keyboard port: a receiver with a FIFO behind it. Host
+ * input comes in on the serial line (rxd), or on inject for a
+ * harness that wants to hand a byte over directly.
+ *
+ *  - channel: the oldest character (this is KBDR); reading it
+ *             (channel.ready) takes it out
+ *  - level:   how many characters are waiting
+ *  - due:     time to interrupt. Either at least threshold characters
+ *             are waiting, or some are and the line has been quiet for
+ *             timeout bit times (0 = never time out). That way a burst
+ *             of input costs one interrupt rather than one per byte.
+ */
+class FifoRx(frequency: Int, baudRate: Int, depth: Int) extends Module {
+  require(depth >= 1 && depth < 256)
+
+  val io = IO(new Bundle {
+    val rxd       = Input(UInt(1.W))
+    val inject    = Flipped(Valid(UInt(8.W)))
+    val channel   = new UartIO()
+    val level     = Output(UInt(8.W))
+    val threshold = Input(UInt(8.W))
+    val timeout   = Input(UInt(8.W))
+    val due       = Output(Bool())
+  })
+
+  val rx   = Module(new Rx(frequency, baudRate))
+  val arb  = Module(new Arbiter(UInt(8.W), 2))
+  val fifo = Module(new Queue(UInt(8.W), depth))
+
+  // an injected byte wins; Rx holds on to its byte for a cycle.
+  // Anything that arrives while the FIFO is full is lost.
+  rx.io.rxd          := io.rxd
+  arb.io.in(0).valid := io.inject.valid
+  arb.io.in(0).bits  := io.inject.bits
+  arb.io.in(1)       <> rx.io.channel
+  fifo.io.enq        <> arb.io.out
+  io.channel         <> fifo.io.deq
+  io.level           := fifo.io.count
+
+  // how long (in bit times) since the last character came in
+  val bitCycles = (frequency + baudRate / 2) / baudRate
+  val (_, tick) = Counter(true.B, bitCycles)
+  val quiet     = RegInit(0.U(8.W))
+
+  when (fifo.io.enq.fire() || fifo.io.count === 0.U) {
+    quiet := 0.U
+  } .elsewhen (tick && quiet =/= 255.U) {
+    quiet := quiet + 1.U
+  }
+
+  val threshold = Mux(io.threshold === 0.U, 1.U, io.threshold)
+
+  io.due := fifo.io.count >= threshold ||
+            (io.timeout =/= 0.U && fifo.io.count =/= 0.U && quiet >= io.timeout)
+}
+
 /**
   * Send a string.
   */
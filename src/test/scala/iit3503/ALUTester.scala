@@ -68,6 +68,69 @@ class ALUTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
     } 
   }
 
-} 
+  behavior of "MulDiv"
 
+  def s16(x: Int) = (x & 0xffff).U
 
+  // start an op and wait for it; returns how many cycles
+  // it took for ready to come back
+  def run(c: MulDiv, op: Int, a: Int, b: Int) : Int = {
+    c.io.start.poke(true.B)
+    c.io.op.poke(op.U)
+    c.io.in_a.poke(s16(a))
+    c.io.in_b.poke(s16(b))
+    c.clock.step(1)
+    c.io.start.poke(false.B)
+    var n = 1
+    while (!c.io.ready.peek().litToBoolean) {
+      c.clock.step(1)
+      n += 1
+      n should be < (100)
+    }
+    n
+  }
+
+  // two bits of in_b per cycle, stopping once the rest are zero
+  def mulCycles(b: Int) = 1 + (32 - Integer.numberOfLeadingZeros(b & 0xffff) + 1) / 2
+
+  it should "MUL properly" in {
+    test(new MulDiv()) { c =>
+      for (i <- -20 to 20) {
+        for (j <- -20 to 20) {
+          run(c, 1, i, j) should be (mulCycles(j))
+          c.io.out.expect(s16(i*j))
+        }
+      }
+      run(c, 1, 1234, 0) should be (1)
+      run(c, 1, 3, -1) should be (9) // all 16 bits
+      c.io.out.expect(s16(-3))
+      run(c, 1, 300, 300)
+      c.io.out.expect(s16(90000)) // low 16 bits
+    }
+  }
+
+  it should "DIV and MOD like C does" in {
+    test(new MulDiv()) { c =>
+      for (i <- Seq(-32768, -1000, -7, -1, 0, 1, 6, 7, 1000, 32767)) {
+        for (j <- Seq(-32768, -9, -3, -1, 1, 2, 3, 7, 500)) {
+          run(c, 2, i, j) should be (17)
+          c.io.out.expect(s16(i / j))
+          run(c, 3, i, j) should be (17)
+          c.io.out.expect(s16(i % j))
+        }
+      }
+      run(c, 2, -32768, -1)
+      c.io.out.expect("h8000".U) // overflows back to itself
+    }
+  }
+
+  it should "give up right away on divide by zero" in {
+    test(new MulDiv()) { c =>
+      run(c, 2, 1234, 0) should be (1)
+      c.io.out.expect("hFFFF".U)
+      run(c, 3, 1234, 0) should be (1)
+      c.io.out.expect(1234.U)
+    }
+  }
+
+}
@@ -0,0 +1,99 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+import chiseltest._
+import chiseltest.experimental.TestOptionBuilder._
+import org.scalatest._
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+class BlockDevTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+  behavior of "Block Device"
+
+  def writeReg(c: BlockDev, ld: Bool, v: Int) = {
+    c.io.wrData.poke(v.U)
+    ld.poke(true.B)
+    c.clock.step(1)
+    ld.poke(false.B)
+  }
+
+  def ctl(c: BlockDev) = c.io.ctl.peek().litValue().toInt
+
+  // the host finishing a command
+  def finish(c: BlockDev, error: Boolean = false) = {
+    c.io.done.poke(true.B)
+    c.io.error.poke(error.B)
+    c.clock.step(1)
+    c.io.done.poke(false.B)
+    c.io.error.poke(false.B)
+  }
+
+  it should "ask the host for what was programmed" in {
+    test(new BlockDev()) { c =>
+      writeReg(c, c.io.ldSec, 42)
+      writeReg(c, c.io.ldAddr, 0x4000)
+      writeReg(c, c.io.ldCnt, 2)
+      c.io.req.expect(false.B)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      c.io.req.expect(true.B)
+      c.io.write.expect(false.B)
+      c.io.sec.expect(42.U)
+      c.io.addr.expect(0x4000.U)
+      c.io.cnt.expect(2.U)
+      ctl(c) should be (0x0001)
+      c.clock.step(10)
+      c.io.req.expect(true.B)
+      finish(c)
+      c.io.req.expect(false.B)
+      ctl(c) should be (0x8000)
+    }
+  }
+
+  it should "say which way the data goes" in {
+    test(new BlockDev()) { c =>
+      writeReg(c, c.io.ldCnt, 1)
+      writeReg(c, c.io.ldCtl, 0x0003)
+      c.io.write.expect(true.B)
+      ctl(c) should be (0x0003)
+    }
+  }
+
+  it should "leave its registers alone while busy" in {
+    test(new BlockDev()) { c =>
+      writeReg(c, c.io.ldSec, 1)
+      writeReg(c, c.io.ldCnt, 1)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      writeReg(c, c.io.ldSec, 7)
+      writeReg(c, c.io.ldCnt, 9)
+      c.io.sec.expect(1.U)
+      c.io.cnt.expect(1.U)
+      finish(c)
+      writeReg(c, c.io.ldSec, 7)
+      c.io.sec.expect(7.U)
+    }
+  }
+
+  it should "report errors, and interrupt until acknowledged" in {
+    test(new BlockDev()) { c =>
+      writeReg(c, c.io.ldCnt, 1)
+      writeReg(c, c.io.ldCtl, 0x4001)
+      c.io.irq.expect(false.B)
+      finish(c, error = true)
+      ctl(c) should be (0xE000)
+      c.io.irq.expect(true.B)
+      writeReg(c, c.io.ldCtl, 0x4000)
+      c.io.irq.expect(false.B)
+      ctl(c) should be (0x4000)
+    }
+  }
+
+  it should "finish right away with nothing to do" in {
+    test(new BlockDev()) { c =>
+      writeReg(c, c.io.ldCnt, 0)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      c.io.req.expect(false.B)
+      ctl(c) should be (0x8000)
+    }
+  }
+}
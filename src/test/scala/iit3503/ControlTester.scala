@@ -11,6 +11,13 @@ import org.scalatest.matchers.should.Matchers
 class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
   behavior of "Control Unit"
 
+  // IFETCH decodes the instruction while it's on the bus on its
+  // way into IR, and later states look at IR itself
+  def fetched(c: Control, ir: UInt) = {
+    c.io.IR.poke(ir)
+    c.io.bus.poke(ir)
+  }
+
   it should "start in IFETCH state (18)" in {
     test(new Control()) { c =>
       c.io.debuguPC.expect(18.U)
@@ -20,7 +27,7 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
   it should "go through unexceptional IFETCH sequence properly" in {
     test(new Control()) { c =>
       // note ACV and INT are not asserted
-      val states = List(18, 33, 28, 30, 32)
+      val states = List(18, 28, 30)
       c.io.R.poke(true.B) // assume the fetch read is complete
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
@@ -41,11 +48,23 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
     }
   }
 
+  it should "take an interrupt ahead of an IFETCH ACV" in {
+    test(new Control()) { c =>
+      val states = List(18, 49)
+      c.io.INT.poke(true.B)
+      c.io.ACVNow.poke(true.B)
+      for (s <- states) {
+        c.io.debuguPC.expect(s.U)
+        c.clock.step(1)
+      }
+    }
+  }
+
   it should "initiate the ACV sequence properly in an IFETCH" in {
     test(new Control()) { c =>
       // note ACV and INT are not asserted
-      val states = List(18, 33, 60)
-      c.io.ACV.poke(true.B) // IRQ requested
+      val states = List(18, 60)
+      c.io.ACVNow.poke(true.B) // fetching from a protected address
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -56,7 +75,7 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
   it should "actually wait for memory in an IFETCH" in {
     test(new Control()) { c =>
       // note ACV and INT are not asserted
-      val states = List(18, 33, 28, 28, 28, 28)
+      val states = List(18, 28, 28, 28, 28)
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -70,9 +89,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
     }
 
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 1, 18)
+      val states = List(18, 28, 30, 1, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h1000".U) // simulated ADD
+      fetched(c, "h1000".U) // simulated ADD
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -82,9 +101,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through ADD states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 1, 18)
+      val states = List(18, 28, 30, 1, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h1000".U) // simulated ADD
+      fetched(c, "h1000".U) // simulated ADD
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -94,9 +113,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through AND states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 5, 18)
+      val states = List(18, 28, 30, 5, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h5000".U) // simulated AND
+      fetched(c, "h5000".U) // simulated AND
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -106,9 +125,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through NOT states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 9, 18)
+      val states = List(18, 28, 30, 9, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h9000".U) // simulated NOT
+      fetched(c, "h9000".U) // simulated NOT
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -118,9 +137,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through LEA states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 14, 18)
+      val states = List(18, 28, 30, 14, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("he000".U) // simulated LEA
+      fetched(c, "he000".U) // simulated LEA
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -130,9 +149,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through LD states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 2, 35, 25, 27, 18)
+      val states = List(18, 28, 30, 2, 35, 25, 27, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h2000".U) // simulated LD
+      fetched(c, "h2000".U) // simulated LD
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -142,9 +161,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through LDR states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 6, 35, 25, 27, 18)
+      val states = List(18, 28, 30, 6, 35, 25, 27, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h6000".U) // simulated LDR
+      fetched(c, "h6000".U) // simulated LDR
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -154,9 +173,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through LDI states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 10, 17, 24, 26, 35, 25, 27, 18)
+      val states = List(18, 28, 30, 10, 17, 24, 26, 35, 25, 27, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("ha000".U) // simulated LDI
+      fetched(c, "ha000".U) // simulated LDI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -166,9 +185,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through STI states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 11, 19, 29, 31, 23, 16, 18)
+      val states = List(18, 28, 30, 11, 19, 29, 31, 23, 16, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("hb000".U) // simulated STI
+      fetched(c, "hb000".U) // simulated STI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -178,9 +197,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through STR states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 7, 23, 16, 18)
+      val states = List(18, 28, 30, 7, 23, 16, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h7000".U) // simulated STR
+      fetched(c, "h7000".U) // simulated STR
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -190,9 +209,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through ST states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 3, 23, 16, 18)
+      val states = List(18, 28, 30, 3, 23, 16, 18)
       c.io.R.poke(true.B) // assume memory is ready
-      c.io.IR.poke("h3000".U) // simulated ST
+      fetched(c, "h3000".U) // simulated ST
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -202,9 +221,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through JSR states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 4, 21, 18)
+      val states = List(18, 28, 30, 4, 21, 18)
       c.io.R.poke(true.B)
-      c.io.IR.poke("h4800".U) // simulated JSR 
+      fetched(c, "h4800".U) // simulated JSR 
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -214,9 +233,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through JSRR states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 4, 20, 18)
+      val states = List(18, 28, 30, 4, 20, 18)
       c.io.R.poke(true.B)
-      c.io.IR.poke("h4000".U) // simulated JSRR
+      fetched(c, "h4000".U) // simulated JSRR
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -226,9 +245,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through JMP states properly " in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 12, 18)
+      val states = List(18, 28, 30, 12, 18)
       c.io.R.poke(true.B)
-      c.io.IR.poke("hc000".U) // simulated JMP
+      fetched(c, "hc000".U) // simulated JMP
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -238,9 +257,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through BR states properly when branch not taken" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 0, 18)
+      val states = List(18, 28, 30, 0, 18)
       c.io.R.poke(true.B)
-      c.io.IR.poke("h0000".U) // simulated BR
+      fetched(c, "h0000".U) // simulated BR
       c.io.BEN.poke(false.B) // branch not taken
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
@@ -251,9 +270,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through BR states properly when branch taken" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 0, 22, 18)
+      val states = List(18, 28, 30, 0, 22, 18)
       c.io.R.poke(true.B)
-      c.io.IR.poke("h0000".U) // simulated BR
+      fetched(c, "h0000".U) // simulated BR
       c.io.BEN.poke(true.B) // branch taken
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
@@ -264,9 +283,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "handle ACV properly on an LD" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 2)
+      val states = List(18, 28, 30, 2)
       c.io.R.poke(true.B)
-      c.io.IR.poke("h2000".U) // simulated LD
+      fetched(c, "h2000".U) // simulated LD
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -284,9 +303,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "handle ACV properly on LDI indirect access" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 10)
+      val states = List(18, 28, 30, 10)
       c.io.R.poke(true.B)
-      c.io.IR.poke("ha000".U) // simulated LDI
+      fetched(c, "ha000".U) // simulated LDI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -305,10 +324,10 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through undefined opcode states properly in supervisor mode" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 13, 62, 37, 41, 43, 46, 52, 54, 53, 55, 18)
+      val states = List(18, 28, 30, 13, 62, 37, 41, 43, 46, 52, 54, 53, 55, 18)
       c.io.PSR15.poke(false.B) // supervisor mode
       c.io.R.poke(true.B)
-      c.io.IR.poke("hd000".U) // simulated UD
+      fetched(c, "hd000".U) // simulated UD
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -318,10 +337,10 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through undefined opcode states properly in user mode" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 13, 62, 45, 37, 41, 43, 46, 52, 54, 53, 55, 18)
+      val states = List(18, 28, 30, 13, 62, 45, 37, 41, 43, 46, 52, 54, 53, 55, 18)
       c.io.PSR15.poke(true.B) // user mode
       c.io.R.poke(true.B)
-      c.io.IR.poke("hd000".U) // simulated UD
+      fetched(c, "hd000".U) // simulated UD
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -329,12 +348,46 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
     }
   }
 
+  it should "go through MUL states properly" in {
+    test(new Control()) { c =>
+      val states = List(18, 28, 30, 13, 58, 32, 33, 18)
+      c.io.R.poke(true.B)
+      c.io.mdReady.poke(true.B) // a quick multiply
+      fetched(c, "hd04a".U) // MUL R0, R1, R2
+      for (s <- states) {
+        c.io.debuguPC.expect(s.U)
+        c.clock.step(1)
+      }
+    }
+  }
+
+  it should "wait for the unit on a DIV" in {
+    test(new Control()) { c =>
+      c.io.R.poke(true.B)
+      c.io.mdReady.poke(false.B)
+      fetched(c, "hd0b3".U) // DIV R0, R2, #3
+      for (s <- List(18, 28, 30, 13, 58)) {
+        c.io.debuguPC.expect(s.U)
+        c.clock.step(1)
+      }
+      for (i <- 0 until 5) {
+        c.io.debuguPC.expect(32.U)
+        c.clock.step(1)
+      }
+      c.io.mdReady.poke(true.B)
+      for (s <- List(32, 33, 18)) {
+        c.io.debuguPC.expect(s.U)
+        c.clock.step(1)
+      }
+    }
+  }
+
   it should "respect the old gods and the new" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 13, 63, 18)
+      val states = List(18, 28, 30, 13, 50, 63, 18)
       c.io.PSR15.poke(true.B) // user mode
       c.io.R.poke(true.B)
-      c.io.IR.poke("hd800".U) // simulated UD
+      fetched(c, "hd800".U) // simulated UD
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -343,12 +396,25 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
     }
   }
 
+  it should "still raise an exception for the reserved encoding without IR[11]" in {
+    test(new Control()) { c =>
+      val states = List(18, 28, 30, 13, 50, 62)
+      c.io.PSR15.poke(true.B) // user mode
+      c.io.R.poke(true.B)
+      fetched(c, "hd000".U) // reserved encoding, IR[11] clear
+      for (s <- states) {
+        c.io.debuguPC.expect(s.U)
+        c.clock.step(1)
+      }
+    }
+  }
+
   it should "raise an exception for RTI in user mode" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 8, 44, 45, 37, 41, 43, 46, 52, 54, 53, 55, 18)
+      val states = List(18, 28, 30, 8, 44, 45, 37, 41, 43, 46, 52, 54, 53, 55, 18)
       c.io.PSR15.poke(true.B) // user mode
       c.io.R.poke(true.B) // reads always ready
-      c.io.IR.poke("h8000".U) // simulated RTI
+      fetched(c, "h8000".U) // simulated RTI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -358,9 +424,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through RTI states properly in supervisor mode" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 8, 36, 38, 39, 40, 42, 34, 51, 18)
+      val states = List(18, 28, 30, 8, 36, 38, 39, 40, 42, 34, 51, 18)
       c.io.R.poke(true.B) // reads always ready
-      c.io.IR.poke("h8000".U) // simulated RTI
+      fetched(c, "h8000".U) // simulated RTI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -370,9 +436,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through RTI states properly in supervisor mode when the INT happened in usermode" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 8, 36, 38, 39, 40, 42)
+      val states = List(18, 28, 30, 8, 36, 38, 39, 40, 42)
       c.io.R.poke(true.B) // reads always ready
-      c.io.IR.poke("h8000".U) // simulated RTI
+      fetched(c, "h8000".U) // simulated RTI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -389,10 +455,10 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through TRAP states properly in usermode" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 15, 47, 45, 37, 41, 43, 46, 52, 54, 53, 55, 18)
+      val states = List(18, 28, 30, 15, 47, 45, 37, 41, 43, 46, 52, 54, 53, 55, 18)
       c.io.R.poke(true.B) // reads always ready
       c.io.PSR15.poke(true.B) // in usermode
-      c.io.IR.poke("hf000".U) // simulated RTI
+      fetched(c, "hf000".U) // simulated RTI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -402,9 +468,9 @@ class ControlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
 
   it should "go through TRAP states properly in supervisor mode" in {
     test(new Control()) { c =>
-      val states = List(18, 33, 28, 30, 32, 15, 47, 37, 41, 43, 46, 52, 54, 53, 55, 18)
+      val states = List(18, 28, 30, 15, 47, 37, 41, 43, 46, 52, 54, 53, 55, 18)
       c.io.R.poke(true.B) // reads always ready
-      c.io.IR.poke("hf000".U) // simulated RTI
+      fetched(c, "hf000".U) // simulated RTI
       for (s <- states) {
         c.io.debuguPC.expect(s.U)
         c.clock.step(1)
@@ -0,0 +1,188 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+import chiseltest._
+import chiseltest.experimental.TestOptionBuilder._
+import org.scalatest._
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+class DMATester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+  behavior of "DMA Engine"
+
+  def writeReg(c: DMA, ld: Bool, v: Int) = {
+    c.io.wrData.poke(v.U)
+    ld.poke(true.B)
+    c.clock.step(1)
+    ld.poke(false.B)
+  }
+
+  def busy(c: DMA) = (c.io.ctl.peek().litValue() & 1) == 1
+
+  // Stands in for ExternalRAM: an access is held on the port until
+  // R, read data comes back in the same cycle, and a write lands on
+  // the edge where R is asserted. Access n takes waits(n) extra
+  // cycles. Returns the number of cycles the transfer took.
+  def runWithRAM(c: DMA, mem: Array[Int], grant: Int => Boolean,
+                 waits: Int => Int = _ => 0) : Int = {
+    var cycles = 0
+    var n      = 0 // accesses completed
+    var held   = 0
+    var last   = (-1, false)
+    while (busy(c) && cycles < 1000) {
+      val g = grant(cycles)
+      c.io.grant.poke(g.B)
+      if (g && c.io.req.peek().litToBoolean) {
+        val a = c.io.addr.peek().litValue().toInt
+        val w = c.io.wEn.peek().litToBoolean
+        if ((a, w) != last) {
+          held = 0
+        }
+        last = (a, w)
+        val r = held >= waits(n)
+        c.io.memR.poke(r.B)
+        c.io.memData.poke(mem(a).U)
+        if (r) {
+          if (w) {
+            mem(a) = c.io.dataIn.peek().litValue().toInt
+          }
+          n   += 1
+          held = 0
+        } else {
+          held += 1
+        }
+      } else {
+        // someone else has the port, so whatever the
+        // engine was doing has to start over
+        c.io.memR.poke(false.B)
+        held = 0
+        last = (-1, false)
+      }
+      c.clock.step(1)
+      cycles += 1
+    }
+    cycles
+  }
+
+  it should "copy a block of memory" in {
+    test(new DMA()) { c =>
+      val mem = Array.tabulate(256)(i => if (i >= 0x10 && i < 0x18) 0xF000 + i else 0)
+      writeReg(c, c.io.ldSrc, 0x10)
+      writeReg(c, c.io.ldDst, 0x40)
+      writeReg(c, c.io.ldLen, 8)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      val cycles = runWithRAM(c, mem, _ => true)
+      for (i <- 0 until 8) {
+        mem(0x40 + i) should be (0xF010 + i)
+      }
+      mem(0x48) should be (0)
+      cycles should be (2 * 8)
+      c.io.ctl.expect("h8000".U) // done, not busy
+      c.io.len.expect(0.U)
+      c.io.dst.expect("h48".U)
+    }
+  }
+
+  it should "fill a block of memory" in {
+    test(new DMA()) { c =>
+      val mem = Array.fill(256)(0)
+      writeReg(c, c.io.ldSrc, 0xBEEF)
+      writeReg(c, c.io.ldDst, 0x20)
+      writeReg(c, c.io.ldLen, 16)
+      writeReg(c, c.io.ldCtl, 0x0003)
+      val cycles = runWithRAM(c, mem, _ => true)
+      for (i <- 0 until 16) {
+        mem(0x20 + i) should be (0xBEEF)
+      }
+      mem(0x1F) should be (0)
+      mem(0x30) should be (0)
+      cycles should be (16)
+      c.io.ctl.expect("h8002".U)
+    }
+  }
+
+  it should "only touch memory when granted the port" in {
+    test(new DMA()) { c =>
+      val mem = Array.tabulate(256)(i => i * 3)
+      writeReg(c, c.io.ldSrc, 0x80)
+      writeReg(c, c.io.ldDst, 0x00)
+      writeReg(c, c.io.ldLen, 4)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      val cycles = runWithRAM(c, mem, cyc => cyc % 3 == 2)
+      for (i <- 0 until 4) {
+        mem(i) should be ((0x80 + i) * 3)
+      }
+      cycles should be > (2 * 4)
+    }
+  }
+
+  it should "wait for memory" in {
+    test(new DMA()) { c =>
+      val mem = Array.tabulate(256)(i => i ^ 0x5A5A)
+      writeReg(c, c.io.ldSrc, 0x30)
+      writeReg(c, c.io.ldDst, 0x90)
+      writeReg(c, c.io.ldLen, 8)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      val cycles = runWithRAM(c, mem, _ => true, n => n % 4)
+      for (i <- 0 until 8) {
+        mem(0x90 + i) should be ((0x30 + i) ^ 0x5A5A)
+      }
+      // 16 accesses, 0-3 wait states each
+      cycles should be (16 + 4 * (0 + 1 + 2 + 3))
+    }
+  }
+
+  it should "ignore register writes while busy" in {
+    test(new DMA()) { c =>
+      writeReg(c, c.io.ldSrc, 0x10)
+      writeReg(c, c.io.ldDst, 0x20)
+      writeReg(c, c.io.ldLen, 4)
+      c.io.grant.poke(false.B)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      writeReg(c, c.io.ldLen, 100)
+      writeReg(c, c.io.ldDst, 0x99)
+      c.io.len.expect(4.U)
+      c.io.dst.expect("h20".U)
+      c.io.ctl.expect("h0001".U)
+    }
+  }
+
+  it should "interrupt on completion, and stop when DMACTL is written" in {
+    test(new DMA()) { c =>
+      val mem = Array.fill(256)(0)
+      writeReg(c, c.io.ldSrc, 0x1234)
+      writeReg(c, c.io.ldDst, 0x10)
+      writeReg(c, c.io.ldLen, 2)
+      writeReg(c, c.io.ldCtl, 0x4003)
+      c.io.irq.expect(false.B)
+      runWithRAM(c, mem, _ => true)
+      c.io.irq.expect(true.B)
+      c.io.ctl.expect("hC002".U)
+      writeReg(c, c.io.ldCtl, 0x4000) // ack, keep interrupts enabled
+      c.io.irq.expect(false.B)
+      c.io.ctl.expect("h4002".U)
+    }
+  }
+
+  it should "not interrupt when interrupts are disabled" in {
+    test(new DMA()) { c =>
+      val mem = Array.fill(256)(0)
+      writeReg(c, c.io.ldDst, 0x10)
+      writeReg(c, c.io.ldLen, 1)
+      writeReg(c, c.io.ldCtl, 0x0003)
+      runWithRAM(c, mem, _ => true)
+      c.io.ctl.expect("h8002".U)
+      c.io.irq.expect(false.B)
+    }
+  }
+
+  it should "finish a zero-length transfer immediately" in {
+    test(new DMA()) { c =>
+      writeReg(c, c.io.ldLen, 0)
+      writeReg(c, c.io.ldCtl, 0x0001)
+      c.io.req.expect(false.B)
+      c.io.ctl.expect("h8000".U)
+    }
+  }
+}
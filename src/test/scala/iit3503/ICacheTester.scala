@@ -0,0 +1,157 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+import chiseltest._
+import chiseltest.experimental.TestOptionBuilder._
+import org.scalatest._
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+// the I-cache with RAM behind it (every access waits the same)
+class CachedRAM(sets: Int, ways: Int, wait: Int) extends Module {
+  val io = IO(new Bundle {
+    val en     = Input(Bool())
+    val wEn    = Input(Bool())
+    val fetch  = Input(Bool())
+    val flush  = Input(Bool())
+    val dataIn = Input(UInt(16.W))
+    val addr   = Input(UInt(16.W))
+
+    val dataOut = Output(UInt(16.W))
+    val R       = Output(Bool())
+    val hits    = Output(UInt(32.W))
+    val misses  = Output(UInt(32.W))
+  })
+
+  val cache = Module(new ICache(sets, ways))
+  val ram   = Module(new RAM(256, wait, wait))
+
+  cache.io.en     := io.en
+  cache.io.wEn    := io.wEn
+  cache.io.fetch  := io.fetch
+  cache.io.flush  := io.flush
+  cache.io.dataIn := io.dataIn
+  cache.io.addr   := io.addr
+
+  cache.io.memR       := ram.io.R
+  cache.io.memDataOut := ram.io.dataOut
+  ram.io.en           := cache.io.memEn
+  ram.io.wEn          := cache.io.memWEn
+  ram.io.dataIn       := cache.io.memDataIn
+  ram.io.addr         := cache.io.memAddr
+
+  // this is the only writer
+  cache.io.snoop     := ram.io.en && ram.io.wEn && ram.io.R
+  cache.io.snoopAddr := ram.io.addr
+
+  io.dataOut := cache.io.dataOut
+  io.R       := cache.io.R
+  io.hits    := cache.io.debugHits
+  io.misses  := cache.io.debugMisses
+}
+
+class ICacheTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+  behavior of "Instruction Cache"
+
+  val wait = 3
+
+  // hold an access on the port until R; returns how many
+  // cycles it took and what came back
+  def access(c: CachedRAM, addr: Int, wEn: Boolean, fetch: Boolean, data: Int = 0) : (Int, BigInt) = {
+    c.io.en.poke(true.B)
+    c.io.wEn.poke(wEn.B)
+    c.io.fetch.poke(fetch.B)
+    c.io.addr.poke(addr.U)
+    c.io.dataIn.poke(data.U)
+    var n = 1
+    while (!c.io.R.peek().litToBoolean) {
+      c.clock.step(1)
+      n += 1
+      n should be < (100)
+    }
+    val v = c.io.dataOut.peek().litValue()
+    c.clock.step(1)
+    c.io.en.poke(false.B)
+    c.io.fetch.poke(false.B)
+    (n, v)
+  }
+
+  def fetch(c: CachedRAM, addr: Int)           = access(c, addr, false, true)
+  def read(c: CachedRAM, addr: Int)            = access(c, addr, false, false)
+  def write(c: CachedRAM, addr: Int, v: Int)   = access(c, addr, true, false, v)
+
+  it should "serve repeat fetches without going to memory" in {
+    test(new CachedRAM(4, 2, wait)) { c =>
+      write(c, 0x10, 0x1234)
+      fetch(c, 0x10) should be ((wait + 1, BigInt(0x1234)))
+      fetch(c, 0x10) should be ((1, BigInt(0x1234)))
+      fetch(c, 0x10) should be ((1, BigInt(0x1234)))
+      c.io.hits.expect(2.U)
+      c.io.misses.expect(1.U)
+    }
+  }
+
+  it should "leave data reads alone" in {
+    test(new CachedRAM(4, 2, wait)) { c =>
+      write(c, 0x10, 0x1234)
+      read(c, 0x10) should be ((wait + 1, BigInt(0x1234)))
+      read(c, 0x10) should be ((wait + 1, BigInt(0x1234)))
+      fetch(c, 0x10)._1 should be (wait + 1)
+      read(c, 0x10)._1 should be (wait + 1)
+      c.io.hits.expect(0.U)
+      c.io.misses.expect(1.U)
+    }
+  }
+
+  it should "invalidate a line when it's written" in {
+    test(new CachedRAM(4, 2, wait)) { c =>
+      write(c, 0x10, 0x1234)
+      fetch(c, 0x10)
+      write(c, 0x10, 0xbeef)
+      fetch(c, 0x10) should be ((wait + 1, BigInt(0xbeef)))
+      fetch(c, 0x10) should be ((1, BigInt(0xbeef)))
+    }
+  }
+
+  it should "keep two lines per set when 2-way" in {
+    test(new CachedRAM(4, 2, wait)) { c =>
+      for (a <- Seq(0x10, 0x14, 0x18)) {
+        write(c, a, a)
+      }
+      fetch(c, 0x10)._1 should be (wait + 1)
+      fetch(c, 0x14)._1 should be (wait + 1)
+      fetch(c, 0x10)._1 should be (1)
+      fetch(c, 0x14)._1 should be (1)
+      fetch(c, 0x18)._1 should be (wait + 1) // evicts 0x10 (LRU)
+      fetch(c, 0x14) should be ((1, BigInt(0x14)))
+      fetch(c, 0x10) should be ((wait + 1, BigInt(0x10)))
+    }
+  }
+
+  it should "evict on a conflict when direct mapped" in {
+    test(new CachedRAM(4, 1, wait)) { c =>
+      write(c, 0x10, 0x10)
+      write(c, 0x14, 0x14)
+      fetch(c, 0x10)._1 should be (wait + 1)
+      fetch(c, 0x11)._1 should be (wait + 1) // different set
+      fetch(c, 0x14)._1 should be (wait + 1)
+      fetch(c, 0x11)._1 should be (1)
+      fetch(c, 0x10) should be ((wait + 1, BigInt(0x10)))
+    }
+  }
+
+  it should "drop everything on a flush" in {
+    test(new CachedRAM(4, 2, wait)) { c =>
+      write(c, 0x10, 1)
+      write(c, 0x11, 2)
+      fetch(c, 0x10)
+      fetch(c, 0x11)
+      c.io.flush.poke(true.B)
+      c.clock.step(1)
+      c.io.flush.poke(false.B)
+      fetch(c, 0x10)._1 should be (wait + 1)
+      fetch(c, 0x11)._1 should be (wait + 1)
+    }
+  }
+}
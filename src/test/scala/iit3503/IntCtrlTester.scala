@@ -64,4 +64,65 @@ class IntCtrlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
     }
   }
 
+  behavior of "Interrupt Arbiter"
+
+  it should "pick the highest-priority requesting line" in {
+    test(new IRQArbiter(2)) { c =>
+      c.io.in(0).req.poke(true.B)
+      c.io.in(0).vec.poke("h80".U)
+      c.io.in(0).prio.poke(4.U)
+      c.io.in(1).req.poke(true.B)
+      c.io.in(1).vec.poke("h81".U)
+      c.io.in(1).prio.poke(3.U)
+      c.io.out.req.expect(true.B)
+      c.io.out.vec.expect("h80".U)
+      c.io.out.prio.expect(4.U)
+      c.io.chosen.expect(0.U)
+
+      c.io.in(1).prio.poke(6.U)
+      c.io.out.vec.expect("h81".U)
+      c.io.out.prio.expect(6.U)
+      c.io.chosen.expect(1.U)
+
+      c.io.in(1).req.poke(false.B)
+      c.io.out.vec.expect("h80".U)
+      c.io.chosen.expect(0.U)
+    }
+  }
+
+  it should "break priority ties in favor of the lower line" in {
+    test(new IRQArbiter(2)) { c =>
+      c.io.in(0).req.poke(true.B)
+      c.io.in(0).vec.poke("h80".U)
+      c.io.in(0).prio.poke(3.U)
+      c.io.in(1).req.poke(true.B)
+      c.io.in(1).vec.poke("h81".U)
+      c.io.in(1).prio.poke(3.U)
+      c.io.out.vec.expect("h80".U)
+    }
+  }
+
+  it should "report priority 0 when nothing is requesting" in {
+    test(new IRQArbiter(2)) { c =>
+      c.io.in(0).req.poke(false.B)
+      c.io.in(0).prio.poke(7.U)
+      c.io.in(1).req.poke(false.B)
+      c.io.in(1).prio.poke(3.U)
+      c.io.out.req.expect(false.B)
+      c.io.out.prio.expect(0.U)
+    }
+  }
+
+  it should "route the acknowledge to the winning line" in {
+    test(new IRQArbiter(2)) { c =>
+      c.io.in(0).req.poke(false.B)
+      c.io.in(1).req.poke(true.B)
+      c.io.in(1).prio.poke(3.U)
+      c.io.ack.poke(true.B)
+      c.io.acks(0).expect(false.B)
+      c.io.acks(1).expect(true.B)
+      c.io.ack.poke(false.B)
+      c.io.acks(1).expect(false.B)
+    }
+  }
 }
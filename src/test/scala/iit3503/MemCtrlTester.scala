@@ -8,7 +8,55 @@ import org.scalatest._
 import org.scalatest.flatspec.AnyFlatSpec
 import org.scalatest.matchers.should.Matchers
 
-class MemCtrlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+// the memory controller with RAM behind it, driven the way the
+// microcode drives it
+class MemSystem(minWait: Int, maxWait: Int) extends Module {
+  val io = IO(new Bundle {
+    val LDMAR = Input(Bool())
+    val LDMDR = Input(Bool())
+    val MIOEN = Input(Bool())
+    val RDWR  = Input(Bool())
+    val bus   = Input(UInt(16.W))
+
+    val R   = Output(Bool())
+    val mdr = Output(UInt(16.W))
+  })
+
+  val ctrl = Module(new MemCtrl)
+  val ram  = Module(new RAM(256, minWait, maxWait))
+
+  ctrl.io.LDMAR := io.LDMAR
+  ctrl.io.LDMDR := io.LDMDR
+  ctrl.io.MIOEN := io.MIOEN
+  ctrl.io.RDWR  := io.RDWR
+  ctrl.io.bus   := io.bus
+
+  ctrl.io.coreId   := 0.U
+  ctrl.io.lock.old := false.B
+
+  ctrl.io.blk.done  := false.B
+  ctrl.io.blk.error := false.B
+
+  ctrl.io.rx.valid  := false.B
+  ctrl.io.rx.bits   := 0.U
+  ctrl.io.rxLevel   := 0.U
+  ctrl.io.rxDue     := false.B
+  ctrl.io.tx.ready  := true.B
+  ctrl.io.txLow     := true.B
+  ctrl.io.txIdle    := true.B
+
+  ctrl.io.memR    := ram.io.R
+  ctrl.io.memData := ram.io.dataOut
+  ram.io.en       := ctrl.io.en
+  ram.io.wEn      := ctrl.io.wEn
+  ram.io.dataIn   := ctrl.io.dataIn
+  ram.io.addr     := ctrl.io.addr
+
+  io.R   := ctrl.io.R
+  io.mdr := ctrl.io.mdrOut
+}
+
+class MemCtrlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers with InMuxConsts {
   behavior of "Memory Controller"
 
   it should "load MAR correctly" in {
@@ -54,4 +102,135 @@ class MemCtrlTester extends AnyFlatSpec with ChiselScalatestTester with Matchers
       c.io.debugMAR.expect("hF00D".U)
     }
   }
+
+  // like states 23 and 16: MAR <- addr, MDR <- data, then
+  // write until R. Returns the number of cycles the write took.
+  def write(c: MemSystem, addr: Int, data: Int) : Int = {
+    c.io.LDMAR.poke(true.B)
+    c.io.bus.poke(addr.U)
+    c.clock.step(1)
+    c.io.LDMAR.poke(false.B)
+    c.io.LDMDR.poke(true.B)
+    c.io.bus.poke(data.U)
+    c.clock.step(1)
+    c.io.LDMDR.poke(false.B)
+    c.io.MIOEN.poke(true.B)
+    c.io.RDWR.poke(true.B)
+    var cycles = 1
+    while (!c.io.R.peek().litToBoolean) {
+      c.clock.step(1)
+      cycles += 1
+      cycles should be < (300)
+    }
+    c.clock.step(1)
+    c.io.MIOEN.poke(false.B)
+    c.io.RDWR.poke(false.B)
+    cycles
+  }
+
+  // like states 35 and 25: MAR <- addr, then read into MDR
+  // until R. Returns the number of cycles the read took.
+  def read(c: MemSystem, addr: Int) : (Int, Int) = {
+    c.io.LDMAR.poke(true.B)
+    c.io.bus.poke(addr.U)
+    c.clock.step(1)
+    c.io.LDMAR.poke(false.B)
+    c.io.MIOEN.poke(true.B)
+    c.io.LDMDR.poke(true.B)
+    var cycles = 1
+    while (!c.io.R.peek().litToBoolean) {
+      c.clock.step(1)
+      cycles += 1
+      cycles should be < (300)
+    }
+    c.clock.step(1)
+    c.io.MIOEN.poke(false.B)
+    c.io.LDMDR.poke(false.B)
+    (c.io.mdr.peek().litValue().toInt, cycles)
+  }
+
+  it should "finish a memory access in one cycle without wait states" in {
+    test(new MemSystem(0, 0)) { c =>
+      write(c, 0x42, 0xCAFE) should be (1)
+      read(c, 0x42) should be ((0xCAFE, 1))
+    }
+  }
+
+  it should "wait for memory that takes a fixed number of cycles" in {
+    test(new MemSystem(3, 3)) { c =>
+      write(c, 0x10, 0x1234) should be (4)
+      read(c, 0x10) should be ((0x1234, 4))
+    }
+  }
+
+  it should "get the right data from memory with a varying latency" in {
+    test(new MemSystem(0, 5)) { c =>
+      val data = (0 until 32).map(i => (i * 0x0731 + 0x55) & 0xFFFF)
+      var cycles = 0
+      for (i <- 0 until 32) {
+        cycles += write(c, 0x80 + i, data(i))
+      }
+      for (i <- 31 to 0 by -1) {
+        val (v, n) = read(c, 0x80 + i)
+        v should be (data(i))
+        n should be <= (6)
+        cycles += n
+      }
+      cycles should be > (64)
+    }
+  }
+
+  behavior of "Address Control"
+
+  // MAR <- addr, then a read through the MMIO path
+  def select(c: AddrCtrl, addr: Int, rw: Boolean) = {
+    c.io.MIOEN.poke(false.B)
+    c.io.LDMAR.poke(true.B)
+    c.io.bus.poke(addr.U)
+    c.clock.step(1)
+    c.io.LDMAR.poke(false.B)
+    c.io.bus.poke(0.U) // MAR's compares were taken as it loaded
+    c.io.MIOEN.poke(true.B)
+    c.io.RW.poke(rw.B)
+  }
+
+  it should "route every device register to its INMUX input" in {
+    test(new AddrCtrl()) { c =>
+      val regs = Seq(
+        0xFE00 -> kbsrSel,   0xFE02 -> kbdrSel,   0xFE08 -> kbcrSel,
+        0xFE04 -> dsrSel,    0xFFFE -> mcrSel,
+        0xFE10 -> dmaSrcSel, 0xFE12 -> dmaDstSel, 0xFE14 -> dmaLenSel, 0xFE16 -> dmaCtlSel,
+        0xFE18 -> blkSecSel, 0xFE1A -> blkAdrSel, 0xFE1C -> blkCntSel, 0xFE1E -> blkCtlSel,
+        0xFE20 -> cpuidSel,  0xFE30 -> lockSel,   0xFE37 -> lockSel,
+        0x3000 -> memSel,    0xFF06 -> memSel
+      )
+      regs.map(_._2).toSet should be ((0 until 16).toSet)
+
+      for ((addr, sel) <- regs) {
+        select(c, addr, false)
+        c.io.INMUX_SEL.expect(sel.U)
+        c.io.MEMEN.expect((sel == memSel).B)
+      }
+
+      select(c, 0xFE35, false)
+      c.io.lockIdx.expect(5.U)
+      c.io.lockRead.expect(true.B)
+    }
+  }
+
+  it should "load the block device registers on writes" in {
+    test(new AddrCtrl()) { c =>
+      val lds = Seq(
+        0xFE18 -> c.io.LDBLKSEC, 0xFE1A -> c.io.LDBLKADR,
+        0xFE1C -> c.io.LDBLKCNT, 0xFE1E -> c.io.LDBLKCTL
+      )
+      for ((addr, ld) <- lds) {
+        select(c, addr, true)
+        for ((_, other) <- lds) {
+          other.expect((other eq ld).B)
+        }
+        c.io.MEMEN.expect(false.B)
+      }
+    }
+  }
 }
@@ -223,6 +223,73 @@ class MicroSeqTester extends AnyFlatSpec with ChiselScalatestTester with Matcher
     }
   }
 
-} 
+  it should "handle the IFETCH condition properly" in {
+    test(new MicroSequencer()) { c =>
+
+      c.io.cFeed.IRD.poke(false.B)
+      c.io.cFeed.COND.poke("b111".U)
+      c.io.cFeed.J.poke(28.U)
+      c.io.INT.poke(false.B)
+      c.io.R.poke(false.B)
+      c.io.IR15_11.poke("b00000".U)
+      c.io.BEN.poke(false.B)
+      c.io.PSR15.poke(false.B)
+      c.io.ACV.poke(false.B)
+      c.io.ACVNow.poke(false.B)
+
+      c.io.ctrlAddr.expect(28.U)
+
+      c.io.ACV.poke(true.B) // stale ACV register shouldn't matter
+
+      c.io.ctrlAddr.expect(28.U)
+
+      c.io.ACVNow.poke(true.B)
+
+      c.io.ctrlAddr.expect(60.U)
+
+      c.io.INT.poke(true.B) // interrupts win
+
+      c.io.ctrlAddr.expect(49.U)
+
+      c.io.ACVNow.poke(false.B)
+
+      c.io.ctrlAddr.expect(49.U)
+
+    }
+  }
+
+  it should "handle the multiply/divide conditions properly" in {
+    test(new MicroSequencer()) { c =>
+
+      c.io.cFeed.IRD.poke(false.B)
+      c.io.cFeed.COND.poke("b1000".U) // unit ready?
+      c.io.cFeed.J.poke(32.U)
+      c.io.INT.poke(true.B) // none of the book's
+      c.io.R.poke(true.B)   // conditions should matter
+      c.io.IR15_11.poke("b00001".U)
+      c.io.BEN.poke(false.B)
+      c.io.PSR15.poke(true.B)
+      c.io.ACV.poke(true.B)
+      c.io.ACVNow.poke(true.B)
+      c.io.MDReady.poke(false.B)
+      c.io.MDOp.poke(true.B)
 
+      c.io.ctrlAddr.expect(32.U)
+
+      c.io.MDReady.poke(true.B)
+
+      c.io.ctrlAddr.expect(33.U)
+
+      c.io.cFeed.COND.poke("b1001".U) // reserved encoding?
+      c.io.cFeed.J.poke(50.U)
+
+      c.io.ctrlAddr.expect(58.U) // bit 3, not IR[11]'s bit 0
+
+      c.io.MDOp.poke(false.B)
+
+      c.io.ctrlAddr.expect(50.U)
+
+    }
+  }
 
+}
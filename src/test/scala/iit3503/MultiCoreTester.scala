@@ -0,0 +1,428 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+import chisel3.stage.ChiselStage
+import chiseltest._
+import chiseltest.experimental.TestOptionBuilder._
+import org.scalatest._
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+// n ports sharing one RAM (every access waits the same)
+class SharedRAM(n: Int, wait: Int) extends Module {
+  val io = IO(new Bundle {
+    val ports = Flipped(Vec(n, new MemPort))
+
+    val snoop     = Output(Bool())
+    val snoopAddr = Output(UInt(16.W))
+  })
+
+  val arb = Module(new MemArbiter(n))
+  val ram = Module(new RAM(256, wait, wait))
+
+  for (i <- 0 until n) {
+    arb.io.in(i) <> io.ports(i)
+  }
+
+  ram.io.en     := arb.io.out.en
+  ram.io.wEn    := arb.io.out.wEn
+  ram.io.dataIn := arb.io.out.dataIn
+  ram.io.addr   := arb.io.out.addr
+  arb.io.out.dataOut := ram.io.dataOut
+  arb.io.out.R       := ram.io.R
+
+  io.snoop     := arb.io.snoop
+  io.snoopAddr := arb.io.snoopAddr
+}
+
+// n memory controllers, driven the way the microcode drives
+// them, sharing one RAM and the spinlocks like Top's cores do
+class SharedCtrls(n: Int, wait: Int) extends Module {
+  val io = IO(new Bundle {
+    val LDMAR = Input(Vec(n, Bool()))
+    val LDMDR = Input(Vec(n, Bool()))
+    val MIOEN = Input(Vec(n, Bool()))
+    val RDWR  = Input(Vec(n, Bool()))
+    val bus   = Input(Vec(n, UInt(16.W)))
+
+    val R       = Output(Vec(n, Bool()))
+    val lockOld = Output(Vec(n, Bool())) // what a LOCKn read got
+  })
+
+  val mem   = Module(new SharedRAM(n, wait))
+  val locks = Module(new Spinlocks(n))
+
+  for (i <- 0 until n) {
+    val ctrl = Module(new MemCtrl)
+
+    ctrl.io.LDMAR := io.LDMAR(i)
+    ctrl.io.LDMDR := io.LDMDR(i)
+    ctrl.io.MIOEN := io.MIOEN(i)
+    ctrl.io.RDWR  := io.RDWR(i)
+    ctrl.io.bus   := io.bus(i)
+
+    ctrl.io.coreId := i.U
+    locks.io.ports(i) <> ctrl.io.lock
+
+    ctrl.io.blk.done  := false.B
+    ctrl.io.blk.error := false.B
+
+    ctrl.io.rx.valid  := false.B
+    ctrl.io.rx.bits   := 0.U
+    ctrl.io.rxLevel   := 0.U
+    ctrl.io.rxDue     := false.B
+    ctrl.io.tx.ready  := true.B
+    ctrl.io.txLow     := true.B
+    ctrl.io.txIdle    := true.B
+
+    val port = mem.io.ports(i)
+    port.en     := ctrl.io.en
+    port.wEn    := ctrl.io.wEn
+    port.dataIn := ctrl.io.dataIn
+    port.addr   := ctrl.io.addr
+    ctrl.io.memR    := port.R
+    ctrl.io.memData := port.dataOut
+
+    io.R(i)       := ctrl.io.R
+    io.lockOld(i) := locks.io.ports(i).old
+  }
+}
+
+class MultiCoreTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+  behavior of "Memory Arbiter"
+
+  val wait = 2
+
+  def request(c: SharedRAM, i: Int, addr: Int, wEn: Boolean, data: Int = 0) = {
+    c.io.ports(i).en.poke(true.B)
+    c.io.ports(i).wEn.poke(wEn.B)
+    c.io.ports(i).addr.poke(addr.U)
+    c.io.ports(i).dataIn.poke(data.U)
+  }
+
+  // step until every port in ps has seen R once (dropping each
+  // one's request when it does); returns the cycle each finished on
+  def finish(c: SharedRAM, ps: Seq[Int]) : Map[Int, Int] = {
+    var done = Map[Int, Int]()
+    var t    = 1
+    while (done.size < ps.size) {
+      for (i <- ps if !done.contains(i) && c.io.ports(i).R.peek().litToBoolean) {
+        done += (i -> t)
+      }
+      c.clock.step(1)
+      for (i <- done.keys) {
+        c.io.ports(i).en.poke(false.B)
+      }
+      t += 1
+      t should be < (100)
+    }
+    done
+  }
+
+  def write(c: SharedRAM, i: Int, addr: Int, data: Int) = {
+    request(c, i, addr, true, data)
+    finish(c, Seq(i))
+  }
+
+  it should "let one port through at a time, lowest first" in {
+    test(new SharedRAM(2, wait)) { c =>
+      write(c, 0, 0x10, 0xaaaa)
+      write(c, 1, 0x11, 0xbbbb)
+      request(c, 0, 0x10, false)
+      request(c, 1, 0x11, false)
+      val t = finish(c, Seq(0, 1))
+      t(0) should be (wait + 1)
+      t(1) should be (2 * (wait + 1))
+    }
+  }
+
+  it should "hand back what each port asked for" in {
+    test(new SharedRAM(2, 0)) { c =>
+      write(c, 0, 0x20, 0x1234)
+      write(c, 1, 0x21, 0x5678)
+      request(c, 0, 0x21, false)
+      c.io.ports(0).R.expect(true.B)
+      c.io.ports(0).dataOut.expect(0x5678.U)
+      c.clock.step(1)
+      c.io.ports(0).en.poke(false.B)
+      request(c, 1, 0x20, false)
+      c.io.ports(1).R.expect(true.B)
+      c.io.ports(1).dataOut.expect(0x1234.U)
+    }
+  }
+
+  it should "not let a busy port starve the others" in {
+    test(new SharedRAM(3, wait)) { c =>
+      // 0 asks again right away, every time
+      var served = Seq[Int]()
+      request(c, 1, 0x30, false)
+      request(c, 2, 0x31, false)
+      for (_ <- 0 until 6 * (wait + 1)) {
+        request(c, 0, 0x32, false)
+        for (i <- 0 until 3 if c.io.ports(i).R.peek().litToBoolean) {
+          served :+= i
+        }
+        c.clock.step(1)
+        for (i <- 1 until 3 if served.contains(i)) {
+          c.io.ports(i).en.poke(false.B)
+        }
+      }
+      served.take(3) should be (Seq(0, 1, 2))
+    }
+  }
+
+  it should "snoop writes as they land" in {
+    test(new SharedRAM(2, wait)) { c =>
+      request(c, 1, 0x40, true, 7)
+      for (_ <- 0 until wait) {
+        c.io.snoop.expect(false.B)
+        c.clock.step(1)
+      }
+      c.io.snoop.expect(true.B)
+      c.io.snoopAddr.expect(0x40.U)
+      c.clock.step(1)
+      c.io.ports(1).en.poke(false.B)
+      request(c, 0, 0x40, false)
+      c.io.snoop.expect(false.B)
+    }
+  }
+
+  behavior of "Spinlocks"
+
+  def take(c: Spinlocks, i: Int, idx: Int) = {
+    c.io.ports(i).req.poke(true.B)
+    c.io.ports(i).idx.poke(idx.U)
+  }
+
+  def idle(c: Spinlocks, n: Int) = {
+    for (i <- 0 until n) {
+      c.io.ports(i).req.poke(false.B)
+      c.io.ports(i).rel.poke(false.B)
+    }
+  }
+
+  it should "give a free lock to the first taker only" in {
+    test(new Spinlocks(2)) { c =>
+      idle(c, 2)
+      take(c, 1, 3)
+      c.io.ports(1).old.expect(false.B)
+      c.clock.step(1)
+      idle(c, 2)
+      take(c, 0, 3)
+      c.io.ports(0).old.expect(true.B)
+      take(c, 1, 3)
+      c.io.ports(1).old.expect(true.B)
+      c.clock.step(1)
+      idle(c, 2)
+      take(c, 0, 4)
+      c.io.ports(0).old.expect(false.B) // different lock
+    }
+  }
+
+  it should "break same-cycle ties by core number" in {
+    test(new Spinlocks(3)) { c =>
+      idle(c, 3)
+      take(c, 2, 5)
+      take(c, 1, 5)
+      c.io.ports(1).old.expect(false.B)
+      c.io.ports(2).old.expect(true.B)
+    }
+  }
+
+  it should "free a lock on release" in {
+    test(new Spinlocks(2)) { c =>
+      idle(c, 2)
+      take(c, 0, 1)
+      c.clock.step(1)
+      idle(c, 2)
+      c.io.ports(0).rel.poke(true.B)
+      c.io.ports(0).idx.poke(1.U)
+      take(c, 1, 1)
+      c.io.ports(1).old.expect(true.B) // sees it as it was
+      c.clock.step(1)
+      idle(c, 2)
+      take(c, 1, 1)
+      c.io.ports(1).old.expect(false.B)
+    }
+  }
+
+  behavior of "Memory controllers sharing RAM and the spinlocks"
+
+  def idle(c: SharedCtrls, i: Int) = {
+    c.io.LDMAR(i).poke(false.B)
+    c.io.LDMDR(i).poke(false.B)
+    c.io.MIOEN(i).poke(false.B)
+    c.io.RDWR(i).poke(false.B)
+  }
+
+  // MAR <- addr (LDMAR, as in state 18 or 7)
+  def loadMAR(c: SharedCtrls, i: Int, addr: Int) = {
+    idle(c, i)
+    c.io.LDMAR(i).poke(true.B)
+    c.io.bus(i).poke(addr.U)
+  }
+
+  // MDR <- M[MAR] (as in state 25 or 28)
+  def read(c: SharedCtrls, i: Int) = {
+    idle(c, i)
+    c.io.MIOEN(i).poke(true.B)
+    c.io.LDMDR(i).poke(true.B)
+  }
+
+  // M[MAR] <- MDR (as in state 16)
+  def write(c: SharedCtrls, i: Int) = {
+    idle(c, i)
+    c.io.MIOEN(i).poke(true.B)
+    c.io.RDWR(i).poke(true.B)
+  }
+
+  it should "alternate two controllers that both keep reading" in {
+    test(new SharedCtrls(2, wait)) { c =>
+      loadMAR(c, 0, 0x3000)
+      loadMAR(c, 1, 0x3001)
+      c.clock.step(1)
+
+      // neither one ever lets go of the port, like two cores
+      // spinning on memory
+      read(c, 0)
+      read(c, 1)
+      var served = Seq[(Int, Int)]()
+      for (t <- 1 to 4 * (wait + 1)) {
+        for (i <- 0 until 2 if c.io.R(i).peek().litToBoolean) {
+          served :+= (i -> t)
+        }
+        c.clock.step(1)
+      }
+      served should be (Seq(
+        0 -> (wait + 1), 1 -> 2 * (wait + 1),
+        0 -> 3 * (wait + 1), 1 -> 4 * (wait + 1)))
+    }
+  }
+
+  it should "give a lock both take at once to core 0, then to core 1 once it's released" in {
+    test(new SharedCtrls(2, wait)) { c =>
+      loadMAR(c, 0, 0xFE30)
+      loadMAR(c, 1, 0xFE30)
+      c.clock.step(1)
+
+      // the same test-and-set in the same cycle: the lower core
+      // wins, and neither waits on memory for it
+      read(c, 0)
+      read(c, 1)
+      c.io.R(0).expect(true.B)
+      c.io.R(1).expect(true.B)
+      c.io.lockOld(0).expect(false.B)
+      c.io.lockOld(1).expect(true.B)
+      c.clock.step(1)
+
+      // core 1 spins on it while core 0 works
+      idle(c, 0)
+      for (_ <- 0 until 3) {
+        read(c, 1)
+        c.io.lockOld(1).expect(true.B)
+        c.clock.step(1)
+      }
+
+      // core 0 releases it (any write to LOCK0), and core 1's
+      // try in that same cycle still sees it held...
+      write(c, 0)
+      c.io.R(0).expect(true.B)
+      c.io.lockOld(1).expect(true.B)
+      c.clock.step(1)
+      idle(c, 0)
+
+      // ... and core 1's next try gets it
+      read(c, 1)
+      c.io.lockOld(1).expect(false.B)
+      c.clock.step(1)
+      idle(c, 1)
+
+      // now core 0 is the one locked out
+      loadMAR(c, 0, 0xFE30)
+      c.clock.step(1)
+      read(c, 0)
+      c.io.lockOld(0).expect(true.B)
+    }
+  }
+
+  behavior of "Top"
+
+  def core(c: Top, i: Int) = {
+    c.io.debugCore.poke(i.U)
+  }
+
+  // Top's inputs at rest (the serial line idles high), then a reset
+  // with the boot and AP vectors in place: PC's reset value is
+  // whatever resetVec says while reset is held
+  def boot(c: Top, resetVec: Int, apVec: Int) = {
+    c.io.resetVec.poke(resetVec.U)
+    c.io.apVec.get.poke(apVec.U)
+    c.io.intv.poke(0x80.U)
+    c.io.intPriority.poke(4.U)
+    c.io.devReady.poke(false.B)
+    c.io.devData.poke(0.U)
+    c.io.icFlush.poke(false.B)
+    c.io.blk.done.poke(false.B)
+    c.io.blk.error.poke(false.B)
+    c.io.uartRxd.poke(true.B)
+    c.reset.poke(true.B)
+    c.clock.step(1)
+    c.reset.poke(false.B)
+  }
+
+  it should "start core 0 at resetVec and the others at apVec" in {
+    test(new Top(3, 1 << 16, wait)) { c =>
+      boot(c, 0x3000, 0x4000)
+      for (i <- 0 until 3) {
+        core(c, i)
+        c.io.debuguPC.expect(18.U)
+        c.io.debugPC.expect((if (i == 0) 0x3000 else 0x4000).U)
+      }
+    }
+  }
+
+  // The starter datapath can't run a program yet (MAR, MDR and IR
+  // never load), but every core still makes its first IFETCH read
+  // (state 28) as soon as it's out of reset, so the two fetches
+  // collide in the arbiter
+  it should "make the cores take turns on their first fetch" in {
+    test(new Top(2, 1 << 16, wait)) { c =>
+      boot(c, 0x3000, 0x4000)
+
+      val in28 = Array(0, 0)
+      for (_ <- 0 until 4 * (wait + 1)) {
+        for (i <- 0 until 2) {
+          core(c, i)
+          if (c.io.debuguPC.peek().litValue() == 28) {
+            in28(i) += 1
+          }
+        }
+        c.clock.step(1)
+      }
+
+      // core 0 goes first, core 1 waits out its access too
+      in28(0) should be (wait + 1)
+      in28(1) should be (2 * (wait + 1))
+
+      // and each one went out to RAM once, through its own I-cache
+      for (i <- 0 until 2) {
+        core(c, i)
+        c.io.debugICMisses.expect(1.U)
+      }
+    }
+  }
+
+  // ExternalRAM is a black box, so this stops at Verilog: it
+  // checks that every core count wires up (and passes FIRRTL's
+  // width and initialization checks), not what it does
+  it should "elaborate with one core or several" in {
+    for (n <- Seq(1, 2, 3)) {
+      val v = (new ChiselStage).emitVerilog(new Top(n), Array("-td", s"test_run_dir/Top_$n"))
+      for (i <- 0 until n) {
+        v should include (s"core$i")
+      }
+      v.contains("apVec") should be (n > 1)
+    }
+  }
+}
@@ -0,0 +1,155 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+import chiseltest._
+import chiseltest.experimental.TestOptionBuilder._
+import org.scalatest._
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+class RAMTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+  behavior of "RAM (the ExternalRAM handshake)"
+
+  val wait = 3
+
+  def start(c: RAM, addr: Int, wEn: Boolean, data: Int = 0) = {
+    c.io.en.poke(true.B)
+    c.io.wEn.poke(wEn.B)
+    c.io.addr.poke(addr.U)
+    c.io.dataIn.poke(data.U)
+  }
+
+  // hold an access on the port until R; returns how many
+  // cycles it took and what came back
+  def access(c: RAM, addr: Int, wEn: Boolean, data: Int = 0) : (Int, BigInt) = {
+    start(c, addr, wEn, data)
+    var n = 1
+    while (!c.io.R.peek().litToBoolean) {
+      c.clock.step(1)
+      n += 1
+      n should be < (300)
+    }
+    val v = c.io.dataOut.peek().litValue()
+    c.clock.step(1)
+    c.io.en.poke(false.B)
+    (n, v)
+  }
+
+  def read(c: RAM, addr: Int)          = access(c, addr, false)
+  def write(c: RAM, addr: Int, v: Int) = access(c, addr, true, v)
+
+  it should "complete every access in the cycle it starts with no wait states" in {
+    test(new RAM(256)) { c =>
+      write(c, 0x10, 0x1234)._1 should be (1)
+      read(c, 0x10) should be ((1, BigInt(0x1234)))
+
+      // back to back, without dropping en
+      start(c, 0x11, true, 0xbeef)
+      c.io.R.expect(true.B)
+      c.clock.step(1)
+      start(c, 0x11, false)
+      c.io.R.expect(true.B)
+      c.io.dataOut.expect(0xbeef.U)
+    }
+  }
+
+  it should "hold R low through every wait state" in {
+    test(new RAM(256, wait, wait)) { c =>
+      start(c, 0x20, true, 0x5a5a)
+      for (i <- 0 until wait) {
+        c.io.R.expect(false.B)
+        c.clock.step(1)
+      }
+      c.io.R.expect(true.B)
+      c.clock.step(1)
+      c.io.en.poke(false.B)
+      c.io.R.expect(false.B)
+
+      start(c, 0x20, false)
+      for (i <- 0 until wait) {
+        c.io.R.expect(false.B)
+        c.clock.step(1)
+      }
+      c.io.R.expect(true.B)
+      c.io.dataOut.expect(0x5a5a.U)
+    }
+  }
+
+  it should "not land a write before R" in {
+    test(new RAM(256, wait, wait)) { c =>
+      write(c, 0x30, 0x1111)
+
+      // abandon a write in its last wait state
+      start(c, 0x30, true, 0x2222)
+      c.clock.step(wait - 1)
+      c.io.R.expect(false.B)
+      c.io.en.poke(false.B)
+      c.clock.step(1)
+
+      read(c, 0x30) should be ((wait + 1, BigInt(0x1111)))
+    }
+  }
+
+  it should "start over when the access changes before R" in {
+    test(new RAM(256, wait, wait)) { c =>
+      write(c, 0x40, 0xaaaa)
+      write(c, 0x41, 0xbbbb)
+
+      // a new address...
+      start(c, 0x40, false)
+      c.clock.step(wait - 1)
+      c.io.R.expect(false.B)
+      read(c, 0x41) should be ((wait + 1, BigInt(0xbbbb)))
+
+      // ... or direction, on the same address
+      start(c, 0x40, false)
+      c.clock.step(wait - 1)
+      write(c, 0x40, 0xcccc)._1 should be (wait + 1)
+      read(c, 0x40) should be ((wait + 1, BigInt(0xcccc)))
+    }
+  }
+
+  it should "start over when en drops before R" in {
+    test(new RAM(256, wait, wait)) { c =>
+      start(c, 0x50, false)
+      c.clock.step(wait - 1)
+      c.io.en.poke(false.B)
+      c.io.R.expect(false.B)
+      c.clock.step(1)
+
+      read(c, 0x50)._1 should be (wait + 1)
+    }
+  }
+
+  it should "wait again for a repeat of the access it just finished" in {
+    test(new RAM(256, wait, wait)) { c =>
+      write(c, 0x60, 0x0606)
+      start(c, 0x60, false)
+      c.clock.step(wait)
+      c.io.R.expect(true.B)
+      c.clock.step(1)
+
+      // still on the port, same address and direction
+      c.io.R.expect(false.B)
+      c.clock.step(wait)
+      c.io.R.expect(true.B)
+      c.io.dataOut.expect(0x0606.U)
+    }
+  }
+
+  it should "keep every access's wait states within its bounds" in {
+    val (lo, hi) = (1, 6)
+    test(new RAM(256, lo, hi)) { c =>
+      val seen = scala.collection.mutable.Set[Int]()
+      for (i <- 0 until 200) {
+        val a = i % 16
+        val (n, _) = if (i % 3 == 0) write(c, a, i) else read(c, a)
+        n should be >= (lo + 1)
+        n should be <= (hi + 1)
+        seen += n
+      }
+      seen.size should be > (1)
+    }
+  }
+}
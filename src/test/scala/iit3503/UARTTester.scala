@@ -0,0 +1,177 @@
+package iit3503
+
+import chisel3._
+import chisel3.util._
+import chiseltest._
+import chiseltest.experimental.TestOptionBuilder._
+import org.scalatest._
+import org.scalatest.flatspec.AnyFlatSpec
+import org.scalatest.matchers.should.Matchers
+
+class UARTTester extends AnyFlatSpec with ChiselScalatestTester with Matchers {
+  behavior of "Serial Out FIFO"
+
+  // 4 cycles per bit keeps frames short (12 bits = 48 cycles)
+  val freq  = 4
+  val baud  = 1
+  val depth = 4
+  val low   = 1
+
+  def txd(c: FifoTx) = c.io.txd.peek().litValue().toInt
+
+  // hand over as many characters as the FIFO will take without
+  // waiting on the line; returns how many that was
+  def burst(c: FifoTx, s: String) : Int = {
+    var n = 0
+    while (n < s.length && c.io.channel.ready.peek().litToBoolean) {
+      c.io.channel.valid.poke(true.B)
+      c.io.channel.bits.poke(s(n).toInt.U)
+      c.clock.step(1)
+      n += 1
+    }
+    c.io.channel.valid.poke(false.B)
+    n
+  }
+
+  // decode one frame off the line (like the harness does)
+  def recv(c: FifoTx) : Int = {
+    var wait = 0
+    while (txd(c) == 1) {
+      c.clock.step(1)
+      wait += 1
+      wait should be < (1000)
+    }
+    c.clock.step(2) // middle of the start bit
+    var v = 0
+    for (i <- 0 until 8) {
+      c.clock.step(4)
+      v |= txd(c) << i
+    }
+    c.clock.step(4)
+    txd(c) should be (1) // stop bit
+    v
+  }
+
+  it should "only accept characters while it isn't full" in {
+    test(new FifoTx(freq, baud, depth, low)) { c =>
+      // the line is still busy counting out its first (idle)
+      // bit period, so all of these have to wait in the FIFO
+      burst(c, "abcdefgh") should be (depth)
+      c.io.channel.ready.expect(false.B)
+      c.io.low.expect(false.B)
+      c.io.idle.expect(false.B)
+    }
+  }
+
+  it should "send characters in order" in {
+    test(new FifoTx(freq, baud, depth, low)) { c =>
+      val msg = "Hi!"
+      burst(c, msg) should be (msg.length)
+      for (ch <- msg) {
+        recv(c) should be (ch.toInt)
+      }
+    }
+  }
+
+  it should "signal low before it goes idle" in {
+    test(new FifoTx(freq, baud, depth, low)) { c =>
+      c.io.low.expect(true.B)
+      c.io.idle.expect(true.B)
+      burst(c, "1234") should be (4)
+      var cycles  = 0
+      var sawLow  = false
+      while (!c.io.idle.peek().litToBoolean && cycles < 1000) {
+        if (c.io.low.peek().litToBoolean) {
+          sawLow = true
+        }
+        c.clock.step(1)
+        cycles += 1
+      }
+      sawLow should be (true)
+      c.io.idle.expect(true.B)
+      c.io.low.expect(true.B)
+      c.io.channel.ready.expect(true.B)
+      // 4 frames of 12 bits
+      cycles should be >= (4 * 12 * 4 - 8)
+    }
+  }
+
+  behavior of "Keyboard In FIFO"
+
+  // drive one frame onto the line: start bit, data, stop bit
+  def send(c: FifoRx, b: Int) = {
+    val bits = Seq(0) ++ (0 until 8).map(i => (b >> i) & 1) ++ Seq(1, 1)
+    for (bit <- bits) {
+      c.io.rxd.poke(bit.U)
+      c.clock.step(4)
+    }
+  }
+
+  def inject(c: FifoRx, b: Int) = {
+    c.io.inject.valid.poke(true.B)
+    c.io.inject.bits.poke(b.U)
+    c.clock.step(1)
+    c.io.inject.valid.poke(false.B)
+  }
+
+  it should "receive characters off the line in order" in {
+    test(new FifoRx(freq, baud, depth)) { c =>
+      c.io.rxd.poke(1.U)
+      c.io.threshold.poke(1.U)
+      c.io.timeout.poke(0.U)
+      c.clock.step(8)
+      c.io.channel.valid.expect(false.B)
+      send(c, 'O'.toInt)
+      send(c, 'K'.toInt)
+      c.clock.step(4)
+      c.io.level.expect(2.U)
+      c.io.channel.valid.expect(true.B)
+      c.io.channel.bits.expect('O'.toInt.U)
+      c.io.channel.ready.poke(true.B) // KBDR read
+      c.clock.step(1)
+      c.io.channel.ready.poke(false.B)
+      c.io.level.expect(1.U)
+      c.io.channel.bits.expect('K'.toInt.U)
+    }
+  }
+
+  it should "drop characters once the FIFO is full" in {
+    test(new FifoRx(freq, baud, depth)) { c =>
+      c.io.rxd.poke(1.U)
+      for (i <- 0 until depth + 2) {
+        inject(c, 0x30 + i)
+      }
+      c.io.level.expect(depth.U)
+      c.io.channel.bits.expect(0x30.U)
+    }
+  }
+
+  it should "only interrupt once threshold characters are waiting" in {
+    test(new FifoRx(freq, baud, depth)) { c =>
+      c.io.rxd.poke(1.U)
+      c.io.threshold.poke(3.U)
+      c.io.timeout.poke(0.U)
+      inject(c, 1)
+      inject(c, 2)
+      c.clock.step(100)
+      c.io.due.expect(false.B)
+      inject(c, 3)
+      c.io.due.expect(true.B)
+    }
+  }
+
+  it should "interrupt once the line has been quiet for the timeout" in {
+    test(new FifoRx(freq, baud, depth)) { c =>
+      c.io.rxd.poke(1.U)
+      c.io.threshold.poke(3.U)
+      c.io.timeout.poke(3.U) // bit times
+      c.clock.step(20)
+      c.io.due.expect(false.B) // nothing to time out on
+      inject(c, 1)
+      c.clock.step(8)
+      c.io.due.expect(false.B)
+      c.clock.step(8)
+      c.io.due.expect(true.B)
+    }
+  }
+}
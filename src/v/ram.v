@@ -1,10 +1,35 @@
 `define RAMWIDTH 16
-import "DPI-C" function void extern_ram(input bit en, 
-                                        input bit wEn, 
-                                        input shortint dataIn, 
-                                        input shortint addr, 
-                                        output shortint dataOut, 
-                                        output bit R);
+
+/*
+ * Single-cycle handshake: address, enable and write enable are
+ * held by the memory controller until R is asserted. Read data
+ * (and R) come back combinationally for whatever is on the port.
+ * A write lands at the clock edge where R is asserted. With no
+ * wait states, that means every access completes in the cycle
+ * it starts in.
+ *
+ * There are two versions of the memory behind the port:
+ *
+ *  - by default, it lives in the simulator (src/cpp/ram.cpp) and
+ *    every access goes out through DPI. The host sees every write
+ *    as it happens, so RAM can be shared (--shm).
+ *
+ *  - with IIT3503_RAM_ARRAY (make RAM_MODEL=array), it's an array
+ *    in here that Verilator compiles into the model, and nothing
+ *    leaves the model per cycle. The host gets at it only through
+ *    the ram_backdoor_* functions (loading images, peek/poke).
+ */
+
+`ifndef IIT3503_RAM_ARRAY
+import "DPI-C" function void extern_ram_read(input bit en,
+                                             input shortint addr,
+                                             input byte waited,
+                                             output shortint dataOut,
+                                             output bit R);
+import "DPI-C" function void extern_ram_commit(input bit wEn,
+                                               input shortint dataIn,
+                                               input shortint addr);
+`endif
 
 module ExternalRAM(
   input  clk,
@@ -12,12 +37,92 @@ module ExternalRAM(
   input  wEn,
   input  [`RAMWIDTH-1:0] dataIn,
   input  [`RAMWIDTH-1:0] addr,
-  output [`RAMWIDTH-1:0] dataOut,
-  output R
+  output reg [`RAMWIDTH-1:0] dataOut,
+  output reg R
 );
 
+  // cycles the access on the port has been held without R (its
+  // wait states so far). Changing the address or direction before
+  // R abandons the old access and starts a new one.
+  reg [7:0] held = 0;
+  reg [`RAMWIDTH-1:0] heldAddr = 0;
+  reg heldWEn = 0;
+
+  wire [7:0] waited = (addr == heldAddr && wEn == heldWEn) ? held : 8'd0;
+
+`ifdef IIT3503_RAM_ARRAY
+
+  reg [`RAMWIDTH-1:0] mem [0:65535];
+
+  // every access takes waitMin..waitMax extra cycles, picked from
+  // an LFSR (stepped once per access) when the access starts. These
+  // two are only ever set through the backdoor, so they mustn't
+  // have initializers (those run at the first eval, after it).
+  reg [7:0]  waitMin;
+  reg [7:0]  waitMax;
+  reg [7:0]  need    = 0;
+  reg [15:0] lfsr    = 16'hACE1;
+
+  wire [8:0] span  = {1'b0, waitMax} - {1'b0, waitMin} + 9'd1;
+  wire [7:0] needs = (waited == 0) ? waitMin + (lfsr % span) : need;
+
+  always @(*) begin
+    dataOut = en ? mem[addr] : 0;
+    R       = en && waited >= needs;
+  end
+
   always @(posedge clk) begin
-    extern_ram(en, wEn, dataIn, addr, dataOut, R);
+    heldAddr <= addr;
+    heldWEn  <= wEn;
+    need     <= needs;
+    if (en && R) begin
+      if (wEn)
+        mem[addr] <= dataIn;
+      lfsr <= {lfsr[14:0], lfsr[15] ^ lfsr[13] ^ lfsr[12] ^ lfsr[10]};
+      held <= 0;
+    end else if (en) begin
+      held <= waited + 1;
+    end else begin
+      held <= 0;
+    end
   end
 
+  export "DPI-C" function ram_backdoor_read;
+  export "DPI-C" function ram_backdoor_write;
+  export "DPI-C" function ram_backdoor_wait;
+
+  function shortint ram_backdoor_read(input shortint a);
+    ram_backdoor_read = mem[$unsigned(a)];
+  endfunction
+
+  function void ram_backdoor_write(input shortint a, input shortint d);
+    mem[$unsigned(a)] = d;
+  endfunction
+
+  function void ram_backdoor_wait(input byte min, input byte max);
+    waitMin = min;
+    waitMax = max;
+  endfunction
+
+`else
+
+  always @(*) begin
+    extern_ram_read(en, addr, waited, dataOut, R);
+  end
+
+  always @(posedge clk) begin
+    heldAddr <= addr;
+    heldWEn  <= wEn;
+    if (en && R) begin
+      extern_ram_commit(wEn, dataIn, addr);
+      held <= 0;
+    end else if (en) begin
+      held <= waited + 1;
+    end else begin
+      held <= 0;
+    end
+  end
+
+`endif
+
 endmodule
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+#
+# Summarize a nextpnr timing report (nextpnr-ice40 --report, see
+# `make timing`) by Chisel module. yosys flattens the design but
+# keeps the instance path in each cell's name (core0.dataPath.bus...,
+# core0.ctrlUnit.ctrlStore..., arb...), so every hop on a
+# critical path can be pinned on the module it sits in.
+#
+#   tools/critpath.py Top_timing.json [-n paths] [-d depth]
+#
+import argparse
+import json
+import sys
+from collections import OrderedDict
+
+
+def module_of(cell, depth):
+    # "core0.dataPath.ALU.io_out_SB_LUT4_O" -> "core0.dataPath.ALU"
+    parts = cell.lstrip("\\$").split(".")[:-1]
+    if not parts:
+        return "Top"
+    return ".".join(parts[:depth])
+
+
+def by_module(path, depth):
+    # delay per module, in path order (logic delay goes to the
+    # cell's module, routing to the module of the cell it feeds)
+    mods = OrderedDict()
+    for hop in path:
+        cell = hop["to"]["cell"] if hop["type"] == "routing" else hop["from"]["cell"]
+        m = module_of(cell, depth)
+        mods[m] = mods.get(m, 0.0) + hop["delay"]
+    return mods
+
+
+def main():
+    ap = argparse.ArgumentParser(description="nextpnr critical paths by Chisel module")
+    ap.add_argument("report")
+    ap.add_argument("-n", type=int, default=3, help="critical paths to show")
+    ap.add_argument("-d", type=int, default=3, help="module path depth to group by")
+    args = ap.parse_args()
+
+    with open(args.report) as f:
+        rpt = json.load(f)
+
+    for clk, f in rpt.get("fmax", {}).items():
+        status = "ok" if f["achieved"] >= f["constraint"] else "FAILS"
+        print(f"{clk}: {f['achieved']:.2f} MHz (target {f['constraint']:.2f} MHz) {status}")
+
+    paths = sorted(rpt.get("critical_paths", []),
+                   key=lambda p: -sum(h["delay"] for h in p["path"]))
+
+    totals = {}
+    for i, p in enumerate(paths):
+        hops  = p["path"]
+        total = sum(h["delay"] for h in hops)
+        mods  = by_module(hops, args.d)
+        for m, d in mods.items():
+            totals[m] = totals.get(m, 0.0) + d
+        if i >= args.n:
+            continue
+        print()
+        print(f"{p['from']} -> {p['to']}: {total:.2f} ns, {len(hops)} hops")
+        print(f"  from {hops[0]['from']['cell']}")
+        print(f"  to   {hops[-1]['to']['cell']}")
+        for m, d in mods.items():
+            print(f"    {d:6.2f} ns  {100 * d / total:5.1f}%  {m}")
+
+    if totals:
+        print()
+        print("all reported paths, by module:")
+        for m, d in sorted(totals.items(), key=lambda kv: -kv[1]):
+            print(f"  {d:8.2f} ns  {m}")
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
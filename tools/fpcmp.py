@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+#
+# Compare two state fingerprint files (driver --fingerprint, see
+# src/cpp/fingerprint.h) and find the first interval the runs
+# disagree in. Once two runs' states differ they practically never
+# agree again, so that's a binary search rather than a scan.
+#
+#   tools/fpcmp.py a.fp b.fp
+#
+# Exits 0 if the files agree (as far as the shorter one goes), 1 if
+# they don't, and 2 if they can't be compared.
+#
+import argparse
+import mmap
+import struct
+import sys
+
+MAGIC  = b"I3503FP1"
+HEADER = struct.Struct("<8sQ")
+RECORD = struct.Struct("<QQQ")  # instructions, cycles, hash
+
+
+class Fingerprints:
+    def __init__(self, path):
+        self.path = path
+        with open(path, "rb") as f:
+            self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        if len(self.data) < HEADER.size:
+            raise ValueError("%s: not a fingerprint file" % path)
+        magic, self.every = HEADER.unpack_from(self.data, 0)
+        if magic != MAGIC:
+            raise ValueError("%s: not a fingerprint file" % path)
+
+        self.count = (len(self.data) - HEADER.size) // RECORD.size
+
+    def __len__(self):
+        return self.count
+
+    def __getitem__(self, i):
+        return RECORD.unpack_from(self.data, HEADER.size + i * RECORD.size)
+
+
+def same(a, b, i):
+    # the instruction counts too, in case an interval went missing
+    ra, rb = a[i], b[i]
+    return ra[0] == rb[0] and ra[2] == rb[2]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Find the first interval two fingerprint files disagree in")
+    ap.add_argument("a")
+    ap.add_argument("b")
+    args = ap.parse_args()
+
+    try:
+        a = Fingerprints(args.a)
+        b = Fingerprints(args.b)
+    except (OSError, ValueError) as e:
+        print(e, file=sys.stderr)
+        return 2
+
+    if a.every != b.every:
+        print("%s has a fingerprint every %d instructions, %s every %d: they can't be compared"
+              % (a.path, a.every, b.path, b.every), file=sys.stderr)
+        return 2
+
+    n = min(len(a), len(b))
+    if n == 0 or same(a, b, n - 1):
+        print("The runs agree for %d fingerprints (%d instructions)%s"
+              % (n, a[n - 1][0] if n else 0,
+                 "" if len(a) == len(b) else "; one ran longer"))
+        return 0
+
+    # the first record that differs
+    lo, hi = 0, n - 1
+    while lo < hi:
+        mid = (lo + hi) // 2
+        if same(a, b, mid):
+            lo = mid + 1
+        else:
+            hi = mid
+
+    start = a[lo - 1][0] if lo else 0
+    end   = a[lo][0]
+    print("First divergence: between instructions %d and %d" % (start, end))
+    print("  %s: cycles %d..%d" % (a.path, a[lo - 1][1] if lo else 0, a[lo][1]))
+    print("  %s: cycles %d..%d" % (b.path, b[lo - 1][1] if lo else 0, b[lo][1]))
+    print("Re-run just that interval with: --trace <vcd> --trace-window %d:%d" % (start, end))
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,189 @@
+#
+# Thin ctypes binding for libiit3503 (see src/cpp/libiit3503.h).
+#
+#   from iit3503 import Machine
+#   m = Machine(image="binaries/simple_add.bin")
+#   m.run_until(0x3005, 10000)
+#   print(m.regs().r[0])
+#
+import ctypes
+import os
+
+STOP_PC    = 0
+STOP_HALT  = 1
+STOP_LIMIT = 2
+
+HISTORY_LEN = 256
+
+RETIRE_REG   = 0x01
+RETIRE_LOAD  = 0x02
+RETIRE_STORE = 0x04
+RETIRE_INT   = 0x08
+RETIRE_EXCP  = 0x10
+
+_here = os.path.dirname(os.path.abspath(__file__))
+_lib  = ctypes.CDLL(os.environ.get("IIT3503_LIB", os.path.join(_here, "..", "build", "libiit3503.so")))
+
+
+class Config(ctypes.Structure):
+    _fields_ = [("image",       ctypes.c_char_p),
+                ("os_image",    ctypes.c_char_p),
+                ("trace",       ctypes.c_char_p),
+                ("shm",         ctypes.c_char_p),
+                ("shm_is_file", ctypes.c_bool),
+                ("entry",       ctypes.c_uint16),
+                ("ram_wait_min", ctypes.c_uint8),
+                ("ram_wait_max", ctypes.c_uint8),
+                ("ap_entry",    ctypes.c_uint16),
+                ("disk",        ctypes.c_char_p),
+                ("disk_latency", ctypes.c_uint32),
+                ("lockstep",    ctypes.c_bool),
+                ("fingerprint", ctypes.c_char_p),
+                ("fingerprint_every", ctypes.c_uint64)]
+
+
+class Regs(ctypes.Structure):
+    _fields_ = [("r",      ctypes.c_uint16 * 8),
+                ("pc",     ctypes.c_uint16),
+                ("ir",     ctypes.c_uint16),
+                ("psr",    ctypes.c_uint16),
+                ("upc",    ctypes.c_uint16),
+                ("mar",    ctypes.c_uint16),
+                ("mdr",    ctypes.c_uint16),
+                ("mcr",    ctypes.c_uint16),
+                ("cycles", ctypes.c_uint64),
+                ("instrs", ctypes.c_uint64),
+                ("icache_hits",   ctypes.c_uint32),
+                ("icache_misses", ctypes.c_uint32)]
+
+
+class Stats(ctypes.Structure):
+    _fields_ = [("cycles",       ctypes.c_uint64),
+                ("instrs",       ctypes.c_uint64),
+                ("wall_secs",    ctypes.c_double),
+                ("eval_secs",    ctypes.c_double),
+                ("trace_secs",   ctypes.c_double),
+                ("harness_secs", ctypes.c_double),
+                ("irqs_raised",  ctypes.c_uint64),
+                ("irqs_taken",   ctypes.c_uint64),
+                ("uart_out",     ctypes.c_uint64),
+                ("uart_in",      ctypes.c_uint64)]
+
+
+class Retire(ctypes.Structure):
+    _fields_ = [("cycle",    ctypes.c_uint64),
+                ("pc",       ctypes.c_uint16),
+                ("ir",       ctypes.c_uint16),
+                ("psr",      ctypes.c_uint16),
+                ("flags",    ctypes.c_uint8),
+                ("reg",      ctypes.c_uint8),
+                ("reg_val",  ctypes.c_uint16),
+                ("mem_addr", ctypes.c_uint16),
+                ("mem_data", ctypes.c_uint16)]
+
+
+_lib.iit3503_init.restype        = ctypes.c_void_p
+_lib.iit3503_init.argtypes       = [ctypes.POINTER(Config)]
+_lib.iit3503_deinit.argtypes     = [ctypes.c_void_p]
+_lib.iit3503_reset.argtypes      = [ctypes.c_void_p]
+_lib.iit3503_step_cycle.restype  = ctypes.c_bool
+_lib.iit3503_step_cycle.argtypes = [ctypes.c_void_p, ctypes.c_bool]
+_lib.iit3503_step_instr.restype  = ctypes.c_bool
+_lib.iit3503_step_instr.argtypes = [ctypes.c_void_p, ctypes.c_bool]
+_lib.iit3503_run_until.restype   = ctypes.c_int
+_lib.iit3503_run_until.argtypes  = [ctypes.c_void_p, ctypes.c_uint16, ctypes.c_uint64]
+_lib.iit3503_read_regs.argtypes  = [ctypes.c_void_p, ctypes.POINTER(Regs)]
+_lib.iit3503_read_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(Stats)]
+_lib.iit3503_read_mem.argtypes   = [ctypes.c_void_p, ctypes.c_uint16, ctypes.POINTER(ctypes.c_uint16), ctypes.c_size_t]
+_lib.iit3503_write_mem.argtypes  = [ctypes.c_void_p, ctypes.c_uint16, ctypes.POINTER(ctypes.c_uint16), ctypes.c_size_t]
+_lib.iit3503_raise_irq.argtypes  = [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_uint8, ctypes.c_uint16]
+_lib.iit3503_num_cores.restype   = ctypes.c_uint
+_lib.iit3503_select_core.restype = ctypes.c_bool
+_lib.iit3503_select_core.argtypes = [ctypes.c_void_p, ctypes.c_uint]
+_lib.iit3503_read_uart.restype   = ctypes.c_size_t
+_lib.iit3503_read_uart.argtypes  = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+_lib.iit3503_diverged.restype    = ctypes.c_uint64
+_lib.iit3503_diverged.argtypes   = [ctypes.c_void_p]
+_lib.iit3503_history.restype     = ctypes.c_size_t
+_lib.iit3503_history.argtypes    = [ctypes.c_void_p, ctypes.POINTER(Retire), ctypes.c_size_t]
+
+
+def _enc(s):
+    return s.encode() if s is not None else None
+
+
+class Machine:
+    def __init__(self, image=None, os_image=None, trace=None, entry=0x3000, ram_wait=(0, 0),
+                 ap_entry=0x3000, disk=None, disk_latency=256, lockstep=False,
+                 fingerprint=None, fingerprint_every=10000):
+        cfg = Config(_enc(image), _enc(os_image), _enc(trace), None, False, entry,
+                     ram_wait[0], ram_wait[1], ap_entry, _enc(disk), disk_latency, lockstep,
+                     _enc(fingerprint), fingerprint_every)
+        self.h = _lib.iit3503_init(ctypes.byref(cfg))
+        if not self.h:
+            raise RuntimeError("could not create iit3503 instance")
+        _lib.iit3503_reset(self.h)
+
+    def close(self):
+        if self.h:
+            _lib.iit3503_deinit(self.h)
+            self.h = None
+
+    def __del__(self):
+        self.close()
+
+    def reset(self):
+        _lib.iit3503_reset(self.h)
+
+    def step_cycle(self):
+        return _lib.iit3503_step_cycle(self.h, False)
+
+    def step_instr(self):
+        return _lib.iit3503_step_instr(self.h, False)
+
+    def run_until(self, pc, max_cycles):
+        return _lib.iit3503_run_until(self.h, pc, max_cycles)
+
+    def cores(self):
+        return _lib.iit3503_num_cores()
+
+    def select_core(self, core):
+        if not _lib.iit3503_select_core(self.h, core):
+            raise ValueError("no core %d" % core)
+
+    def regs(self):
+        r = Regs()
+        _lib.iit3503_read_regs(self.h, ctypes.byref(r))
+        return r
+
+    def stats(self):
+        st = Stats()
+        _lib.iit3503_read_stats(self.h, ctypes.byref(st))
+        return st
+
+    def diverged(self):
+        # cycle the RTL and the microcode model first disagreed at, or 0
+        return _lib.iit3503_diverged(self.h)
+
+    def history(self, n=HISTORY_LEN):
+        # the flight recorder's last n Retire records, oldest first
+        buf = (Retire * n)()
+        got = _lib.iit3503_history(self.h, buf, n)
+        return list(buf[:got])
+
+    def read_mem(self, addr, count=1):
+        buf = (ctypes.c_uint16 * count)()
+        _lib.iit3503_read_mem(self.h, addr, buf, count)
+        return list(buf)
+
+    def write_mem(self, addr, words):
+        buf = (ctypes.c_uint16 * len(words))(*words)
+        _lib.iit3503_write_mem(self.h, addr, buf, len(words))
+
+    def raise_irq(self, irq, priority, data):
+        _lib.iit3503_raise_irq(self.h, irq, priority, data)
+
+    def uart_output(self):
+        buf = ctypes.create_string_buffer(4096)
+        n = _lib.iit3503_read_uart(self.h, buf, len(buf))
+        return buf.raw[:n].decode(errors="replace")
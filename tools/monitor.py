@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+#
+# Live monitor for a running iit3503 simulation. Start the
+# simulator with --shm <name> (or --ram-file <path>) and point
+# this at the same name. Nothing here stops or slows the sim;
+# we just read the shared status page.
+#
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+STATUS_MAGIC = 0x33353033
+STATUS_FMT   = "<IIIHHHH8H4xQQB"
+STATUS_LEN   = struct.calcsize(STATUS_FMT)
+
+
+def open_status(name, is_file):
+    path = name + ".status"
+    if not is_file:
+        path = "/dev/shm/" + path.lstrip("/")
+    fd = os.open(path, os.O_RDONLY)
+    m  = mmap.mmap(fd, 4096, mmap.MAP_SHARED, mmap.PROT_READ)
+    os.close(fd)
+    return m
+
+
+def snapshot(m):
+    # seqlock read: retry while a writer is mid-update
+    while True:
+        seq0 = struct.unpack_from("<I", m, 8)[0]
+        st   = struct.unpack_from(STATUS_FMT, m, 0)
+        seq1 = struct.unpack_from("<I", m, 8)[0]
+        if seq0 == seq1 and not (seq0 & 1):
+            return st
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Watch a running iit3503 simulation")
+    parser.add_argument("name", help="shared memory name (or file path with -f)")
+    parser.add_argument("-f", "--file", action="store_true", help="name is an mmap'd file path")
+    parser.add_argument("-i", "--interval", type=float, default=0.5, help="refresh interval (seconds)")
+    args = parser.parse_args()
+
+    m = open_status(args.name, args.file)
+
+    if struct.unpack_from("<I", m, 0)[0] != STATUS_MAGIC:
+        print("Not an iit3503 status page")
+        sys.exit(1)
+
+    last_cycles = 0
+    while True:
+        st = snapshot(m)
+        pc, ir, psr, upc = st[3:7]
+        regs = st[7:15]
+        cycles, instrs, halted = st[15:18]
+        rate = (cycles - last_cycles) / args.interval
+        last_cycles = cycles
+
+        print("PC=x%04x IR=x%04x PSR=x%04x uPC=%-2u cycles=%u instrs=%u (%.2f MHz)%s" %
+              (pc, ir, psr, upc, cycles, instrs, rate / 1e6, " HALTED" if halted else ""))
+        print("  " + " ".join("R%d=x%04x" % (i, r) for i, r in enumerate(regs)))
+
+        if halted:
+            break
+        time.sleep(args.interval)
+
+
+if __name__ == "__main__":
+    main()
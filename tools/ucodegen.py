@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+#
+# Generate the C++ microcode model's tables (src/cpp/ucode.cpp) from
+# the Chisel sources, so the model runs whatever microcode the RTL
+# does. From ControlStore.scala it takes the fields of CtrlFeedback
+# and CtrlSigs and every row of the control store; from Control.scala
+# and MicroSequencer.scala, the handful of states the control unit
+# treats specially (reset, the IFETCH read, INT ACK).
+#
+# Rows that ControlStore.scala still leaves to be filled in (the
+# "FILL ME IN" ones) go out as written, and the header defines
+# UCODE_UNFINISHED to the list of them, so the simulator still builds
+# but the model refuses to run (see ucode_create()) until they're done.
+#
+#   tools/ucodegen.py -o build/gen/ucode_rom.h ControlStore.scala Control.scala MicroSequencer.scala
+#
+# The rows are read the way they're written in ControlStore.scala:
+#
+#   val c27 = 0.U.asTypeOf(new MicroInstr)
+#   c27.feed.J := 18.U
+#   c27.sigs.LDCC := true.B
+#   cStore(27) := c27
+#
+import argparse
+import os
+import re
+import sys
+
+ROWS = 64
+
+def die(path, lineno, msg):
+    sys.exit(f"{path}:{lineno}: {msg}")
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", lambda m: "\n" * m.group(0).count("\n"), text, flags=re.S)
+    return [re.sub(r"//.*", "", l) for l in text.split("\n")]
+
+
+def bundle_fields(lines, path, name):
+    # "class CtrlSigs extends Bundle {" ... "}" -> [(field, width)]
+    start = None
+    for i, l in enumerate(lines):
+        if re.match(rf"\s*class\s+{name}\s+extends\s+Bundle\s*\{{", l):
+            start = i
+            break
+    if start is None:
+        die(path, 0, f"no Bundle {name}")
+
+    fields = []
+    for i in range(start + 1, len(lines)):
+        l = lines[i]
+        if re.match(r"\s*\}", l):
+            return fields
+        m = re.match(r"\s*val\s+(\w+)\s*=\s*(Bool\(\)|UInt\((\d+)\.W\))", l)
+        if m:
+            fields.append((m.group(1), 1 if m.group(2) == "Bool()" else int(m.group(3))))
+        elif l.strip():
+            die(path, i + 1, f"can't read {name} field: {l.strip()}")
+    die(path, start + 1, f"unterminated Bundle {name}")
+
+
+def literal(s, path, lineno):
+    s = s.strip()
+    if s == "true.B":
+        return 1
+    if s == "false.B":
+        return 0
+    m = re.fullmatch(r"(\d+)\.U", s)
+    if m:
+        return int(m.group(1))
+    m = re.fullmatch(r'"([bhd])([0-9a-fA-F_]+)"\.U', s)
+    if m:
+        return int(m.group(2).replace("_", ""), {"b": 2, "h": 16, "d": 10}[m.group(1)])
+    die(path, lineno, f"can't read value '{s}'")
+
+
+def control_store(path, feed, sigs):
+    with open(path) as f:
+        text = f.read()
+    lines = strip_comments(text)
+    raw = text.split("\n")
+
+    widths = {("feed", n): w for n, w in feed}
+    widths.update({("sigs", n): w for n, w in sigs})
+
+    vals = {}           # cNN -> {(part, field): value}
+    rom = [None] * ROWS  # row -> cNN
+    unfinished = set()  # cNNs with a FILL ME IN
+    last = None
+
+    for i, l in enumerate(lines):
+        lineno = i + 1
+        if "FILL ME IN" in raw[i] and last:
+            unfinished.add(last)
+        m = re.match(r"\s*val\s+(\w+)\s*=\s*0\.U\.asTypeOf\(new MicroInstr\)", l)
+        if m:
+            vals[m.group(1)] = {}
+            last = m.group(1)
+            continue
+        m = re.match(r"\s*(\w+)\.(feed|sigs)\.(\w+)\s*:=\s*(.+?)\s*$", l)
+        if m:
+            row, part, field, v = m.groups()
+            if row not in vals:
+                die(path, lineno, f"{row} assigned before it's declared")
+            if (part, field) not in widths:
+                die(path, lineno, f"no such field {part}.{field}")
+            v = literal(v, path, lineno)
+            if v >> widths[(part, field)]:
+                die(path, lineno, f"{v} doesn't fit in {part}.{field}")
+            vals[row][(part, field)] = v
+            continue
+        m = re.match(r"\s*cStore\((\d+)\)\s*:=\s*(\w+)\s*$", l)
+        if m:
+            n, row = int(m.group(1)), m.group(2)
+            if n >= ROWS or row not in vals:
+                die(path, lineno, f"bad control store row: {l.strip()}")
+            rom[n] = row
+
+    rows = [dict(vals[r]) if r else {} for r in rom]
+    todo = [n for n, r in enumerate(rom) if r in unfinished]
+
+    return rows, todo
+
+
+def constant(path, pattern, what):
+    with open(path) as f:
+        text = "\n".join(strip_comments(f.read()))
+    m = re.search(pattern, text)
+    if not m:
+        sys.exit(f"{path}: can't find {what}")
+    return int(m.group(1))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="C++ microcode tables from the Chisel control unit")
+    ap.add_argument("-o", "--output", required=True)
+    ap.add_argument("control_store", help="ControlStore.scala")
+    ap.add_argument("control", help="Control.scala")
+    ap.add_argument("useq", help="MicroSequencer.scala")
+    args = ap.parse_args()
+
+    with open(args.control_store) as f:
+        lines = strip_comments(f.read())
+    feed = bundle_fields(lines, args.control_store, "CtrlFeedback")
+    sigs = bundle_fields(lines, args.control_store, "CtrlSigs")
+    rows, todo = control_store(args.control_store, feed, sigs)
+
+    consts = [
+        ("UCODE_RESET_UPC", constant(args.control, r"val\s+uPC\s*=\s*RegInit\((\d+)\.U", "uPC's reset value"),
+         "where uPC comes out of reset"),
+        ("UCODE_FETCH_READ_UPC", constant(args.control, r"io\.ifetch\s*:=\s*uPC\s*===\s*(\d+)\.U", "the IFETCH read state"),
+         "the IFETCH read (the I-cache only looks these up)"),
+        ("UCODE_INTACK_UPC", constant(args.control, r"io\.intAck\s*:=\s*uPC\s*===\s*(\d+)\.U", "the INT ACK state"),
+         "acknowledges the interrupt being taken"),
+        ("UCODE_INT_UPC", constant(args.useq, r"Mux\(fetch\s*&\s*io\.INT,\s*(\d+)\.U", "the interrupt entry"),
+         "where IFETCH goes when an interrupt is pending"),
+    ]
+
+    fields = feed + sigs
+    src = os.path.basename(args.control_store)
+
+    out = []
+    out.append(f"// Generated by tools/ucodegen.py from {src} and friends. Don't edit.")
+    out.append("#ifndef __UCODE_ROM_H__")
+    out.append("#define __UCODE_ROM_H__")
+    out.append("#include <stdint.h>")
+    out.append("")
+    for name, v, what in consts:
+        out.append(f"#define {name} {v} // {what}")
+    out.append("")
+    if todo:
+        out.append(f"// still FILL ME IN in {src}; the model won't run on these")
+        out.append(f"#define UCODE_UNFINISHED \"{', '.join(str(n) for n in todo)}\"")
+        out.append("")
+    out.append("// one row of the control store: CtrlFeedback, then CtrlSigs")
+    out.append("typedef struct ucode_row {")
+    for name, w in fields:
+        out.append(f"    uint8_t {name}; // {w} bit{'s' if w > 1 else ''}")
+    out.append("} ucode_row_t;")
+    out.append("")
+    out.append(f"static const ucode_row_t ucode_rom[{ROWS}] = {{")
+    for n, r in enumerate(rows):
+        vals = [str(r.get(("feed", f), 0)) for f, _ in feed] + \
+               [str(r.get(("sigs", f), 0)) for f, _ in sigs]
+        note = " // FILL ME IN" if n in todo else ""
+        out.append(f"    /* {n:2} */ {{ {', '.join(vals)} }},{note}")
+    out.append("};")
+    out.append("")
+    out.append("#endif")
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    tmp = args.output + ".tmp"
+    with open(tmp, "w") as f:
+        f.write("\n".join(out) + "\n")
+    os.replace(tmp, args.output)
+
+
+if __name__ == "__main__":
+    main()